@@ -246,10 +246,6 @@ unsigned int APDS9300_ReadWordReg(char reg)
  */
 unsigned int APDS9300_ReadWord(void)
 {
-	char buff[2] = {0x00,0x00};
-	bcm2835_i2c_setSlaveAddress(APDS9300ADDR);
-	bcm2835_i2c_read(buff,2);
-	
-
-	return (buff[1] << 8)|buff[0];
+	unsigned int val = I2C_ReadWordPresetPointer(APDS9300ADDR);	//Through i2c.c so it is counted and traced
+	return ((val & 0xFF) << 8)|((val >> 8) & 0xFF);				//The low byte comes first
 }
@@ -0,0 +1,61 @@
+/**
+ * @file Bench_BusStats.c
+ * @brief Measures what BUS_STATS_START and BUS_STATS_RECORD add to every bus transaction.
+ *
+ * Usage: ./Bench_BusStats [transactions]
+ * Records transactions for the five sensors without touching the bus, then prints the overhead per
+ * transaction and the resulting dump. Needs no hardware.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Utilities.h"
+#include "BusStats.h"
+
+int main(int argc, char **argv)
+{
+#ifndef BUS_STATS
+	BusStats_Dump(stdout);					//Says how to enable them
+	return 1;
+#else
+	static const unsigned int address[] = {0x1E, 0x28, 0x29, 0x60, 0x6F};
+	unsigned long transactions = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000000UL;
+	volatile uint8_t reason = 0;
+
+	volatile uint64_t sink = 0;
+	uint64_t start = timestamp_ns();
+	for(unsigned long i = 0; i < transactions; i++)
+	{
+		sink += BusStats_Ticks();
+	}
+	double clock_ns = (double)(timestamp_ns() - start) / transactions;
+
+	start = timestamp_ns();
+	for(unsigned long i = 0; i < transactions; i++)
+	{
+		BUS_STATS_START(t);
+		BUS_STATS_RECORD(BUS_I2C, address[i % 5], (BusOp_t)(i % BUS_OP_COUNT), 2, reason, t);
+	}
+	double ns = (double)(timestamp_ns() - start) / transactions;
+
+	printf("%.1f ns per recorded transaction, of which %.1f ns are the two clock reads\n", ns, 2 * clock_ns);
+	BusStats_Dump(stdout);
+
+	BusOpStats_t s;
+	uint64_t total = 0;
+	for(int d = 0; d < 5; d++)
+	{
+		for(int op = 0; op < BUS_OP_COUNT; op++)
+		{
+			BusStats_Get(BUS_I2C, address[d], op, &s);
+			total += s.count;
+		}
+	}
+	if(total != transactions)
+	{
+		printf("Counted %llu transactions, expected %lu\n", (unsigned long long) total, transactions);
+		return 1;
+	}
+	return 0;
+#endif
+}
@@ -0,0 +1,648 @@
+/**
+ * @file Bench_Drivers.c
+ * @brief Measures the bus traffic and CPU time of every poll and config call of the drivers against the
+ *		  fake shield, and fails when they regress past a stored baseline.
+ *
+ * Usage: ./Bench_Drivers [-u] [-t tolerance] [baseline]
+ * Linked with FakeShield.o in place of libbcm2835, so it needs no hardware and never sleeps. Each call is
+ * repeated and reported per call: I2C and SPI transactions and bytes as the fake chips see them, the time
+ * they take on the bus at the configured rates, the time spent in delays and polling, and the CPU time of
+ * the calling thread. Transactions, bytes and bus time are deterministic and must not exceed the baseline
+ * (default Bench_Drivers.baseline). CPU time may exceed it by the tolerance factor (default 2) and is only
+ * compared with a baseline recorded on the same kind of machine. -u rewrites the baseline instead.
+ * Exits with 1 if anything regressed.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include "MPL3115A2.h"
+#include "APDS9300.h"
+#include "CAP1203.h"
+#include "FXOS8700CQ.h"
+#include "MCP79410.h"
+#include "TFT.h"
+#include "TFT_Printer.h"
+#include "SensorsInterface.h"
+#include "SensorAcquire.h"
+#include "SensorPower.h"
+#include "FakeShield.h"
+
+#define BENCH_MAX			128		//Calls in the table below, and baseline entries read
+#define CPU_FLOOR_NS		500		//CPU differences below this are noise, whatever the ratio
+
+/**
+ * @brief A call to measure and how often to repeat it.
+ */
+typedef struct _DriverBench
+{
+	const char *name;
+	void (*run)(void);
+	unsigned int calls;
+} DriverBench_t;
+
+/**
+ * @brief Per call results of a benchmark, or a baseline entry.
+ */
+typedef struct _DriverResult
+{
+	char name[48];
+	double transactions;
+	double bytes;
+	double bus_us;						/**< Modelled I2C and SPI time */
+	double wait_us;						/**< Modelled delays, not compared since setup waits on the real clock */
+	double cpu_ns;
+} DriverResult_t;
+
+static volatile int sink;				/*!< Keeps the getters from being optimized away */
+static SensorSnapshot_t snapshot;
+static Acquisition_t acquisition;
+static rawdata_t accel, mag;
+
+//The calls measured, without arguments
+
+static void benchSetup(void)
+{
+	SetupReport_t r;
+	sink += setupSensorianFast(NULL, SETUP_WAIT_DATA, &r);
+}
+
+static void benchTFTSetup(void)
+{
+	TFT_Setup();
+}
+
+static void benchAmbientLight(void)
+{
+	sink += (int) getAmbientLight();
+}
+
+static void benchPollMPL(void)
+{
+	pollMPL();
+}
+
+static void benchTemperature(void)
+{
+	sink += getTemperature();
+}
+
+static void benchAltitude(void)
+{
+	sink += getAltitude();
+}
+
+static void benchPressure(void)
+{
+	sink += getBarometricPressure();
+}
+
+static void benchPollFXOS(void)
+{
+	pollFXOS();
+}
+
+static void benchMag(void)
+{
+	sink += getMagX() + getMagY() + getMagZ();
+}
+
+static void benchAccel(void)
+{
+	sink += getAccelX() + getAccelY() + getAccelZ();
+}
+
+static void benchPollRTCC(void)
+{
+	poll_rtcc();
+}
+
+static void benchRTCCFields(void)
+{
+	sink += get_rtcc_year() + get_rtcc_month() + get_rtcc_date() + get_rtcc_hour() + get_rtcc_minute()
+			+ get_rtcc_second();
+}
+
+static void benchSetDatetime(void)
+{
+	set_rtcc_datetime(26, 10, 19, 1, 12, 0, 0);
+}
+
+static void benchSetAlarm(void)
+{
+	set_rtcc_alarm(26, 10, 19, 1, 12, 0, 30, 0);
+}
+
+static void benchPollAlarm(void)
+{
+	sink += poll_rtcc_alarm();
+}
+
+static void benchResetAlarm(void)
+{
+	reset_alarm();
+}
+
+static void benchLED(void)
+{
+	orange_led_on();
+	orange_led_off();
+}
+
+static void benchSnapshot(void)
+{
+	sink += getSnapshot(&snapshot);
+}
+
+static void benchSnapshotLight(void)
+{
+	sink += getSnapshotChannels(&snapshot, SENSOR_CHANNEL_BIT(SENSOR_LIGHT));
+}
+
+static void benchAcquireLight(void)
+{
+	sink += Acquire_Device(SENSOR_DEV_APDS9300, &acquisition);
+}
+
+static void benchAcquireMPL(void)
+{
+	sink += Acquire_Device(SENSOR_DEV_MPL3115A2, &acquisition);
+}
+
+static void benchAcquireFXOS(void)
+{
+	sink += Acquire_Device(SENSOR_DEV_FXOS8700CQ, &acquisition);
+}
+
+static void benchAcquireCAP(void)
+{
+	sink += Acquire_Device(SENSOR_DEV_CAP1203, &acquisition);
+}
+
+static void benchAcquireRTCC(void)
+{
+	sink += Acquire_Device(SENSOR_DEV_MCP79410, &acquisition);
+}
+
+static void benchMPLInit(void)
+{
+	MPL3115A2_Initialize();
+}
+
+static void benchMPLAltimeter(void)
+{
+	MPL3115A2_AltimeterMode();
+}
+
+static void benchMPLBarometer(void)
+{
+	MPL3115A2_BarometerMode();
+}
+
+static void benchMPLOneShot(void)
+{
+	MPL3115A2_ToggleOneShot();
+}
+
+static void benchMPLPressure(void)
+{
+	sink += (int) MPL3115A2_ReadBarometricPressure();
+}
+
+static void benchMPLTemperature(void)
+{
+	sink += (int) MPL3115A2_ReadTemperature();
+}
+
+static void benchMPLEvents(void)
+{
+	MPL3115A2_EnableEventFlags();
+}
+
+static void benchLightInit(void)
+{
+	sink += AL_Initialize();
+}
+
+static void benchLightGain(void)
+{
+	sink += AL_SetGain(GAIN_16);
+}
+
+static void benchLightSampling(void)
+{
+	AL_SetSamplingTime(S3);
+}
+
+static void benchLightInterrupt(void)
+{
+	AL_ConfigureInterrupt(1, PER4_OUT_RANGE);
+	AL_Clear_Interrupt();
+}
+
+static void benchLightChannel(void)
+{
+	sink += AL_ReadChannel(CH0);
+}
+
+static void benchTouchInit(void)
+{
+	CAP1203_Initialize();
+}
+
+static void benchTouchSensitivity(void)
+{
+	CAP1203_SetSensitivity(CAP_S1);
+}
+
+static void benchTouchMulti(void)
+{
+	CAP1203_ConfigureMultiTouch(ONE, B1);
+}
+
+static void benchTouchButton(void)
+{
+	sink += CAP1203_ReadPressedButton();
+}
+
+static void benchMotionConfigure(void)
+{
+	FXOS8700CQ_Configure();
+	FXOS8700CQ_ActiveMode();
+}
+
+static void benchMotionAccelConfig(void)
+{
+	FXOS8700CQ_ConfigureAccelerometer();
+}
+
+static void benchMotionMagConfig(void)
+{
+	FXOS8700CQ_ConfigureMagnetometer();
+}
+
+static void benchMotionRange(void)
+{
+	FXOS8700CQ_SetAccelerometerDynamicRange(SCALE4G);
+}
+
+static void benchMotionODR(void)
+{
+	FXOS8700CQ_SetODR(HYB_DATA_RATE_50HZ);
+}
+
+static void benchMotionOrientation(void)
+{
+	FXOS8700CQ_ConfigureOrientation();
+}
+
+static void benchMotionData(void)
+{
+	FXOS8700CQ_GetData(&accel, &mag);
+}
+
+static void benchRTCCGetTime(void)
+{
+	RTCC_Struct *time = MCP79410_GetTime();
+	sink += time->sec;
+	free(time);
+}
+
+static void benchRTCCAlarmStatus(void)
+{
+	sink += MCP79410_GetAlarmStatus(RTCC_ZERO);
+}
+
+static void benchRTCCMFP(void)
+{
+	MCP79410_SetMFP_Functionality(ALARM_INTERRUPT);
+}
+
+static void benchTFTPixel(void)
+{
+	TFT_SetPixel(10, 10, WHITE);
+}
+
+static void benchTFTBackground(void)
+{
+	TFT_Background(BLACK);
+}
+
+static void benchTFTString(void)
+{
+	TFT_PrintString(0, 0, WHITE, BLACK, "Sensorian", 1);
+}
+
+static void benchTFTRotation(void)
+{
+	TFT_SetRotation(PORTRAIT);
+}
+
+static void benchTFTPrinter(void)
+{
+	//TFT_Printer_PrintWrap edits the message
+	char message[] = "Temperature 21.5 C";
+	TFT_Printer_Print(message);
+}
+
+static void benchTFTLog(void)
+{
+	static int started = 0;
+	if (!started)
+	{
+		started = (TFT_Printer_LogStart(PORTRAIT, WHITE, BLACK, 1) == 0);
+	}
+	TFT_Printer_LogLine("Temperature 21.5 C");
+}
+
+static const DriverBench_t benches[] = {
+	{"setupSensorianFast", benchSetup, 1},				//Cold bring-up, must stay first
+	{"TFT_Setup", benchTFTSetup, 1},
+	{"getAmbientLight", benchAmbientLight, 2000},
+	{"pollMPL", benchPollMPL, 2000},
+	{"getTemperature", benchTemperature, 100000},
+	{"getAltitude", benchAltitude, 100000},
+	{"getBarometricPressure", benchPressure, 100000},
+	{"pollFXOS", benchPollFXOS, 2000},
+	{"getMagXYZ", benchMag, 100000},
+	{"getAccelXYZ", benchAccel, 100000},
+	{"poll_rtcc", benchPollRTCC, 2000},
+	{"get_rtcc_fields", benchRTCCFields, 100000},
+	{"set_rtcc_datetime", benchSetDatetime, 500},
+	{"set_rtcc_alarm", benchSetAlarm, 500},
+	{"poll_rtcc_alarm", benchPollAlarm, 2000},
+	{"reset_alarm", benchResetAlarm, 2000},
+	{"orange_led_on_off", benchLED, 100000},
+	{"getSnapshot", benchSnapshot, 1000},
+	{"getSnapshotChannels_light", benchSnapshotLight, 2000},
+	{"Acquire_Device_APDS9300", benchAcquireLight, 2000},
+	{"Acquire_Device_MPL3115A2", benchAcquireMPL, 2000},
+	{"Acquire_Device_FXOS8700CQ", benchAcquireFXOS, 2000},
+	{"Acquire_Device_CAP1203", benchAcquireCAP, 2000},
+	{"Acquire_Device_MCP79410", benchAcquireRTCC, 2000},
+	{"MPL3115A2_Initialize", benchMPLInit, 2000},
+	{"MPL3115A2_AltimeterMode", benchMPLAltimeter, 2000},
+	{"MPL3115A2_BarometerMode", benchMPLBarometer, 2000},
+	{"MPL3115A2_ToggleOneShot", benchMPLOneShot, 2000},
+	{"MPL3115A2_ReadBarometricPressure", benchMPLPressure, 2000},
+	{"MPL3115A2_ReadTemperature", benchMPLTemperature, 2000},
+	{"MPL3115A2_EnableEventFlags", benchMPLEvents, 2000},
+	{"AL_Initialize", benchLightInit, 2000},
+	{"AL_SetGain", benchLightGain, 2000},
+	{"AL_SetSamplingTime", benchLightSampling, 2000},
+	{"AL_ConfigureInterrupt", benchLightInterrupt, 2000},
+	{"AL_ReadChannel", benchLightChannel, 2000},
+	{"CAP1203_Initialize", benchTouchInit, 2000},
+	{"CAP1203_SetSensitivity", benchTouchSensitivity, 2000},
+	{"CAP1203_ConfigureMultiTouch", benchTouchMulti, 2000},
+	{"CAP1203_ReadPressedButton", benchTouchButton, 2000},
+	{"FXOS8700CQ_Configure", benchMotionConfigure, 2000},
+	{"FXOS8700CQ_ConfigureAccelerometer", benchMotionAccelConfig, 2000},
+	{"FXOS8700CQ_ConfigureMagnetometer", benchMotionMagConfig, 2000},
+	{"FXOS8700CQ_SetAccelerometerDynamicRange", benchMotionRange, 2000},
+	{"FXOS8700CQ_SetODR", benchMotionODR, 2000},
+	{"FXOS8700CQ_ConfigureOrientation", benchMotionOrientation, 2000},
+	{"FXOS8700CQ_GetData", benchMotionData, 2000},
+	{"MCP79410_GetTime", benchRTCCGetTime, 2000},
+	{"MCP79410_GetAlarmStatus", benchRTCCAlarmStatus, 2000},
+	{"MCP79410_SetMFP_Functionality", benchRTCCMFP, 2000},
+	{"TFT_SetPixel", benchTFTPixel, 2000},
+	{"TFT_Background", benchTFTBackground, 20},
+	{"TFT_PrintString", benchTFTString, 200},
+	{"TFT_SetRotation", benchTFTRotation, 2000},
+	{"TFT_Printer_Print", benchTFTPrinter, 50},
+	{"TFT_Printer_LogLine", benchTFTLog, 500},
+};
+
+#define BENCH_COUNT		(sizeof(benches) / sizeof(benches[0]))
+
+/**
+ * @brief CPU time of the calling thread in ns.
+ */
+static uint64_t cpuNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Runs one benchmark and stores its per call results.
+ */
+static void measure(const DriverBench_t *bench, DriverResult_t *result)
+{
+	FakeShieldStats_t before, after;
+
+	FakeShield_Stats(&before);
+	uint64_t cpu = cpuNs();
+	for(unsigned int i = 0; i < bench->calls; i++)
+	{
+		bench->run();
+	}
+	cpu = cpuNs() - cpu;
+	FakeShield_Stats(&after);
+	uint64_t transactions = (after.i2c_transfers - before.i2c_transfers) + (after.spi_transfers - before.spi_transfers);
+	uint64_t bytes = (after.i2c_bytes - before.i2c_bytes) + (after.spi_bytes - before.spi_bytes);
+
+	snprintf(result->name, sizeof(result->name), "%s", bench->name);
+	result->transactions = (double) transactions / bench->calls;
+	result->bytes = (double) bytes / bench->calls;
+	result->bus_us = (double)((after.i2c_ns - before.i2c_ns) + (after.spi_ns - before.spi_ns)) / 1000.0 / bench->calls;
+	result->wait_us = (double)(after.delay_ns - before.delay_ns) / 1000.0 / bench->calls;
+	result->cpu_ns = (double) cpu / bench->calls;
+}
+
+/**
+ * @brief Reads a baseline file: a "machine" line and one line per benchmark.
+ * @return count Entries read, -1 if the file cannot be opened.
+ */
+static int loadBaseline(const char *path, char *machine, size_t machine_len, DriverResult_t *entries)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+	int count = 0;
+
+	if(f == NULL)
+	{
+		return -1;
+	}
+	machine[0] = '\0';
+	while(fgets(line, sizeof(line), f) && count < BENCH_MAX)
+	{
+		DriverResult_t *e = &entries[count];
+		char word[64];
+		if(line[0] == '#' || sscanf(line, "%63s", word) != 1)
+		{
+			continue;
+		}
+		if(strcmp(word, "machine") == 0)
+		{
+			sscanf(line, "machine %63s", word);
+			snprintf(machine, machine_len, "%s", word);
+		}
+		else if(sscanf(line, "%47s %lf %lf %lf %lf", e->name, &e->transactions, &e->bytes, &e->bus_us,
+					   &e->cpu_ns) == 5)
+		{
+			count++;
+		}
+	}
+	fclose(f);
+	return count;
+}
+
+/**
+ * @brief Writes the results as the new baseline.
+ * @return status 0 on success, -1 if the file cannot be written.
+ */
+static int saveBaseline(const char *path, const char *machine, const DriverResult_t *results, unsigned int count)
+{
+	FILE *f = fopen(path, "w");
+
+	if(f == NULL)
+	{
+		return -1;
+	}
+	fprintf(f, "# Bench_Drivers baseline, rewrite with ./Bench_Drivers -u\n");
+	fprintf(f, "# name transactions bytes bus_us cpu_ns, per call\n");
+	fprintf(f, "machine %s\n", machine);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		fprintf(f, "%s %.3f %.3f %.3f %.0f\n", results[i].name, results[i].transactions, results[i].bytes,
+				results[i].bus_us, results[i].cpu_ns);
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static DriverResult_t results[BENCH_MAX];
+	static DriverResult_t baseline[BENCH_MAX];
+	const char *path = "Bench_Drivers.baseline";
+	double tolerance = 2.0;
+	int update = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "ut:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'u':
+				update = 1;
+				break;
+			case 't':
+				tolerance = atof(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-u] [-t tolerance] [baseline]\n", argv[0]);
+				return 2;
+		}
+	}
+	if(optind < argc)
+	{
+		path = argv[optind];
+	}
+	struct utsname host;
+	uname(&host);
+	FakeShield_Reset();
+	for(unsigned int i = 0; i < BENCH_COUNT; i++)
+	{
+		measure(&benches[i], &results[i]);
+		if(i == 0)						//Repeated calls must not depend on idle timeouts
+		{
+			for(int device = 0; device < SENSOR_DEVICE_COUNT; device++)
+			{
+				SensorPower_KeepAwake(device, 1);
+			}
+		}
+		else if(i == 1)
+		{
+			TFT_SetIdleTimeout(0);
+		}
+	}
+
+	if(update)
+	{
+		if(saveBaseline(path, host.machine, results, BENCH_COUNT) != 0)
+		{
+			perror(path);
+			return 2;
+		}
+		printf("Wrote %u results to %s\n", (unsigned int) BENCH_COUNT, path);
+		return 0;
+	}
+
+	char machine[64];
+	int entries = loadBaseline(path, machine, sizeof(machine), baseline);
+	int compare_cpu = (entries > 0 && strcmp(machine, host.machine) == 0);
+	int regressions = 0;
+
+	if(entries < 0)
+	{
+		printf("No baseline in %s, run with -u to record one\n", path);
+	}
+	else if(!compare_cpu)
+	{
+		printf("Baseline recorded on %s, CPU times are not compared on %s\n", machine, host.machine);
+	}
+	printf("%-40s %8s %9s %10s %10s %10s  %s\n", "call", "trans", "bytes", "bus_us", "wait_us", "cpu_ns", "");
+	for(unsigned int i = 0; i < BENCH_COUNT; i++)
+	{
+		const DriverResult_t *r = &results[i];
+		const DriverResult_t *b = NULL;
+		char status[160] = "";
+		char reasons[128] = "";
+		for(int e = 0; e < entries; e++)
+		{
+			if(strcmp(baseline[e].name, r->name) == 0)
+			{
+				b = &baseline[e];
+				break;
+			}
+		}
+		if(b == NULL)
+		{
+			snprintf(status, sizeof(status), "%s", (entries < 0) ? "" : "not in baseline");
+		}
+		else
+		{
+			size_t len = 0;
+			if(r->transactions > b->transactions + 0.001)
+			{
+				len += snprintf(reasons + len, sizeof(reasons) - len, "transactions %.3f > %.3f ", r->transactions,
+								b->transactions);
+			}
+			if(r->bytes > b->bytes + 0.001)
+			{
+				len += snprintf(reasons + len, sizeof(reasons) - len, "bytes %.3f > %.3f ", r->bytes, b->bytes);
+			}
+			if(r->bus_us > b->bus_us + 0.001)
+			{
+				len += snprintf(reasons + len, sizeof(reasons) - len, "bus %.3f > %.3f us ", r->bus_us, b->bus_us);
+			}
+			if(compare_cpu && r->cpu_ns > b->cpu_ns * tolerance && r->cpu_ns - b->cpu_ns > CPU_FLOOR_NS)
+			{
+				len += snprintf(reasons + len, sizeof(reasons) - len, "cpu %.0f > %.1f x %.0f ns ", r->cpu_ns, tolerance,
+								b->cpu_ns);
+			}
+			if(len)
+			{
+				regressions++;
+				snprintf(status, sizeof(status), "REGRESSED: %s", reasons);
+			}
+		}
+		printf("%-40s %8.3f %9.3f %10.3f %10.3f %10.0f  %s\n", r->name, r->transactions, r->bytes, r->bus_us,
+			   r->wait_us, r->cpu_ns, status);
+	}
+
+	if(regressions)
+	{
+		printf("%d calls regressed against %s\n", regressions, path);
+		return 1;
+	}
+	return 0;
+}
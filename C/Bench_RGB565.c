@@ -0,0 +1,216 @@
+/**
+ * @file Bench_RGB565.c
+ * @brief Checks the frame conversion against TFT_Color565 and the areas found by RGB565_Diff.
+ *
+ * Usage: ./Bench_RGB565 [frames]
+ * Random RGB888 and RGBA frames of widths that are and are not multiples of
+ * the 16 pixel blocks are converted with and without dither, so both the
+ * block path (NEON when built for it) and the tail path are compared pixel
+ * by pixel with TFT_Color565 of the same colour plus its Bayer threshold.
+ * Random frames are then diffed against the previous one: every changed
+ * pixel must lie in an area, every area must start and end on changed rows
+ * and columns, and bands must be merged exactly when they are closer than
+ * RGB565_MERGE_ROWS rows, or when the areas ran out. Exits with 1 on any
+ * failure.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Utilities.h"
+#include "TFT.h"
+#include "RGB565.h"
+
+#define MAX_WIDTH	160
+#define MAX_HEIGHT	128
+#define MAX_RECTS	4
+
+static const unsigned char bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+static const unsigned int widths[] = {1, 7, 15, 16, 17, 33, 100, MAX_WIDTH};
+
+static uint8_t src[MAX_WIDTH * MAX_HEIGHT * 4 + 8];
+static uint8_t frame[MAX_WIDTH * MAX_HEIGHT * 2];
+static uint8_t previous[MAX_WIDTH * MAX_HEIGHT * 2];
+static uint8_t sent[MAX_WIDTH * MAX_HEIGHT * 2];
+static unsigned long frames = 1000UL;
+
+/**
+ * @brief Adds a threshold to a channel with saturation.
+ */
+static unsigned char saturate(unsigned int value)
+{
+	return (value > 255) ? 255 : (unsigned char) value;
+}
+
+/**
+ * @brief Converts a random frame and compares every pixel with TFT_Color565.
+ * @return mismatches Number of pixels that differ.
+ */
+static unsigned long check_convert(unsigned int width, unsigned int height, unsigned int channels,
+								   unsigned int flags)
+{
+	unsigned int stride = width * channels + (rand() & 7);	//Rows that do not follow each other
+	unsigned long errors = 0;
+
+	for(unsigned int i = 0; i < stride * height; i++)
+	{
+		src[i] = (uint8_t) rand();
+	}
+	RGB565_Convert(src, width, height, stride, channels, flags, frame);
+
+	for(unsigned int y = 0; y < height; y++)
+	{
+		for(unsigned int x = 0; x < width; x++)
+		{
+			const uint8_t *p = src + y * stride + x * channels;
+			unsigned int t = (flags & RGB565_DITHER) ? bayer[y & 3][x & 3] : 0;
+			unsigned int color = TFT_Color565(saturate(p[0] + (t >> 1)), saturate(p[1] + (t >> 2)),
+											  saturate(p[2] + (t >> 1)));
+			if(frame[(y * width + x) * 2] != (color >> 8) || frame[(y * width + x) * 2 + 1] != (color & 0xFF))
+			{
+				errors++;
+			}
+		}
+	}
+	return errors;
+}
+
+/**
+ * @brief Tells whether a pixel differs between two converted frames.
+ */
+static int changed(const uint8_t *a, const uint8_t *b, unsigned int width, unsigned int x, unsigned int y)
+{
+	unsigned int i = (y * width + x) * 2;
+	return a[i] != b[i] || a[i + 1] != b[i + 1];
+}
+
+/**
+ * @brief Changes a few random spans of the last frame, diffs it and checks the areas.
+ * @return errors Number of broken rules.
+ */
+static unsigned long check_diff(unsigned int width, unsigned int height)
+{
+	RGB565Rect_t rects[MAX_RECTS];
+	unsigned int max_rects = 1 + rand() % MAX_RECTS;
+	unsigned int spans = rand() % 8;
+	unsigned long errors = 0;
+
+	memcpy(frame, sent, width * height * 2);
+	for(unsigned int s = 0; s < spans; s++)
+	{
+		unsigned int y = rand() % height, x0 = rand() % width;
+		unsigned int x1 = x0 + rand() % (width - x0);
+		for(unsigned int x = x0; x <= x1; x++)
+		{
+			frame[(y * width + x) * 2 + (rand() & 1)] ^= (uint8_t)(1 + rand() % 255);
+		}
+	}
+
+	unsigned int count = RGB565_Diff(frame, previous, width, height, rects, max_rects);
+
+	if(count > max_rects || memcmp(previous, frame, width * height * 2) != 0)
+	{
+		return 1;
+	}
+	for(unsigned int y = 0; y < height; y++)
+	{
+		for(unsigned int x = 0; x < width; x++)
+		{
+			int covered = 0;
+			for(unsigned int r = 0; r < count; r++)
+			{
+				covered |= x >= rects[r].x0 && x <= rects[r].x1 && y >= rects[r].y0 && y <= rects[r].y1;
+			}
+			if(changed(frame, sent, width, x, y) && !covered)
+			{
+				errors++;
+			}
+		}
+	}
+	for(unsigned int r = 0; r < count; r++)
+	{
+		const RGB565Rect_t *a = &rects[r];
+		int first = 0, last = 0, left = 0, right = 0;
+		unsigned int unchanged = 0, gap = 0;
+
+		if(a->x0 > a->x1 || a->y0 > a->y1 || a->x1 >= width || a->y1 >= height)
+		{
+			errors++;
+			continue;
+		}
+		if(r > 0 && a->y0 - rects[r - 1].y1 <= RGB565_MERGE_ROWS)
+		{
+			errors++;										//Should have been merged
+		}
+		for(unsigned int x = a->x0; x <= a->x1; x++)
+		{
+			first |= changed(frame, sent, width, x, a->y0);
+			last |= changed(frame, sent, width, x, a->y1);
+		}
+		for(unsigned int y = a->y0; y <= a->y1; y++)
+		{
+			int row = 0;
+			for(unsigned int x = 0; x < width; x++)
+			{
+				row |= changed(frame, sent, width, x, y);
+			}
+			unchanged = row ? 0 : unchanged + 1;
+			gap = (unchanged > gap) ? unchanged : gap;
+			left |= changed(frame, sent, width, a->x0, y);
+			right |= changed(frame, sent, width, a->x1, y);
+		}
+		if(!first || !last || !left || !right)
+		{
+			errors++;										//Larger than what changed
+		}
+		if(gap >= RGB565_MERGE_ROWS && !(r == count - 1 && count == max_rects))
+		{
+			errors++;										//Merged bands that are too far apart
+		}
+	}
+	memcpy(sent, frame, width * height * 2);
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long convert_errors = 0, diff_errors = 0;
+
+	if(argc > 1) frames = strtoul(argv[1], NULL, 0);
+	if(frames == 0)
+	{
+		printf("Invalid frame count.\n");
+		return 1;
+	}
+	srand(1);
+
+	for(unsigned long k = 0; k < frames; k++)
+	{
+		unsigned int width = widths[k % (sizeof(widths) / sizeof(widths[0]))];
+		unsigned int height = 1 + rand() % MAX_HEIGHT;
+		convert_errors += check_convert(width, height, 3 + (k & 1), (k & 2) ? RGB565_DITHER : 0);
+	}
+
+	for(unsigned int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+	{
+		unsigned int width = widths[w];
+		memset(sent, 0, sizeof(sent));
+		memset(previous, 0, sizeof(previous));
+		for(unsigned long k = 0; k < frames; k++)
+		{
+			diff_errors += check_diff(width, MAX_HEIGHT);
+		}
+	}
+
+	uint64_t start = timestamp_ns();
+	for(unsigned long k = 0; k < frames; k++)
+	{
+		RGB565_Convert(src, MAX_WIDTH, MAX_HEIGHT, MAX_WIDTH * 3, 3, RGB565_DITHER, frame);
+	}
+	double per_frame = (double)(timestamp_ns() - start) / frames;
+
+	printf("%lu frames: %lu converted pixels differ from TFT_Color565, %lu bad diff areas, %.0f ns per %ux%u frame\n",
+		   frames, convert_errors, diff_errors, per_frame, MAX_WIDTH, MAX_HEIGHT);
+	return (convert_errors || diff_errors) ? 1 : 0;
+}
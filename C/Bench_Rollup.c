@@ -0,0 +1,74 @@
+/**
+ * @file Bench_Rollup.c
+ * @brief Measures the cost per sample of Rollup_Add with one to ROLLUP_MAX_TIERS tiers.
+ *
+ * Usage: ./Bench_Rollup [samples]
+ * Feeds a 50 Hz accelerometer stream into tiers of 1 s, 1 min, 1 h and 1 day and checks that every tier
+ * accounts for every sample.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Utilities.h"
+#include "Rollup.h"
+
+#define BATCH	64
+
+int main(int argc, char **argv)
+{
+	static const uint64_t width[ROLLUP_MAX_TIERS] = {1000000000ULL, 60000000000ULL, 3600000000000ULL, 86400000000000ULL};
+	static const uint32_t capacity[ROLLUP_MAX_TIERS] = {3600, 1440, 720, 365};
+	unsigned long samples = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000000UL;
+	RollupBucket_t *buckets = malloc(3600 * sizeof(RollupBucket_t));
+	Sample_t batch[BATCH];
+	Rollup_t rollup;
+	int errors = 0;
+
+	for(unsigned int tiers = 1; tiers <= ROLLUP_MAX_TIERS; tiers++)
+	{
+		if(Rollup_Init(&rollup, width, capacity, tiers) != 0)
+		{
+			return 1;
+		}
+
+		uint64_t start = timestamp_ns();
+		for(unsigned long i = 0; i < samples; i += BATCH)
+		{
+			for(int b = 0; b < BATCH; b++)
+			{
+				batch[b].timestamp_ns = (i + b) * 20000000ULL;
+				batch[b].value = (float)((i + b) % 101) * 0.01f;
+				batch[b].channel = SENSOR_ACCEL_Z;
+				batch[b].flags = SAMPLE_VALID;
+			}
+			Rollup_Add(&rollup, batch, BATCH);
+		}
+		double ns = (double)(timestamp_ns() - start) / samples;
+
+		//Every tier must account for the samples it still covers
+		uint64_t end = samples * 20000000ULL;
+		for(unsigned int k = 0; k < tiers; k++)
+		{
+			uint64_t from = (end > width[k] * (capacity[k] - 1)) ? end - width[k] * (capacity[k] - 1) : 0;
+			from -= from % width[k];
+			unsigned int used;
+			int n = Rollup_Query(&rollup, SENSOR_ACCEL_Z, from, UINT64_MAX, width[k], buckets, 3600, &used);
+			uint64_t total = 0;
+			for(int b = 0; b < n; b++)
+			{
+				total += buckets[b].count;
+			}
+			uint64_t expected = (end - from + 19999999ULL) / 20000000ULL;
+			if(used != k || total != expected)
+			{
+				printf("Tier %u: %llu samples, expected %llu\n", k, (unsigned long long) total,
+					   (unsigned long long) expected);
+				errors++;
+			}
+		}
+		printf("%u tier%s: %.1f ns/sample\n", tiers, (tiers > 1) ? "s" : "", ns);
+		Rollup_Free(&rollup);
+	}
+	free(buckets);
+	return errors ? 1 : 0;
+}
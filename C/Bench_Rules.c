@@ -0,0 +1,81 @@
+/**
+ * @file Bench_Rules.c
+ * @brief Measures the cost per sample of Rules_Evaluate for growing numbers of rules.
+ *
+ * Usage: ./Bench_Rules [samples]
+ * Every rule watches the light channel with a random threshold, hysteresis and hold time, and the light
+ * reading sweeps through all the thresholds so rules keep firing and re-arming. A second pass spreads the
+ * same rules over every channel to show that a sample only pays for the rules of its own channel.
+ * Fired actions are counted but never run, so once the queue is full they are dropped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Utilities.h"
+#include "Rules.h"
+
+#define BATCH	64
+
+/**
+ * @brief Writes a rules file of count random rules, on the light channel only or on every channel.
+ */
+static char* makeRules(unsigned int count, int spread)
+{
+	static const char *op[] = {"<", "<=", ">", ">="};
+	char *text = malloc(count * 64 + 1);
+	size_t len = 0;
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		int ch = spread ? (int)(i % SENSOR_CHANNEL_COUNT) : SENSOR_LIGHT;
+		len += sprintf(text + len, "%s %s %d %d %d print \"rule %u\"\n", SensorChannel_Name(ch), op[rand() % 4],
+					   rand() % 1000, rand() % 20, rand() % 3 * 50, i % 16);
+	}
+	text[len] = '\0';
+	return text;
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned int counts[] = {1, 16, 256, 1024, 4096};
+	unsigned long samples = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000UL;
+	Sample_t batch[BATCH];
+	RulesStats_t before, after;
+
+	for(int spread = 0; spread < 2; spread++)
+	{
+		for(unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+		{
+			char *text = makeRules(counts[c], spread);
+			if(Rules_LoadString(text) != (int) counts[c])
+			{
+				return 1;
+			}
+			free(text);
+
+			Rules_GetStats(&before);
+			uint64_t start = timestamp_ns();
+			for(unsigned long i = 0; i < samples; i += BATCH)
+			{
+				for(int b = 0; b < BATCH; b++)
+				{
+					batch[b].timestamp_ns = (i + b) * 10000000ULL;		//10 Hz
+					batch[b].value = 500.0f + 520.0f * sinf((i + b) * 0.001f);
+					batch[b].channel = SENSOR_LIGHT;
+					batch[b].flags = SAMPLE_VALID;
+				}
+				Rules_Evaluate(batch, BATCH);
+			}
+			double ns = (double)(timestamp_ns() - start) / samples;
+			Rules_GetStats(&after);
+
+			printf("%4u rules on %s: %7.1f ns/sample, %.2f ns/rule checked, %llu fired\n", counts[c],
+				   spread ? "all channels" : "one channel ", ns,
+				   ns * samples / (double)((after.checks - before.checks) ? after.checks - before.checks : 1),
+				   (unsigned long long)(after.fired - before.fired));
+		}
+	}
+	Rules_Free();
+	return 0;
+}
@@ -0,0 +1,306 @@
+/**
+ * @file Bench_SensorShm.c
+ * @brief Checks the shared segment with a publisher process and many forked readers.
+ *
+ * Usage: ./Bench_SensorShm [readers] [publishes]
+ * A first publisher stamps every sample of a batch with the number of its
+ * publish, then removes the segment. A second publisher creates it again,
+ * continues the numbering and dies in the middle of an update. Each reader
+ * checks that snapshots are whole and that numbers never go backwards, and
+ * must notice both the restart and the death by a failed read instead of
+ * reading the old contents or spinning forever. Uses /dev/shm/sensorian, so
+ * do not run it next to a real publisher. Exits with 1 on any failure.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "Utilities.h"
+#include "SensorShm.h"
+
+#define MAX_READERS	256
+#define TIMEOUT_NS	5000000000ULL		//Longest wait for the readers to catch up
+#define HISTORY_READ	64
+
+/**
+ * @brief Shared between the forked processes.
+ */
+typedef struct _Control
+{
+	int stop;							/**< Set when the readers should exit */
+	uint64_t seen[MAX_READERS];			/**< Highest publish each reader has read */
+	unsigned long reads[MAX_READERS];	/**< Successful reads of each reader */
+	unsigned long lost[MAX_READERS];	/**< Failed reads of each reader, each one detaches */
+	unsigned long errors[MAX_READERS];	/**< Torn or out of order reads of each reader */
+} Control_t;
+
+static Control_t *control;
+static unsigned int readers;
+static unsigned long publishes = 200000UL;	/*!< Below 2^24, so every number is exact as a float */
+
+/**
+ * @brief Publishes the numbers first to last, one batch of every channel each.
+ */
+static void publish(unsigned long first, unsigned long last)
+{
+	Sample_t batch[SENSOR_CHANNEL_COUNT];
+
+	for(unsigned long k = first; k <= last; k++)
+	{
+		for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+		{
+			batch[ch].timestamp_ns = k;
+			batch[ch].value = (float) k;
+			batch[ch].channel = (uint16_t) ch;
+			batch[ch].flags = SAMPLE_VALID;
+		}
+		SensorShm_Publish(batch, SENSOR_CHANNEL_COUNT, NULL);
+	}
+}
+
+/**
+ * @brief Waits until every reader has read the publish k.
+ * @return status 0 on success, -1 on timeout.
+ */
+static int wait_seen(uint64_t k)
+{
+	uint64_t deadline = timestamp_ns() + TIMEOUT_NS;
+
+	for(unsigned int i = 0; i < readers; i++)
+	{
+		while(__atomic_load_n(&control->seen[i], __ATOMIC_ACQUIRE) < k)
+		{
+			if(timestamp_ns() > deadline)
+			{
+				return -1;
+			}
+			usleep(100);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief First publisher, removes the segment when every reader has read its last publish.
+ */
+static int writer_restart(unsigned int arg)
+{
+	unsigned long half = publishes / 2;
+
+	if(SensorShm_Create() != 0)
+	{
+		return 1;
+	}
+	publish(1, half);
+	int status = wait_seen(half);
+	SensorShm_Destroy();
+	return status ? 1 : 0;
+}
+
+/**
+ * @brief Second publisher, dies inside an update when every reader has read its last publish.
+ */
+static int writer_death(unsigned int arg)
+{
+	if(SensorShm_Create() != 0)
+	{
+		return 1;
+	}
+	publish(publishes / 2 + 1, publishes);
+	if(wait_seen(publishes) != 0)
+	{
+		return 1;
+	}
+
+	int fd = shm_open(SENSOR_SHM_NAME, O_RDWR, 0);
+	SensorShm_t *shm = mmap(NULL, sizeof(SensorShm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(shm == MAP_FAILED)
+	{
+		return 1;
+	}
+	Seqlock_WriteBegin(&shm->lock);
+	_exit(0);									//Without Seqlock_WriteEnd
+}
+
+/**
+ * @brief Reader process, reads snapshots and the history and attaches again whenever a read fails.
+ */
+static int reader(unsigned int id)
+{
+	SensorSnapshot_t snapshot;
+	Sample_t history[HISTORY_READ];
+	uint64_t cursor = 0, last = 0, last_key = 0;
+	int attached = 0;
+
+	while(__atomic_load_n(&control->stop, __ATOMIC_ACQUIRE) == 0)
+	{
+		if(!attached)
+		{
+			if(SensorShm_Attach() != 0)
+			{
+				usleep(100);
+				continue;
+			}
+			attached = 1;
+			cursor = 0;
+		}
+
+		int n = SensorShm_ReadSnapshot(&snapshot);
+		if(n >= 0)
+		{
+			n = SensorShm_ReadHistory(&cursor, history, HISTORY_READ);
+		}
+		if(n < 0)
+		{
+			control->lost[id]++;
+			attached = 0;
+			continue;
+		}
+
+		if(snapshot.valid)
+		{
+			uint64_t k = snapshot.reading[0].timestamp_ns;
+			for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+			{
+				SensorReading_t *r = &snapshot.reading[ch];
+				if(!r->valid || r->timestamp_ns != k || r->value != (float) k)
+				{
+					control->errors[id]++;
+					break;
+				}
+			}
+			if(k < last)
+			{
+				control->errors[id]++;
+			}
+			last = k;
+			__atomic_store_n(&control->seen[id], k, __ATOMIC_RELEASE);
+		}
+		for(int i = 0; i < n; i++)
+		{
+			uint64_t key = history[i].timestamp_ns * SENSOR_CHANNEL_COUNT + history[i].channel;
+			if(key <= last_key || history[i].value != (float) history[i].timestamp_ns)
+			{
+				control->errors[id]++;
+			}
+			last_key = key;
+		}
+		control->reads[id]++;
+	}
+	return 0;
+}
+
+/**
+ * @brief Forks a process running a function and returns its pid, or exits on failure.
+ */
+static pid_t spawn(int (*function)(unsigned int), unsigned int arg)
+{
+	pid_t pid = fork();
+	if(pid < 0)
+	{
+		perror("fork");
+		exit(1);
+	}
+	if(pid == 0)
+	{
+		_exit(function(arg));
+	}
+	return pid;
+}
+
+int main(int argc, char **argv)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pid_t pids[MAX_READERS];
+	unsigned long reads = 0, lost = 0, errors = 0, before[MAX_READERS];
+	unsigned int hung = 0, missed = 0;
+	int status, failed = 0;
+
+	readers = (cpus > 1) ? (unsigned int)(cpus * 2) : 4;
+	if(argc > 1) readers = (unsigned int) strtoul(argv[1], NULL, 0);
+	if(argc > 2) publishes = strtoul(argv[2], NULL, 0);
+	if(readers == 0 || readers > MAX_READERS || publishes < 2 || publishes >= (1UL << 24))
+	{
+		printf("Invalid reader count or publishes.\n");
+		return 1;
+	}
+
+	control = mmap(NULL, sizeof(Control_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(control == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+	memset(control, 0, sizeof(*control));
+
+	uint64_t start = timestamp_ns();
+	for(unsigned int i = 0; i < readers; i++)
+	{
+		pids[i] = spawn(reader, i);
+	}
+
+	//Restart: every reader must leave the removed segment for the new one
+	waitpid(spawn(writer_restart, 0), &status, 0);
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		printf("Readers did not all read the first publisher.\n");
+		failed = 1;
+	}
+	waitpid(spawn(writer_death, 0), &status, 0);
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		printf("Readers did not all follow the restart.\n");
+		failed = 1;
+	}
+
+	//Death: the publisher is reaped, every reader must fail a read instead of spinning
+	for(unsigned int i = 0; i < readers; i++)
+	{
+		before[i] = __atomic_load_n(&control->lost[i], __ATOMIC_ACQUIRE);
+	}
+	uint64_t deadline = timestamp_ns() + TIMEOUT_NS;
+	for(unsigned int i = 0; i < readers; i++)
+	{
+		while(__atomic_load_n(&control->lost[i], __ATOMIC_ACQUIRE) == before[i])
+		{
+			if(timestamp_ns() > deadline)
+			{
+				missed++;
+				break;
+			}
+			usleep(1000);
+		}
+	}
+	if(missed)
+	{
+		printf("%u readers did not notice the publisher died.\n", missed);
+		failed = 1;
+	}
+	double seconds = (timestamp_ns() - start) / 1e9;
+
+	__atomic_store_n(&control->stop, 1, __ATOMIC_RELEASE);
+	usleep(100000);
+	for(unsigned int i = 0; i < readers; i++)
+	{
+		if(waitpid(pids[i], &status, WNOHANG) == 0)
+		{
+			kill(pids[i], SIGKILL);
+			waitpid(pids[i], &status, 0);
+			hung++;
+		}
+		reads += control->reads[i];
+		lost += control->lost[i];
+		errors += control->errors[i];
+	}
+	shm_unlink(SENSOR_SHM_NAME);
+
+	printf("%u readers, %lu publishes: %.3f s, %lu reads, %lu failed reads, %lu bad reads, %u readers hung\n",
+		   readers, publishes, seconds, reads, lost, errors, hung);
+	return (failed || errors || hung) ? 1 : 0;
+}
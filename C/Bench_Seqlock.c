@@ -0,0 +1,137 @@
+/**
+ * @file Bench_Seqlock.c
+ * @brief Stresses the seqlock of Shield_t.state with one writer and many readers.
+ *
+ * Usage: ./Bench_Seqlock [readers] [writes]
+ * The writer stamps every field of the state with the number of its update,
+ * as the library's writers do, under writer_lock and the seqlock. Each reader
+ * copies the whole state the way the getters do and checks that all fields
+ * carry the same update and that updates never go backwards. Any torn or
+ * stale copy makes the run exit with 1.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Utilities.h"
+#include "Shield.h"
+
+#define MAX_READERS	256
+
+static Shield_t shield;
+static unsigned long writes = 2000000UL;		/*!< Below 2^24, so every update is exact as a float */
+static volatile int writing = 1;
+static unsigned long errors = 0;
+static unsigned long reads = 0;
+
+/**
+ * @brief Sets every field of a state to the number of an update.
+ */
+static void stamp(ShieldState_t *state, unsigned long k)
+{
+	memset(state, 0, sizeof(*state));			//Padding too, copies are compared whole
+	state->mpl_temperature = (float) k;
+	state->mpl_altitude = (float) k;
+	state->mpl_pressure = (float) k;
+	state->magnetometer.x = state->magnetometer.y = state->magnetometer.z = (int16_t) k;
+	state->accelerometer.x = state->accelerometer.y = state->accelerometer.z = (int16_t) k;
+	state->current_time.sec = state->current_time.min = state->current_time.hour = (unsigned char) k;
+	state->current_time.weekday = state->current_time.date = (unsigned char) k;
+	state->current_time.month = state->current_time.year = (unsigned char) k;
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		state->latest[ch].timestamp_ns = k;
+		state->latest[ch].value = (float) k;
+		state->latest[ch].valid = 1;
+	}
+	state->latest_valid = (uint32_t) k;
+}
+
+/**
+ * @brief Writer thread, publishes the updates back to back like a sampler at full speed.
+ */
+static void* writer(void *arg)
+{
+	ShieldState_t next;
+
+	for(unsigned long k = 1; k <= writes; k++)
+	{
+		stamp(&next, k);
+		pthread_mutex_lock(&shield.writer_lock);
+		Seqlock_WriteBegin(&shield.state_lock);
+		memcpy(&shield.state, &next, sizeof(next));
+		Seqlock_WriteEnd(&shield.state_lock);
+		pthread_mutex_unlock(&shield.writer_lock);
+	}
+	writing = 0;
+	return NULL;
+}
+
+/**
+ * @brief Reader thread, copies the whole state and checks it against the update it claims to be.
+ */
+static void* reader(void *arg)
+{
+	ShieldState_t copy, expected;
+	unsigned long last = 0, n = 0, bad = 0;
+	uint32_t seq;
+
+	while(writing)
+	{
+		do
+		{
+			seq = Seqlock_ReadBegin(&shield.state_lock);
+			memcpy(&copy, &shield.state, sizeof(copy));
+		} while(Seqlock_ReadRetry(&shield.state_lock, seq));
+
+		unsigned long k = (unsigned long) copy.latest[0].timestamp_ns;
+		stamp(&expected, k);
+		if(memcmp(&copy, &expected, sizeof(copy)) != 0 || k < last)
+		{
+			bad++;
+		}
+		last = k;
+		n++;
+	}
+	__atomic_add_fetch(&errors, bad, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&reads, n, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int readers = (cpus > 1) ? (unsigned int)(cpus * 4) : 8;
+	pthread_t threads[MAX_READERS + 1];
+
+	if(argc > 1) readers = (unsigned int) strtoul(argv[1], NULL, 0);
+	if(argc > 2) writes = strtoul(argv[2], NULL, 0);
+	if(readers == 0 || readers > MAX_READERS || writes == 0 || writes >= (1UL << 24))
+	{
+		printf("Invalid reader count or writes.\n");
+		return 1;
+	}
+
+	memset(&shield, 0, sizeof(shield));
+	stamp(&shield.state, 0);					//Update 0, consistent like every later one
+	pthread_mutex_init(&shield.writer_lock, NULL);
+
+	uint64_t start = timestamp_ns();
+	for(unsigned int i = 0; i < readers; i++)
+	{
+		pthread_create(&threads[i], NULL, reader, NULL);
+	}
+	pthread_create(&threads[readers], NULL, writer, NULL);
+	for(unsigned int i = 0; i <= readers; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	double seconds = (timestamp_ns() - start) / 1e9;
+
+	printf("%u readers, %lu writes: %.3f s, %.2f M writes/s, %.2f M reads/s, %lu torn reads\n",
+		   readers, writes, seconds, writes / seconds / 1e6, reads / seconds / 1e6, errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file Bench_SeriesLog.c
+ * @brief Measures SeriesLog write and query speed and compression on a synthetic recording.
+ *
+ * Usage: ./Bench_SeriesLog [seconds] [file]
+ * The recording has the six FXOS8700CQ channels at 50 Hz, light at 10 Hz and the other channels at 1 Hz,
+ * with timestamp jitter and values quantized like the real sensors.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "Utilities.h"
+#include "SeriesLog.h"
+
+#define BATCH	64
+
+static const float rate_hz[SENSOR_CHANNEL_COUNT] = {10, 1, 1, 1, 50, 50, 50, 50, 50, 50, 1, 1};
+
+/**
+ * @brief Makes a plausible reading of a channel at time t in seconds.
+ */
+static float synthesize(int ch, double t)
+{
+	double noise = (rand() % 7) - 3;
+	switch(ch)
+	{
+		case SENSOR_LIGHT:			return roundf(300 + 50 * sin(t / 600) + noise) * 0.25f;
+		case SENSOR_TEMPERATURE:	return roundf((22 + sin(t / 3600)) * 16) / 16.0f;
+		case SENSOR_PRESSURE:		return roundf((101000 + 100 * sin(t / 7200)) * 4 + noise) / 4.0f;
+		case SENSOR_ALTITUDE:		return 44330.77f * (1.0f - powf((101000 + 100 * sin(t / 7200)) / 101326.0, 0.1902632f));
+		case SENSOR_ACCEL_Z:		return (4096 + (int) noise) * 0.000244f * 9.80665f;
+		case SENSOR_ACCEL_X:
+		case SENSOR_ACCEL_Y:		return ((int) noise * 2) * 0.000244f * 9.80665f;
+		case SENSOR_MAG_X:			return (250 + (int) noise) * 0.1f;
+		case SENSOR_MAG_Y:			return (-120 + (int) noise) * 0.1f;
+		case SENSOR_MAG_Z:			return (410 + (int) noise) * 0.1f;
+		case SENSOR_TOUCH:			return 0.0f;
+		default:					return fmod(t, 86400.0);
+	}
+}
+
+/**
+ * @brief Counts the visited samples.
+ */
+static int countSamples(const Sample_t *samples, unsigned int count, void *arg)
+{
+	*(uint64_t *) arg += count;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 3600.0;
+	const char *path = (argc > 2) ? argv[2] : "/tmp/Bench_SeriesLog.log";
+	uint64_t next[SENSOR_CHANNEL_COUNT] = {0};
+	uint64_t end = (uint64_t)(seconds * 1e9);
+	uint64_t csv_bytes = 0, visited = 0;
+	Sample_t batch[BATCH];
+	unsigned int n = 0;
+	SeriesLogWriter_t writer;
+	SeriesLogReader_t reader;
+	SeriesLogSummary_t summary;
+
+	unlink(path);
+	if(SeriesLogWriter_Open(&writer, path, 0) != 0)
+	{
+		return 1;
+	}
+
+	uint64_t start = timestamp_ns();
+	for(;;)
+	{
+		int ch = 0;
+		for(int c = 1; c < SENSOR_CHANNEL_COUNT; c++)
+		{
+			ch = (next[c] < next[ch]) ? c : ch;
+		}
+		if(next[ch] >= end)
+		{
+			break;
+		}
+		uint64_t period = (uint64_t)(1e9 / rate_hz[ch]);
+		batch[n].timestamp_ns = next[ch] + (rand() % 100000);		//Up to 100 us late
+		batch[n].value = synthesize(ch, next[ch] / 1e9);
+		batch[n].channel = ch;
+		batch[n].flags = SAMPLE_VALID;
+		csv_bytes += snprintf(NULL, 0, "%llu,%s,%.9g,%s\n", (unsigned long long) batch[n].timestamp_ns,
+							  SensorChannel_Name(ch), batch[n].value, SensorChannel_Unit(ch));
+		next[ch] += period;
+		if(++n == BATCH)
+		{
+			SeriesLogWriter_Append(&writer, batch, n);
+			n = 0;
+		}
+	}
+	SeriesLogWriter_Append(&writer, batch, n);
+	uint64_t samples = writer.samples;
+	SeriesLogWriter_Close(&writer);
+	double write_s = (timestamp_ns() - start) / 1e9;
+	uint64_t bytes = writer.bytes;
+
+	printf("Wrote %llu samples in %.3f s: %.2f M samples/s\n", (unsigned long long) samples, write_s,
+		   samples / write_s / 1e6);
+	printf("File %llu bytes, %.2f bytes/sample, %.1fx smaller than Sample_t, %.1fx smaller than CSV\n",
+		   (unsigned long long) bytes, (double) bytes / samples, 16.0 * samples / bytes, (double) csv_bytes / bytes);
+
+	if(SeriesLogReader_Open(&reader, path) != 0)
+	{
+		return 1;
+	}
+
+	start = timestamp_ns();
+	SeriesLogReader_Query(&reader, SENSOR_ALL_CHANNELS, 0, UINT64_MAX, countSamples, &visited);
+	double read_s = (timestamp_ns() - start) / 1e9;
+	printf("Decoded all %llu samples in %.3f s: %.2f M samples/s\n", (unsigned long long) visited, read_s,
+		   visited / read_s / 1e6);
+
+	uint64_t mid = end / 2;
+	visited = 0;
+	reader.chunks_decoded = reader.chunks_skipped = 0;
+	start = timestamp_ns();
+	SeriesLogReader_Query(&reader, SENSOR_CHANNEL_BIT(SENSOR_ACCEL_Z), mid, mid + 60000000000ULL, countSamples, &visited);
+	printf("One minute of accel_z: %llu samples in %.1f us, %llu chunks decoded, %llu skipped\n",
+		   (unsigned long long) visited, (timestamp_ns() - start) / 1e3,
+		   (unsigned long long) reader.chunks_decoded, (unsigned long long) reader.chunks_skipped);
+
+	reader.chunks_decoded = reader.chunks_skipped = 0;
+	start = timestamp_ns();
+	SeriesLogReader_Summary(&reader, SENSOR_ACCEL_Z, end / 10, end - end / 10, &summary);
+	printf("Summary of 80%% of accel_z: %llu samples, min %f, max %f in %.1f us, %llu columns decoded\n",
+		   (unsigned long long) summary.count, summary.min, summary.max, (timestamp_ns() - start) / 1e3,
+		   (unsigned long long) reader.chunks_decoded);
+
+	SeriesLogReader_Close(&reader);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file BusStats.h
+ * @brief Header for the transaction counters and latency histograms of the I2C and SPI layers
+ *
+ * The counters are only compiled in with -DBUS_STATS. Without it the
+ * BUS_STATS_START and BUS_STATS_RECORD macros expand to nothing and the
+ * query functions report that no statistics exist.
+ */
+
+#ifndef __BUSSTATS_H__
+#define __BUSSTATS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BUS_STATS_MAX_DEVICES	16		/*!< Devices tracked per bus */
+#define BUS_STATS_BUCKETS		32		/*!< Histogram bucket k holds latencies of 2^k to 2^(k+1)-1 ns, the last one everything longer */
+
+/**
+ * @brief The buses that are instrumented.
+ */
+typedef enum {BUS_I2C = 0,
+			  BUS_SPI,
+			  BUS_COUNT
+} Bus_t;
+
+/**
+ * @brief Kind of transaction.
+ */
+typedef enum {BUS_OP_READ = 0,				/**< Read only, e.g. from a preset register pointer */
+			  BUS_OP_WRITE,					/**< Write only */
+			  BUS_OP_WRITE_READ,			/**< Register address written, then data read, or a full duplex SPI transfer */
+			  BUS_OP_COUNT
+} BusOp_t;
+
+/**
+ * @brief Counters of one operation on one device.
+ */
+typedef struct _BusOpStats
+{
+	uint64_t count;							/**< Transactions */
+	uint64_t bytes;							/**< Bytes written and read */
+	uint64_t errors;						/**< Transactions the controller reported as failed, e.g. NACK */
+	uint64_t total_ns;						/**< Sum of the latencies */
+	uint64_t max_ns;						/**< Longest latency */
+	uint32_t histogram[BUS_STATS_BUCKETS];	/**< Latencies in power of two buckets */
+} BusOpStats_t;
+
+#ifdef BUS_STATS
+
+uint64_t 		BusStats_Clock(void);
+
+/**
+ * @brief Reads the cheapest clock available: the ARM generic timer counter, which user space may read
+ *		  directly, or the monotonic clock on other processors. BusStats_Record converts the ticks to ns.
+ */
+static inline uint64_t BusStats_Ticks(void)
+{
+#if defined(__aarch64__)
+	uint64_t ticks;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (ticks));
+	return ticks;
+#elif defined(__arm__) && __ARM_ARCH >= 7
+	uint64_t ticks;
+	__asm__ __volatile__("mrrc p15, 1, %Q0, %R0, c14" : "=r" (ticks));
+	return ticks;
+#else
+	return BusStats_Clock();
+#endif
+}
+
+void 			BusStats_Record(Bus_t bus, unsigned int device, BusOp_t op, uint32_t bytes, int error, uint64_t start);
+
+#define BUS_STATS_START(t)								uint64_t t = BusStats_Ticks()
+#define BUS_STATS_RECORD(bus, device, op, bytes, error, t)	BusStats_Record(bus, device, op, bytes, error, t)
+
+#else
+
+#define BUS_STATS_START(t)
+#define BUS_STATS_RECORD(bus, device, op, bytes, error, t)	((void)(error))
+
+#endif
+
+int 			BusStats_Enabled(void);
+int 			BusStats_Get(Bus_t bus, unsigned int device, BusOp_t op, BusOpStats_t *stats);
+unsigned int 	BusStats_Devices(Bus_t bus, unsigned int *devices, unsigned int count);
+uint64_t 		BusStats_Percentile(const BusOpStats_t *stats, unsigned int percent);
+const char* 	BusStats_DeviceName(Bus_t bus, unsigned int device);
+void 			BusStats_Reset(void);
+void 			BusStats_Dump(FILE *out);
+
+#endif
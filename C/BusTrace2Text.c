@@ -0,0 +1,67 @@
+/**
+ * @file BusTrace2Text.c
+ * @brief Prints a saved bus trace, one transaction per line
+ *
+ * Usage: ./BusTrace2Text trace [address]
+ * Each line holds the time since the first record in us, the bus, the chip, the operation, the result and
+ * the bytes written and read in hex. An I2C address such as 0x60 limits the output to one chip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "BusTrace.h"
+
+/**
+ * @brief Prints bytes in hex, separated by spaces.
+ */
+static void printBytes(const uint8_t *bytes, uint32_t length)
+{
+	for(uint32_t i = 0; i < length; i++)
+	{
+		printf(" %02X", bytes[i]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const char *op_names[BUS_OP_COUNT] = {"read", "write", "write-read"};
+	BusTraceReader_t trace;
+	BusTraceRecord_t r;
+	long address = -1;
+	int status;
+
+	if(argc < 2)
+	{
+		printf("Usage: %s trace [address]\n", argv[0]);
+		return 1;
+	}
+	if(argc > 2) address = strtol(argv[2], NULL, 0);
+	if(BusTraceReader_Open(&trace, argv[1]) != 0)
+	{
+		printf("Could not read %s\n", argv[1]);
+		return 1;
+	}
+	printf("# %llu records from %.3f s after the epoch, %llu older ones dropped\n",
+		   (unsigned long long) trace.header.records, trace.header.start_ns / 1e9,
+		   (unsigned long long) trace.header.dropped);
+	while((status = BusTraceReader_Next(&trace, &r)) == 1)
+	{
+		if(address >= 0 && (r.bus != BUS_I2C || r.address != address))
+		{
+			continue;
+		}
+		printf("%12llu %s 0x%02X %-16s %-10s %u  w", (unsigned long long) r.time_us, (r.bus == BUS_I2C) ? "I2C" : "SPI",
+			   r.address, BusStats_DeviceName(r.bus, r.address), op_names[r.op], r.result);
+		printBytes(r.write, r.write_length);
+		printf("  r");
+		printBytes(r.read, r.read_length);
+		printf("\n");
+	}
+	BusTraceReader_Close(&trace);
+	if(status < 0)
+	{
+		fprintf(stderr, "%s is corrupt after the last record printed.\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
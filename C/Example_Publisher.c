@@ -0,0 +1,64 @@
+/**
+ * @file Example_Publisher.c
+ * @brief Example sampler that owns the bus and publishes every channel to shared memory for other processes
+ *
+ * Run one publisher, then read the sensors from any number of processes with SensorShm_Attach and
+ * SensorShm_ReadSnapshot, or from Python with SensorsInterface.attachShared and getSharedReading.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include "SensorsInterface.h"
+#include "Scheduler.h"
+#include "SensorShm.h"
+
+static volatile sig_atomic_t running = 1;  // Cleared by SIGINT or SIGTERM to shut down cleanly
+
+// Stops the main loop when the process is asked to exit
+static void stop(int sig)
+{
+    running = 0;
+}
+
+int main(void)
+{
+    setupSensorian(); // Set up all the sensors on the Sensorian Shield
+
+    if (SensorShm_Create() != 0) // Create the shared segment at /dev/shm/sensorian
+    {
+        return 1;
+    }
+
+    Scheduler_SetRate(SENSOR_LIGHT, 10.0f, 0); // Sample each channel at its own rate in Hz
+    Scheduler_SetRate(SENSOR_TEMPERATURE, 1.0f, 0);
+    Scheduler_SetRate(SENSOR_PRESSURE, 1.0f, 0);
+    Scheduler_SetRate(SENSOR_ALTITUDE, 1.0f, 0);
+    for (int ch = SENSOR_ACCEL_X; ch <= SENSOR_MAG_Z; ch++)
+    {
+        Scheduler_SetRate(ch, 50.0f, 0); // All six axes share one burst read
+    }
+    Scheduler_SetRate(SENSOR_TOUCH, 20.0f, 0);
+    Scheduler_SetRate(SENSOR_RTCC, 1.0f, 0);
+
+    Scheduler_AddCallback(SensorShm_Publish, NULL); // Every batch of samples goes to the shared segment
+    Scheduler_AddCallback(publishSamples, NULL); // and to the getters of this process
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    if (Scheduler_Start(SCHEDULER_TIMERFD) != 0)
+    {
+        SensorShm_Destroy();
+        return 1;
+    }
+    printf("Publishing to /dev/shm%s, press Ctrl+C to stop.\n", SENSOR_SHM_NAME);
+    while (running)
+    {
+        pause(); // The scheduler thread does all the work
+    }
+
+    Scheduler_Stop();
+    SensorShm_Destroy();
+    return 0;
+}
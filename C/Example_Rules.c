@@ -0,0 +1,70 @@
+/**
+ * @file Example_Rules.c
+ * @brief Example that drives the LED, the TFT and IFTTT from a rules file instead of hard-coded loops
+ *
+ * Usage: ./Example_Rules [rules file]
+ * Example_Rules.conf is used by default. It reproduces Example_Lights and Example_Door as rules.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include "SensorsInterface.h"
+#include "TFT_Printer.h"
+#include "Scheduler.h"
+#include "Rules.h"
+
+static volatile sig_atomic_t running = 1;  // Cleared by SIGINT or SIGTERM to shut down cleanly
+
+// Stops the main loop when the process is asked to exit
+static void stop(int sig)
+{
+    running = 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 1) ? argv[1] : "Example_Rules.conf";
+    RulesStats_t stats;
+
+    int count = Rules_Load(path); // Compile the rules before touching the hardware
+    if (count < 0)
+    {
+        return 1;
+    }
+
+    setupSensorianFast(TFT_Setup, 0, NULL); // Set up the sensors, and the TFT LCD at the same time
+
+    for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+    {
+        float hz = Rules_Rate(ch); // Only sample the channels the rules look at
+        if (hz > 0.0f)
+        {
+            Scheduler_SetRate(ch, hz, 0);
+        }
+    }
+    Scheduler_AddCallback(Rules_Callback, NULL); // Every batch of samples is checked against the rules
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    Rules_Start(); // Actions run on their own thread so a slow HTTP trigger never delays sampling
+    if (Scheduler_Start(SCHEDULER_TIMERFD) != 0)
+    {
+        Rules_Stop();
+        return 1;
+    }
+    printf("%d rules loaded from %s, press Ctrl+C to stop.\n", count, path);
+    while (running)
+    {
+        pause(); // The scheduler and action threads do all the work
+    }
+
+    Scheduler_Stop();
+    Rules_Stop();
+    Rules_GetStats(&stats);
+    printf("%llu samples, %llu rules fired, %llu actions dropped\n", (unsigned long long) stats.samples,
+           (unsigned long long) stats.fired, (unsigned long long) stats.dropped);
+    orange_led_off();
+    return 0;
+}
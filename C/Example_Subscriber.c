@@ -0,0 +1,54 @@
+/**
+ * @file Example_Subscriber.c
+ * @brief Example client of sensoriand that streams the accelerometer and shows the light level on the TFT
+ *
+ * Start sensoriand first. This program does not link the drivers or run setupSensorian, so it starts
+ * immediately and can run beside any number of other clients.
+ */
+
+#include <stdio.h>
+#include "SensordClient.h"
+
+#define WHITE_565 0xFFFF
+#define BLACK_565 0x0000
+
+int main(void)
+{
+    Sample_t samples[SENSORD_MAX_SAMPLES]; // Buffer big enough for any batch the daemon sends
+    SensorSnapshot_t snapshot; // Latest reading of every channel
+    char line[SENSORD_TEXT_MAX];
+
+    int fd = Sensord_Connect(NULL); // Connect to the daemon on the default socket
+    if (fd < 0)
+    {
+        printf("Could not connect to sensoriand.\n");
+        return 1;
+    }
+
+    if (Sensord_Snapshot(fd, SENSOR_ALL_CHANNELS, &snapshot) > 0) // Read everything once without waiting on the bus
+    {
+        snprintf(line, sizeof(line), "Light: %.1f lux", snapshot.reading[SENSOR_LIGHT].value);
+        Sensord_TFTClear(fd, BLACK_565); // Drawn by the daemon's TFT thread
+        Sensord_TFTText(fd, 0, 0, WHITE_565, BLACK_565, line, 1);
+    }
+
+    Sensord_Subscribe(fd, SENSOR_CHANNEL_BIT(SENSOR_ACCEL_X) | SENSOR_CHANNEL_BIT(SENSOR_ACCEL_Y) |
+                          SENSOR_CHANNEL_BIT(SENSOR_ACCEL_Z), 10.0f); // 10 samples per second per axis
+    for (int received = 0; received < 100;)
+    {
+        int count = Sensord_ReadSamples(fd, samples, SENSORD_MAX_SAMPLES, 1000); // Wait up to a second
+        if (count < 0)
+        {
+            break; // The daemon went away
+        }
+        for (int i = 0; i < count; i++)
+        {
+            printf("%llu %s %f %s\n", (unsigned long long) samples[i].timestamp_ns,
+                   SensorChannel_Name(samples[i].channel), samples[i].value, SensorChannel_Unit(samples[i].channel));
+        }
+        received += count;
+    }
+
+    Sensord_Close(fd); // The daemon drops the subscription and lowers the rate again
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include "FXOS8700CQ.h"
 #include "MemoryMap.h"
 #include "i2c.h"
+#include "Utilities.h"
 
 /// \defgroup accelerometer Accelerometer and Magnetometer 
 /// These functions expose the accelerometer and magnetometer functionality
@@ -13,11 +14,40 @@
  */
 void  FXOS8700CQ_Initialize(void)
 {
-  FXOS8700CQ_WriteByte(FXOS_CTRL_REG2, RST_MASK);   					//Reset sensor, and wait for reboot to complete
-  bcm2835_delay(2);												//Wait at least 1ms after issuing a reset before attempting communications.
-  
+  FXOS8700CQ_Reset();
+  poll_ready(FXOS8700CQ_IsReady, FXOS_RESET_TIMEOUT_MS);		//Reboot takes about 1ms
+  FXOS8700CQ_Configure();
+}
+
+/**
+ *@brief Starts a software reset. The sensor does not answer until it has rebooted, see FXOS8700CQ_IsReady.
+ *@return none
+ */
+void FXOS8700CQ_Reset(void)
+{
+  FXOS8700CQ_WriteByte(FXOS_CTRL_REG2, RST_MASK);
+}
+
+/**
+ *@brief Checks whether the sensor has rebooted after FXOS8700CQ_Reset
+ *@return ready 1 once it answers with its ID and the reset bit has cleared, 0 otherwise
+ */
+unsigned char FXOS8700CQ_IsReady(void)
+{
+  if ((unsigned char) FXOS8700CQ_ReadByte(FXOS_WHO_AM_I) != FXOS8700CQ_WHOAMI_VAL)		//Reads 0 while the chip does not acknowledge
+  {
+    return 0;
+  }
+  return (FXOS8700CQ_ReadByte(FXOS_CTRL_REG2) & RST_MASK) == 0;
+}
+
+/**
+ *@brief Configures hybrid mode with a +/- 2g scale, leaving the sensor in standby
+ *@return none
+ */
+void FXOS8700CQ_Configure(void)
+{
   FXOS8700CQ_StandbyMode();
-  while (FXOS8700CQ_ReadByte(FXOS_CTRL_REG2) & RST_MASK);
   FXOS8700CQ_WriteByte(M_CTRL_REG1, (HYBRID_ACTIVE|M_OSR2_MASK|M_OSR1_MASK|M_OSR0_MASK) );      // OSR=max, Hybrid Mode 
   FXOS8700CQ_WriteByte(M_CTRL_REG2, M_HYB_AUTOINC_MASK);       							//Enable Hyb Mode Auto Increments  in order to read all data
   FXOS8700CQ_WriteByte(FXOS_CTRL_REG4, INT_EN_DRDY_MASK );           						// Enable interrupts for DRDY (TO, Aug 2012)
@@ -0,0 +1,2251 @@
+/**
+ * @file FakeShield.c
+ * @brief In-process stand-in for the Sensorian shield, linked in place of libbcm2835.
+ *
+ * Implements the bcm2835 I2C, SPI, GPIO and delay calls used by the drivers.
+ * Each I2C chip is a 256 byte register file with hooks for the registers that
+ * do more than store a value: data ready flags, self clearing bits, the APDS9300
+ * command byte, the FXOS8700CQ hybrid auto-increment and the MCP79410
+ * oscillator. Conversions complete on a virtual clock that every transfer
+ * advances by its bit time at the configured bus rate and every delay advances
+ * by its length, so a run is deterministic and never sleeps. Chips update
+ * lazily, when they are next addressed or their pins are sampled. The ST7735 decodes CASET, RASET,
+ * MADCTL and RAMWR into its display RAM, using the DC pin for command or data,
+ * and SCRLAR, VSCSAD, PTLAR and the partial and idle modes into what it shows.
+ *
+ * The MPL3115A2 and FXOS8700CQ queue their samples in FIFO mode, and every chip
+ * drives its interrupt output onto the GPIO pin of the shield with the polarity
+ * it is configured for. Pins are sampled when read, and around every transfer
+ * while edge detection is enabled, which is where their rising edges are
+ * detected; enough for the latched interrupt outputs and the slower RTCC
+ * square waves. FakeShield_SetEnvironment sets what
+ * the sensors measure and which buttons are touched. FakeShield_VirtualTime
+ * moves timestamp_ns and the scheduler onto the virtual clock as well, so hours
+ * of scheduled sampling run in seconds.
+ *
+ * With a trace from BusTrace.c loaded, by FakeShield_Replay or the BUS_REPLAY
+ * environment variable, the transfers are answered from the trace instead:
+ * each bus takes the next record of that bus and returns what the drivers
+ * received when it was recorded. Any program relinked against FakeShield.o
+ * then runs the recorded code path at full speed.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bcm2835.h"
+#include "BusTrace.h"
+#include "Utilities.h"
+#include "FakeShield.h"
+
+#define FAKE_GPIO_PINS			54
+
+#define FAKE_TFT_CS_PIN			RPI_V2_GPIO_P1_24
+#define FAKE_TFT_DC_PIN			RPI_V2_GPIO_P1_22
+#define FAKE_TFT_RST_PIN		RPI_V2_GPIO_P1_16
+
+#define FAKE_MPL_ADDRESS		0x60
+#define FAKE_APDS_ADDRESS		0x29
+#define FAKE_CAP_ADDRESS		0x28
+#define FAKE_FXOS_ADDRESS		0x1E
+#define FAKE_RTCC_ADDRESS		0x6F
+#define FAKE_EEPROM_ADDRESS		0x57
+
+#define FAKE_MPL_PRESSURE_PA	98000		//What the chips measure, about 280 m above sea level
+#define FAKE_MPL_ALTITUDE_M		280
+#define FAKE_MPL_TEMPERATURE_C	21.5
+#define FAKE_APDS_CH0			1200		//Counts at gain 1 and 402 ms
+#define FAKE_APDS_CH1			300
+#define FAKE_FXOS_ACCEL_MG		{20, -10, 1000}
+#define FAKE_FXOS_MAG_DUT		{250, -120, 430}	//0.1 uT per count
+#define FAKE_FXOS_TEMP_C		24
+
+#define FAKE_FXOS_BOOT_NS		1000000ULL	//The FXOS8700CQ does not acknowledge for 1 ms after a reset
+#define FAKE_RTCC_START_NS		2000000ULL	//Crystal start up, until OSCRUN is set
+#define FAKE_RTCC_STOP_NS		31000ULL	//One 32 kHz cycle, until OSCRUN is cleared
+#define FAKE_ANY_OP				-1			//SPI transfers do not tell a write from a read
+
+#define FAKE_FIFO_DEPTH			32			//Samples, in both the MPL3115A2 and the FXOS8700CQ
+
+/**
+ * @brief One I2C chip. Hooks left NULL read and write the register file plainly.
+ */
+typedef struct _FakeChip
+{
+	uint8_t address;
+	uint8_t reg[256];
+	uint8_t pointer;						/**< Register pointer, auto-incremented by transfers */
+	uint64_t busy_until;					/**< Not acknowledged until then, e.g. while rebooting */
+	uint64_t due;							/**< Next conversion, tick or oscillator change, 0 if none is pending */
+	uint8_t fifo[FAKE_FIFO_DEPTH][6];		/**< Samples queued in FIFO mode */
+	uint8_t fifo_head;						/**< Oldest sample */
+	uint8_t fifo_count;
+	uint8_t fifo_byte;						/**< Next byte of the oldest sample, for the MPL3115A2 F_DATA */
+	uint8_t fifo_overflow;					/**< A sample was lost since F_STATUS was last read */
+	uint8_t interrupt;						/**< Latched interrupt, for chips without a source register */
+	uint8_t persist;						/**< Consecutive conversions out of the interrupt thresholds */
+	uint8_t pin;							/**< GPIO driven by the interrupt output */
+	void (*reset)(struct _FakeChip *chip);
+	void (*update)(struct _FakeChip *chip, uint64_t now);
+	int (*select)(struct _FakeChip *chip, uint8_t byte);		/**< Returns 0 if the byte is data, not a register address */
+	uint8_t (*read)(struct _FakeChip *chip, uint8_t reg);
+	void (*write)(struct _FakeChip *chip, uint8_t reg, uint8_t value);
+	uint8_t (*next)(struct _FakeChip *chip, uint8_t reg);
+	uint8_t (*level)(struct _FakeChip *chip);					/**< Level of the interrupt output, NULL without one */
+} FakeChip_t;
+
+/**
+ * @brief The ST7735 display controller.
+ */
+typedef struct _FakeTFT
+{
+	uint8_t command;						/**< Last command byte */
+	unsigned int args;						/**< Data bytes received since the command */
+	uint16_t xs, xe, ys, ye;				/**< Window set by CASET and RASET */
+	uint16_t x, y;							/**< RAMWR position in the window */
+	uint8_t high;							/**< First byte of a RAMWR pixel */
+	uint8_t madctl;
+	uint8_t sleeping;
+	uint8_t display_on;
+	uint8_t inverted;
+	uint8_t scrolling;						/**< Set by VSCSAD until NORON */
+	uint16_t tfa, vsa, ssa;					/**< Top fixed rows, scrolling rows and first row shown, SCRLAR and VSCSAD */
+	uint8_t partial;						/**< Set by PTLON until NORON */
+	uint16_t psr, per;						/**< First and last row shown in partial mode, PTLAR */
+	uint8_t idle;							/**< 8 colour idle mode */
+	uint16_t ram[FAKE_TFT_HEIGHT][FAKE_TFT_WIDTH];
+} FakeTFT_t;
+
+static void mplReset(FakeChip_t *chip);
+static void mplUpdate(FakeChip_t *chip, uint64_t now);
+static uint8_t mplRead(FakeChip_t *chip, uint8_t reg);
+static void mplWrite(FakeChip_t *chip, uint8_t reg, uint8_t value);
+static void mplSource(FakeChip_t *chip);
+static uint8_t mplNext(FakeChip_t *chip, uint8_t reg);
+static uint8_t mplLevel(FakeChip_t *chip);
+static void apdsReset(FakeChip_t *chip);
+static void apdsUpdate(FakeChip_t *chip, uint64_t now);
+static int apdsSelect(FakeChip_t *chip, uint8_t byte);
+static void apdsWrite(FakeChip_t *chip, uint8_t reg, uint8_t value);
+static uint8_t apdsNext(FakeChip_t *chip, uint8_t reg);
+static uint8_t apdsLevel(FakeChip_t *chip);
+static void apdsThreshold(FakeChip_t *chip, uint16_t ch0);
+static void capReset(FakeChip_t *chip);
+static void capWrite(FakeChip_t *chip, uint8_t reg, uint8_t value);
+static void capTouch(FakeChip_t *chip, uint8_t touched);
+static uint8_t capLevel(FakeChip_t *chip);
+static void fxosReset(FakeChip_t *chip);
+static void fxosUpdate(FakeChip_t *chip, uint64_t now);
+static uint8_t fxosRead(FakeChip_t *chip, uint8_t reg);
+static void fxosWrite(FakeChip_t *chip, uint8_t reg, uint8_t value);
+static uint8_t fxosNext(FakeChip_t *chip, uint8_t reg);
+static uint8_t fxosLevel(FakeChip_t *chip);
+static void fxosSource(FakeChip_t *chip);
+static void rtccReset(FakeChip_t *chip);
+static void rtccUpdate(FakeChip_t *chip, uint64_t now);
+static void rtccWrite(FakeChip_t *chip, uint8_t reg, uint8_t value);
+static uint8_t rtccNext(FakeChip_t *chip, uint8_t reg);
+static uint8_t rtccLevel(FakeChip_t *chip);
+static void tftReset(void);
+static void tftByte(uint8_t byte);
+static FakeChip_t* chipAt(uint8_t address);
+static int chipAck(FakeChip_t *chip);
+static void chipSelect(FakeChip_t *chip, uint8_t byte);
+static void chipWrite(FakeChip_t *chip, const char *buf, uint32_t len);
+static void chipRead(FakeChip_t *chip, char *buf, uint32_t len);
+static void i2cClock(uint32_t bytes, int restart);
+static void pinsUpdate(void);
+static void pinsEdges(void);
+static void gpioRising(uint8_t pin, uint8_t enable);
+static uint8_t interruptLevel(int asserted, int active_high);
+static void fifoFlush(FakeChip_t *chip);
+static void fifoPush(FakeChip_t *chip, const uint8_t *sample, unsigned int bytes, uint8_t setup);
+static void fifoPop(FakeChip_t *chip);
+static uint8_t fifoStatus(FakeChip_t *chip, uint8_t setup);
+static void spiWrite(const char *buf, uint32_t len);
+static int replayOpen(const char *path);
+static int replayNext(Bus_t bus, int op, const char *write, uint32_t write_length, char *read, uint32_t read_length);
+static void fakeReset(void);
+static void fakeSetup(void);
+static void fakeLoad(void) __attribute__((constructor));
+static void fakeWaitUntil(uint64_t ns);
+static void fakeSaveImageAtExit(void);
+
+static FakeChip_t chips[] = {
+	{.address = FAKE_MPL_ADDRESS, .reset = mplReset, .update = mplUpdate, .read = mplRead, .write = mplWrite,
+	 .next = mplNext, .pin = MPL_PIN, .level = mplLevel},
+	{.address = FAKE_APDS_ADDRESS, .reset = apdsReset, .update = apdsUpdate, .select = apdsSelect,
+	 .write = apdsWrite, .next = apdsNext, .pin = LUX_PIN, .level = apdsLevel},
+	{.address = FAKE_CAP_ADDRESS, .reset = capReset, .write = capWrite, .pin = ALERT_PIN, .level = capLevel},
+	{.address = FAKE_FXOS_ADDRESS, .reset = fxosReset, .update = fxosUpdate, .read = fxosRead, .write = fxosWrite,
+	 .next = fxosNext, .pin = ACLM_PIN, .level = fxosLevel},
+	{.address = FAKE_RTCC_ADDRESS, .reset = rtccReset, .update = rtccUpdate, .write = rtccWrite, .next = rtccNext,
+	 .pin = MFP_PIN, .level = rtccLevel},
+	{.address = FAKE_EEPROM_ADDRESS},
+};
+
+static const FakeShieldEnvironment_t default_environment = {
+	.pressure_pa = FAKE_MPL_PRESSURE_PA,
+	.altitude_m = FAKE_MPL_ALTITUDE_M,
+	.temperature_c = FAKE_MPL_TEMPERATURE_C,
+	.light_ch0 = FAKE_APDS_CH0,
+	.light_ch1 = FAKE_APDS_CH1,
+	.accel_mg = FAKE_FXOS_ACCEL_MG,
+	.mag = FAKE_FXOS_MAG_DUT,
+	.fxos_temperature_c = FAKE_FXOS_TEMP_C,
+	.touched = 0,
+};
+
+#define FAKE_CHIP_COUNT		(sizeof(chips) / sizeof(chips[0]))
+
+static FakeTFT_t tft;
+static uint8_t gpio_level[FAKE_GPIO_PINS];
+static uint8_t gpio_rising[FAKE_GPIO_PINS];	/*!< Rising edge detection enabled */
+static uint8_t gpio_event[FAKE_GPIO_PINS];		/*!< Edge detected, until cleared with bcm2835_gpio_set_eds */
+static unsigned int gpio_edge_pins = 0;			/*!< Pins with edge detection enabled */
+static FakeShieldEnvironment_t fake_environment;
+static uint8_t i2c_address = 0;
+static uint32_t i2c_hz = 100000;
+static uint32_t spi_hz = BCM2835_CORE_CLK_HZ / 65536;
+static uint64_t fake_now = 0;				/*!< Virtual time in ns */
+static FakeShieldStats_t fake_stats;
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t fake_once = PTHREAD_ONCE_INIT;
+static BusTraceReader_t replay;				/*!< Trace being replayed, data is NULL without one */
+static BusTraceReader_t replay_cursor[BUS_COUNT];	/*!< Position of each bus in the trace */
+
+/// \defgroup fakeshield Fake shield
+/// These functions control the simulated chips that stand in for the shield.
+/// @{
+
+/**
+ * @brief Powers every chip on again with its reset values, sets the virtual clock to zero and rewinds the
+ *		  replayed trace.
+ * @return none
+ */
+void FakeShield_Reset(void)
+{
+	pthread_once(&fake_once, fakeSetup);
+	pthread_mutex_lock(&fake_lock);
+	fakeReset();
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Answers the transfers from a saved trace from now on, starting at its first record.
+ * @param path Trace saved by BusTrace_Save, NULL to go back to the simulated chips
+ * @return status 0 on success, -1 if the trace cannot be read.
+ */
+int FakeShield_Replay(const char *path)
+{
+	pthread_once(&fake_once, fakeSetup);
+	pthread_mutex_lock(&fake_lock);
+	int status = replayOpen(path);
+	pthread_mutex_unlock(&fake_lock);
+	return status;
+}
+
+/**
+ * @brief Puts timestamp_ns, wait_until_ns and with them the scheduler on the virtual clock, so that
+ *		  waiting for the next sample jumps the clock forward instead of sleeping.
+ * @param enable 1 for the virtual clock, 0 for the monotonic clock
+ * @return none
+ */
+void FakeShield_VirtualTime(int enable)
+{
+	pthread_once(&fake_once, fakeSetup);
+	timestamp_set_clock(enable ? FakeShield_Now : NULL, enable ? fakeWaitUntil : NULL);
+}
+
+/**
+ * @brief Reads what the simulated sensors measure.
+ * @param environment Receives the values
+ * @return none
+ */
+void FakeShield_GetEnvironment(FakeShieldEnvironment_t *environment)
+{
+	pthread_once(&fake_once, fakeSetup);
+	pthread_mutex_lock(&fake_lock);
+	*environment = fake_environment;
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Changes what the simulated sensors measure from their next conversion on, and touches or
+ *		  releases the buttons right away.
+ * @param environment New values
+ * @return none
+ */
+void FakeShield_SetEnvironment(const FakeShieldEnvironment_t *environment)
+{
+	pthread_once(&fake_once, fakeSetup);
+	pthread_mutex_lock(&fake_lock);
+	pinsUpdate();						//Conversions due before now still see the old values
+	uint8_t touched = environment->touched & ~fake_environment.touched;
+	fake_environment = *environment;
+	capTouch(chipAt(FAKE_CAP_ADDRESS), touched);
+	pinsUpdate();
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Reads the virtual clock.
+ * @return ns Virtual time since FakeShield_Reset.
+ */
+uint64_t FakeShield_Now(void)
+{
+	pthread_mutex_lock(&fake_lock);
+	uint64_t now = fake_now;
+	pthread_mutex_unlock(&fake_lock);
+	return now;
+}
+
+/**
+ * @brief Reports the bus traffic so far and splits the virtual time between the buses and the delays.
+ * @param stats Receives the counters
+ * @return none
+ */
+void FakeShield_Stats(FakeShieldStats_t *stats)
+{
+	pthread_mutex_lock(&fake_lock);
+	*stats = fake_stats;
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Lets virtual time pass without bus activity, e.g. to let a conversion complete.
+ * @param ns Time to add to the clock
+ * @return none
+ */
+void FakeShield_Advance(uint64_t ns)
+{
+	pthread_mutex_lock(&fake_lock);
+	fake_now += ns;
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Reads a register of an I2C chip without the side effects of a bus read.
+ * @param address I2C address of the chip
+ * @param reg Register address
+ * @return value Register content, 0 for an address without a chip.
+ */
+uint8_t FakeShield_Register(uint8_t address, uint8_t reg)
+{
+	uint8_t value = 0;
+
+	pthread_mutex_lock(&fake_lock);
+	FakeChip_t *chip = chipAt(address);
+	if(chip)
+	{
+		if(chip->update)
+		{
+			chip->update(chip, fake_now);
+		}
+		value = chip->reg[reg];
+	}
+	pthread_mutex_unlock(&fake_lock);
+	return value;
+}
+
+/**
+ * @brief Reads a pixel of the display RAM.
+ * @param x Column, 0 to FAKE_TFT_WIDTH - 1
+ * @param y Row, 0 to FAKE_TFT_HEIGHT - 1
+ * @return color RGB565 color, 0 outside the RAM.
+ */
+uint16_t FakeShield_Pixel(unsigned int x, unsigned int y)
+{
+	if(x >= FAKE_TFT_WIDTH || y >= FAKE_TFT_HEIGHT)
+	{
+		return 0;
+	}
+	pthread_mutex_lock(&fake_lock);
+	uint16_t color = tft.ram[y][x];
+	pthread_mutex_unlock(&fake_lock);
+	return color;
+}
+
+/**
+ * @brief Saves what the display shows as a binary PPM image: the display RAM with the vertical scrolling,
+ *		  the partial area, the idle mode, MADCTL's RGB order and the inversion applied, or black while the
+ *		  display is off or sleeping. Rows outside the partial area are black.
+ * @param path File to write
+ * @return status 0 on success, -1 if the file cannot be written.
+ */
+int FakeShield_SaveImage(const char *path)
+{
+	static uint8_t pixels[FAKE_TFT_HEIGHT][FAKE_TFT_WIDTH][3];
+	FILE *file = fopen(path, "wb");
+
+	if(file == NULL)
+	{
+		return -1;
+	}
+	pthread_mutex_lock(&fake_lock);
+	int shown = tft.display_on && !tft.sleeping;
+	for(unsigned int y = 0; y < FAKE_TFT_HEIGHT; y++)
+	{
+		unsigned int source = y;
+		if(tft.scrolling && y >= tft.tfa && y - tft.tfa < tft.vsa && tft.ssa >= tft.tfa)
+		{
+			source = tft.tfa + (y - tft.tfa + tft.ssa - tft.tfa) % tft.vsa;		//RAM row shown on this line
+		}
+		int scanned = !tft.partial || ((tft.psr <= tft.per) ? (y >= tft.psr && y <= tft.per)
+															   : (y >= tft.psr || y <= tft.per));
+		for(unsigned int x = 0; x < FAKE_TFT_WIDTH; x++)
+		{
+			uint16_t color = (shown && scanned && source < FAKE_TFT_HEIGHT) ? tft.ram[source][x] : 0;
+			if(shown && scanned && tft.inverted)
+			{
+				color = ~color;
+			}
+			if(tft.idle)							//Only the top bit of each channel
+			{
+				color = ((color & 0x8000) ? 0xF800 : 0) | ((color & 0x0400) ? 0x07E0 : 0) | ((color & 0x0010) ? 0x001F : 0);
+			}
+			uint8_t first = (uint8_t)((color >> 11) << 3);
+			uint8_t green = (uint8_t)(((color >> 5) & 0x3F) << 2);
+			uint8_t last = (uint8_t)((color & 0x1F) << 3);
+			int bgr = (tft.madctl & 0x08) != 0;			//The panel is wired BGR, so RGB data needs BGR set
+			pixels[y][x][0] = bgr ? first : last;
+			pixels[y][x][1] = green;
+			pixels[y][x][2] = bgr ? last : first;
+		}
+	}
+	pthread_mutex_unlock(&fake_lock);
+	fprintf(file, "P6\n%d %d\n255\n", FAKE_TFT_WIDTH, FAKE_TFT_HEIGHT);
+	size_t written = fwrite(pixels, sizeof(pixels), 1, file);
+	if(fclose(file) != 0 || written != 1)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/// @}
+
+/// \defgroup fakebcm2835 bcm2835 stand-ins
+/// The subset of libbcm2835 used by the drivers, acting on the fake chips.
+/// @{
+
+/**
+ * @brief Brings the fake shield up on first use. Nothing is mapped.
+ * @return 1 for success
+ */
+int bcm2835_init(void)
+{
+	pthread_once(&fake_once, fakeSetup);
+	return 1;
+}
+
+/**
+ * @brief Counterpart of bcm2835_init, the chips keep their state.
+ * @return 1 for success
+ */
+int bcm2835_close(void)
+{
+	return 1;
+}
+
+/**
+ * @brief Waits by advancing the virtual clock.
+ * @param millis Delay in ms
+ * @return none
+ */
+void bcm2835_delay(unsigned int millis)
+{
+	bcm2835_delayMicroseconds((uint64_t) millis * 1000);
+}
+
+/**
+ * @brief Waits by advancing the virtual clock.
+ * @param micros Delay in us
+ * @return none
+ */
+void bcm2835_delayMicroseconds(uint64_t micros)
+{
+	pthread_mutex_lock(&fake_lock);
+	fake_now += micros * 1000;
+	fake_stats.delay_ns += micros * 1000;
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Pin functions are not modelled.
+ */
+void bcm2835_gpio_fsel(uint8_t pin, uint8_t mode)
+{
+	(void) pin;
+	(void) mode;
+}
+
+/**
+ * @brief Drives a pin. The TFT samples DC on each SPI byte and resets while RST is low.
+ * @param pin GPIO number
+ * @param on HIGH or LOW
+ * @return none
+ */
+void bcm2835_gpio_write(uint8_t pin, uint8_t on)
+{
+	if(pin >= FAKE_GPIO_PINS)
+	{
+		return;
+	}
+	pthread_mutex_lock(&fake_lock);
+	gpio_level[pin] = (on != LOW);
+	if(pin == FAKE_TFT_RST_PIN && on == LOW)
+	{
+		tftReset();
+	}
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Reads a pin: the interrupt output of the chip wired to it, else the level last written.
+ * @param pin GPIO number
+ * @return level HIGH or LOW
+ */
+uint8_t bcm2835_gpio_lev(uint8_t pin)
+{
+	if(pin >= FAKE_GPIO_PINS)
+	{
+		return LOW;
+	}
+	pthread_mutex_lock(&fake_lock);
+	pinsUpdate();
+	uint8_t level = gpio_level[pin];
+	pthread_mutex_unlock(&fake_lock);
+	return level;
+}
+
+/**
+ * @brief Tells whether a rising edge was detected on a pin since its event was last cleared.
+ * @param pin GPIO number
+ * @return event 1 if an edge was detected, else 0.
+ */
+uint8_t bcm2835_gpio_eds(uint8_t pin)
+{
+	if(pin >= FAKE_GPIO_PINS)
+	{
+		return 0;
+	}
+	pthread_mutex_lock(&fake_lock);
+	pinsUpdate();
+	uint8_t event = gpio_event[pin];
+	pthread_mutex_unlock(&fake_lock);
+	return event;
+}
+
+/**
+ * @brief Pull resistors are not modelled.
+ */
+void bcm2835_gpio_set_pud(uint8_t pin, uint8_t pud)
+{
+	(void) pin;
+	(void) pud;
+}
+
+/**
+ * @brief Clears the edge event of a pin.
+ * @param pin GPIO number
+ * @return none
+ */
+void bcm2835_gpio_set_eds(uint8_t pin)
+{
+	if(pin < FAKE_GPIO_PINS)
+	{
+		pthread_mutex_lock(&fake_lock);
+		gpio_event[pin] = 0;
+		pthread_mutex_unlock(&fake_lock);
+	}
+}
+
+/**
+ * @brief Enables rising edge detection on a pin.
+ * @param pin GPIO number
+ * @return none
+ */
+void bcm2835_gpio_ren(uint8_t pin)
+{
+	gpioRising(pin, 1);
+}
+
+/**
+ * @brief Disables rising edge detection on a pin.
+ * @param pin GPIO number
+ * @return none
+ */
+void bcm2835_gpio_clr_ren(uint8_t pin)
+{
+	gpioRising(pin, 0);
+}
+
+/**
+ * @brief Enables asynchronous rising edge detection on a pin.
+ * @param pin GPIO number
+ * @return none
+ */
+void bcm2835_gpio_aren(uint8_t pin)
+{
+	gpioRising(pin, 1);
+}
+
+/**
+ * @brief Disables asynchronous rising edge detection on a pin.
+ * @param pin GPIO number
+ * @return none
+ */
+void bcm2835_gpio_clr_aren(uint8_t pin)
+{
+	gpioRising(pin, 0);
+}
+
+/**
+ * @brief Nothing to configure.
+ */
+void bcm2835_i2c_begin(void)
+{
+}
+
+/**
+ * @brief Nothing to release.
+ */
+void bcm2835_i2c_end(void)
+{
+}
+
+/**
+ * @brief Selects the chip addressed by the next transfers.
+ * @param addr 7 bit I2C address
+ * @return none
+ */
+void bcm2835_i2c_setSlaveAddress(uint8_t addr)
+{
+	i2c_address = addr;
+}
+
+/**
+ * @brief Sets the bus rate from the BSC clock divider.
+ * @param divider Divider of the 250 MHz core clock
+ * @return none
+ */
+void bcm2835_i2c_setClockDivider(uint16_t divider)
+{
+	i2c_hz = BCM2835_CORE_CLK_HZ / (divider ? divider : 32768);
+}
+
+/**
+ * @brief Sets the bus rate.
+ * @param baudrate Rate in Hz
+ * @return none
+ */
+void bcm2835_i2c_set_baudrate(uint32_t baudrate)
+{
+	if(baudrate)
+	{
+		i2c_hz = baudrate;
+	}
+}
+
+/**
+ * @brief Writes to the selected chip. The first byte is the register address.
+ * @param buf Bytes to write
+ * @param len Number of bytes
+ * @return reason BCM2835_I2C_REASON_OK, or BCM2835_I2C_REASON_ERROR_NACK if no chip answers.
+ */
+uint8_t bcm2835_i2c_write(const char *buf, uint32_t len)
+{
+	pthread_mutex_lock(&fake_lock);
+	FakeChip_t *chip = chipAt(i2c_address);
+	uint8_t reason = BCM2835_I2C_REASON_ERROR_NACK;
+	if(replay.data)
+	{
+		reason = replayNext(BUS_I2C, BUS_OP_WRITE, buf, len, NULL, 0);
+		i2cClock(len, 0);
+	}
+	else if(chipAck(chip))
+	{
+		chipWrite(chip, buf, len);
+		i2cClock(len, 0);
+		pinsEdges();
+		reason = BCM2835_I2C_REASON_OK;
+	}
+	else
+	{
+		i2cClock(0, 0);
+	}
+	pthread_mutex_unlock(&fake_lock);
+	return reason;
+}
+
+/**
+ * @brief Reads from the register pointer of the selected chip.
+ * @param buf Receives the bytes, left unchanged if no chip answers
+ * @param len Number of bytes
+ * @return reason BCM2835_I2C_REASON_OK, or BCM2835_I2C_REASON_ERROR_NACK if no chip answers.
+ */
+uint8_t bcm2835_i2c_read(char *buf, uint32_t len)
+{
+	pthread_mutex_lock(&fake_lock);
+	FakeChip_t *chip = chipAt(i2c_address);
+	uint8_t reason = BCM2835_I2C_REASON_ERROR_NACK;
+	if(replay.data)
+	{
+		reason = replayNext(BUS_I2C, BUS_OP_READ, NULL, 0, buf, len);
+		i2cClock(len, 0);
+	}
+	else if(chipAck(chip))
+	{
+		chipRead(chip, buf, len);
+		i2cClock(len, 0);
+		pinsEdges();
+		reason = BCM2835_I2C_REASON_OK;
+	}
+	else
+	{
+		i2cClock(0, 0);
+	}
+	pthread_mutex_unlock(&fake_lock);
+	return reason;
+}
+
+/**
+ * @brief Writes a register address, then reads from it after a repeated start.
+ * @param regaddr Register address
+ * @param buf Receives the bytes, left unchanged if no chip answers
+ * @param len Number of bytes
+ * @return reason BCM2835_I2C_REASON_OK, or BCM2835_I2C_REASON_ERROR_NACK if no chip answers.
+ */
+uint8_t bcm2835_i2c_read_register_rs(char *regaddr, char *buf, uint32_t len)
+{
+	return bcm2835_i2c_write_read_rs(regaddr, 1, buf, len);
+}
+
+/**
+ * @brief Writes bytes, then reads after a repeated start.
+ * @param cmds Bytes to write, the first one is the register address
+ * @param cmds_len Number of bytes to write
+ * @param buf Receives the bytes, left unchanged if no chip answers
+ * @param buf_len Number of bytes to read
+ * @return reason BCM2835_I2C_REASON_OK, or BCM2835_I2C_REASON_ERROR_NACK if no chip answers.
+ */
+uint8_t bcm2835_i2c_write_read_rs(char *cmds, uint32_t cmds_len, char *buf, uint32_t buf_len)
+{
+	pthread_mutex_lock(&fake_lock);
+	FakeChip_t *chip = chipAt(i2c_address);
+	uint8_t reason = BCM2835_I2C_REASON_ERROR_NACK;
+	if(replay.data)
+	{
+		reason = replayNext(BUS_I2C, BUS_OP_WRITE_READ, cmds, cmds_len, buf, buf_len);
+		i2cClock(cmds_len + buf_len, 1);
+	}
+	else if(chipAck(chip))
+	{
+		chipWrite(chip, cmds, cmds_len);
+		chipRead(chip, buf, buf_len);
+		i2cClock(cmds_len + buf_len, 1);
+		pinsEdges();
+		reason = BCM2835_I2C_REASON_OK;
+	}
+	else
+	{
+		i2cClock(0, 0);
+	}
+	pthread_mutex_unlock(&fake_lock);
+	return reason;
+}
+
+/**
+ * @brief Nothing to configure.
+ */
+void bcm2835_spi_begin(void)
+{
+}
+
+/**
+ * @brief Nothing to release.
+ */
+void bcm2835_spi_end(void)
+{
+}
+
+/**
+ * @brief Only MSB first is modelled.
+ */
+void bcm2835_spi_setBitOrder(uint8_t order)
+{
+	(void) order;
+}
+
+/**
+ * @brief Only mode 0 is modelled.
+ */
+void bcm2835_spi_setDataMode(uint8_t mode)
+{
+	(void) mode;
+}
+
+/**
+ * @brief The TFT chip select is driven as a GPIO.
+ */
+void bcm2835_spi_chipSelect(uint8_t cs)
+{
+	(void) cs;
+}
+
+/**
+ * @brief Sets the bus rate from the SPI clock divider.
+ * @param divider Divider of the 250 MHz core clock, 0 for 65536
+ * @return none
+ */
+void bcm2835_spi_setClockDivider(uint16_t divider)
+{
+	spi_hz = BCM2835_CORE_CLK_HZ / (divider ? divider : 65536);
+}
+
+/**
+ * @brief Sends a byte to the TFT.
+ * @param value Byte to send
+ * @return byte Received byte, 0 since the TFT is write only here, or the recorded one when replaying.
+ */
+uint8_t bcm2835_spi_transfer(uint8_t value)
+{
+	char received = 0;
+	bcm2835_spi_transfernb((char *) &value, &received, 1);
+	return (uint8_t) received;
+}
+
+/**
+ * @brief Sends bytes to the TFT.
+ * @param tbuf Bytes to send
+ * @param rbuf Receives zeros, or the recorded bytes when replaying
+ * @param len Number of bytes
+ * @return none
+ */
+void bcm2835_spi_transfernb(char *tbuf, char *rbuf, uint32_t len)
+{
+	pthread_mutex_lock(&fake_lock);
+	spiWrite(tbuf, len);
+	memset(rbuf, 0, len);
+	if(replay.data)
+	{
+		replayNext(BUS_SPI, FAKE_ANY_OP, tbuf, len, rbuf, len);
+	}
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Sends bytes to the TFT, which takes them while its chip select is low. The display is still drawn
+ *		  when replaying, only what the drivers read comes from the trace.
+ * @param buf Bytes to send
+ * @param len Number of bytes
+ * @return none
+ */
+void bcm2835_spi_writenb(char *buf, uint32_t len)
+{
+	pthread_mutex_lock(&fake_lock);
+	spiWrite(buf, len);
+	if(replay.data)
+	{
+		replayNext(BUS_SPI, FAKE_ANY_OP, buf, len, NULL, 0);
+	}
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/// @}
+
+/**
+ * @brief Resets the shield the first time the library is initialized.
+ */
+static void fakeSetup(void)
+{
+	const char *path = getenv("BUS_REPLAY");
+	const char *virtual_time = getenv("FAKESHIELD_VIRTUAL_TIME");
+
+	pthread_mutex_lock(&fake_lock);
+	if(path != NULL && replayOpen(path) != 0)
+	{
+		fprintf(stderr, "FakeShield: cannot replay %s\n", path);
+	}
+	fakeReset();
+	pthread_mutex_unlock(&fake_lock);
+	if(virtual_time != NULL && strcmp(virtual_time, "1") == 0)
+	{
+		timestamp_set_clock(FakeShield_Now, fakeWaitUntil);
+	}
+	if(getenv("FAKESHIELD_IMAGE") != NULL)
+	{
+		atexit(fakeSaveImageAtExit);
+	}
+}
+
+/**
+ * @brief Sets the shield up as soon as the program is loaded, so timestamp_ns is on the virtual clock before
+ *		  the program first reads it.
+ */
+static void fakeLoad(void)
+{
+	pthread_once(&fake_once, fakeSetup);
+}
+
+/**
+ * @brief Waiting on the virtual clock moves it forward to the deadline.
+ */
+static void fakeWaitUntil(uint64_t ns)
+{
+	pthread_mutex_lock(&fake_lock);
+	if(ns > fake_now)
+	{
+		fake_stats.delay_ns += ns - fake_now;
+		fake_now = ns;
+	}
+	pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief Saves the display to FAKESHIELD_IMAGE when the program exits.
+ */
+static void fakeSaveImageAtExit(void)
+{
+	const char *path = getenv("FAKESHIELD_IMAGE");
+
+	if(path != NULL && FakeShield_SaveImage(path) != 0)
+	{
+		fprintf(stderr, "FakeShield: cannot save %s\n", path);
+	}
+}
+
+/**
+ * @brief Puts every chip and the clock in their power on state. Called with fake_lock held.
+ */
+static void fakeReset(void)
+{
+	fake_now = 0;
+	memset(&fake_stats, 0, sizeof(fake_stats));
+	for(int bus = 0; bus < BUS_COUNT; bus++)
+	{
+		BusTraceReader_Rewind(&replay_cursor[bus]);
+	}
+	for(unsigned int c = 0; c < FAKE_CHIP_COUNT; c++)
+	{
+		FakeChip_t *chip = &chips[c];
+		memset(chip->reg, 0, sizeof(chip->reg));
+		chip->pointer = 0;
+		chip->busy_until = 0;
+		chip->due = 0;
+		chip->interrupt = 0;
+		chip->persist = 0;
+		fifoFlush(chip);
+		if(chip->reset)
+		{
+			chip->reset(chip);
+		}
+	}
+	fake_environment = default_environment;
+	memset(gpio_level, 0, sizeof(gpio_level));
+	memset(gpio_event, 0, sizeof(gpio_event));
+	pinsUpdate();
+	memset(gpio_event, 0, sizeof(gpio_event));
+	tftReset();
+	memset(tft.ram, 0, sizeof(tft.ram));
+}
+
+/**
+ * @brief Finds the chip at an I2C address, NULL if there is none.
+ */
+static FakeChip_t* chipAt(uint8_t address)
+{
+	for(unsigned int c = 0; c < FAKE_CHIP_COUNT; c++)
+	{
+		if(chips[c].address == address)
+		{
+			return &chips[c];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Brings a chip up to the current time and tells whether it acknowledges its address.
+ *		  The pins are sampled first, so that flags cleared by the transfer still raise their edges.
+ */
+static int chipAck(FakeChip_t *chip)
+{
+	pinsEdges();
+	if(chip == NULL || fake_now < chip->busy_until)
+	{
+		return 0;
+	}
+	if(chip->update)
+	{
+		chip->update(chip, fake_now);
+	}
+	return 1;
+}
+
+/**
+ * @brief Handles the first byte of a write, normally the register address.
+ */
+static void chipSelect(FakeChip_t *chip, uint8_t byte)
+{
+	if(chip->select == NULL)
+	{
+		chip->pointer = byte;
+	}
+	else if(chip->select(chip, byte) == 0)
+	{
+		chip->write(chip, chip->pointer, byte);
+	}
+}
+
+/**
+ * @brief Writes the bytes of a transfer from the register pointer on.
+ */
+static void chipWrite(FakeChip_t *chip, const char *buf, uint32_t len)
+{
+	if(len == 0)
+	{
+		return;
+	}
+	chipSelect(chip, (uint8_t) buf[0]);
+	for(uint32_t i = 1; i < len; i++)
+	{
+		if(chip->write)
+		{
+			chip->write(chip, chip->pointer, (uint8_t) buf[i]);
+		}
+		else
+		{
+			chip->reg[chip->pointer] = (uint8_t) buf[i];
+		}
+		chip->pointer = chip->next ? chip->next(chip, chip->pointer) : (uint8_t)(chip->pointer + 1);
+	}
+}
+
+/**
+ * @brief Reads the bytes of a transfer from the register pointer on.
+ */
+static void chipRead(FakeChip_t *chip, char *buf, uint32_t len)
+{
+	for(uint32_t i = 0; i < len; i++)
+	{
+		buf[i] = (char)(chip->read ? chip->read(chip, chip->pointer) : chip->reg[chip->pointer]);
+		chip->pointer = chip->next ? chip->next(chip, chip->pointer) : (uint8_t)(chip->pointer + 1);
+	}
+}
+
+/**
+ * @brief Counts an I2C transfer and advances the clock by its time: start, address, 9 bits per byte and
+ *		  stop, plus a repeated start and a second address for a combined write and read.
+ */
+static void i2cClock(uint32_t bytes, int restart)
+{
+	fake_stats.i2c_transfers++;
+	fake_stats.i2c_bytes += bytes;
+	uint64_t bits = 1 + 9 + 9ULL * bytes + 1;
+	if(restart)
+	{
+		bits += 1 + 9;
+	}
+	uint64_t ns = bits * 1000000000ULL / i2c_hz;
+	fake_now += ns;
+	fake_stats.i2c_ns += ns;
+}
+
+/**
+ * @brief Brings every chip up to the current time and drives their interrupt outputs onto the pins,
+ *		  noting rising edges where detection is enabled. Called with fake_lock held.
+ */
+static void pinsUpdate(void)
+{
+	for(unsigned int c = 0; c < FAKE_CHIP_COUNT; c++)
+	{
+		FakeChip_t *chip = &chips[c];
+		if(chip->level == NULL)
+		{
+			continue;
+		}
+		if(chip->update && fake_now >= chip->busy_until)
+		{
+			chip->update(chip, fake_now);
+		}
+		uint8_t level = chip->level(chip);
+		if(level == HIGH && gpio_level[chip->pin] == LOW && gpio_rising[chip->pin])
+		{
+			gpio_event[chip->pin] = 1;
+		}
+		gpio_level[chip->pin] = level;
+	}
+}
+
+/**
+ * @brief Samples the pins around a transfer, only needed to catch edges while edge detection is enabled
+ *		  since reading a pin samples it anyway. Called with fake_lock held.
+ */
+static void pinsEdges(void)
+{
+	if(gpio_edge_pins)
+	{
+		pinsUpdate();
+	}
+}
+
+/**
+ * @brief Enables or disables rising edge detection on a pin. Synchronous and asynchronous detection
+ *		  are the same thing here.
+ */
+static void gpioRising(uint8_t pin, uint8_t enable)
+{
+	if(pin < FAKE_GPIO_PINS)
+	{
+		pthread_mutex_lock(&fake_lock);
+		gpio_edge_pins += (enable != 0) - (gpio_rising[pin] != 0);
+		gpio_rising[pin] = enable;
+		pthread_mutex_unlock(&fake_lock);
+	}
+}
+
+/**
+ * @brief Level of an interrupt output for its polarity.
+ */
+static uint8_t interruptLevel(int asserted, int active_high)
+{
+	return ((asserted != 0) == (active_high != 0)) ? HIGH : LOW;
+}
+
+/**
+ * @brief Empties the FIFO of a chip.
+ */
+static void fifoFlush(FakeChip_t *chip)
+{
+	chip->fifo_head = 0;
+	chip->fifo_count = 0;
+	chip->fifo_byte = 0;
+	chip->fifo_overflow = 0;
+}
+
+/**
+ * @brief Queues a sample. A full FIFO drops its oldest sample, or the new one in fill mode, F_MODE 10
+ *		  in F_SETUP.
+ */
+static void fifoPush(FakeChip_t *chip, const uint8_t *sample, unsigned int bytes, uint8_t setup)
+{
+	if(chip->fifo_count == FAKE_FIFO_DEPTH)
+	{
+		chip->fifo_overflow = 1;
+		if((setup & 0xC0) == 0x80)
+		{
+			return;
+		}
+		fifoPop(chip);
+	}
+	memcpy(chip->fifo[(chip->fifo_head + chip->fifo_count) % FAKE_FIFO_DEPTH], sample, bytes);
+	chip->fifo_count++;
+}
+
+/**
+ * @brief Drops the oldest sample.
+ */
+static void fifoPop(FakeChip_t *chip)
+{
+	if(chip->fifo_count)
+	{
+		chip->fifo_head = (chip->fifo_head + 1) % FAKE_FIFO_DEPTH;
+		chip->fifo_count--;
+	}
+	chip->fifo_byte = 0;
+}
+
+/**
+ * @brief F_STATUS: F_OVF, F_WMRK_FLAG once the count reaches the watermark in F_SETUP, and the count.
+ */
+static uint8_t fifoStatus(FakeChip_t *chip, uint8_t setup)
+{
+	uint8_t watermark = setup & 0x3F;
+	uint8_t status = chip->fifo_count;
+
+	if(chip->fifo_overflow)
+	{
+		status |= 0x80;
+	}
+	if(watermark && chip->fifo_count >= watermark)
+	{
+		status |= 0x40;
+	}
+	return status;
+}
+
+/**
+ * @brief Power on values of the MPL3115A2: standby, barometer mode.
+ */
+static void mplReset(FakeChip_t *chip)
+{
+	chip->reg[0x0C] = 0xC4;				//WHO_AM_I
+}
+
+/**
+ * @brief Conversion time of the MPL3115A2 for the oversampling ratio in CTRL_REG1.
+ */
+static uint64_t mplConversionNs(FakeChip_t *chip)
+{
+	unsigned int os = (chip->reg[0x26] >> 3) & 0x07;
+	uint64_t ms = 4ULL << os;
+	return ((ms < 6) ? 6 : ms) * 1000000ULL;
+}
+
+/**
+ * @brief Sets the interrupt sources of the MPL3115A2 from its data ready flags and its FIFO.
+ */
+static void mplSource(FakeChip_t *chip)
+{
+	uint8_t source = 0;
+
+	if(chip->reg[0x06] & 0x08)				//PTDR
+	{
+		source |= 0x80;						//SRC_DRDY
+	}
+	if(fifoStatus(chip, chip->reg[0x0F]) & 0xC0)
+	{
+		source |= 0x40;						//SRC_FIFO on overflow or watermark
+	}
+	chip->reg[0x12] = source;				//INT_SOURCE
+}
+
+/**
+ * @brief Completes the conversions due by now: latches the outputs and sets the data ready flags.
+ *		  Active mode converts every 2^ST s, at least the conversion time, one shot mode once.
+ *		  In FIFO mode every conversion also queues its five output bytes.
+ */
+static void mplUpdate(FakeChip_t *chip, uint64_t now)
+{
+	while(chip->due != 0 && now >= chip->due)
+	{
+		int32_t p;
+		if(chip->reg[0x26] & 0x80)			//ALT, Q16.4 m
+		{
+			p = (int32_t)(fake_environment.altitude_m * 256);
+		}
+		else								//Q18.2 Pa
+		{
+			p = (int32_t)(fake_environment.pressure_pa * 64);
+		}
+		int32_t t = (int32_t)(fake_environment.temperature_c * 256);
+		chip->reg[0x01] = (uint8_t)(p >> 16);
+		chip->reg[0x02] = (uint8_t)(p >> 8);
+		chip->reg[0x03] = (uint8_t) p;
+		chip->reg[0x04] = (uint8_t)(t >> 8);
+		chip->reg[0x05] = (uint8_t) t;
+		uint8_t status = chip->reg[0x00];
+		status |= (status & 0x0E) << 4;		//Overwrite flags for data that was not read
+		status |= 0x0E;						//PTDR, PDR, TDR
+		chip->reg[0x00] = status;
+		chip->reg[0x06] = status;
+		if(chip->reg[0x0F] & 0xC0)
+		{
+			fifoPush(chip, &chip->reg[0x01], 5, chip->reg[0x0F]);
+		}
+		mplSource(chip);
+
+		if(chip->reg[0x26] & 0x01)
+		{
+			uint64_t step = (1ULL << (chip->reg[0x27] & 0x0F)) * 1000000000ULL;
+			uint64_t conversion = mplConversionNs(chip);
+			chip->due += (step > conversion) ? step : conversion;
+		}
+		else
+		{
+			chip->reg[0x26] &= ~0x02;		//OST clears once the one shot conversion is done
+			chip->due = 0;
+		}
+	}
+}
+
+/**
+ * @brief Reading the output MSBs clears the matching data ready flags. In FIFO mode STATUS reads as
+ *		  F_STATUS and F_DATA returns the queued samples, oldest first.
+ */
+static uint8_t mplRead(FakeChip_t *chip, uint8_t reg)
+{
+	uint8_t value = chip->reg[reg];
+
+	if(reg == 0x0D || (reg == 0x00 && (chip->reg[0x0F] & 0xC0)))
+	{
+		value = fifoStatus(chip, chip->reg[0x0F]);
+		chip->fifo_overflow = 0;
+		mplSource(chip);
+		return value;
+	}
+	if(reg == 0x0E)
+	{
+		value = 0;
+		if(chip->fifo_count)
+		{
+			value = chip->fifo[chip->fifo_head][chip->fifo_byte];
+			if(++chip->fifo_byte == 5)
+			{
+				fifoPop(chip);
+			}
+		}
+		mplSource(chip);
+		return value;
+	}
+	if(reg == 0x01)
+	{
+		chip->reg[0x00] &= ~0x44;
+	}
+	else if(reg == 0x04)
+	{
+		chip->reg[0x00] &= ~0x22;
+	}
+	if((chip->reg[0x00] & 0x06) == 0)
+	{
+		chip->reg[0x00] &= ~0x88;
+	}
+	chip->reg[0x06] = chip->reg[0x00];
+	mplSource(chip);
+	return value;
+}
+
+/**
+ * @brief CTRL_REG1 starts conversions in active mode or with OST, and resets the chip with RST.
+ */
+static void mplWrite(FakeChip_t *chip, uint8_t reg, uint8_t value)
+{
+	uint64_t now = fake_now;
+
+	switch(reg)
+	{
+		case 0x00:							//STATUS, OUT and SYSMOD are read only
+		case 0x01:
+		case 0x02:
+		case 0x03:
+		case 0x04:
+		case 0x05:
+		case 0x06:
+		case 0x0C:
+		case 0x0D:
+		case 0x0E:
+		case 0x11:
+		case 0x12:
+			return;
+		case 0x0F:							//F_SETUP, changing the mode empties the FIFO
+			if((value ^ chip->reg[0x0F]) & 0xC0)
+			{
+				fifoFlush(chip);
+			}
+			chip->reg[0x0F] = value;
+			mplSource(chip);
+			return;
+		case 0x26:
+		{
+			uint8_t old = chip->reg[0x26];
+			if(value & 0x04)
+			{
+				memset(chip->reg, 0, sizeof(chip->reg));
+				mplReset(chip);
+				fifoFlush(chip);
+				chip->due = 0;
+				return;
+			}
+			chip->reg[0x26] = value;
+			chip->reg[0x11] = value & 0x01;		//SYSMOD follows SBYB
+			if((value & 0x01) && !(old & 0x01))
+			{
+				chip->due = now + mplConversionNs(chip);
+			}
+			else if(!(value & 0x01) && (old & 0x01))
+			{
+				chip->due = 0;
+			}
+			if(!(value & 0x01) && (value & 0x02) && !(old & 0x02))		//One shot
+			{
+				chip->due = now + mplConversionNs(chip);
+			}
+			return;
+		}
+		default:
+			chip->reg[reg] = value;
+	}
+}
+
+/**
+ * @brief In FIFO mode the pointer stays on F_DATA so that a burst reads consecutive samples.
+ */
+static uint8_t mplNext(FakeChip_t *chip, uint8_t reg)
+{
+	if(reg == 0x0E && (chip->reg[0x0F] & 0xC0))
+	{
+		return reg;
+	}
+	return reg + 1;
+}
+
+/**
+ * @brief INT1 and INT2 both drive the interrupt pin of the MPL3115A2, active low unless IPOL1 is set.
+ */
+static uint8_t mplLevel(FakeChip_t *chip)
+{
+	return interruptLevel(chip->reg[0x12] & chip->reg[0x29], chip->reg[0x28] & 0x20);
+}
+
+/**
+ * @brief Power on values of the APDS9300: powered down, gain 1, 402 ms.
+ */
+static void apdsReset(FakeChip_t *chip)
+{
+	chip->reg[0x01] = 0x02;				//TIMING
+	chip->reg[0x0A] = 0x50;				//ID, part number 5, revision 0
+}
+
+/**
+ * @brief Integration time of the APDS9300 in ns, 0 for manual integration.
+ */
+static uint64_t apdsIntegrationNs(FakeChip_t *chip)
+{
+	switch(chip->reg[0x01] & 0x03)
+	{
+		case 0x00:
+			return 13700000ULL;
+		case 0x01:
+			return 101000000ULL;
+		case 0x02:
+			return 402000000ULL;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * @brief Latches the interrupt in level mode once channel 0 has been out of THRESHLOW to THRESHHIGH for
+ *		  the number of integrations in PERSIST, or after every integration for a PERSIST of 0.
+ */
+static void apdsThreshold(FakeChip_t *chip, uint16_t ch0)
+{
+	uint8_t control = chip->reg[0x06];
+	uint16_t low = (uint16_t)(chip->reg[0x02] | (chip->reg[0x03] << 8));
+	uint16_t high = (uint16_t)(chip->reg[0x04] | (chip->reg[0x05] << 8));
+
+	if((control & 0x30) != 0x10)			//INTR, level interrupts disabled
+	{
+		chip->persist = 0;
+		return;
+	}
+	if((control & 0x0F) == 0)
+	{
+		chip->interrupt = 1;
+		return;
+	}
+	chip->persist = (ch0 < low || ch0 > high) ? chip->persist + 1 : 0;
+	if(chip->persist >= (control & 0x0F))
+	{
+		chip->interrupt = 1;
+		chip->persist = 0;
+	}
+}
+
+/**
+ * @brief Latches the ADC channels at the end of every integration while powered.
+ */
+static void apdsUpdate(FakeChip_t *chip, uint64_t now)
+{
+	uint64_t integration = apdsIntegrationNs(chip);
+
+	if(chip->due == 0 || integration == 0)
+	{
+		return;
+	}
+	if(now >= chip->due)
+	{
+		uint64_t scale = (chip->reg[0x01] & 0x10) ? 16 : 1;			//GAIN
+		uint64_t ch0 = fake_environment.light_ch0 * scale * integration / 402000000ULL;
+		uint64_t ch1 = fake_environment.light_ch1 * scale * integration / 402000000ULL;
+		ch0 = (ch0 > 0xFFFF) ? 0xFFFF : ch0;
+		ch1 = (ch1 > 0xFFFF) ? 0xFFFF : ch1;
+		chip->reg[0x0C] = (uint8_t) ch0;
+		chip->reg[0x0D] = (uint8_t)(ch0 >> 8);
+		chip->reg[0x0E] = (uint8_t) ch1;
+		chip->reg[0x0F] = (uint8_t)(ch1 >> 8);
+		chip->due += ((now - chip->due) / integration + 1) * integration;
+		apdsThreshold(chip, (uint16_t) ch0);
+	}
+}
+
+/**
+ * @brief The command byte: CMD set selects a register, CLEAR clears the interrupt. Without CMD the
+ *		  byte is data for the selected register, which is how the driver writes them.
+ */
+static int apdsSelect(FakeChip_t *chip, uint8_t byte)
+{
+	if((byte & 0x80) == 0)
+	{
+		return 0;
+	}
+	if(byte & 0x40)
+	{
+		chip->interrupt = 0;
+	}
+	chip->pointer = byte & 0x0F;
+	return 1;
+}
+
+/**
+ * @brief CONTROL powers the ADC up or down, the ID and data registers are read only.
+ */
+static void apdsWrite(FakeChip_t *chip, uint8_t reg, uint8_t value)
+{
+	if(reg == 0x00)
+	{
+		value &= 0x03;
+		if(value == 0x03 && chip->reg[0x00] != 0x03)
+		{
+			chip->due = fake_now + apdsIntegrationNs(chip);
+		}
+		else if(value != 0x03)
+		{
+			chip->due = 0;
+		}
+		chip->reg[0x00] = value;
+	}
+	else if(reg != 0x0A && reg < 0x0C)
+	{
+		chip->reg[reg] = value;
+	}
+}
+
+/**
+ * @brief The register pointer wraps within the 16 registers.
+ */
+static uint8_t apdsNext(FakeChip_t *chip, uint8_t reg)
+{
+	(void) chip;
+	return (reg + 1) & 0x0F;
+}
+
+/**
+ * @brief The interrupt output of the APDS9300 is active low.
+ */
+static uint8_t apdsLevel(FakeChip_t *chip)
+{
+	return interruptLevel(chip->interrupt, 0);
+}
+
+/**
+ * @brief Power on values of the CAP1203: active, all inputs enabled, nothing touched.
+ */
+static void capReset(FakeChip_t *chip)
+{
+	chip->reg[0x1F] = 0x2F;				//SENSITIVITY
+	chip->reg[0x20] = 0x20;				//CONFIG1
+	chip->reg[0x21] = 0x07;				//SENSINPUTEN
+	chip->reg[0x24] = 0x39;				//AVERAGE_SAMP_CONF
+	chip->reg[0x27] = 0x07;				//INT_ENABLE
+	chip->reg[0x44] = 0x40;				//CONFIG2
+	chip->reg[0xFD] = 0x6D;				//PRODUCT_ID
+	chip->reg[0xFE] = 0x5D;				//MAN_ID
+	chip->reg[0xFF] = 0x02;				//REV
+}
+
+/**
+ * @brief Clearing INT in MAIN_CTRL clears the touch status of the released inputs, the status and ID
+ *		  registers are read only.
+ */
+static void capWrite(FakeChip_t *chip, uint8_t reg, uint8_t value)
+{
+	switch(reg)
+	{
+		case 0x00:
+			if(!(value & 0x01))
+			{
+				uint8_t held = fake_environment.touched & chip->reg[0x21];
+				chip->reg[0x03] = held;								//SENSOR_INPUTS
+				chip->reg[0x02] = (chip->reg[0x02] & ~0x01) | (held ? 0x01 : 0);	//GEN_STATUS TOUCH
+			}
+			chip->reg[0x00] = value;
+			return;
+		case 0x02:
+		case 0x03:
+		case 0x10:
+		case 0x11:
+		case 0x12:
+		case 0xFD:
+		case 0xFE:
+		case 0xFF:
+			return;
+		default:
+			chip->reg[reg] = value;
+	}
+}
+
+/**
+ * @brief Sets the status of the enabled inputs that were just touched, and INT for those with
+ *		  their interrupt enabled.
+ */
+static void capTouch(FakeChip_t *chip, uint8_t touched)
+{
+	uint8_t pressed = touched & chip->reg[0x21];		//SENSINPUTEN
+
+	if(pressed == 0)
+	{
+		return;
+	}
+	chip->reg[0x03] |= pressed;
+	chip->reg[0x02] |= 0x01;
+	if(pressed & chip->reg[0x27])						//INT_ENABLE
+	{
+		chip->reg[0x00] |= 0x01;
+	}
+}
+
+/**
+ * @brief ALERT follows INT in MAIN_CTRL, active low when ALT_POL is set in CONFIG2.
+ */
+static uint8_t capLevel(FakeChip_t *chip)
+{
+	return interruptLevel(chip->reg[0x00] & 0x01, !(chip->reg[0x44] & 0x40));
+}
+
+/**
+ * @brief Power on values of the FXOS8700CQ: standby, 800 Hz, accelerometer only.
+ */
+static void fxosReset(FakeChip_t *chip)
+{
+	chip->reg[0x0D] = 0xC7;				//WHO_AM_I
+}
+
+/**
+ * @brief Output data period of the FXOS8700CQ, which halves its rate in hybrid mode.
+ */
+static uint64_t fxosPeriodNs(FakeChip_t *chip)
+{
+	static const uint32_t period_us[8] = {1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000};
+	uint64_t ns = period_us[(chip->reg[0x2A] >> 3) & 0x07] * 1000ULL;
+	return ((chip->reg[0x5B] & 0x03) == 0x03) ? 2 * ns : ns;
+}
+
+/**
+ * @brief Stores a left justified 14 bit acceleration for the range in XYZ_DATA_CFG.
+ */
+static void fxosAccel(FakeChip_t *chip, uint8_t reg, int32_t mg)
+{
+	int32_t counts = mg * (4096 >> (chip->reg[0x0E] & 0x03)) / 1000;
+	uint16_t raw = (uint16_t)(counts * 4);
+	chip->reg[reg] = (uint8_t)(raw >> 8);
+	chip->reg[reg + 1] = (uint8_t) raw;
+}
+
+/**
+ * @brief Sets the interrupt sources of the FXOS8700CQ from its data ready flag and its FIFO.
+ */
+static void fxosSource(FakeChip_t *chip)
+{
+	uint8_t source = chip->reg[0x0C] & ~0x41;
+
+	if(chip->reg[0x00] & 0x08)				//ZYXDR
+	{
+		source |= 0x01;						//SRC_DRDY
+	}
+	if(fifoStatus(chip, chip->reg[0x09]) & 0xC0)
+	{
+		source |= 0x40;						//SRC_FIFO on overflow or watermark
+	}
+	chip->reg[0x0C] = source;				//INT_SOURCE
+}
+
+/**
+ * @brief Latches new samples and sets the data ready flags once per output data period while active.
+ *		  In FIFO mode the accelerometer samples are also queued, trigger mode behaves as circular mode.
+ */
+static void fxosUpdate(FakeChip_t *chip, uint64_t now)
+{
+	if(chip->due == 0 || now < chip->due)
+	{
+		return;
+	}
+	uint64_t period = fxosPeriodNs(chip);
+	for(int axis = 0; axis < 3; axis++)
+	{
+		fxosAccel(chip, 0x01 + 2 * axis, fake_environment.accel_mg[axis]);
+		chip->reg[0x33 + 2 * axis] = (uint8_t)((uint16_t) fake_environment.mag[axis] >> 8);
+		chip->reg[0x34 + 2 * axis] = (uint8_t) fake_environment.mag[axis];
+	}
+	chip->reg[0x51] = (uint8_t) fake_environment.fxos_temperature_c;
+	chip->reg[0x00] |= (chip->reg[0x00] & 0x0F) ? 0xFF : 0x0F;		//ZYXOW and the overwrite bits if not read
+	chip->reg[0x32] |= (chip->reg[0x32] & 0x0F) ? 0xFF : 0x0F;
+	if(chip->reg[0x09] & 0xC0)
+	{
+		fifoPush(chip, &chip->reg[0x01], 6, chip->reg[0x09]);
+	}
+	fxosSource(chip);
+	chip->due += ((now - chip->due) / period + 1) * period;
+}
+
+/**
+ * @brief Reading the X MSBs clears the data ready flags, RST reads as 0 once rebooted. In FIFO mode
+ *		  STATUS reads as F_STATUS and reading the X MSBs moves the oldest queued sample into the outputs.
+ */
+static uint8_t fxosRead(FakeChip_t *chip, uint8_t reg)
+{
+	if(chip->reg[0x09] & 0xC0)
+	{
+		if(reg == 0x00)
+		{
+			uint8_t status = fifoStatus(chip, chip->reg[0x09]);
+			chip->fifo_overflow = 0;
+			fxosSource(chip);
+			return status;
+		}
+		if(reg == 0x01 && chip->fifo_count)
+		{
+			memcpy(&chip->reg[0x01], chip->fifo[chip->fifo_head], 6);
+			fifoPop(chip);
+		}
+	}
+
+	uint8_t value = chip->reg[reg];
+	if(reg == 0x01)
+	{
+		chip->reg[0x00] = 0;
+	}
+	else if(reg == 0x33)
+	{
+		chip->reg[0x32] = 0;
+	}
+	fxosSource(chip);
+	return value;
+}
+
+/**
+ * @brief CTRL_REG1 starts and stops sampling, RST in CTRL_REG2 reboots the chip.
+ */
+static void fxosWrite(FakeChip_t *chip, uint8_t reg, uint8_t value)
+{
+	switch(reg)
+	{
+		case 0x2A:
+			if((value & 0x01) && !(chip->reg[0x2A] & 0x01))
+			{
+				chip->reg[0x2A] = value;
+				chip->due = fake_now + fxosPeriodNs(chip);
+			}
+			else if(!(value & 0x01))
+			{
+				chip->due = 0;
+			}
+			chip->reg[0x2A] = value;
+			chip->reg[0x0B] = value & 0x01;			//SYSMOD
+			return;
+		case 0x2B:
+			if(value & 0x40)
+			{
+				memset(chip->reg, 0, sizeof(chip->reg));
+				fxosReset(chip);
+				fifoFlush(chip);
+				chip->due = 0;
+				chip->busy_until = fake_now + FAKE_FXOS_BOOT_NS;
+				return;
+			}
+			chip->reg[reg] = value;
+			return;
+		case 0x09:							//F_SETUP, changing the mode empties the FIFO
+			if((value ^ chip->reg[0x09]) & 0xC0)
+			{
+				fifoFlush(chip);
+			}
+			chip->reg[0x09] = value;
+			fxosSource(chip);
+			return;
+		case 0x00:
+		case 0x0B:
+		case 0x0C:
+		case 0x0D:
+		case 0x32:
+		case 0x51:
+			return;
+		default:
+			if((reg >= 0x01 && reg <= 0x06) || (reg >= 0x33 && reg <= 0x38))
+			{
+				return;
+			}
+			chip->reg[reg] = value;
+	}
+}
+
+/**
+ * @brief With hyb_autoinc_mode a burst continues from the accelerometer into the magnetometer outputs.
+ *		  In FIFO mode it wraps back to the X MSBs instead, so that a burst reads consecutive samples.
+ */
+static uint8_t fxosNext(FakeChip_t *chip, uint8_t reg)
+{
+	if(reg == 0x06 && (chip->reg[0x09] & 0xC0))
+	{
+		return 0x01;
+	}
+	if(reg == 0x06 && (chip->reg[0x5C] & 0x20))
+	{
+		return 0x33;
+	}
+	if(reg == 0x38 && (chip->reg[0x5C] & 0x20))
+	{
+		return 0x00;
+	}
+	return reg + 1;
+}
+
+/**
+ * @brief INT1 and INT2 both drive the interrupt pin of the FXOS8700CQ, active low unless IPOL is set.
+ */
+static uint8_t fxosLevel(FakeChip_t *chip)
+{
+	return interruptLevel(chip->reg[0x0C] & chip->reg[0x2D], chip->reg[0x2C] & 0x02);
+}
+
+/**
+ * @brief Power on values of the MCP79410: oscillator stopped, 1 January 2000, a Monday.
+ */
+static void rtccReset(FakeChip_t *chip)
+{
+	chip->reg[0x03] = 0x01;				//RTCWKDAY
+	chip->reg[0x04] = 0x01;				//RTCDATE
+	chip->reg[0x05] = 0x01;				//RTCMTH
+	chip->reg[0x07] = 0x80;				//CONTROL, OUT set
+}
+
+/**
+ * @brief Increments a BCD register, wrapping from max back to min. Returns 1 on a wrap.
+ */
+static int rtccBcdIncrement(uint8_t *reg, uint8_t mask, unsigned int min, unsigned int max)
+{
+	unsigned int value = ((*reg & mask) >> 4) * 10 + (*reg & mask & 0x0F);
+	int wrap = (value >= max);
+
+	value = wrap ? min : value + 1;
+	*reg = (*reg & ~mask) | (uint8_t)(((value / 10) << 4) | (value % 10));
+	return wrap;
+}
+
+/**
+ * @brief Sets the interrupt flag of an alarm whose masked fields match the time.
+ */
+static void rtccAlarm(FakeChip_t *chip, uint8_t base, uint8_t enable)
+{
+	if(!(chip->reg[0x07] & enable))
+	{
+		return;
+	}
+	uint8_t *alarm = &chip->reg[base];
+	uint8_t *time = chip->reg;
+	int match;
+	switch((alarm[3] >> 4) & 0x07)
+	{
+		case 0:
+			match = (alarm[0] & 0x7F) == (time[0] & 0x7F);
+			break;
+		case 1:
+			match = (alarm[1] & 0x7F) == (time[1] & 0x7F);
+			break;
+		case 2:
+			match = (alarm[2] & 0x3F) == (time[2] & 0x3F);
+			break;
+		case 3:
+			match = (alarm[3] & 0x07) == (time[3] & 0x07);
+			break;
+		case 4:
+			match = (alarm[4] & 0x3F) == (time[4] & 0x3F);
+			break;
+		case 7:
+			match = (alarm[0] & 0x7F) == (time[0] & 0x7F) && (alarm[1] & 0x7F) == (time[1] & 0x7F)
+					&& (alarm[2] & 0x3F) == (time[2] & 0x3F) && (alarm[3] & 0x07) == (time[3] & 0x07)
+					&& (alarm[4] & 0x3F) == (time[4] & 0x3F) && (alarm[5] & 0x1F) == (time[5] & 0x1F);
+			break;
+		default:
+			match = 0;
+	}
+	if(match)
+	{
+		alarm[3] |= 0x08;					//ALMxIF
+	}
+}
+
+/**
+ * @brief Sets or clears OSCRUN once the oscillator has started or stopped, and counts the seconds
+ *		  in 24 hour mode while it runs.
+ */
+static void rtccUpdate(FakeChip_t *chip, uint64_t now)
+{
+	static const uint8_t days[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	if(chip->due == 0 || now < chip->due)
+	{
+		return;
+	}
+	if(!(chip->reg[0x00] & 0x80))					//Stopped
+	{
+		chip->reg[0x03] &= ~0x20;
+		chip->due = 0;
+		return;
+	}
+	if(!(chip->reg[0x03] & 0x20))					//Started
+	{
+		chip->reg[0x03] |= 0x20;
+		chip->due += 1000000000ULL;
+	}
+	while(now >= chip->due)
+	{
+		uint8_t *t = chip->reg;
+		if(rtccBcdIncrement(&t[0], 0x7F, 0, 59) && rtccBcdIncrement(&t[1], 0x7F, 0, 59)
+		   && rtccBcdIncrement(&t[2], 0x3F, 0, 23))
+		{
+			rtccBcdIncrement(&t[3], 0x07, 1, 7);
+			unsigned int month = ((t[5] >> 4) & 0x01) * 10 + (t[5] & 0x0F);
+			unsigned int last = days[(month >= 1 && month <= 12) ? month - 1 : 0];
+			if(month == 2 && !(t[5] & 0x20))			//LPYR
+			{
+				last = 28;
+			}
+			if(rtccBcdIncrement(&t[4], 0x3F, 1, last) && rtccBcdIncrement(&t[5], 0x1F, 1, 12))
+			{
+				rtccBcdIncrement(&t[6], 0xFF, 0, 99);
+			}
+		}
+		rtccAlarm(chip, 0x0A, 0x10);
+		rtccAlarm(chip, 0x11, 0x20);
+		chip->due += 1000000000ULL;
+	}
+}
+
+/**
+ * @brief ST in RTCSEC starts and stops the oscillator, OSCRUN is read only and PWRFAIL can only be cleared.
+ */
+static void rtccWrite(FakeChip_t *chip, uint8_t reg, uint8_t value)
+{
+	switch(reg)
+	{
+		case 0x00:
+			if((value & 0x80) && !(chip->reg[0x00] & 0x80))
+			{
+				chip->reg[0x03] &= ~0x20;
+				chip->due = fake_now + FAKE_RTCC_START_NS;
+			}
+			else if(!(value & 0x80) && (chip->reg[0x00] & 0x80))
+			{
+				chip->due = fake_now + FAKE_RTCC_STOP_NS;
+			}
+			chip->reg[0x00] = value;
+			return;
+		case 0x03:
+			chip->reg[0x03] = (value & ~0x30) | (chip->reg[0x03] & 0x20) | (chip->reg[0x03] & value & 0x10);
+			return;
+		default:
+			chip->reg[reg] = value;
+	}
+}
+
+/**
+ * @brief The pointer wraps within the time keeping registers and within the SRAM.
+ */
+static uint8_t rtccNext(FakeChip_t *chip, uint8_t reg)
+{
+	(void) chip;
+	if(reg == 0x1F)
+	{
+		return 0x00;
+	}
+	if(reg == 0x5F)
+	{
+		return 0x20;
+	}
+	return reg + 1;
+}
+
+/**
+ * @brief MFP outputs the square wave while SQWEN is set and the oscillator runs, else the alarm interrupts
+ *		  with the polarity of ALMPOL if an alarm is enabled, else the OUT bit.
+ */
+static uint8_t rtccLevel(FakeChip_t *chip)
+{
+	static const uint32_t hz[4] = {1, 4096, 8192, 32768};
+	uint8_t control = chip->reg[0x07];
+
+	if(control & 0x40)
+	{
+		if(!(chip->reg[0x03] & 0x20))
+		{
+			return LOW;
+		}
+		uint64_t half = 500000000ULL / hz[control & 0x03];
+		return ((fake_now / half) & 1) ? LOW : HIGH;
+	}
+	if(control & 0x30)
+	{
+		int asserted = ((control & 0x10) && (chip->reg[0x0D] & 0x08)) || ((control & 0x20) && (chip->reg[0x14] & 0x08));
+		return interruptLevel(asserted, chip->reg[0x0D] & 0x80);
+	}
+	return (control & 0x80) ? HIGH : LOW;
+}
+
+/**
+ * @brief Hardware or software reset of the ST7735: sleeping, display off, default window.
+ */
+static void tftReset(void)
+{
+	tft.command = 0;
+	tft.args = 0;
+	tft.xs = 0;
+	tft.xe = FAKE_TFT_WIDTH - 1;
+	tft.ys = 0;
+	tft.ye = FAKE_TFT_HEIGHT - 1;
+	tft.x = 0;
+	tft.y = 0;
+	tft.high = 0;
+	tft.madctl = 0;
+	tft.sleeping = 1;
+	tft.display_on = 0;
+	tft.inverted = 0;
+	tft.scrolling = 0;
+	tft.tfa = 0;
+	tft.vsa = FAKE_TFT_HEIGHT;
+	tft.ssa = 0;
+	tft.partial = 0;
+	tft.psr = 0;
+	tft.per = FAKE_TFT_HEIGHT - 1;
+	tft.idle = 0;
+}
+
+/**
+ * @brief Stores a pixel at a window position, mapped to the RAM through MADCTL.
+ */
+static void tftPixel(uint16_t color)
+{
+	unsigned int column = tft.x;
+	unsigned int row = tft.y;
+
+	if(tft.madctl & 0x20)					//MV exchanges rows and columns
+	{
+		unsigned int swap = column;
+		column = row;
+		row = swap;
+	}
+	if(tft.madctl & 0x40)					//MX mirrors the columns
+	{
+		column = FAKE_TFT_WIDTH - 1 - column;
+	}
+	if(tft.madctl & 0x80)					//MY mirrors the rows
+	{
+		row = FAKE_TFT_HEIGHT - 1 - row;
+	}
+	if(column < FAKE_TFT_WIDTH && row < FAKE_TFT_HEIGHT)
+	{
+		tft.ram[row][column] = color;
+	}
+	if(++tft.x > tft.xe)
+	{
+		tft.x = tft.xs;
+		if(++tft.y > tft.ye)
+		{
+			tft.y = tft.ys;
+		}
+	}
+}
+
+/**
+ * @brief Takes a byte from the SPI bus, a command while DC is low and its data while DC is high.
+ */
+static void tftByte(uint8_t byte)
+{
+	if(gpio_level[FAKE_TFT_DC_PIN] == LOW)
+	{
+		tft.command = byte;
+		tft.args = 0;
+		switch(byte)
+		{
+			case 0x01:						//SWRESET
+				tftReset();
+				tft.command = byte;
+				break;
+			case 0x10:						//SLPIN
+				tft.sleeping = 1;
+				break;
+			case 0x11:						//SLPOUT
+				tft.sleeping = 0;
+				break;
+			case 0x12:						//PTLON ends the scrolling mode
+				tft.partial = 1;
+				tft.scrolling = 0;
+				break;
+			case 0x13:						//NORON ends the partial and scrolling modes
+				tft.partial = 0;
+				tft.scrolling = 0;
+				break;
+			case 0x20:						//INVOFF
+				tft.inverted = 0;
+				break;
+			case 0x21:						//INVON
+				tft.inverted = 1;
+				break;
+			case 0x28:						//DISPOFF
+				tft.display_on = 0;
+				break;
+			case 0x29:						//DISPON
+				tft.display_on = 1;
+				break;
+			case 0x38:						//IDLE_MODE_OFF
+				tft.idle = 0;
+				break;
+			case 0x39:						//IDLE_MODE_ON
+				tft.idle = 1;
+				break;
+			case 0x2C:						//RAMWR starts at the top left of the window
+				tft.x = tft.xs;
+				tft.y = tft.ys;
+				tft.high = 0;
+				break;
+		}
+		return;
+	}
+
+	unsigned int arg = tft.args++;
+	switch(tft.command)
+	{
+		case 0x2A:							//CASET
+		case 0x2B:							//RASET
+		{
+			uint16_t *start = (tft.command == 0x2A) ? &tft.xs : &tft.ys;
+			uint16_t *end = (tft.command == 0x2A) ? &tft.xe : &tft.ye;
+			if(arg == 0)
+			{
+				*start = (uint16_t)(byte << 8);
+			}
+			else if(arg == 1)
+			{
+				*start |= byte;
+			}
+			else if(arg == 2)
+			{
+				*end = (uint16_t)(byte << 8);
+			}
+			else if(arg == 3)
+			{
+				*end |= byte;
+			}
+			break;
+		}
+		case 0x30:							//PTLAR
+			if(arg == 0 || arg == 2)
+			{
+				uint16_t *row = (arg == 0) ? &tft.psr : &tft.per;
+				*row = (uint16_t)(byte << 8);
+			}
+			else if(arg == 1 || arg == 3)
+			{
+				uint16_t *row = (arg == 1) ? &tft.psr : &tft.per;
+				*row |= byte;
+			}
+			break;
+		case 0x33:							//SCRLAR, the bottom fixed rows follow from the other two
+			if(arg == 0 || arg == 2)
+			{
+				uint16_t *rows = (arg == 0) ? &tft.tfa : &tft.vsa;
+				*rows = (uint16_t)(byte << 8);
+			}
+			else if(arg == 1 || arg == 3)
+			{
+				uint16_t *rows = (arg == 1) ? &tft.tfa : &tft.vsa;
+				*rows |= byte;
+			}
+			break;
+		case 0x37:							//VSCSAD starts the scrolling mode
+			if(arg == 0)
+			{
+				tft.ssa = (uint16_t)(byte << 8);
+			}
+			else if(arg == 1)
+			{
+				tft.ssa |= byte;
+				tft.scrolling = 1;
+			}
+			break;
+		case 0x36:							//MADCTL
+			tft.madctl = byte;
+			break;
+		case 0x2C:							//RAMWR, two bytes per RGB565 pixel
+			if(arg & 1)
+			{
+				tftPixel((uint16_t)((tft.high << 8) | byte));
+			}
+			else
+			{
+				tft.high = byte;
+			}
+			break;
+	}
+}
+
+/**
+ * @brief Clocks bytes into the TFT while its chip select is low. Called with fake_lock held.
+ */
+static void spiWrite(const char *buf, uint32_t len)
+{
+	if(gpio_level[FAKE_TFT_CS_PIN] == LOW)
+	{
+		for(uint32_t i = 0; i < len; i++)
+		{
+			tftByte((uint8_t) buf[i]);
+		}
+	}
+	uint64_t ns = (uint64_t) len * 8 * 1000000000ULL / spi_hz;
+	fake_stats.spi_transfers++;
+	fake_stats.spi_bytes += len;
+	fake_now += ns;
+	fake_stats.spi_ns += ns;
+}
+
+/**
+ * @brief Loads the trace to replay, or closes it for a NULL path. Called with fake_lock held.
+ */
+static int replayOpen(const char *path)
+{
+	BusTraceReader_Close(&replay);
+	if(path != NULL && BusTraceReader_Open(&replay, path) != 0)
+	{
+		return -1;
+	}
+	for(int bus = 0; bus < BUS_COUNT; bus++)
+	{
+		replay_cursor[bus] = replay;			//Shares the records, only the position is per bus
+	}
+	return 0;
+}
+
+/**
+ * @brief Takes the next record of a bus from the trace and hands its received bytes to the driver. Counts
+ *		  a divergence if the driver did not do what was recorded, or the trace has ended. Called with fake_lock held.
+ * @return result Recorded result, BCM2835_I2C_REASON_ERROR_NACK past the end of the trace.
+ */
+static int replayNext(Bus_t bus, int op, const char *write, uint32_t write_length, char *read, uint32_t read_length)
+{
+	BusTraceReader_t *cursor = &replay_cursor[bus];
+	BusTraceRecord_t record;
+	int status;
+
+	while((status = BusTraceReader_Next(cursor, &record)) == 1 && record.bus != bus);
+	if(status != 1)
+	{
+		fake_stats.diverged++;
+		return BCM2835_I2C_REASON_ERROR_NACK;
+	}
+	fake_stats.replayed++;
+	if((op != FAKE_ANY_OP && (int) record.op != op) || (bus == BUS_I2C && record.address != i2c_address) ||
+	   record.write_length != write_length || record.read_length != read_length ||
+	   (write_length && memcmp(record.write, write, write_length) != 0))
+	{
+		fake_stats.diverged++;
+	}
+	if(read_length)
+	{
+		memcpy(read, record.read, (record.read_length < read_length) ? record.read_length : read_length);
+	}
+	return record.result;
+}
@@ -411,6 +411,20 @@ void MCP79410_SetMFP_Functionality(MFP_t mode)
 	}
 }
 
+/**
+ * @brief This function selects the square wave frequency output on the MFP pin when SQWEN is set.
+ *		  MFP_64H uses the coarse trim bit, the MFP then outputs 64 Hz regardless of SQWFS.
+ * @param rate One of MFP_01H, MFP_04K, MFP_08K, MFP_32K or MFP_64H.
+ * @return none
+ */
+void MCP79410_SetSquareWaveRate(unsigned char rate)
+{
+	unsigned char ctrl_bits = MCP79410_Read(CTRL);
+	ctrl_bits &= ~(MFP_64H|MFP_32K);				//Clear CRSTRIM and SQWFS1:0
+	ctrl_bits |= (rate & (MFP_64H|MFP_32K));
+	MCP79410_Write(CTRL,ctrl_bits);
+}
+
 /**
  * @brief This function sets the MFP output logic level when the pin is configured as GPO 
  * @param status Polarity of MFP pin , Asserted output state of MFP is a logic low level for LOW and opposite for HIGH
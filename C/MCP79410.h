@@ -57,6 +57,9 @@
 
 /************************GLOBAL CONSTANTS RTCC - INITIALIZATION****************/
 
+#define  RTCC_STOP_TIMEOUT_MS   10     //  Longest wait for OSCRUN to clear after stopping the oscillator
+#define  RTCC_START_TIMEOUT_MS  1000   //  Longest wait for the crystal to start, OSCRUN set
+
 #define  PM                0x20       //  post-meridian bit (HOUR)
 #define  HOUR_FORMAT       0x40       //  Hour format
 #define  OUT_PIN           0x80       //  = b7 (CTRL)
@@ -149,6 +152,7 @@ void 			MCP79410_SetAlarmMFPPolarity(Polarity_t MFP_pol,Alarm_t alarm);
 void 			MCP79410_SetAlarmMatch(Match_t match,Alarm_t alarm);
 void 			MCP79410_SetMFP_Functionality(MFP_t mode);
 void 			MCP79410_SetMFP_GPOStatus(Polarity_t status);
+void 			MCP79410_SetSquareWaveRate(unsigned char rate);
 
 unsigned char	MCP79410_CheckPowerFailure(void);
 unsigned char 	MCP79410_IsVbatEnabled(void);
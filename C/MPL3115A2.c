@@ -47,6 +47,15 @@ void MPL3115A2_StandbyMode(void)
   MPL3115A2_WriteByte(CTRL_REG1, ctrl_reg);               //Put device in Standby mode
 }
 
+/**
+ * @brief Checks whether the sensor has left standby and is converting, after MPL3115A2_ActiveMode.
+ * @return active 1 if SYSMOD reports active mode, 0 otherwise
+ */
+unsigned char MPL3115A2_IsActive(void)
+{
+	return (MPL3115A2_ReadByte(SYSMOD) & SYSMOD_ACTIVE) != 0;
+}
+
 /**
  * @brief Puts the sensor in active mode, needed is the sensor is in standby mode.
  * @return none
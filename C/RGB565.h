@@ -0,0 +1,31 @@
+/**
+ * @file RGB565.h
+ * @brief Header for the frame conversion to the TFT's 16 bit pixel format and the diff against the last frame sent
+ */
+
+#ifndef __RGB565_H__
+#define __RGB565_H__
+
+#include <stdint.h>
+
+#define RGB565_DITHER		0x01	/*!< Ordered 4x4 dither instead of truncating to 5 and 6 bits */
+#define RGB565_MERGE_ROWS	2		/*!< Changed bands closer than this many rows are flushed as one */
+
+/**
+ * @brief Changed area of a frame, inclusive bounds as sent with CASET and RASET.
+ */
+typedef struct _RGB565Rect
+{
+	uint16_t x0;		/**< First column */
+	uint16_t y0;		/**< First row */
+	uint16_t x1;		/**< Last column */
+	uint16_t y1;		/**< Last row */
+} RGB565Rect_t;
+
+void 		 RGB565_Convert(const uint8_t *src, unsigned int width, unsigned int height, unsigned int stride,
+							unsigned int channels, unsigned int flags, uint8_t *dst);
+unsigned int RGB565_Diff(const uint8_t *frame, uint8_t *previous, unsigned int width, unsigned int height,
+						 RGB565Rect_t *rects, unsigned int max_rects);
+unsigned int RGB565_Crop(const uint8_t *frame, unsigned int width, const RGB565Rect_t *rect, uint8_t *out);
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file Rollup.c
+ * @brief Keeps min, max, mean, count and last of every channel at several time resolutions.
+ *
+ * A sample only ever touches the open bucket of the finest tier. When a
+ * bucket closes, it is stored in its tier's ring and merged as a whole into
+ * the open bucket of the next tier, so a tier of width W sees one update per
+ * W instead of one per sample. The work per sample is therefore constant on
+ * average however many tiers are configured. Queries rebuild the partial
+ * open bucket of a tier from the open buckets of the finer tiers.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Rollup.h"
+
+static void Rollup_AddToTier(Rollup_t *rollup, RollupTier_t *tiers, unsigned int k, const RollupBucket_t *bucket);
+static void Rollup_Merge(RollupBucket_t *dst, const RollupBucket_t *src);
+
+/// \defgroup rollup Rollups
+/// These functions aggregate the sample stream into tiers of fixed width buckets.
+/// @{
+
+/**
+ * @brief Allocates the tiers of every channel.
+ * @param rollup Rollup to initialize
+ * @param width_ns Bucket width of each tier from finest to coarsest, each a multiple of the previous
+ * @param capacity Number of closed buckets each tier keeps per channel
+ * @param tiers Number of tiers, 1 to ROLLUP_MAX_TIERS
+ * @return status 0 on success, -1 for invalid tiers or when out of memory.
+ */
+int Rollup_Init(Rollup_t *rollup, const uint64_t *width_ns, const uint32_t *capacity, unsigned int tiers)
+{
+	if(tiers == 0 || tiers > ROLLUP_MAX_TIERS)
+	{
+		return -1;
+	}
+	for(unsigned int k = 0; k < tiers; k++)
+	{
+		if(width_ns[k] == 0 || capacity[k] == 0 ||
+		   (k > 0 && (width_ns[k] <= width_ns[k - 1] || width_ns[k] % width_ns[k - 1] != 0)))
+		{
+			return -1;
+		}
+	}
+
+	memset(rollup, 0, sizeof(*rollup));
+	rollup->tiers = tiers;
+	for(unsigned int k = 0; k < tiers; k++)
+	{
+		rollup->width_ns[k] = width_ns[k];
+		rollup->capacity[k] = capacity[k];
+		for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+		{
+			rollup->tier[ch][k].buckets = calloc(capacity[k], sizeof(RollupBucket_t));
+			if(rollup->tier[ch][k].buckets == NULL)
+			{
+				Rollup_Free(rollup);
+				return -1;
+			}
+		}
+	}
+	pthread_mutex_init(&rollup->lock, NULL);
+	return 0;
+}
+
+/**
+ * @brief Releases the tiers.
+ * @param rollup Rollup to free
+ * @return none
+ */
+void Rollup_Free(Rollup_t *rollup)
+{
+	for(unsigned int k = 0; k < ROLLUP_MAX_TIERS; k++)
+	{
+		for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+		{
+			free(rollup->tier[ch][k].buckets);
+			rollup->tier[ch][k].buckets = NULL;
+		}
+	}
+	rollup->tiers = 0;
+}
+
+/**
+ * @brief Adds samples to the rollups of their channels. Samples without SAMPLE_VALID are skipped.
+ * @param rollup Initialized rollup
+ * @param samples Samples in time order per channel
+ * @param count Number of samples
+ * @return none
+ */
+void Rollup_Add(Rollup_t *rollup, const Sample_t *samples, unsigned int count)
+{
+	RollupBucket_t single = {0};
+
+	pthread_mutex_lock(&rollup->lock);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		if(samples[i].channel >= SENSOR_CHANNEL_COUNT || (samples[i].flags & SAMPLE_VALID) == 0)
+		{
+			continue;
+		}
+		single.start_ns = samples[i].timestamp_ns;
+		single.sum = samples[i].value;
+		single.min = single.max = single.last = samples[i].value;
+		single.count = 1;
+		Rollup_AddToTier(rollup, rollup->tier[samples[i].channel], 0, &single);
+	}
+	pthread_mutex_unlock(&rollup->lock);
+}
+
+/**
+ * @brief SampleCallback_t that feeds every batch to a rollup: Scheduler_AddCallback(Rollup_Callback, &rollup).
+ * @param samples Samples of one scheduler pass
+ * @param count Number of samples
+ * @param rollup Rollup_t to update
+ * @return none
+ */
+void Rollup_Callback(const Sample_t *samples, unsigned int count, void *rollup)
+{
+	Rollup_Add((Rollup_t *) rollup, samples, count);
+}
+
+/**
+ * @brief Returns the buckets of a channel covering a time range from the coarsest tier whose width is
+ *		  at most the resolution asked for, or the finest tier if none is that fine. The last bucket may
+ *		  still be filling.
+ * @param rollup Initialized rollup
+ * @param channel Channel to query
+ * @param t_from Start of the range in ns
+ * @param t_to End of the range in ns
+ * @param resolution_ns Widest bucket acceptable to the caller
+ * @param buckets Array to fill, oldest first, with mean filled in
+ * @param count Size of the array
+ * @param tier Receives the index of the tier used, may be NULL
+ * @return count Number of buckets returned, -1 for an invalid channel.
+ */
+int Rollup_Query(Rollup_t *rollup, SensorChannel_t channel, uint64_t t_from, uint64_t t_to, uint64_t resolution_ns,
+				 RollupBucket_t *buckets, unsigned int count, unsigned int *tier)
+{
+	unsigned int k = 0;
+	unsigned int n = 0;
+
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT || rollup->tiers == 0)
+	{
+		return -1;
+	}
+	for(unsigned int i = 1; i < rollup->tiers; i++)
+	{
+		if(rollup->width_ns[i] <= resolution_ns)
+		{
+			k = i;
+		}
+	}
+	if(tier)
+	{
+		*tier = k;
+	}
+
+	uint64_t width = rollup->width_ns[k];
+	uint32_t capacity = rollup->capacity[k];
+
+	pthread_mutex_lock(&rollup->lock);
+	RollupTier_t *tiers = rollup->tier[channel];
+	RollupTier_t *t = &tiers[k];
+
+	//Closed buckets are in start order, find the first one ending after t_from
+	uint64_t lo = (t->closed > capacity) ? t->closed - capacity : 0;
+	uint64_t hi = t->closed;
+	while(lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(t->buckets[mid % capacity].start_ns + width <= t_from)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	for(uint64_t i = lo; i < t->closed && n < count; i++)
+	{
+		const RollupBucket_t *b = &t->buckets[i % capacity];
+		if(b->start_ns > t_to)
+		{
+			break;
+		}
+		buckets[n++] = *b;
+	}
+
+	//The open bucket plus whatever the finer tiers have not cascaded yet
+	RollupBucket_t open = t->current;
+	for(int j = (int) k - 1; j >= 0; j--)
+	{
+		const RollupBucket_t *c = &tiers[j].current;
+		if(c->count == 0)
+		{
+			continue;
+		}
+		if(open.count && c->start_ns >= open.start_ns + width)
+		{
+			if(open.start_ns + width > t_from && open.start_ns <= t_to && n < count)
+			{
+				buckets[n++] = open;
+			}
+			open.count = 0;
+		}
+		if(open.count == 0)
+		{
+			open.start_ns = c->start_ns - c->start_ns % width;
+		}
+		Rollup_Merge(&open, c);
+	}
+	if(open.count && open.start_ns + width > t_from && open.start_ns <= t_to && n < count)
+	{
+		buckets[n++] = open;
+	}
+	pthread_mutex_unlock(&rollup->lock);
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		buckets[i].mean = (float)(buckets[i].sum / buckets[i].count);
+	}
+	return n;
+}
+
+/// @}
+
+/**
+ * @brief Adds a sample or a closed finer bucket to tier k, closing its open bucket when the new data
+ *		  starts past it.
+ */
+static void Rollup_AddToTier(Rollup_t *rollup, RollupTier_t *tiers, unsigned int k, const RollupBucket_t *bucket)
+{
+	RollupTier_t *t = &tiers[k];
+	uint64_t width = rollup->width_ns[k];
+
+	if(t->current.count && bucket->start_ns >= t->current.start_ns + width)
+	{
+		t->buckets[t->closed % rollup->capacity[k]] = t->current;
+		t->closed++;
+		if(k + 1 < rollup->tiers)
+		{
+			Rollup_AddToTier(rollup, tiers, k + 1, &t->current);	//Once per bucket, not per sample
+		}
+		t->current.count = 0;
+	}
+	if(t->current.count == 0)
+	{
+		t->current.start_ns = bucket->start_ns - bucket->start_ns % width;
+	}
+	Rollup_Merge(&t->current, bucket);
+}
+
+/**
+ * @brief Merges the statistics of src into dst. src must be the later of the two.
+ */
+static void Rollup_Merge(RollupBucket_t *dst, const RollupBucket_t *src)
+{
+	if(dst->count == 0)
+	{
+		dst->sum = src->sum;
+		dst->min = src->min;
+		dst->max = src->max;
+	}
+	else
+	{
+		dst->sum += src->sum;
+		dst->min = (src->min < dst->min) ? src->min : dst->min;
+		dst->max = (src->max > dst->max) ? src->max : dst->max;
+	}
+	dst->last = src->last;
+	dst->count += src->count;
+}
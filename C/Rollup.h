@@ -0,0 +1,58 @@
+/**
+ * @file Rollup.h
+ * @brief Header for the multi-tier rollup aggregation of the sample stream
+ */
+
+#ifndef __ROLLUP_H__
+#define __ROLLUP_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "SensorChannels.h"
+
+#define ROLLUP_MAX_TIERS	4			/*!< Tiers per rollup, e.g. 1 s, 1 min, 1 h, 1 day */
+
+/**
+ * @brief Aggregate of one channel over one interval of a tier.
+ */
+typedef struct _RollupBucket
+{
+	uint64_t start_ns;				/**< Start of the interval, a multiple of the tier width */
+	double sum;						/**< Sum of the values, kept so buckets merge exactly */
+	float min;						/**< Smallest value */
+	float max;						/**< Largest value */
+	float last;						/**< Latest value */
+	float mean;						/**< sum / count, filled in by Rollup_Query */
+	uint32_t count;					/**< Samples in the interval, 0 for an empty bucket */
+} RollupBucket_t;
+
+/**
+ * @brief One tier of one channel: a ring of closed buckets and the bucket being filled.
+ */
+typedef struct _RollupTier
+{
+	RollupBucket_t *buckets;		/**< capacity closed buckets, oldest overwritten first */
+	uint64_t closed;				/**< Buckets closed since Rollup_Init, buckets[closed % capacity] is next */
+	RollupBucket_t current;			/**< Open bucket */
+} RollupTier_t;
+
+/**
+ * @brief Rollups of every channel.
+ */
+typedef struct _Rollup
+{
+	unsigned int tiers;
+	uint64_t width_ns[ROLLUP_MAX_TIERS];		/**< Bucket width, each a multiple of the previous */
+	uint32_t capacity[ROLLUP_MAX_TIERS];		/**< Closed buckets kept per channel */
+	RollupTier_t tier[SENSOR_CHANNEL_COUNT][ROLLUP_MAX_TIERS];
+	pthread_mutex_t lock;						/**< Lets queries run beside the sampler */
+} Rollup_t;
+
+int 	Rollup_Init(Rollup_t *rollup, const uint64_t *width_ns, const uint32_t *capacity, unsigned int tiers);
+void 	Rollup_Free(Rollup_t *rollup);
+void 	Rollup_Add(Rollup_t *rollup, const Sample_t *samples, unsigned int count);
+void 	Rollup_Callback(const Sample_t *samples, unsigned int count, void *rollup);
+int 	Rollup_Query(Rollup_t *rollup, SensorChannel_t channel, uint64_t t_from, uint64_t t_to, uint64_t resolution_ns,
+					 RollupBucket_t *buckets, unsigned int count, unsigned int *tier);
+
+#endif
@@ -0,0 +1,810 @@
+/**
+ * @file Rules.c
+ * @brief Compiles a rules file into a table grouped by channel and fires actions from the sample stream.
+ *
+ * Each line of a rules file is a rule or a sampling rate:
+ *
+ *     # channel   op  threshold  hysteresis  hold_ms  action
+ *     light       <   20         5           2000     led on
+ *     light       >=  20         0           0        led off
+ *     mag_x       >   40         5           250      ifttt MAKER_KEY door_opened
+ *     temperature >   30         1           10000    tft "Too hot: {value} C"
+ *     touch       ==  1          0           0        print "Button 1"
+ *     rate light 10
+ *
+ * op is one of < <= > >= ==. A rule fires once when its comparison has held
+ * for hold_ms, and re-arms when the reading moves back past the threshold by
+ * more than the hysteresis. Actions are led on|off, tft "text", print "text"
+ * and ifttt key event.
+ *
+ * Loading turns every rule into two closed intervals: the one the reading must
+ * enter to fire and the wider one it must leave to re-arm. The rules of each
+ * channel sit next to each other and a sample only walks its own channel's
+ * slice, comparing against the interval of the rule's current state. Only a
+ * rule whose comparison changes takes the slow path, and fired actions are
+ * queued so LED, TFT and HTTP work never runs on the sampling thread.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "Rules.h"
+#include "led.h"
+#include "TFT_Printer.h"
+#include "CloudTools.h"
+
+#define RULES_LINE_SIZE		256
+#define RULES_BLOCK			32			//Rules compared per step of the loop, the arrays are padded by one block
+
+/**
+ * @brief State of a rule.
+ */
+typedef enum {RULE_IDLE = 0,				/**< Comparison false, armed */
+			  RULE_PENDING,					/**< Comparison true, waiting out the hold time */
+			  RULE_ACTIVE					/**< Fired, waiting for the reading to move back past the hysteresis */
+} RuleState_t;
+
+/**
+ * @brief Parts of a rule only read when its comparison changes.
+ */
+typedef struct _RuleSlow
+{
+	float on[2];					/**< Interval the reading must be in to fire */
+	float hold[2];					/**< Interval the reading must leave to re-arm */
+	uint64_t hold_ns;				/**< Time the comparison must hold before firing */
+	uint64_t since_ns;				/**< When the comparison became true */
+	uint16_t action;				/**< Index into actions */
+	uint8_t state;					/**< RuleState_t */
+} RuleSlow_t;
+
+/**
+ * @brief A fired rule waiting for the action thread.
+ */
+typedef struct _RuleFired
+{
+	uint64_t timestamp_ns;
+	float value;
+	uint16_t channel;
+	RuleAction_t action;			/**< Copied so reloading the rules never pulls it from under the action thread */
+} RuleFired_t;
+
+static unsigned int rule_count = 0;
+static unsigned int first[SENSOR_CHANNEL_COUNT + 1];		//Rules of channel c are [first[c], first[c + 1])
+static float *low = NULL;									//Interval of the current state of each rule,
+static float *high = NULL;									//the only data the loop reads besides active
+static uint8_t *active = NULL;								//1 if the comparison is expected true
+static uint64_t due[SENSOR_CHANNEL_COUNT];					//Earliest end of a hold time per channel
+static RuleSlow_t *slow = NULL;
+static RuleAction_t *actions = NULL;
+static unsigned int action_count = 0;
+static float rate[SENSOR_CHANNEL_COUNT];
+
+static RuleFired_t queue[RULES_QUEUE_SIZE];
+static unsigned int queue_head = 0, queue_tail = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t action_thread;
+static int action_running = 0;
+static RulesStats_t stats;
+
+static int Rules_ParseLine(char *line, unsigned int number, RuleSlow_t *rule, uint16_t *channel);
+static int Rules_ParseAction(char **tokens, int count, RuleAction_t *action);
+static int Rules_Tokenize(char *line, char **tokens, int max);
+static int Rules_Channel(const char *name);
+static uint8_t Rules_CompareBlock(float v, const float *restrict lo, const float *restrict hi,
+								  const uint8_t *restrict expected, uint8_t *restrict changed);
+static void Rules_Change(unsigned int i, int match, const Sample_t *sample);
+static void Rules_Expire(unsigned int channel, const Sample_t *sample);
+static void Rules_Fire(unsigned int i, const Sample_t *sample);
+static void Rules_Run(const RuleFired_t *fired);
+static void* Rules_Thread(void *arg);
+
+/// \defgroup rules Rules
+/// These functions load a rules file and fire its actions from the sample stream.
+/// @{
+
+/**
+ * @brief Loads and compiles a rules file, replacing the rules loaded before. Must not run beside
+ *		  Rules_Evaluate.
+ * @param path Rules file
+ * @return count Number of rules loaded, -1 if the file cannot be read or has errors, which are printed.
+ */
+int Rules_Load(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if(file == NULL)
+	{
+		printf("Rules: cannot open %s\n", path);
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	rewind(file);
+
+	char *text = malloc(size + 1);
+	if(text == NULL)
+	{
+		fclose(file);
+		return -1;
+	}
+	size_t n = fread(text, 1, size, file);
+	text[n] = '\0';
+	fclose(file);
+
+	int status = Rules_LoadString(text);
+	free(text);
+	return status;
+}
+
+/**
+ * @brief Compiles rules given as the text of a rules file, replacing the rules loaded before. Must not
+ *		  run beside Rules_Evaluate.
+ * @param text Lines of a rules file
+ * @return count Number of rules loaded, -1 for a syntax error, which is printed, or when out of memory.
+ */
+int Rules_LoadString(const char *text)
+{
+	char line[RULES_LINE_SIZE];
+	unsigned int capacity = 0, count = 0, number = 0, errors = 0;
+	unsigned int offset[SENSOR_CHANNEL_COUNT + 1];
+	RuleSlow_t *parsed = NULL;
+	uint16_t *channel = NULL;
+
+	Rules_Free();
+	while(*text)
+	{
+		size_t len = strcspn(text, "\n");
+		number++;
+		if(len >= sizeof(line))
+		{
+			printf("Rules: line %u is too long\n", number);
+			errors++;
+			len = sizeof(line) - 1;
+		}
+		memcpy(line, text, len);
+		line[len] = '\0';
+		text += strcspn(text, "\n");
+		text += (*text == '\n');
+
+		if(count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 64;
+			RuleSlow_t *p = realloc(parsed, capacity * sizeof(RuleSlow_t));
+			uint16_t *c = realloc(channel, capacity * sizeof(uint16_t));
+			parsed = p ? p : parsed;
+			channel = c ? c : channel;
+			if(p == NULL || c == NULL)
+			{
+				errors++;
+				break;
+			}
+		}
+		int status = Rules_ParseLine(line, number, &parsed[count], &channel[count]);
+		if(status < 0)
+		{
+			errors++;
+		}
+		count += (status > 0);
+	}
+
+	if(errors == 0 && count > 0)
+	{
+		low = malloc((count + RULES_BLOCK) * sizeof(float));
+		high = malloc((count + RULES_BLOCK) * sizeof(float));
+		active = calloc(count + RULES_BLOCK, 1);
+		slow = malloc(count * sizeof(RuleSlow_t));
+		errors += (low == NULL || high == NULL || active == NULL || slow == NULL);
+	}
+	if(errors)
+	{
+		free(parsed);
+		free(channel);
+		Rules_Free();
+		return -1;
+	}
+
+	//Counting sort by channel keeps the file order within a channel
+	memset(first, 0, sizeof(first));
+	for(unsigned int i = 0; i < count; i++)
+	{
+		first[channel[i] + 1]++;
+	}
+	for(int c = 0; c < SENSOR_CHANNEL_COUNT; c++)
+	{
+		first[c + 1] += first[c];
+	}
+	memcpy(offset, first, sizeof(offset));
+	for(unsigned int i = 0; i < count; i++)
+	{
+		unsigned int j = offset[channel[i]]++;
+		slow[j] = parsed[i];
+		low[j] = parsed[i].on[0];
+		high[j] = parsed[i].on[1];
+		active[j] = 0;
+	}
+	for(unsigned int j = count; j < count + RULES_BLOCK; j++)
+	{
+		low[j] = INFINITY;			//Empty interval, the padding never matches
+		high[j] = -INFINITY;
+	}
+	rule_count = count;
+	free(parsed);
+	free(channel);
+	return (int) count;
+}
+
+/**
+ * @brief Unloads the rules. Actions already queued still run. Must not run beside Rules_Evaluate.
+ * @return none
+ */
+void Rules_Free(void)
+{
+	free(low);
+	free(high);
+	free(active);
+	free(slow);
+	low = NULL;
+	high = NULL;
+	active = NULL;
+	slow = NULL;
+	rule_count = 0;
+	memset(first, 0, sizeof(first));
+	memset(rate, 0, sizeof(rate));
+	memset(due, 0xff, sizeof(due));
+	free(actions);
+	actions = NULL;
+	action_count = 0;
+}
+
+/**
+ * @brief Returns the number of rules loaded.
+ * @return count Number of rules
+ */
+unsigned int Rules_Count(void)
+{
+	return rule_count;
+}
+
+/**
+ * @brief Returns the sampling rate the rules need on a channel, to pass to Scheduler_SetRate.
+ * @param channel Channel to look up
+ * @return hz Rate of the channel's rate line, RULES_DEFAULT_RATE if rules use the channel without one,
+ *		   0 if nothing uses it.
+ */
+float Rules_Rate(SensorChannel_t channel)
+{
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT)
+	{
+		return 0.0f;
+	}
+	if(rate[channel] > 0.0f)
+	{
+		return rate[channel];
+	}
+	return (first[channel + 1] > first[channel]) ? RULES_DEFAULT_RATE : 0.0f;
+}
+
+/**
+ * @brief Checks samples against the rules of their channels and queues the actions of the rules that
+ *		  fire. Samples without SAMPLE_VALID are skipped.
+ * @param samples Samples in time order per channel
+ * @param count Number of samples
+ * @return none
+ */
+void Rules_Evaluate(const Sample_t *samples, unsigned int count)
+{
+	for(unsigned int s = 0; s < count; s++)
+	{
+		unsigned int ch = samples[s].channel;
+		if(ch >= SENSOR_CHANNEL_COUNT || (samples[s].flags & SAMPLE_VALID) == 0)
+		{
+			continue;
+		}
+		float v = samples[s].value;
+		unsigned int end = first[ch + 1];
+		for(unsigned int i = first[ch]; i < end; i += RULES_BLOCK)
+		{
+			uint8_t changed[RULES_BLOCK];
+			if(!Rules_CompareBlock(v, &low[i], &high[i], &active[i], changed))
+			{
+				continue;
+			}
+			for(unsigned int k = 0; k < RULES_BLOCK && i + k < end; k++)
+			{
+				if(changed[k])
+				{
+					Rules_Change(i + k, !active[i + k], &samples[s]);
+				}
+			}
+		}
+		if(samples[s].timestamp_ns >= due[ch])
+		{
+			Rules_Expire(ch, &samples[s]);
+		}
+		stats.checks += end - first[ch];
+		stats.samples++;
+	}
+}
+
+/**
+ * @brief SampleCallback_t that evaluates every batch: Scheduler_AddCallback(Rules_Callback, NULL).
+ * @param samples Samples of one scheduler pass
+ * @param count Number of samples
+ * @param arg Unused
+ * @return none
+ */
+void Rules_Callback(const Sample_t *samples, unsigned int count, void *arg)
+{
+	Rules_Evaluate(samples, count);
+}
+
+/**
+ * @brief Runs the queued actions on the calling thread, for programs that do not use Rules_Start.
+ * @return count Number of actions run
+ */
+unsigned int Rules_RunActions(void)
+{
+	unsigned int count = 0;
+	RuleFired_t fired;
+
+	pthread_mutex_lock(&queue_lock);
+	while(queue_head != queue_tail)
+	{
+		fired = queue[queue_tail % RULES_QUEUE_SIZE];
+		queue_tail++;
+		pthread_mutex_unlock(&queue_lock);
+		Rules_Run(&fired);
+		count++;
+		pthread_mutex_lock(&queue_lock);
+	}
+	pthread_mutex_unlock(&queue_lock);
+	return count;
+}
+
+/**
+ * @brief Starts a thread that runs actions as soon as they are queued.
+ * @return status 0 on success, -1 if it is already running or cannot be started.
+ */
+int Rules_Start(void)
+{
+	if(action_running)
+	{
+		return -1;
+	}
+	action_running = 1;
+	if(pthread_create(&action_thread, NULL, Rules_Thread, NULL) != 0)
+	{
+		action_running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Stops the action thread once the queued actions have run.
+ * @return none
+ */
+void Rules_Stop(void)
+{
+	if(!action_running)
+	{
+		return;
+	}
+	pthread_mutex_lock(&queue_lock);
+	action_running = 0;
+	pthread_cond_signal(&queue_cond);
+	pthread_mutex_unlock(&queue_lock);
+	pthread_join(action_thread, NULL);
+}
+
+/**
+ * @brief Copies the counters of the engine.
+ * @param stats Structure to fill
+ * @return none
+ */
+void Rules_GetStats(RulesStats_t *out)
+{
+	pthread_mutex_lock(&queue_lock);
+	*out = stats;
+	pthread_mutex_unlock(&queue_lock);
+}
+
+/// @}
+
+/**
+ * @brief Compares a reading with one block of rules. The block has no branches and its arrays cannot
+ *		  alias, so the compiler vectorizes it. Padding past the last rule never matches.
+ * @return changed Non-zero if the comparison of any rule no longer matches its state, which is flagged
+ *		   in changed.
+ */
+static uint8_t Rules_CompareBlock(float v, const float *restrict lo, const float *restrict hi,
+								  const uint8_t *restrict expected, uint8_t *restrict changed)
+{
+	uint8_t any = 0;
+
+	for(unsigned int k = 0; k < RULES_BLOCK; k++)
+	{
+		uint8_t match = (uint8_t)((v >= lo[k]) & (v <= hi[k]));
+		changed[k] = match ^ expected[k];
+		any |= changed[k];
+	}
+	return any;
+}
+
+/**
+ * @brief Handles a rule whose comparison no longer matches its state: fires it, starts its hold time or
+ *		  re-arms it.
+ */
+static void Rules_Change(unsigned int i, int match, const Sample_t *sample)
+{
+	RuleSlow_t *rule = &slow[i];
+
+	if(!match)
+	{
+		rule->state = RULE_IDLE;			//Left the hold interval or dropped out during the hold time
+		low[i] = rule->on[0];
+		high[i] = rule->on[1];
+		active[i] = 0;
+	}
+	else if(rule->hold_ns == 0)
+	{
+		Rules_Fire(i, sample);
+	}
+	else
+	{
+		//Expected to keep matching, so only dropping out comes back here. Rules_Expire fires it.
+		rule->state = RULE_PENDING;
+		rule->since_ns = sample->timestamp_ns;
+		active[i] = 1;
+		if(rule->since_ns + rule->hold_ns < due[sample->channel])
+		{
+			due[sample->channel] = rule->since_ns + rule->hold_ns;
+		}
+	}
+}
+
+/**
+ * @brief Fires the pending rules of a channel whose hold time is over and finds the next one due.
+ */
+static void Rules_Expire(unsigned int channel, const Sample_t *sample)
+{
+	uint64_t next = UINT64_MAX;
+
+	for(unsigned int i = first[channel]; i < first[channel + 1]; i++)
+	{
+		RuleSlow_t *rule = &slow[i];
+		if(rule->state != RULE_PENDING)
+		{
+			continue;
+		}
+		if(sample->timestamp_ns - rule->since_ns >= rule->hold_ns)
+		{
+			Rules_Fire(i, sample);
+		}
+		else if(rule->since_ns + rule->hold_ns < next)
+		{
+			next = rule->since_ns + rule->hold_ns;
+		}
+	}
+	due[channel] = next;
+}
+
+/**
+ * @brief Moves a rule to its hold interval and queues its action.
+ */
+static void Rules_Fire(unsigned int i, const Sample_t *sample)
+{
+	RuleSlow_t *rule = &slow[i];
+
+	rule->state = RULE_ACTIVE;
+	low[i] = rule->hold[0];
+	high[i] = rule->hold[1];
+	active[i] = 1;
+
+	pthread_mutex_lock(&queue_lock);
+	stats.fired++;
+	if(queue_head - queue_tail < RULES_QUEUE_SIZE)
+	{
+		RuleFired_t *fired = &queue[queue_head % RULES_QUEUE_SIZE];
+		fired->timestamp_ns = sample->timestamp_ns;
+		fired->value = sample->value;
+		fired->channel = sample->channel;
+		fired->action = actions[rule->action];
+		queue_head++;
+		pthread_cond_signal(&queue_cond);
+	}
+	else
+	{
+		stats.dropped++;
+	}
+	pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ * @brief Runs one fired action.
+ */
+static void Rules_Run(const RuleFired_t *fired)
+{
+	const RuleAction_t *action = &fired->action;
+	char value[32];
+	char text[RULES_TEXT_SIZE + 32];
+
+	snprintf(value, sizeof(value), "%g", fired->value);
+	if(action->type == RULE_TFT || action->type == RULE_PRINT)
+	{
+		const char *mark = strstr(action->text, "{value}");
+		if(mark)
+		{
+			snprintf(text, sizeof(text), "%.*s%s%s", (int)(mark - action->text), action->text, value, mark + 7);
+		}
+		else
+		{
+			snprintf(text, sizeof(text), "%s", action->text);
+		}
+	}
+
+	switch(action->type)
+	{
+		case RULE_LED_ON:
+			LED_on();
+			break;
+		case RULE_LED_OFF:
+			LED_off();
+			break;
+		case RULE_TFT:
+			TFT_Printer_Print(text);
+			break;
+		case RULE_PRINT:
+			printf("%s\n", text);
+			break;
+		case RULE_IFTTT:
+			cloud_ifttt_trigger_values((char *) action->key, (char *) action->event, RULES_IFTTT_TIMEOUT,
+									   (char *) SensorChannel_Name(fired->channel), value,
+									   (char *) SensorChannel_Unit(fired->channel));
+			break;
+	}
+	pthread_mutex_lock(&queue_lock);
+	stats.executed++;
+	pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ * @brief Runs queued actions until Rules_Stop.
+ */
+static void* Rules_Thread(void *arg)
+{
+	pthread_mutex_lock(&queue_lock);
+	for(;;)
+	{
+		while(queue_head == queue_tail && action_running)
+		{
+			pthread_cond_wait(&queue_cond, &queue_lock);
+		}
+		if(queue_head == queue_tail)
+		{
+			break;
+		}
+		pthread_mutex_unlock(&queue_lock);
+		Rules_RunActions();
+		pthread_mutex_lock(&queue_lock);
+	}
+	pthread_mutex_unlock(&queue_lock);
+	return NULL;
+}
+
+/**
+ * @brief Parses one line of a rules file into a rule, or applies it if it is a rate line.
+ * @return status 1 for a rule, 0 for a blank, comment or rate line, -1 for an error, which is printed.
+ */
+static int Rules_ParseLine(char *line, unsigned int number, RuleSlow_t *rule, uint16_t *channel)
+{
+	char *tokens[8];
+	char *end;
+	int count = Rules_Tokenize(line, tokens, 8);
+
+	if(count == 0)
+	{
+		return 0;
+	}
+	if(count < 0)
+	{
+		printf("Rules: line %u: unterminated quote or too many words\n", number);
+		return -1;
+	}
+
+	if(strcmp(tokens[0], "rate") == 0)
+	{
+		int ch = (count == 3) ? Rules_Channel(tokens[1]) : -1;
+		float hz = (count == 3) ? strtof(tokens[2], &end) : 0.0f;
+		if(ch < 0 || *end != '\0' || !(hz > 0.0f))
+		{
+			printf("Rules: line %u: expected rate channel hz\n", number);
+			return -1;
+		}
+		rate[ch] = hz;
+		return 0;
+	}
+
+	if(count < 7)
+	{
+		printf("Rules: line %u: expected channel op threshold hysteresis hold_ms action\n", number);
+		return -1;
+	}
+	int ch = Rules_Channel(tokens[0]);
+	if(ch < 0)
+	{
+		printf("Rules: line %u: unknown channel %s\n", number, tokens[0]);
+		return -1;
+	}
+	float threshold = strtof(tokens[2], &end);
+	int bad = (*end != '\0');
+	float hysteresis = strtof(tokens[3], &end);
+	bad |= (*end != '\0') || !(hysteresis >= 0.0f);
+	unsigned long hold_ms = strtoul(tokens[4], &end, 10);
+	bad |= (*end != '\0');
+	if(bad)
+	{
+		printf("Rules: line %u: threshold, hysteresis and hold_ms must be numbers, hysteresis not negative\n", number);
+		return -1;
+	}
+
+	//Strict comparisons become closed intervals through the next float toward the inside
+	const char *op = tokens[1];
+	if(strcmp(op, ">") == 0 || strcmp(op, ">=") == 0)
+	{
+		int strict = (op[1] == '\0');
+		rule->on[0] = strict ? nextafterf(threshold, INFINITY) : threshold;
+		rule->hold[0] = strict ? nextafterf(threshold - hysteresis, INFINITY) : threshold - hysteresis;
+		rule->on[1] = rule->hold[1] = INFINITY;
+	}
+	else if(strcmp(op, "<") == 0 || strcmp(op, "<=") == 0)
+	{
+		int strict = (op[1] == '\0');
+		rule->on[1] = strict ? nextafterf(threshold, -INFINITY) : threshold;
+		rule->hold[1] = strict ? nextafterf(threshold + hysteresis, -INFINITY) : threshold + hysteresis;
+		rule->on[0] = rule->hold[0] = -INFINITY;
+	}
+	else if(strcmp(op, "==") == 0)
+	{
+		rule->on[0] = rule->on[1] = threshold;
+		rule->hold[0] = threshold - hysteresis;
+		rule->hold[1] = threshold + hysteresis;
+	}
+	else
+	{
+		printf("Rules: line %u: unknown comparison %s, use < <= > >= ==\n", number, op);
+		return -1;
+	}
+
+	RuleAction_t action;
+	if(Rules_ParseAction(&tokens[5], count - 5, &action) != 0)
+	{
+		printf("Rules: line %u: expected led on|off, tft \"text\", print \"text\" or ifttt key event\n", number);
+		return -1;
+	}
+
+	//Rules with the same action share its entry
+	unsigned int a;
+	for(a = 0; a < action_count && memcmp(&actions[a], &action, sizeof(action)) != 0; a++);
+	if(a == action_count)
+	{
+		RuleAction_t *grown = (action_count % 16) ? actions : realloc(actions, (action_count + 16) * sizeof(RuleAction_t));
+		if(grown == NULL || action_count == RULES_MAX_ACTIONS)
+		{
+			printf("Rules: line %u: more than %d different actions\n", number, RULES_MAX_ACTIONS);
+			return -1;
+		}
+		actions = grown;
+		actions[action_count++] = action;
+	}
+
+	rule->hold_ns = (uint64_t) hold_ms * 1000000ULL;
+	rule->since_ns = 0;
+	rule->action = a;
+	rule->state = RULE_IDLE;
+	*channel = ch;
+	return 1;
+}
+
+/**
+ * @brief Parses the action words of a rule.
+ * @return status 0 on success, -1 for an unknown action or wrong arguments.
+ */
+static int Rules_ParseAction(char **tokens, int count, RuleAction_t *action)
+{
+	memset(action, 0, sizeof(*action));			//Zeroed so equal actions compare equal with memcmp
+	if(strcmp(tokens[0], "led") == 0 && count == 2 && strcmp(tokens[1], "on") == 0)
+	{
+		action->type = RULE_LED_ON;
+	}
+	else if(strcmp(tokens[0], "led") == 0 && count == 2 && strcmp(tokens[1], "off") == 0)
+	{
+		action->type = RULE_LED_OFF;
+	}
+	else if((strcmp(tokens[0], "tft") == 0 || strcmp(tokens[0], "print") == 0) && count == 2 &&
+			strlen(tokens[1]) < RULES_TEXT_SIZE)
+	{
+		action->type = (tokens[0][0] == 't') ? RULE_TFT : RULE_PRINT;
+		strcpy(action->text, tokens[1]);
+	}
+	else if(strcmp(tokens[0], "ifttt") == 0 && count == 3 &&
+			strlen(tokens[1]) < RULES_KEY_SIZE && strlen(tokens[2]) < RULES_KEY_SIZE)
+	{
+		action->type = RULE_IFTTT;
+		strcpy(action->key, tokens[1]);
+		strcpy(action->event, tokens[2]);
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Splits a line into words in place. Double quotes group words, # starts a comment.
+ * @return count Number of words, -1 for an unterminated quote or more than max words.
+ */
+static int Rules_Tokenize(char *line, char **tokens, int max)
+{
+	int count = 0;
+	char *p = line;
+
+	for(;;)
+	{
+		while(*p == ' ' || *p == '\t' || *p == '\r')
+		{
+			p++;
+		}
+		if(*p == '\0' || *p == '#')
+		{
+			return count;
+		}
+		if(count == max)
+		{
+			return -1;
+		}
+		if(*p == '"')
+		{
+			tokens[count++] = ++p;
+			p = strchr(p, '"');
+			if(p == NULL)
+			{
+				return -1;
+			}
+		}
+		else
+		{
+			tokens[count++] = p;
+			p += strcspn(p, " \t\r#");
+			if(*p == '#')
+			{
+				*p = '\0';
+				return count;
+			}
+		}
+		if(*p)
+		{
+			*p++ = '\0';
+		}
+	}
+}
+
+/**
+ * @brief Looks up a channel by its SensorChannel_Name.
+ * @return channel SensorChannel_t, -1 if unknown
+ */
+static int Rules_Channel(const char *name)
+{
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		if(strcmp(name, SensorChannel_Name(ch)) == 0)
+		{
+			return ch;
+		}
+	}
+	return -1;
+}
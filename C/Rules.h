@@ -0,0 +1,64 @@
+/**
+ * @file Rules.h
+ * @brief Header for the threshold and hysteresis rules engine driving actions from the sample stream
+ */
+
+#ifndef __RULES_H__
+#define __RULES_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+
+#define RULES_MAX_ACTIONS		1024		/*!< Distinct actions in one rules file */
+#define RULES_QUEUE_SIZE		64			/*!< Fired actions waiting for the action thread */
+#define RULES_TEXT_SIZE			64			/*!< Longest TFT or print message, with the terminator */
+#define RULES_KEY_SIZE			48			/*!< Longest IFTTT key or event name, with the terminator */
+#define RULES_IFTTT_TIMEOUT		5			/*!< Seconds an IFTTT trigger may take */
+#define RULES_DEFAULT_RATE		1.0f		/*!< Hz of channels used by rules without a rate line */
+
+/**
+ * @brief What a rule does when it fires.
+ */
+typedef enum {RULE_LED_ON = 0,				/**< Turns the orange LED on */
+			  RULE_LED_OFF,					/**< Turns the orange LED off */
+			  RULE_TFT,						/**< Prints a message on the TFT, {value} becomes the reading */
+			  RULE_PRINT,					/**< Prints a message on standard output, {value} becomes the reading */
+			  RULE_IFTTT					/**< Triggers an IFTTT event with the channel, reading and unit as values */
+} RuleActionType_t;
+
+/**
+ * @brief One action of the rules file. Rules with identical actions share one entry.
+ */
+typedef struct _RuleAction
+{
+	RuleActionType_t type;
+	char text[RULES_TEXT_SIZE];		/**< Message of RULE_TFT and RULE_PRINT */
+	char key[RULES_KEY_SIZE];		/**< Maker key of RULE_IFTTT */
+	char event[RULES_KEY_SIZE];		/**< Event name of RULE_IFTTT */
+} RuleAction_t;
+
+/**
+ * @brief Counters of the engine.
+ */
+typedef struct _RulesStats
+{
+	uint64_t samples;				/**< Samples evaluated */
+	uint64_t checks;				/**< Rule comparisons made */
+	uint64_t fired;					/**< Rules that fired */
+	uint64_t dropped;				/**< Fired actions lost because the queue was full */
+	uint64_t executed;				/**< Actions run */
+} RulesStats_t;
+
+int 			Rules_Load(const char *path);
+int 			Rules_LoadString(const char *text);
+void 			Rules_Free(void);
+unsigned int 	Rules_Count(void);
+float 			Rules_Rate(SensorChannel_t channel);
+void 			Rules_Evaluate(const Sample_t *samples, unsigned int count);
+void 			Rules_Callback(const Sample_t *samples, unsigned int count, void *arg);
+unsigned int 	Rules_RunActions(void);
+int 			Rules_Start(void);
+void 			Rules_Stop(void);
+void 			Rules_GetStats(RulesStats_t *stats);
+
+#endif
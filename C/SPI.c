@@ -27,22 +27,31 @@
  
 #include "SPI.h"
 #include <stdio.h>
+#include "Utilities.h"
+#include "BusStats.h"
+#include "BusTrace.h"
+
+static int spi_mapped = 0;		/*!< 1 while SPI holds a hardware_acquire reference */
 
 /**
  *@brief Initializes the SPI peripheral
  *@return none
  */
 void SPI_Initialize(void)
-{	if (!bcm2835_init())
+{	if (!spi_mapped)
 	{
-		printf("BCM libray error.\n");			//Should be run with the sudo cmd
+		if (hardware_acquire() != 0)			//Shares the mapping with I2C and GPIO
+		{
+			printf("BCM libray error.\n");		//Should be run with the sudo cmd
+			return;
+		}
+		spi_mapped = 1;
 	}
 	bcm2835_spi_begin();						//Configure SPI pins
 	bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);      	//Configure bit order
 	bcm2835_spi_setDataMode(BCM2835_SPI_MODE0);  			//Set clock polarity and phase CPOL=0, CPHA=0
 	bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_8);	//SPI baud rate at 244 Khz
 	bcm2835_spi_chipSelect(BCM2835_SPI_CS_NONE);			//Control CE0 in software
-	printf("SPI initialized...\n");
 }
 
 /**
@@ -52,7 +61,11 @@ void SPI_Initialize(void)
  */
 unsigned char SPI_Write(unsigned char data)
 {
-	return bcm2835_spi_transfer(data);
+	BUS_STATS_START(t);
+	unsigned char result = bcm2835_spi_transfer(data);
+	BUS_STATS_RECORD(BUS_SPI, 0, BUS_OP_WRITE, 1, 0, t);
+	BUS_TRACE_RECORD(BUS_SPI, 0, BUS_OP_WRITE, &data, 1, &result, 1, 0);
+	return result;
 }
 
 /**
@@ -61,7 +74,11 @@ unsigned char SPI_Write(unsigned char data)
  */
 unsigned char SPI_Read(void)
 {
-	unsigned char data = bcm2835_spi_transfer(0xff);
+	BUS_STATS_START(t);
+	unsigned char dummy = 0xff;
+	unsigned char data = bcm2835_spi_transfer(dummy);
+	BUS_STATS_RECORD(BUS_SPI, 0, BUS_OP_READ, 1, 0, t);
+	BUS_TRACE_RECORD(BUS_SPI, 0, BUS_OP_READ, &dummy, 1, &data, 1, 0);
 	return data;
 }
 
@@ -73,7 +90,10 @@ unsigned char SPI_Read(void)
  */
 void SPI_Write_Array(char* buff, unsigned int length)
 {
+	BUS_STATS_START(t);
 	bcm2835_spi_writenb(buff,length);
+	BUS_STATS_RECORD(BUS_SPI, 0, BUS_OP_WRITE, length, 0, t);
+	BUS_TRACE_RECORD(BUS_SPI, 0, BUS_OP_WRITE, buff, length, NULL, 0, 0);
 }
 
 /**
@@ -85,7 +105,10 @@ void SPI_Write_Array(char* buff, unsigned int length)
  */
 void SPI_Read_Array(char* sArray, char* rArray, char length)
 {
+	BUS_STATS_START(t);
 	bcm2835_spi_transfernb(sArray,rArray,length);
+	BUS_STATS_RECORD(BUS_SPI, 0, BUS_OP_WRITE_READ, (unsigned char) length, 0, t);
+	BUS_TRACE_RECORD(BUS_SPI, 0, BUS_OP_WRITE_READ, sArray, (unsigned char) length, rArray, (unsigned char) length, 0);
 }
 
 /**
@@ -95,4 +118,9 @@ void SPI_Read_Array(char* sArray, char* rArray, char length)
 void SPI_Close(void)
 {
 	bcm2835_spi_end();
+	if (spi_mapped)
+	{
+		spi_mapped = 0;
+		hardware_release();
+	}
 }
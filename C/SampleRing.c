@@ -0,0 +1,256 @@
+/**
+ * @file SampleRing.c
+ * @brief Lock-free single producer, single consumer ring of samples.
+ *
+ * head and tail are free running 32 bit indices, the number of records in the
+ * ring is head - tail. The producer publishes records with a release store of
+ * head and the consumer frees them with a release store of tail. Each side
+ * keeps a cached copy of the other side's index and only reloads it when the
+ * cached value says the ring is full or empty, so a batch costs one shared
+ * cache line transfer instead of one per record.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "SampleRing.h"
+
+/// \defgroup samplering Sample Ring
+/// These functions pass a stream of samples from one thread to another.
+/// @{
+
+/**
+ * @brief Allocates the ring storage.
+ * @param ring Ring to initialize
+ * @param capacity Minimum number of records, rounded up to a power of two.
+ * @return status 0 on success, -1 on error.
+ */
+int SampleRing_Init(SampleRing_t *ring, unsigned int capacity)
+{
+	uint32_t size = 1;
+	void *buffer = NULL;
+
+	if(capacity == 0 || capacity > 0x80000000U)
+	{
+		return -1;
+	}
+	while(size < capacity)
+	{
+		size <<= 1;
+	}
+	if(posix_memalign(&buffer, SAMPLE_RING_CACHELINE, (size_t) size * sizeof(Sample_t)) != 0)
+	{
+		return -1;
+	}
+
+	memset(ring, 0, sizeof(*ring));
+	ring->buffer = buffer;
+	ring->capacity = size;
+	ring->mask = size - 1;
+	return 0;
+}
+
+/**
+ * @brief Releases the ring storage. Neither side may use the ring afterwards.
+ * @param ring Ring to free
+ * @return none
+ */
+void SampleRing_Free(SampleRing_t *ring)
+{
+	free(ring->buffer);
+	ring->buffer = NULL;
+	ring->capacity = 0;
+	ring->mask = 0;
+}
+
+/**
+ * @brief Producer: returns contiguous free slots to fill in place. Fewer than asked are returned when
+ *		  the ring is nearly full or the free space wraps around the end of the storage.
+ * @param ring Ring
+ * @param slots Receives a pointer to the first free slot
+ * @param count Number of slots wanted
+ * @return reserved Number of slots that may be written, hand the number filled to SampleRing_Commit.
+ */
+unsigned int SampleRing_Reserve(SampleRing_t *ring, Sample_t **slots, unsigned int count)
+{
+	uint32_t head = ring->head;
+	uint32_t space = ring->capacity - (head - ring->tail_cache);
+
+	if(space < count)
+	{
+		ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		space = ring->capacity - (head - ring->tail_cache);
+	}
+
+	uint32_t offset = head & ring->mask;
+	uint32_t contiguous = ring->capacity - offset;
+	if(count > space)
+	{
+		count = space;
+	}
+	if(count > contiguous)
+	{
+		count = contiguous;
+	}
+	*slots = &ring->buffer[offset];
+	return count;
+}
+
+/**
+ * @brief Producer: publishes slots filled after SampleRing_Reserve.
+ * @param ring Ring
+ * @param count Number of slots filled, at most the number reserved
+ * @return none
+ */
+void SampleRing_Commit(SampleRing_t *ring, unsigned int count)
+{
+	__atomic_store_n(&ring->head, ring->head + count, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Producer: copies samples into the ring. Samples that do not fit are dropped and counted.
+ * @param ring Ring
+ * @param samples Samples to append
+ * @param count Number of samples
+ * @return written Number of samples appended.
+ */
+unsigned int SampleRing_Push(SampleRing_t *ring, const Sample_t *samples, unsigned int count)
+{
+	unsigned int written = 0;
+	Sample_t *slots;
+
+	while(written < count)			//At most two passes, before and after the wrap
+	{
+		unsigned int n = SampleRing_Reserve(ring, &slots, count - written);
+		if(n == 0)
+		{
+			break;
+		}
+		memcpy(slots, samples + written, n * sizeof(Sample_t));
+		SampleRing_Commit(ring, n);
+		written += n;
+	}
+
+	if(written < count)
+	{
+		__atomic_store_n(&ring->dropped, ring->dropped + (count - written), __ATOMIC_RELAXED);
+		__atomic_store_n(&ring->overflows, ring->overflows + 1, __ATOMIC_RELAXED);
+	}
+	return written;
+}
+
+/**
+ * @brief Consumer: returns contiguous filled slots to read in place. Fewer than asked are returned when
+ *		  the ring holds fewer records or they wrap around the end of the storage.
+ * @param ring Ring
+ * @param slots Receives a pointer to the oldest record
+ * @param count Maximum number of records wanted
+ * @return available Number of records that may be read, hand the number consumed to SampleRing_Release.
+ */
+unsigned int SampleRing_Peek(SampleRing_t *ring, const Sample_t **slots, unsigned int count)
+{
+	uint32_t tail = ring->tail;
+	uint32_t filled = ring->head_cache - tail;
+
+	if(filled < count)
+	{
+		ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		filled = ring->head_cache - tail;
+	}
+
+	uint32_t offset = tail & ring->mask;
+	uint32_t contiguous = ring->capacity - offset;
+	if(count > filled)
+	{
+		count = filled;
+	}
+	if(count > contiguous)
+	{
+		count = contiguous;
+	}
+	*slots = &ring->buffer[offset];
+	return count;
+}
+
+/**
+ * @brief Consumer: frees records read after SampleRing_Peek.
+ * @param ring Ring
+ * @param count Number of records consumed, at most the number peeked
+ * @return none
+ */
+void SampleRing_Release(SampleRing_t *ring, unsigned int count)
+{
+	__atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Consumer: copies the oldest records out of the ring.
+ * @param ring Ring
+ * @param samples Buffer to fill
+ * @param count Size of the buffer in records
+ * @return read Number of records copied.
+ */
+unsigned int SampleRing_Pop(SampleRing_t *ring, Sample_t *samples, unsigned int count)
+{
+	unsigned int read = 0;
+	const Sample_t *slots;
+
+	while(read < count)
+	{
+		unsigned int n = SampleRing_Peek(ring, &slots, count - read);
+		if(n == 0)
+		{
+			break;
+		}
+		memcpy(samples + read, slots, n * sizeof(Sample_t));
+		SampleRing_Release(ring, n);
+		read += n;
+	}
+	return read;
+}
+
+/**
+ * @brief Returns the number of records waiting. Exact only on the consumer thread.
+ * @param ring Ring
+ * @return count Records in the ring.
+ */
+unsigned int SampleRing_Count(const SampleRing_t *ring)
+{
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+}
+
+/**
+ * @brief Returns the number of records dropped because the ring was full. Safe from any thread.
+ * @param ring Ring
+ * @return dropped Records lost since SampleRing_Init.
+ */
+uint64_t SampleRing_Dropped(const SampleRing_t *ring)
+{
+	return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Returns the number of pushes that did not fit entirely. Safe from any thread.
+ * @param ring Ring
+ * @return overflows Overflow events since SampleRing_Init.
+ */
+uint64_t SampleRing_Overflows(const SampleRing_t *ring)
+{
+	return __atomic_load_n(&ring->overflows, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief SampleCallback_t that pushes every batch into a ring, so the scheduler thread can be the producer:
+ *		  Scheduler_AddCallback(SampleRing_Callback, &ring).
+ * @param samples Samples of one scheduler pass
+ * @param count Number of samples
+ * @param ring SampleRing_t to push into
+ * @return none
+ */
+void SampleRing_Callback(const Sample_t *samples, unsigned int count, void *ring)
+{
+	SampleRing_Push((SampleRing_t *) ring, samples, count);
+}
+
+/// @}
@@ -0,0 +1,54 @@
+/**
+ * @file SampleRing.h
+ * @brief Header for the single producer, single consumer ring of samples
+ */
+
+#ifndef __SAMPLERING_H__
+#define __SAMPLERING_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+
+#define SAMPLE_RING_CACHELINE	64		/*!< Head and tail live on separate lines of this size */
+
+/**
+ * @brief Fixed capacity ring of Sample_t records. One thread may produce and one other thread may consume
+ *		  without locks. The producer and consumer fields sit on separate cache lines so the two cores
+ *		  do not keep stealing each other's line.
+ */
+typedef struct _SampleRing
+{
+	/* Producer line */
+	uint32_t head __attribute__((aligned(SAMPLE_RING_CACHELINE)));	/**< Free running write index */
+	uint32_t tail_cache;			/**< Producer's last view of tail, refreshed only when the ring looks full */
+	uint64_t dropped;				/**< Records that did not fit */
+	uint64_t overflows;				/**< Pushes that were cut short because the ring was full */
+
+	/* Consumer line */
+	uint32_t tail __attribute__((aligned(SAMPLE_RING_CACHELINE)));	/**< Free running read index */
+	uint32_t head_cache;			/**< Consumer's last view of head, refreshed only when the ring looks empty */
+
+	/* Read only after SampleRing_Init */
+	Sample_t *buffer __attribute__((aligned(SAMPLE_RING_CACHELINE)));	/**< Storage, capacity records */
+	uint32_t capacity;				/**< Power of two */
+	uint32_t mask;					/**< capacity - 1 */
+} SampleRing_t;
+
+int 		 SampleRing_Init(SampleRing_t *ring, unsigned int capacity);
+void 		 SampleRing_Free(SampleRing_t *ring);
+
+unsigned int SampleRing_Reserve(SampleRing_t *ring, Sample_t **slots, unsigned int count);
+void 		 SampleRing_Commit(SampleRing_t *ring, unsigned int count);
+unsigned int SampleRing_Push(SampleRing_t *ring, const Sample_t *samples, unsigned int count);
+
+unsigned int SampleRing_Peek(SampleRing_t *ring, const Sample_t **slots, unsigned int count);
+void 		 SampleRing_Release(SampleRing_t *ring, unsigned int count);
+unsigned int SampleRing_Pop(SampleRing_t *ring, Sample_t *samples, unsigned int count);
+
+unsigned int SampleRing_Count(const SampleRing_t *ring);
+uint64_t 	 SampleRing_Dropped(const SampleRing_t *ring);
+uint64_t 	 SampleRing_Overflows(const SampleRing_t *ring);
+
+void 		 SampleRing_Callback(const Sample_t *samples, unsigned int count, void *ring);
+
+#endif
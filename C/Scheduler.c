@@ -0,0 +1,557 @@
+/**
+ * @file Scheduler.c
+ * @brief Samples every channel at its own rate from a single thread.
+ *
+ * Each channel has a period and a deadline. The thread sleeps on a timerfd
+ * armed for the earliest due channel (or on the RTCC timebase edges), then
+ * reads every channel that is due within SCHEDULER_MERGE_NS in one pass.
+ * Channels of the same device share one burst read through Acquire_Device,
+ * so e.g. all six FXOS8700CQ axes cost a single transaction. The samples of
+ * a pass are handed to the registered callbacks as one batch. On a simulated
+ * clock (timestamp_set_clock) the thread moves the clock to each due time
+ * instead of sleeping.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include "Utilities.h"
+#include "SensorAcquire.h"
+#include "SensorPower.h"
+#include "Timebase.h"
+#include "Scheduler.h"
+
+#define NEVER	UINT64_MAX
+
+/**
+ * @brief Schedule and running statistics of one channel.
+ */
+typedef struct _ChannelSchedule
+{
+	uint64_t period_ns;			/**< Sampling period, 0 when the channel is disabled */
+	uint64_t deadline_ns;		/**< Allowed delay after the due time */
+	uint64_t next_due;			/**< Next due time */
+	uint64_t last_ts;			/**< Timestamp of the previous sample */
+	uint64_t intervals;			/**< Number of intervals in the spacing statistics */
+	double   interval_m2;		/**< Sum of squared deviations for the spacing variance */
+	SchedulerStats_t stats;
+} ChannelSchedule_t;
+
+/**
+ * @brief A registered sample callback.
+ */
+typedef struct _SchedulerCallback
+{
+	SampleCallback_t callback;
+	void *arg;
+} SchedulerCallback_t;
+
+static ChannelSchedule_t schedule[SENSOR_CHANNEL_COUNT];
+static SchedulerCallback_t callbacks[SCHEDULER_MAX_CALLBACKS];
+static pthread_mutex_t scheduler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t scheduler_thread;
+static volatile int scheduler_running = 0;
+static int scheduler_wake_fd = -1;			/*!< eventfd used to wake the thread on stop or rate changes */
+static SchedulerClock_t scheduler_clock = SCHEDULER_TIMERFD;
+static uint64_t scheduler_merge_ns = SCHEDULER_MERGE_NS;
+static unsigned long scheduler_awake = 0;	/*!< Devices kept awake because one of their channels is sampled */
+
+static void Scheduler_Wake(void);
+static void Scheduler_KeepAwake(void);
+static void* Scheduler_Thread(void *arg);
+static void Scheduler_Record(ChannelSchedule_t *ch, uint64_t ts);
+
+/// \defgroup scheduler Sampling Scheduler
+/// These functions sample the sensors at per channel rates from one thread.
+/// @{
+
+/**
+ * @brief Sets the sampling rate and deadline of a channel. Can be called while the scheduler runs. The
+ *		  device of a sampled channel is brought up on its first sample and kept out of standby.
+ * @param channel Channel to configure
+ * @param hz Samples per second, 0 or less disables the channel.
+ * @param deadline_us Delay after the due time after which a sample counts as a deadline miss,
+ *		  0 uses half the period.
+ * @return status 0 on success, -1 for an invalid channel.
+ */
+int Scheduler_SetRate(SensorChannel_t channel, float hz, uint32_t deadline_us)
+{
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&scheduler_lock);
+	ChannelSchedule_t *ch = &schedule[channel];
+	if(hz <= 0.0f)
+	{
+		ch->period_ns = 0;
+	}
+	else
+	{
+		ch->period_ns = (uint64_t)(1e9 / hz);
+		ch->deadline_ns = deadline_us ? (uint64_t) deadline_us * 1000ULL : ch->period_ns / 2;
+		ch->next_due = timestamp_ns();
+	}
+	Scheduler_KeepAwake();
+	pthread_mutex_unlock(&scheduler_lock);
+
+	Scheduler_Wake();
+	return 0;
+}
+
+/**
+ * @brief Returns the configured rate of a channel.
+ * @param channel Channel id
+ * @return hz Samples per second, 0 when disabled.
+ */
+float Scheduler_GetRate(SensorChannel_t channel)
+{
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT || schedule[channel].period_ns == 0)
+	{
+		return 0.0f;
+	}
+	return (float)(1e9 / schedule[channel].period_ns);
+}
+
+/**
+ * @brief Registers a function to receive the samples. It runs on the scheduler thread and should return quickly.
+ * @param callback Function receiving each batch of samples
+ * @param arg User pointer handed to the callback
+ * @return id Callback id for Scheduler_RemoveCallback, -1 if all slots are in use.
+ */
+int Scheduler_AddCallback(SampleCallback_t callback, void *arg)
+{
+	int id = -1;
+
+	pthread_mutex_lock(&scheduler_lock);
+	for(int i = 0; i < SCHEDULER_MAX_CALLBACKS; i++)
+	{
+		if(callbacks[i].callback == NULL)
+		{
+			callbacks[i].callback = callback;
+			callbacks[i].arg = arg;
+			id = i;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&scheduler_lock);
+	return id;
+}
+
+/**
+ * @brief Unregisters a sample callback.
+ * @param id Id returned by Scheduler_AddCallback
+ * @return none
+ */
+void Scheduler_RemoveCallback(int id)
+{
+	if(id < 0 || id >= SCHEDULER_MAX_CALLBACKS)
+	{
+		return;
+	}
+	pthread_mutex_lock(&scheduler_lock);
+	callbacks[id].callback = NULL;
+	callbacks[id].arg = NULL;
+	pthread_mutex_unlock(&scheduler_lock);
+}
+
+/**
+ * @brief Starts the scheduler thread. Devices are brought up when their first channel is due.
+ * @param clock SCHEDULER_TIMERFD, or SCHEDULER_TIMEBASE after a successful Timebase_Open.
+ * @return status 0 on success, -1 on error.
+ */
+int Scheduler_Start(SchedulerClock_t clock)
+{
+	if(scheduler_running)
+	{
+		return -1;
+	}
+	if(clock == SCHEDULER_TIMEBASE && Timebase_Fd() < 0)
+	{
+		printf("Scheduler: timebase is not open.\n");
+		return -1;
+	}
+
+	scheduler_wake_fd = eventfd(0, EFD_CLOEXEC);
+	if(scheduler_wake_fd < 0)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&scheduler_lock);
+	uint64_t now = timestamp_ns();
+	for(int i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+	{
+		schedule[i].next_due = now;			//Take the first sample of every channel together
+	}
+	pthread_mutex_unlock(&scheduler_lock);
+
+	scheduler_clock = clock;
+	scheduler_merge_ns = SCHEDULER_MERGE_NS;
+	if(clock == SCHEDULER_TIMEBASE && Timebase_PeriodNs() / 2 > SCHEDULER_MERGE_NS)
+	{
+		scheduler_merge_ns = Timebase_PeriodNs() / 2;	//Due times snap to the nearest edge
+	}
+	scheduler_running = 1;
+	if(pthread_create(&scheduler_thread, NULL, Scheduler_Thread, NULL) != 0)
+	{
+		scheduler_running = 0;
+		close(scheduler_wake_fd);
+		scheduler_wake_fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Stops the scheduler thread and waits for it to exit.
+ * @return none
+ */
+void Scheduler_Stop(void)
+{
+	if(!scheduler_running)
+	{
+		return;
+	}
+	scheduler_running = 0;
+	Scheduler_Wake();
+	pthread_join(scheduler_thread, NULL);
+	close(scheduler_wake_fd);
+	scheduler_wake_fd = -1;
+}
+
+/**
+ * @brief Returns the earliest due time of all enabled channels.
+ * @return due Due time on the monotonic clock, UINT64_MAX when no channel is enabled.
+ */
+uint64_t Scheduler_NextDue(void)
+{
+	uint64_t due = NEVER;
+
+	pthread_mutex_lock(&scheduler_lock);
+	for(int i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+	{
+		if(schedule[i].period_ns && schedule[i].next_due < due)
+		{
+			due = schedule[i].next_due;
+		}
+	}
+	pthread_mutex_unlock(&scheduler_lock);
+	return due;
+}
+
+/**
+ * @brief Samples every channel due at the given time and delivers the samples.
+ *		  Called by the scheduler thread, or directly by applications that run their own loop.
+ * @param now Current time on the monotonic clock
+ * @return count Number of samples delivered.
+ */
+unsigned int Scheduler_Poll(uint64_t now)
+{
+	unsigned long due = 0;
+	unsigned long devices = 0;
+	SchedulerCallback_t targets[SCHEDULER_MAX_CALLBACKS];
+
+	pthread_mutex_lock(&scheduler_lock);
+	for(int i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+	{
+		if(schedule[i].period_ns && schedule[i].next_due <= now + scheduler_merge_ns)
+		{
+			due |= SENSOR_CHANNEL_BIT(i);
+			devices |= 1UL << SensorChannel_Device(i);
+		}
+	}
+	memcpy(targets, callbacks, sizeof(targets));
+	pthread_mutex_unlock(&scheduler_lock);
+
+	if(due == 0)
+	{
+		return 0;
+	}
+
+	Acquisition_t acq[SENSOR_DEVICE_COUNT];
+	for(int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
+	{
+		if(devices & (1UL << dev))
+		{
+			Acquire_Device(dev, &acq[dev]);		//One burst per device, however many of its channels are due
+		}
+	}
+
+	Sample_t batch[SENSOR_CHANNEL_COUNT];
+	unsigned int count = 0;
+
+	pthread_mutex_lock(&scheduler_lock);
+	for(int i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+	{
+		if((due & SENSOR_CHANNEL_BIT(i)) == 0)
+		{
+			continue;
+		}
+		ChannelSchedule_t *ch = &schedule[i];
+		const Acquisition_t *a = &acq[SensorChannel_Device(i)];
+		uint16_t flags = 0;
+
+		int64_t lateness = (int64_t)(a->timestamp_ns - ch->next_due);
+		if(lateness > ch->stats.max_lateness_ns)
+		{
+			ch->stats.max_lateness_ns = lateness;
+		}
+		if(lateness > (int64_t) ch->deadline_ns)
+		{
+			ch->stats.deadline_misses++;
+			flags |= SAMPLE_LATE;
+		}
+
+		if(a->valid & SENSOR_CHANNEL_BIT(i))
+		{
+			batch[count].timestamp_ns = a->timestamp_ns;
+			batch[count].value = a->value[i];
+			batch[count].channel = i;
+			batch[count].flags = flags | SAMPLE_VALID;
+			count++;
+			Scheduler_Record(ch, a->timestamp_ns);
+		}
+
+		if(ch->period_ns == 0)					//Disabled while the bus was read
+		{
+			continue;
+		}
+		if(scheduler_clock == SCHEDULER_TIMEBASE && scheduler_running)
+		{
+			ch->next_due = now + ch->period_ns;	//Re-anchor on the edge so the schedule follows the crystal
+		}
+		else
+		{
+			ch->next_due += ch->period_ns;		//Fixed rate, the schedule does not drift with read times
+		}
+		if(ch->next_due + scheduler_merge_ns <= now)
+		{
+			uint64_t behind = (now - ch->next_due) / ch->period_ns + 1;
+			ch->next_due += behind * ch->period_ns;
+			ch->stats.skipped += behind;
+		}
+	}
+	pthread_mutex_unlock(&scheduler_lock);
+
+	if(count > 0)
+	{
+		for(int i = 0; i < SCHEDULER_MAX_CALLBACKS; i++)
+		{
+			if(targets[i].callback)
+			{
+				targets[i].callback(batch, count, targets[i].arg);
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Copies the timing statistics of a channel.
+ * @param channel Channel id
+ * @param stats Structure to fill
+ * @return none
+ */
+void Scheduler_GetStats(SensorChannel_t channel, SchedulerStats_t *stats)
+{
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT)
+	{
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	pthread_mutex_lock(&scheduler_lock);
+	*stats = schedule[channel].stats;
+	pthread_mutex_unlock(&scheduler_lock);
+}
+
+/**
+ * @brief Clears the timing statistics of all channels.
+ * @return none
+ */
+void Scheduler_ResetStats(void)
+{
+	pthread_mutex_lock(&scheduler_lock);
+	for(int i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+	{
+		memset(&schedule[i].stats, 0, sizeof(schedule[i].stats));
+		schedule[i].intervals = 0;
+		schedule[i].interval_m2 = 0.0;
+		schedule[i].last_ts = 0;
+	}
+	pthread_mutex_unlock(&scheduler_lock);
+}
+
+/// @}
+
+/**
+ * @brief Keeps the devices of the sampled channels awake, a periodic reading needs fresh conversions.
+ *		  Called with scheduler_lock held.
+ */
+static void Scheduler_KeepAwake(void)
+{
+	unsigned long awake = 0;
+
+	for(int i = 0; i < SENSOR_CHANNEL_COUNT; i++)
+	{
+		if(schedule[i].period_ns)
+		{
+			awake |= 1UL << SensorChannel_Device(i);
+		}
+	}
+	for(int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
+	{
+		if((awake ^ scheduler_awake) & (1UL << dev))
+		{
+			SensorPower_KeepAwake(dev, (awake >> dev) & 1);
+		}
+	}
+	scheduler_awake = awake;
+}
+
+/**
+ * @brief Wakes the scheduler thread so it re-evaluates its timer.
+ */
+static void Scheduler_Wake(void)
+{
+	if(scheduler_wake_fd >= 0)
+	{
+		uint64_t one = 1;
+		if(write(scheduler_wake_fd, &one, sizeof(one)) < 0)
+		{
+			perror("Scheduler wake");
+		}
+	}
+}
+
+/**
+ * @brief Updates the sample count and the spacing statistics (Welford's running variance).
+ */
+static void Scheduler_Record(ChannelSchedule_t *ch, uint64_t ts)
+{
+	ch->stats.samples++;
+	if(ch->last_ts != 0)
+	{
+		int64_t interval = (int64_t)(ts - ch->last_ts);
+		ch->intervals++;
+		double delta = interval - ch->stats.interval_mean_ns;
+		ch->stats.interval_mean_ns += delta / ch->intervals;
+		ch->interval_m2 += delta * (interval - ch->stats.interval_mean_ns);
+		ch->stats.interval_stddev_ns = (ch->intervals > 1) ? sqrt(ch->interval_m2 / (ch->intervals - 1)) : 0.0;
+		if(ch->intervals == 1 || interval < ch->stats.interval_min_ns)
+		{
+			ch->stats.interval_min_ns = interval;
+		}
+		if(interval > ch->stats.interval_max_ns)
+		{
+			ch->stats.interval_max_ns = interval;
+		}
+	}
+	ch->last_ts = ts;
+}
+
+/**
+ * @brief Scheduler thread, waits for the next due time or timebase edge and samples.
+ */
+static void* Scheduler_Thread(void *arg)
+{
+	struct pollfd fds[2];
+	int timer_fd = -1;
+	(void) arg;
+
+	fds[0].fd = scheduler_wake_fd;
+	fds[0].events = POLLIN;
+	if(scheduler_clock == SCHEDULER_TIMERFD)
+	{
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		if(timer_fd < 0)
+		{
+			perror("Scheduler timerfd");
+			scheduler_running = 0;
+			return NULL;
+		}
+		fds[1].fd = timer_fd;
+	}
+	else
+	{
+		fds[1].fd = Timebase_Fd();
+	}
+	fds[1].events = POLLIN;
+
+	while(scheduler_running)
+	{
+		if(timer_fd >= 0 && timestamp_is_virtual())
+		{
+			uint64_t due = Scheduler_NextDue();
+			if(due != NEVER && poll(fds, 1, 0) == 0)
+			{
+				wait_until_ns(due);				//Moves a simulated clock forward, hours of sampling take seconds
+				Scheduler_Poll(timestamp_ns());
+				continue;
+			}
+		}
+		else if(timer_fd >= 0)
+		{
+			struct itimerspec its;
+			uint64_t due = Scheduler_NextDue();
+			memset(&its, 0, sizeof(its));
+			if(due != NEVER)					//A zero it_value disarms the timer
+			{
+				its.it_value.tv_sec = due / 1000000000ULL;
+				its.it_value.tv_nsec = due % 1000000000ULL;
+				if(its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+				{
+					its.it_value.tv_nsec = 1;
+				}
+			}
+			timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+		}
+
+		if(poll(fds, 2, -1) < 0)
+		{
+			continue;								//EINTR
+		}
+
+		if(fds[0].revents & POLLIN)
+		{
+			uint64_t value;
+			if(read(scheduler_wake_fd, &value, sizeof(value)) < 0)
+			{
+				perror("Scheduler wake");
+			}
+			continue;
+		}
+
+		if(fds[1].revents & POLLIN)
+		{
+			uint64_t now;
+			if(timer_fd >= 0)
+			{
+				uint64_t expirations;
+				if(read(timer_fd, &expirations, sizeof(expirations)) < 0)
+				{
+					continue;
+				}
+				now = timestamp_ns();
+			}
+			else if(Timebase_HandleEvent(&now) < 0)
+			{
+				continue;
+			}
+			Scheduler_Poll(now);
+		}
+	}
+
+	if(timer_fd >= 0)
+	{
+		close(timer_fd);
+	}
+	return NULL;
+}
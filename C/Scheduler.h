@@ -0,0 +1,55 @@
+/**
+ * @file Scheduler.h
+ * @brief Header for the multi-rate sensor sampling scheduler
+ */
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+
+#define SCHEDULER_MAX_CALLBACKS	8			/*!< Number of sample callbacks that can be registered */
+#define SCHEDULER_MERGE_NS		2000000ULL	/*!< Channels due within this window of each other are read together */
+
+/**
+ * @brief Clock driving the scheduler thread.
+ */
+typedef enum {SCHEDULER_TIMERFD = 0,		/**< CLOCK_MONOTONIC timerfd armed for the next deadline */
+			  SCHEDULER_TIMEBASE			/**< RTCC square wave edges, see Timebase.h */
+} SchedulerClock_t;
+
+/**
+ * @brief Receives every batch of samples taken in one scheduler pass.
+ */
+typedef void (*SampleCallback_t)(const Sample_t *samples, unsigned int count, void *arg);
+
+/**
+ * @brief Timing statistics of one channel.
+ */
+typedef struct _SchedulerStats
+{
+	uint64_t samples;				/**< Samples delivered */
+	uint64_t deadline_misses;		/**< Samples taken more than the deadline after they were due */
+	uint64_t skipped;				/**< Periods dropped because the scheduler fell behind */
+	int64_t  max_lateness_ns;		/**< Worst delay between due time and acquisition */
+	double   interval_mean_ns;		/**< Mean spacing of consecutive samples */
+	double   interval_stddev_ns;	/**< Standard deviation of the spacing, i.e. sampling jitter */
+	int64_t  interval_min_ns;		/**< Shortest spacing seen */
+	int64_t  interval_max_ns;		/**< Longest spacing seen */
+} SchedulerStats_t;
+
+int 		Scheduler_SetRate(SensorChannel_t channel, float hz, uint32_t deadline_us);
+float 		Scheduler_GetRate(SensorChannel_t channel);
+int 		Scheduler_AddCallback(SampleCallback_t callback, void *arg);
+void 		Scheduler_RemoveCallback(int id);
+
+int 		Scheduler_Start(SchedulerClock_t clock);
+void 		Scheduler_Stop(void);
+uint64_t 	Scheduler_NextDue(void);
+unsigned int Scheduler_Poll(uint64_t now);
+
+void 		Scheduler_GetStats(SensorChannel_t channel, SchedulerStats_t *stats);
+void 		Scheduler_ResetStats(void);
+
+#endif
@@ -0,0 +1,29 @@
+/**
+ * @file SensorAcquire.h
+ * @brief Header for the per-device burst reads used by the sampler
+ */
+
+#ifndef __SENSORACQUIRE_H__
+#define __SENSORACQUIRE_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+#include "MCP79410.h"
+
+#define SEA_LEVEL_PRESSURE	101326.0f		/*!< Reference pressure in Pa for the altitude channel */
+
+/**
+ * @brief Result of reading one device, only the device's channels are written.
+ */
+typedef struct _Acquisition
+{
+	float value[SENSOR_CHANNEL_COUNT];		/**< Readings indexed by SensorChannel_t */
+	unsigned long valid;					/**< Mask of channels holding fresh readings */
+	uint64_t timestamp_ns;					/**< Midpoint of the bus transfer */
+	RTCC_Struct time;						/**< Full date and time, set by SENSOR_DEV_MCP79410 */
+} Acquisition_t;
+
+int 	Acquire_Device(SensorDevice_t device, Acquisition_t *acq);
+float 	Acquire_PressureToAltitude(float pascal);
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file SensorAsync.h
+ * @brief Header for the non-blocking request queue, whose completions are signalled on an eventfd
+ *
+ * SensorAsync_Submit queues a read of some channels and returns at once. A
+ * worker thread does the bus transfers and posts a SensorCompletion_t. The fd
+ * returned by SensorAsync_Open becomes readable whenever completions are
+ * waiting, so an event loop (poll, epoll, asyncio's add_reader) can wait for
+ * any number of requests from one thread and collect them with
+ * SensorAsync_Complete. Registering SensorAsync_Publish with
+ * Scheduler_AddCallback posts every batch of samples the same way.
+ */
+
+#ifndef __SENSORASYNC_H__
+#define __SENSORASYNC_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+
+#define SENSOR_ASYNC_QUEUE		64			/*!< Requests and completions outstanding at once, power of two */
+#define SENSOR_ASYNC_SAMPLES	0			/*!< Tag of the completions posted by SensorAsync_Publish */
+
+/**
+ * @brief Result of one request, or one batch of published samples. 208 bytes with no padding, so bindings
+ *		  can mirror it directly.
+ */
+typedef struct _SensorCompletion
+{
+	uint64_t tag;								/**< Tag given to SensorAsync_Submit, SENSOR_ASYNC_SAMPLES for samples */
+	int32_t count;								/**< Valid channels of a request, samples of a published batch */
+	uint32_t valid;								/**< Mask of the valid channels */
+	Sample_t samples[SENSOR_CHANNEL_COUNT];		/**< Indexed by channel for a request, in order for a batch */
+} SensorCompletion_t;
+
+int 		 SensorAsync_Open(void);
+void 		 SensorAsync_Close(void);
+int 		 SensorAsync_Submit(unsigned long channels, uint64_t tag);
+unsigned int SensorAsync_Complete(SensorCompletion_t *completions, unsigned int count);
+uint64_t 	 SensorAsync_Dropped(void);
+void 		 SensorAsync_Publish(const Sample_t *samples, unsigned int count, void *arg);
+
+#endif
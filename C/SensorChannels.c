@@ -0,0 +1,109 @@
+/**
+ * @file SensorChannels.c
+ * @brief Lookup tables describing the sensor channels
+ */
+
+#include "SensorChannels.h"
+
+static const SensorDevice_t channel_device[SENSOR_CHANNEL_COUNT] = {
+	SENSOR_DEV_APDS9300,		//SENSOR_LIGHT
+	SENSOR_DEV_MPL3115A2,		//SENSOR_TEMPERATURE
+	SENSOR_DEV_MPL3115A2,		//SENSOR_PRESSURE
+	SENSOR_DEV_MPL3115A2,		//SENSOR_ALTITUDE
+	SENSOR_DEV_FXOS8700CQ,		//SENSOR_ACCEL_X
+	SENSOR_DEV_FXOS8700CQ,		//SENSOR_ACCEL_Y
+	SENSOR_DEV_FXOS8700CQ,		//SENSOR_ACCEL_Z
+	SENSOR_DEV_FXOS8700CQ,		//SENSOR_MAG_X
+	SENSOR_DEV_FXOS8700CQ,		//SENSOR_MAG_Y
+	SENSOR_DEV_FXOS8700CQ,		//SENSOR_MAG_Z
+	SENSOR_DEV_CAP1203,			//SENSOR_TOUCH
+	SENSOR_DEV_MCP79410			//SENSOR_RTCC
+};
+
+static const char *channel_name[SENSOR_CHANNEL_COUNT] = {
+	"light", "temperature", "pressure", "altitude",
+	"accel_x", "accel_y", "accel_z",
+	"mag_x", "mag_y", "mag_z",
+	"touch", "rtcc"
+};
+
+static const char *device_name[SENSOR_DEVICE_COUNT] = {
+	"APDS9300", "MPL3115A2", "FXOS8700CQ", "CAP1203", "MCP79410"
+};
+
+static const char *channel_unit[SENSOR_CHANNEL_COUNT] = {
+	"lx", "C", "Pa", "m",
+	"m/s2", "m/s2", "m/s2",
+	"uT", "uT", "uT",
+	"", "s"
+};
+
+/**
+ * @brief Returns the chip a channel is read from.
+ * @param channel Channel id
+ * @return device Device id
+ */
+SensorDevice_t SensorChannel_Device(SensorChannel_t channel)
+{
+	return channel_device[channel];
+}
+
+/**
+ * @brief Returns a short lower case name for the channel, e.g. for CSV headers.
+ * @param channel Channel id
+ * @return name Channel name, "unknown" for an invalid id.
+ */
+const char* SensorChannel_Name(SensorChannel_t channel)
+{
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT)
+	{
+		return "unknown";
+	}
+	return channel_name[channel];
+}
+
+/**
+ * @brief Returns the unit symbol of the channel's values.
+ * @param channel Channel id
+ * @return unit Unit symbol, empty for unitless channels.
+ */
+const char* SensorChannel_Unit(SensorChannel_t channel)
+{
+	if((unsigned) channel >= SENSOR_CHANNEL_COUNT)
+	{
+		return "";
+	}
+	return channel_unit[channel];
+}
+
+/**
+ * @brief Returns the part number of a device, e.g. for startup reports.
+ * @param device Device id
+ * @return name Part number, "unknown" for an invalid id.
+ */
+const char* SensorDevice_Name(SensorDevice_t device)
+{
+	if((unsigned) device >= SENSOR_DEVICE_COUNT)
+	{
+		return "unknown";
+	}
+	return device_name[device];
+}
+
+/**
+ * @brief Returns the mask of all channels read from a device.
+ * @param device Device id
+ * @return mask Channel mask built with SENSOR_CHANNEL_BIT.
+ */
+unsigned long SensorDevice_Channels(SensorDevice_t device)
+{
+	unsigned long mask = 0;
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		if(channel_device[ch] == device)
+		{
+			mask |= SENSOR_CHANNEL_BIT(ch);
+		}
+	}
+	return mask;
+}
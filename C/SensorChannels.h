@@ -0,0 +1,63 @@
+/**
+ * @file SensorChannels.h
+ * @brief Channel and device identifiers shared by the sampler, snapshot and logging code
+ */
+
+#ifndef __SENSORCHANNELS_H__
+#define __SENSORCHANNELS_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Every value the shield can produce, in SI units where one exists.
+ */
+typedef enum {SENSOR_LIGHT = 0,			/**< Ambient light in lux (APDS9300) */
+			  SENSOR_TEMPERATURE,		/**< Temperature in degrees Celsius (MPL3115A2) */
+			  SENSOR_PRESSURE,			/**< Barometric pressure in Pa (MPL3115A2) */
+			  SENSOR_ALTITUDE,			/**< Altitude in m, derived from pressure (MPL3115A2) */
+			  SENSOR_ACCEL_X,			/**< Acceleration in m/s^2 (FXOS8700CQ) */
+			  SENSOR_ACCEL_Y,
+			  SENSOR_ACCEL_Z,
+			  SENSOR_MAG_X,				/**< Magnetic field in uT (FXOS8700CQ) */
+			  SENSOR_MAG_Y,
+			  SENSOR_MAG_Z,
+			  SENSOR_TOUCH,				/**< Pressed button 1-3, 0 for none (CAP1203) */
+			  SENSOR_RTCC,				/**< Seconds since midnight on the RTCC (MCP79410) */
+			  SENSOR_CHANNEL_COUNT
+} SensorChannel_t;
+
+/**
+ * @brief The chips the channels are read from. Channels of one device are read together.
+ */
+typedef enum {SENSOR_DEV_APDS9300 = 0,
+			  SENSOR_DEV_MPL3115A2,
+			  SENSOR_DEV_FXOS8700CQ,
+			  SENSOR_DEV_CAP1203,
+			  SENSOR_DEV_MCP79410,
+			  SENSOR_DEVICE_COUNT
+} SensorDevice_t;
+
+#define SENSOR_CHANNEL_BIT(ch)	(1UL << (ch))		/*!< Bit of a channel in a channel mask */
+#define SENSOR_ALL_CHANNELS		((1UL << SENSOR_CHANNEL_COUNT) - 1)
+
+#define SAMPLE_VALID	0x0001		/*!< Sample holds a fresh reading */
+#define SAMPLE_LATE		0x0002		/*!< Sample was taken after its deadline */
+
+/**
+ * @brief One timestamped reading of one channel.
+ */
+typedef struct _Sample
+{
+	uint64_t timestamp_ns;		/**< Acquisition time on the monotonic clock */
+	float value;				/**< Reading in the channel's unit */
+	uint16_t channel;			/**< SensorChannel_t */
+	uint16_t flags;				/**< SAMPLE_* flags */
+} Sample_t;
+
+SensorDevice_t 	SensorChannel_Device(SensorChannel_t channel);
+const char* 	SensorChannel_Name(SensorChannel_t channel);
+const char* 	SensorChannel_Unit(SensorChannel_t channel);
+const char* 	SensorDevice_Name(SensorDevice_t device);
+unsigned long 	SensorDevice_Channels(SensorDevice_t device);
+
+#endif
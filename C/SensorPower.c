@@ -0,0 +1,614 @@
+/**
+ * @file SensorPower.c
+ * @brief Brings each chip up the first time it is used and puts it to sleep once it has been idle.
+ *
+ * Every sensor chip is a power unit, and other units such as the TFT can be
+ * registered. SensorPower_Acquire initializes or wakes a unit and marks it in
+ * use until SensorPower_Release. SensorPower_Idle, also run every
+ * SENSOR_POWER_SWEEP_MS by SensorPower_Release, puts units that have not been
+ * used for their idle timeout into standby. A unit is never put to sleep
+ * between an acquire and its release: the acquiring thread raises the user
+ * count before it checks the state, and the idle check changes the state
+ * before it checks the user count, so one of the two always sees the other.
+ *
+ * The sensor chips of every shield context have their own power units,
+ * created on first use, and the units act on the shield bound to the calling
+ * thread. Units added with SensorPower_Register are shared.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "MPL3115A2.h"
+#include "APDS9300.h"
+#include "CAP1203.h"
+#include "FXOS8700CQ.h"
+#include "MCP79410.h"
+#include "i2c.h"
+#include "Utilities.h"
+#include "SensorPower.h"
+#include "Shield.h"
+
+#define SENSOR_READY_TIMEOUT_MS	10		//Longest wait for the APDS9300 and CAP1203 to answer
+
+/**
+ * @brief State of one power unit.
+ */
+typedef struct _PowerUnit
+{
+	const char *name;				/**< NULL for the sensor chips, which use SensorDevice_Name */
+	const SensorPowerOps_t *ops;
+	pthread_mutex_t lock;			/**< Held while the unit changes state */
+	int state;						/**< SensorPowerState_t, read without the lock */
+	int users;						/**< Acquires not released yet */
+	int keep;						/**< SensorPower_KeepAwake count */
+	uint32_t idle_ms;				/**< Idle time before standby, 0 to stay awake */
+	uint64_t last_use_ns;			/**< Last release, or the time the unit became active */
+	uint64_t failed_ns;				/**< Time of the last failed bring-up */
+} PowerUnit_t;
+
+static void mplBegin(void);
+static int mplFinish(void);
+static void mplSleep(void);
+static int mplWake(void);
+static void lightBegin(void);
+static int lightFinish(void);
+static void lightSleep(void);
+static int lightWake(void);
+static void touchBegin(void);
+static int touchFinish(void);
+static void touchSleep(void);
+static int touchWake(void);
+static void motionBegin(void);
+static int motionFinish(void);
+static void motionSleep(void);
+static int motionWake(void);
+static void rtccBegin(void);
+static int rtccFinish(void);
+static PowerUnit_t* SensorPower_Unit(int unit);
+static int SensorPower_Advance(PowerUnit_t *u, SensorPowerState_t until);
+static void SensorPower_InitBus(void);
+
+static const SensorPowerOps_t mpl_ops = {mplBegin, mplFinish, mplSleep, mplWake};
+static const SensorPowerOps_t light_ops = {lightBegin, lightFinish, lightSleep, lightWake};
+static const SensorPowerOps_t touch_ops = {touchBegin, touchFinish, touchSleep, touchWake};
+static const SensorPowerOps_t motion_ops = {motionBegin, motionFinish, motionSleep, motionWake};
+static const SensorPowerOps_t rtcc_ops = {rtccBegin, rtccFinish, NULL, NULL};	//Keeps the time, never sleeps
+
+static PowerUnit_t units[SENSOR_POWER_MAX_UNITS] = {
+	[SENSOR_DEV_APDS9300] = {NULL, &light_ops, PTHREAD_MUTEX_INITIALIZER, SENSOR_POWER_OFF, 0, 0, SENSOR_IDLE_TIMEOUT_MS, 0, 0},
+	[SENSOR_DEV_MPL3115A2] = {NULL, &mpl_ops, PTHREAD_MUTEX_INITIALIZER, SENSOR_POWER_OFF, 0, 0, SENSOR_IDLE_TIMEOUT_MS, 0, 0},
+	[SENSOR_DEV_FXOS8700CQ] = {NULL, &motion_ops, PTHREAD_MUTEX_INITIALIZER, SENSOR_POWER_OFF, 0, 0, SENSOR_IDLE_TIMEOUT_MS, 0, 0},
+	[SENSOR_DEV_CAP1203] = {NULL, &touch_ops, PTHREAD_MUTEX_INITIALIZER, SENSOR_POWER_OFF, 0, 0, SENSOR_IDLE_TIMEOUT_MS, 0, 0},
+	[SENSOR_DEV_MCP79410] = {NULL, &rtcc_ops, PTHREAD_MUTEX_INITIALIZER, SENSOR_POWER_OFF, 0, 0, 0, 0, 0},
+};
+static int unit_count = SENSOR_DEVICE_COUNT;
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;	/*!< Also guards the creation of the units of a shield */
+
+/// \defgroup power Power management
+/// These functions bring the chips up on demand and put idle ones to sleep.
+/// @{
+
+/**
+ * @brief Adds a unit managed like the sensor chips, e.g. the TFT. It starts off.
+ * @param name Name of the unit, must stay valid
+ * @param ops Bring-up, sleep and wake steps, must stay valid
+ * @param idle_ms Idle time before the unit is put to sleep, 0 to keep it awake
+ * @return unit Id to pass to the other functions, -1 when SENSOR_POWER_MAX_UNITS are in use.
+ */
+int SensorPower_Register(const char *name, const SensorPowerOps_t *ops, unsigned int idle_ms)
+{
+	int unit = -1;
+
+	pthread_mutex_lock(&register_lock);
+	if(unit_count < SENSOR_POWER_MAX_UNITS)
+	{
+		unit = unit_count;
+		PowerUnit_t *u = &units[unit];
+		u->name = name;
+		u->ops = ops;
+		pthread_mutex_init(&u->lock, NULL);
+		u->state = SENSOR_POWER_OFF;
+		u->idle_ms = idle_ms;
+		__atomic_store_n(&unit_count, unit + 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&register_lock);
+	return unit;
+}
+
+/**
+ * @brief Starts bringing a unit up without waiting for it, so several chips can get ready at the same time.
+ *		  Does nothing if the unit was already started.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @return status 0 on success, -1 for an invalid unit or one that failed less than SENSOR_POWER_RETRY_MS ago.
+ */
+int SensorPower_Begin(int unit)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return -1;
+	}
+	pthread_mutex_lock(&u->lock);
+	int status = SensorPower_Advance(u, SENSOR_POWER_STARTING);
+	pthread_mutex_unlock(&u->lock);
+	return status;
+}
+
+/**
+ * @brief Brings a unit up or wakes it and waits until it is ready.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @return status 0 once the unit is active, -1 if it did not become ready.
+ */
+int SensorPower_Finish(int unit)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return -1;
+	}
+	pthread_mutex_lock(&u->lock);
+	int status = SensorPower_Advance(u, SENSOR_POWER_ACTIVE);
+	pthread_mutex_unlock(&u->lock);
+	return status;
+}
+
+/**
+ * @brief Marks a unit in use, bringing it up or waking it first. Costs two atomic operations when the unit
+ *		  is already active. Every successful call must be paired with SensorPower_Release.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @return status 0 if the unit is active and may be used, -1 if it did not become ready.
+ */
+int SensorPower_Acquire(int unit)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return -1;
+	}
+
+	__atomic_add_fetch(&u->users, 1, __ATOMIC_SEQ_CST);		//Before the state check, see the file comment
+	if(__atomic_load_n(&u->state, __ATOMIC_SEQ_CST) == SENSOR_POWER_ACTIVE)
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&u->lock);
+	int status = SensorPower_Advance(u, SENSOR_POWER_ACTIVE);
+	pthread_mutex_unlock(&u->lock);
+	if(status != 0)
+	{
+		__atomic_sub_fetch(&u->users, 1, __ATOMIC_SEQ_CST);
+	}
+	return status;
+}
+
+/**
+ * @brief Ends a use started with SensorPower_Acquire and, at most every SENSOR_POWER_SWEEP_MS, puts the
+ *		  units that have been idle long enough to sleep.
+ * @param unit Unit passed to SensorPower_Acquire
+ * @return none
+ */
+void SensorPower_Release(int unit)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return;
+	}
+	uint64_t *last_sweep_ns = &Shield_Current()->last_sweep_ns;
+	uint64_t now = timestamp_ns();
+
+	__atomic_store_n(&u->last_use_ns, now, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&u->users, 1, __ATOMIC_SEQ_CST);
+
+	uint64_t last = __atomic_load_n(last_sweep_ns, __ATOMIC_RELAXED);
+	if(now - last >= SENSOR_POWER_SWEEP_MS * 1000000ULL &&
+	   __atomic_compare_exchange_n(last_sweep_ns, &last, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+		SensorPower_Idle(now);						//Only one thread sweeps at a time
+	}
+}
+
+/**
+ * @brief Keeps a unit awake however long it is idle, e.g. while a channel of it is sampled periodically
+ *		  and every reading must be fresh. Calls nest.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @param keep Non zero to keep the unit awake, 0 to undo one earlier call
+ * @return none
+ */
+void SensorPower_KeepAwake(int unit, int keep)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return;
+	}
+	__atomic_add_fetch(&u->keep, keep ? 1 : -1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sets how long a unit may be idle before it is put to sleep.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @param idle_ms Idle time in ms, 0 to keep the unit awake
+ * @return none
+ */
+void SensorPower_SetIdleTimeout(int unit, unsigned int idle_ms)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return;
+	}
+	__atomic_store_n(&u->idle_ms, idle_ms, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Puts every unit of the current shield that is not in use and has been idle for its idle timeout
+ *		  to sleep. Units being brought up or woken by another thread are skipped until the next call.
+ * @param now Current time from timestamp_ns
+ * @return count Number of units put to sleep.
+ */
+unsigned int SensorPower_Idle(uint64_t now)
+{
+	unsigned int count = 0;
+	int n = __atomic_load_n(&unit_count, __ATOMIC_ACQUIRE);
+
+	for(int unit = 0; unit < n; unit++)
+	{
+		PowerUnit_t *u = SensorPower_Unit(unit);
+		if(u == NULL)
+		{
+			continue;
+		}
+		uint32_t idle_ms = __atomic_load_n(&u->idle_ms, __ATOMIC_RELAXED);
+		uint64_t last = __atomic_load_n(&u->last_use_ns, __ATOMIC_RELAXED);
+
+		if(u->ops->sleep == NULL || idle_ms == 0 || __atomic_load_n(&u->keep, __ATOMIC_RELAXED) > 0 ||
+		   __atomic_load_n(&u->state, __ATOMIC_RELAXED) != SENSOR_POWER_ACTIVE ||
+		   last > now || now - last < idle_ms * 1000000ULL)
+		{
+			continue;
+		}
+		if(pthread_mutex_trylock(&u->lock) != 0)
+		{
+			continue;
+		}
+		__atomic_store_n(&u->state, SENSOR_POWER_STANDBY, __ATOMIC_SEQ_CST);	//Before the user check
+		if(__atomic_load_n(&u->users, __ATOMIC_SEQ_CST) > 0)
+		{
+			__atomic_store_n(&u->state, SENSOR_POWER_ACTIVE, __ATOMIC_SEQ_CST);
+		}
+		else
+		{
+			u->ops->sleep();
+			count++;
+		}
+		pthread_mutex_unlock(&u->lock);
+	}
+	return count;
+}
+
+/**
+ * @brief Returns the power state of a unit.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @return state SensorPowerState_t, SENSOR_POWER_OFF for an invalid unit.
+ */
+SensorPowerState_t SensorPower_State(int unit)
+{
+	PowerUnit_t *u = SensorPower_Unit(unit);
+	if(u == NULL)
+	{
+		return SENSOR_POWER_OFF;
+	}
+	return (SensorPowerState_t) __atomic_load_n(&u->state, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Returns the name of a unit.
+ * @param unit SensorDevice_t or an id from SensorPower_Register
+ * @return name Name of the unit, "?" for an invalid unit.
+ */
+const char* SensorPower_Name(int unit)
+{
+	if(unit < 0 || unit >= __atomic_load_n(&unit_count, __ATOMIC_ACQUIRE))
+	{
+		return "?";
+	}
+	return (unit < SENSOR_DEVICE_COUNT) ? SensorDevice_Name((SensorDevice_t) unit) : units[unit].name;
+}
+
+/// @}
+
+/**
+ * @brief Finds a unit: the sensor chips of the current shield, or a registered unit. The units of a shield
+ *		  other than the default one are created from the defaults on first use. NULL for an invalid unit.
+ */
+static PowerUnit_t* SensorPower_Unit(int unit)
+{
+	if(unit < 0 || unit >= __atomic_load_n(&unit_count, __ATOMIC_ACQUIRE))
+	{
+		return NULL;
+	}
+	Shield_t *shield = Shield_Current();
+	if(unit >= SENSOR_DEVICE_COUNT || shield == Shield_Default())
+	{
+		return &units[unit];
+	}
+
+	PowerUnit_t *power = __atomic_load_n(&shield->power, __ATOMIC_ACQUIRE);
+	if(power == NULL)
+	{
+		pthread_mutex_lock(&register_lock);
+		power = shield->power;
+		if(power == NULL && (power = calloc(SENSOR_DEVICE_COUNT, sizeof(PowerUnit_t))) != NULL)
+		{
+			for(int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
+			{
+				power[dev].ops = units[dev].ops;
+				pthread_mutex_init(&power[dev].lock, NULL);
+				power[dev].state = SENSOR_POWER_OFF;
+				power[dev].idle_ms = units[dev].idle_ms;
+			}
+			__atomic_store_n(&shield->power, power, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&register_lock);
+	}
+	return power ? &power[unit] : NULL;
+}
+
+/**
+ * @brief Moves a unit towards until, SENSOR_POWER_STARTING or SENSOR_POWER_ACTIVE. Called with the lock held.
+ */
+static int SensorPower_Advance(PowerUnit_t *u, SensorPowerState_t until)
+{
+	int status = 0;
+	uint64_t now = timestamp_ns();
+
+	switch(u->state)
+	{
+		case SENSOR_POWER_FAILED:
+			if(now - u->failed_ns < SENSOR_POWER_RETRY_MS * 1000000ULL)
+			{
+				return -1;							//A missing chip must not stall every read
+			}
+			//Fall through
+		case SENSOR_POWER_OFF:
+			if(u->name == NULL)						//A sensor chip, on the bus of the current shield
+			{
+				pthread_once(&Shield_Current()->bus_once, SensorPower_InitBus);
+			}
+			if(u->ops->begin)
+			{
+				u->ops->begin();
+			}
+			__atomic_store_n(&u->state, SENSOR_POWER_STARTING, __ATOMIC_RELEASE);
+			if(until == SENSOR_POWER_STARTING)
+			{
+				return 0;
+			}
+			//Fall through
+		case SENSOR_POWER_STARTING:
+			if(until == SENSOR_POWER_STARTING)
+			{
+				return 0;
+			}
+			status = u->ops->finish ? u->ops->finish() : 0;
+			break;
+		case SENSOR_POWER_STANDBY:
+			if(until == SENSOR_POWER_STARTING)
+			{
+				return 0;
+			}
+			status = u->ops->wake ? u->ops->wake() : 0;
+			break;
+		default:
+			return 0;
+	}
+
+	now = timestamp_ns();
+	if(status == 0)
+	{
+		__atomic_store_n(&u->last_use_ns, now, __ATOMIC_RELAXED);	//The idle time starts now
+		__atomic_store_n(&u->state, SENSOR_POWER_ACTIVE, __ATOMIC_SEQ_CST);
+	}
+	else
+	{
+		u->failed_ns = now;
+		__atomic_store_n(&u->state, SENSOR_POWER_FAILED, __ATOMIC_RELEASE);
+	}
+	return status;
+}
+
+/**
+ * @brief Maps the peripherals and starts the I2C bus of the current shield for the first sensor used.
+ */
+static void SensorPower_InitBus(void)
+{
+	I2C_Initialize();
+}
+
+/**
+ * @brief Ready condition of the APDS9300: it answers with its part number
+ */
+static unsigned char lightReady(void)
+{
+	return (AL_ChipID() & 0xF0) == APDS9300_PARTNO;
+}
+
+/**
+ * @brief Ready condition of the CAP1203: it answers with its product ID
+ */
+static unsigned char touchReady(void)
+{
+	return CAP1203_Read(PRODUCT_ID) == CAP1203_PRODUCT_ID;
+}
+
+/**
+ * @brief Ready condition after stopping the RTCC oscillator: OSCRUN has cleared
+ */
+static unsigned char rtccStopped(void)
+{
+	return !MCP79410_IsRunning();
+}
+
+/**
+ * @brief Starts the MPL3115A2 in barometer mode with OS_128, its first conversion takes 512 ms
+ */
+static void mplBegin(void)
+{
+	MPL3115A2_Initialize();
+	MPL3115A2_ActiveMode();
+}
+
+/**
+ * @brief Waits until the MPL3115A2 reports active mode
+ */
+static int mplFinish(void)
+{
+	return poll_ready(MPL3115A2_IsActive, MPL_ACTIVE_TIMEOUT_MS);
+}
+
+/**
+ * @brief Stops the MPL3115A2 conversions
+ */
+static void mplSleep(void)
+{
+	MPL3115A2_StandbyMode();
+}
+
+/**
+ * @brief Restarts the MPL3115A2 conversions
+ */
+static int mplWake(void)
+{
+	MPL3115A2_ActiveMode();
+	return mplFinish();
+}
+
+/**
+ * @brief Powers the APDS9300 on with gain 16 and the 402 ms integration time
+ */
+static void lightBegin(void)
+{
+	AL_Initialize();
+	AL_SetGain(GAIN_16);
+	AL_SetSamplingTime(S3);
+	AL_Clear_Interrupt();
+}
+
+/**
+ * @brief Waits until the APDS9300 answers
+ */
+static int lightFinish(void)
+{
+	return poll_ready(lightReady, SENSOR_READY_TIMEOUT_MS);
+}
+
+/**
+ * @brief Powers the APDS9300 off, it keeps its configuration
+ */
+static void lightSleep(void)
+{
+	AL_PowerState(POWER_OFF);
+}
+
+/**
+ * @brief Powers the APDS9300 back on
+ */
+static int lightWake(void)
+{
+	AL_PowerState(POWER_ON);
+	return 0;
+}
+
+/**
+ * @brief Configures the CAP1203 inputs and sampling
+ */
+static void touchBegin(void)
+{
+	CAP1203_Initialize();
+}
+
+/**
+ * @brief Waits until the CAP1203 answers
+ */
+static int touchFinish(void)
+{
+	return poll_ready(touchReady, SENSOR_READY_TIMEOUT_MS);
+}
+
+/**
+ * @brief Puts the CAP1203 in deep sleep, where it stops sensing
+ */
+static void touchSleep(void)
+{
+	CAP1203_DeepSleep();
+}
+
+/**
+ * @brief Resumes sensing on the CAP1203
+ */
+static int touchWake(void)
+{
+	CAP1203_ResumeFromDeepSleep();
+	return 0;
+}
+
+/**
+ * @brief Reboots the FXOS8700CQ, which takes about a millisecond
+ */
+static void motionBegin(void)
+{
+	FXOS8700CQ_Reset();
+}
+
+/**
+ * @brief Waits for the end of the FXOS8700CQ reboot, then configures and activates it
+ */
+static int motionFinish(void)
+{
+	int status = poll_ready(FXOS8700CQ_IsReady, FXOS_RESET_TIMEOUT_MS);
+	FXOS8700CQ_Configure();
+	FXOS8700CQ_ActiveMode();
+	return status;
+}
+
+/**
+ * @brief Puts the FXOS8700CQ in standby, it keeps its configuration
+ */
+static void motionSleep(void)
+{
+	FXOS8700CQ_StandbyMode();
+}
+
+/**
+ * @brief Makes the FXOS8700CQ active again
+ */
+static int motionWake(void)
+{
+	FXOS8700CQ_ActiveMode();
+	return 0;
+}
+
+/**
+ * @brief Stops the RTCC oscillator, sets the system time and starts it again
+ */
+static void rtccBegin(void)
+{
+	if(MCP79410_IsRunning())				//The time can only be set with the oscillator stopped
+	{
+		MCP79410_DisableOscillator();
+		poll_ready(rtccStopped, RTCC_STOP_TIMEOUT_MS);
+	}
+	MCP79410_Initialize();
+}
+
+/**
+ * @brief Waits until the RTCC oscillator runs
+ */
+static int rtccFinish(void)
+{
+	return poll_ready(MCP79410_IsRunning, RTCC_START_TIMEOUT_MS);
+}
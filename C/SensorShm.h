@@ -0,0 +1,49 @@
+/**
+ * @file SensorShm.h
+ * @brief Header for the shared memory segment through which one sampler process publishes to many readers
+ */
+
+#ifndef __SENSORSHM_H__
+#define __SENSORSHM_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+#include "SensorsInterface.h"
+#include "Seqlock.h"
+
+#define SENSOR_SHM_NAME		"/sensorian"	/*!< POSIX shared memory object, /dev/shm/sensorian */
+#define SENSOR_SHM_MAGIC	0x534E5353		/*!< "SSNS", set once the segment is initialized */
+#define SENSOR_SHM_VERSION	1				/*!< Bumped whenever the layout below changes */
+#define SENSOR_SHM_HISTORY	1024			/*!< Samples kept in the history, power of two */
+
+/**
+ * @brief Layout of the shared segment. Everything after the header is only written between
+ *		  Seqlock_WriteBegin and Seqlock_WriteEnd by the single publishing process.
+ */
+typedef struct _SensorShm
+{
+	uint32_t magic;						/**< SENSOR_SHM_MAGIC */
+	uint32_t version;					/**< SENSOR_SHM_VERSION */
+	uint32_t size;						/**< sizeof(SensorShm_t) of the publisher */
+	uint32_t writer_pid;				/**< Process id of the publisher */
+	Seqlock_t lock;						/**< Guards everything below */
+	uint32_t history_len;				/**< SENSOR_SHM_HISTORY */
+	uint64_t publish_count;				/**< Incremented on every publish, cheap change detection */
+	uint64_t history_head;				/**< Samples appended since creation, history[head % len] is next */
+	SensorSnapshot_t latest;			/**< Latest reading of every channel */
+	Sample_t history[SENSOR_SHM_HISTORY];	/**< Most recent samples of all channels in arrival order */
+} SensorShm_t;
+
+int 		 SensorShm_Create(void);
+void 		 SensorShm_Destroy(void);
+void 		 SensorShm_Publish(const Sample_t *samples, unsigned int count, void *arg);
+void 		 SensorShm_PublishSnapshot(const SensorSnapshot_t *snapshot);
+
+int 		 SensorShm_Attach(void);
+void 		 SensorShm_Detach(void);
+uint64_t 	 SensorShm_PublishCount(void);
+int 		 SensorShm_ReadSnapshot(SensorSnapshot_t *snapshot);
+int 		 SensorShm_ReadChannel(SensorChannel_t channel, SensorReading_t *reading);
+int 		 SensorShm_ReadHistory(uint64_t *cursor, Sample_t *samples, unsigned int count);
+
+#endif
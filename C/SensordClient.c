@@ -0,0 +1,297 @@
+/**
+ * @file SensordClient.c
+ * @brief Talks to sensoriand, which owns the sensors, the TFT and the bus.
+ *
+ * A client only opens a Unix socket: it does not link the drivers and does
+ * not run setupSensorian, so it starts instantly and any number of them can
+ * run beside the daemon. The fd returned by Sensord_Connect can be added to
+ * a poll set and becomes readable when samples arrive.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "SensordClient.h"
+
+#define SNAPSHOT_TIMEOUT_MS	1000
+
+static int Sensord_Send(int fd, SensordMsgType_t type, const void *payload, uint16_t length);
+static int Sensord_Receive(int fd, SensordHeader_t *header, void *payload, size_t size, int timeout_ms);
+
+/// \defgroup sensordclient Sensor Daemon Client
+/// These functions read the sensors and draw on the TFT through sensoriand.
+/// @{
+
+/**
+ * @brief Connects to the daemon and checks its protocol version.
+ * @param path Socket path, NULL for SENSORD_SOCKET
+ * @return fd Connected socket, -1 on error.
+ */
+int Sensord_Connect(const char *path)
+{
+	struct sockaddr_un addr;
+	SensordHeader_t header;
+	SensordHello_t hello;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path ? path : SENSORD_SOCKET, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+	{
+		return -1;
+	}
+	if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	   Sensord_Receive(fd, &header, &hello, sizeof(hello), SNAPSHOT_TIMEOUT_MS) != (int) sizeof(hello) ||
+	   header.type != SENSORD_MSG_HELLO)
+	{
+		close(fd);
+		return -1;
+	}
+	if(hello.version != SENSORD_VERSION || hello.channel_count != SENSOR_CHANNEL_COUNT)
+	{
+		printf("Sensord: daemon speaks version %u with %u channels.\n", hello.version, hello.channel_count);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * @brief Disconnects. The daemon drops the subscriptions of this connection.
+ * @param fd Socket from Sensord_Connect
+ * @return none
+ */
+void Sensord_Close(int fd)
+{
+	if(fd >= 0)
+	{
+		close(fd);
+	}
+}
+
+/**
+ * @brief Subscribes to channels, replacing the rate of channels already subscribed. The daemon samples
+ *		  each channel at the highest rate any client asked for and decimates for the slower ones.
+ * @param fd Socket from Sensord_Connect
+ * @param channels Channel mask, see SENSOR_CHANNEL_BIT
+ * @param hz Samples per second for each channel
+ * @return status 0 if the request was sent, -1 on error.
+ */
+int Sensord_Subscribe(int fd, unsigned long channels, float hz)
+{
+	SensordSubscribe_t sub = {.channels = (uint32_t) channels, .hz = hz};
+	return Sensord_Send(fd, SENSORD_MSG_SUBSCRIBE, &sub, sizeof(sub));
+}
+
+/**
+ * @brief Stops the samples of channels.
+ * @param fd Socket from Sensord_Connect
+ * @param channels Channel mask
+ * @return status 0 if the request was sent, -1 on error.
+ */
+int Sensord_Unsubscribe(int fd, unsigned long channels)
+{
+	SensordSubscribe_t sub = {.channels = (uint32_t) channels, .hz = 0.0f};
+	return Sensord_Send(fd, SENSORD_MSG_UNSUBSCRIBE, &sub, sizeof(sub));
+}
+
+/**
+ * @brief Gets the latest reading of channels from the daemon without waiting for the bus.
+ *		  Samples that arrive while waiting for the reply are discarded, so use a separate
+ *		  connection for snapshots if this one has subscriptions.
+ * @param fd Socket from Sensord_Connect
+ * @param channels Channel mask
+ * @param snapshot Structure to fill
+ * @return count Number of valid channels, -1 on error.
+ */
+int Sensord_Snapshot(int fd, unsigned long channels, SensorSnapshot_t *snapshot)
+{
+	SensordSubscribe_t req = {.channels = (uint32_t) channels, .hz = 0.0f};
+	SensordHeader_t header;
+	char payload[SENSORD_MAX_MSG];
+
+	if(Sensord_Send(fd, SENSORD_MSG_SNAPSHOT_REQ, &req, sizeof(req)) < 0)
+	{
+		return -1;
+	}
+	for(;;)
+	{
+		int length = Sensord_Receive(fd, &header, payload, sizeof(payload), SNAPSHOT_TIMEOUT_MS);
+		if(length < 0 || header.type == SENSORD_MSG_ERROR)
+		{
+			return -1;
+		}
+		if(header.type == SENSORD_MSG_SNAPSHOT && length == (int) sizeof(*snapshot))
+		{
+			break;
+		}
+	}
+
+	memcpy(snapshot, payload, sizeof(*snapshot));
+	int count = 0;
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		count += (snapshot->valid >> ch) & 1;
+	}
+	return count;
+}
+
+/**
+ * @brief Receives the next batch of subscribed samples. A batch holds up to SENSORD_MAX_SAMPLES samples,
+ *		  any beyond count are discarded.
+ * @param fd Socket from Sensord_Connect
+ * @param samples Buffer to fill
+ * @param count Size of the buffer in samples
+ * @param timeout_ms Longest wait, -1 waits forever and 0 only checks.
+ * @return count Number of samples received, 0 on timeout, -1 on error or if the daemon went away.
+ */
+int Sensord_ReadSamples(int fd, Sample_t *samples, unsigned int count, int timeout_ms)
+{
+	SensordHeader_t header;
+	Sample_t payload[SENSORD_MAX_SAMPLES];
+
+	for(;;)
+	{
+		int length = Sensord_Receive(fd, &header, payload, sizeof(payload), timeout_ms);
+		if(length < 0)
+		{
+			return (errno == ETIMEDOUT) ? 0 : -1;
+		}
+		if(header.type == SENSORD_MSG_ERROR)
+		{
+			printf("Sensord: request %u failed with %d.\n", header.request_id, ((SensordError_t *) payload)->code);
+			continue;
+		}
+		if(header.type != SENSORD_MSG_SAMPLES)
+		{
+			continue;							//Late snapshot reply
+		}
+
+		unsigned int n = (length < (int) sizeof(payload) ? length : (int) sizeof(payload)) / sizeof(Sample_t);
+		if(n > count)
+		{
+			n = count;
+		}
+		memcpy(samples, payload, n * sizeof(Sample_t));
+		return n;
+	}
+}
+
+/**
+ * @brief Queues a screen clear on the daemon's TFT.
+ * @param fd Socket from Sensord_Connect
+ * @param color RGB565 fill color
+ * @return status 0 if the request was sent, -1 on error.
+ */
+int Sensord_TFTClear(int fd, uint16_t color)
+{
+	SensordTFT_t draw = {.op = SENSORD_TFT_CLEAR, .color = color};
+	return Sensord_Send(fd, SENSORD_MSG_TFT, &draw, offsetof(SensordTFT_t, text));
+}
+
+/**
+ * @brief Queues a string drawn at a position on the daemon's TFT.
+ * @param fd Socket from Sensord_Connect
+ * @param x Column in pixels
+ * @param y Row in pixels
+ * @param color RGB565 text color
+ * @param background RGB565 background color
+ * @param text String, cut at SENSORD_TEXT_MAX - 1 characters
+ * @param size Font size
+ * @return status 0 if the request was sent, -1 on error.
+ */
+int Sensord_TFTText(int fd, uint8_t x, uint8_t y, uint16_t color, uint16_t background, const char *text, uint8_t size)
+{
+	SensordTFT_t draw = {.op = SENSORD_TFT_TEXT, .x = x, .y = y, .size = size, .color = color, .background = background};
+	strncpy(draw.text, text, SENSORD_TEXT_MAX - 1);
+	return Sensord_Send(fd, SENSORD_MSG_TFT, &draw, offsetof(SensordTFT_t, text) + strlen(draw.text) + 1);
+}
+
+/**
+ * @brief Queues one pixel on the daemon's TFT.
+ * @param fd Socket from Sensord_Connect
+ * @param x Column in pixels
+ * @param y Row in pixels
+ * @param color RGB565 color
+ * @return status 0 if the request was sent, -1 on error.
+ */
+int Sensord_TFTPixel(int fd, uint8_t x, uint8_t y, uint16_t color)
+{
+	SensordTFT_t draw = {.op = SENSORD_TFT_PIXEL, .x = x, .y = y, .color = color};
+	return Sensord_Send(fd, SENSORD_MSG_TFT, &draw, offsetof(SensordTFT_t, text));
+}
+
+/**
+ * @brief Queues a message wrapped to fit the whole screen, like TFT_Printer_PrintBoth.
+ * @param fd Socket from Sensord_Connect
+ * @param color RGB565 text color
+ * @param background RGB565 background color
+ * @param text String, cut at SENSORD_TEXT_MAX - 1 characters
+ * @param size Font size
+ * @return status 0 if the request was sent, -1 on error.
+ */
+int Sensord_TFTPrint(int fd, uint16_t color, uint16_t background, const char *text, uint8_t size)
+{
+	SensordTFT_t draw = {.op = SENSORD_TFT_PRINT, .size = size, .color = color, .background = background};
+	strncpy(draw.text, text, SENSORD_TEXT_MAX - 1);
+	return Sensord_Send(fd, SENSORD_MSG_TFT, &draw, offsetof(SensordTFT_t, text) + strlen(draw.text) + 1);
+}
+
+/// @}
+
+/**
+ * @brief Sends one request packet.
+ */
+static int Sensord_Send(int fd, SensordMsgType_t type, const void *payload, uint16_t length)
+{
+	static uint32_t request_id = 0;
+	char packet[SENSORD_MAX_MSG];
+	SensordHeader_t header = {.type = type, .length = length, .request_id = ++request_id};
+
+	memcpy(packet, &header, sizeof(header));
+	memcpy(packet + sizeof(header), payload, length);
+	return (send(fd, packet, sizeof(header) + length, MSG_NOSIGNAL) < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Receives one packet and splits it into header and payload, copying at most size payload bytes.
+ * @return length Payload bytes in the packet, -1 on error with errno set to ETIMEDOUT on timeout.
+ */
+static int Sensord_Receive(int fd, SensordHeader_t *header, void *payload, size_t size, int timeout_ms)
+{
+	char packet[SENSORD_MAX_MSG];
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+	int ready = poll(&pfd, 1, timeout_ms);
+	if(ready <= 0)
+	{
+		if(ready == 0)
+		{
+			errno = ETIMEDOUT;
+		}
+		return -1;
+	}
+
+	ssize_t n = recv(fd, packet, sizeof(packet), 0);
+	if(n < (ssize_t) sizeof(*header))
+	{
+		errno = (n == 0) ? ECONNRESET : errno;
+		return -1;
+	}
+	memcpy(header, packet, sizeof(*header));
+	if(header->length > n - sizeof(*header))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+	memcpy(payload, packet + sizeof(*header), (header->length < size) ? header->length : size);
+	return header->length;
+}
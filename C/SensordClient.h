@@ -0,0 +1,25 @@
+/**
+ * @file SensordClient.h
+ * @brief Header for the client side of the sensoriand protocol. Clients never touch the bus.
+ */
+
+#ifndef __SENSORDCLIENT_H__
+#define __SENSORDCLIENT_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+#include "SensorsInterface.h"
+#include "SensordProtocol.h"
+
+int 	Sensord_Connect(const char *path);
+void 	Sensord_Close(int fd);
+int 	Sensord_Subscribe(int fd, unsigned long channels, float hz);
+int 	Sensord_Unsubscribe(int fd, unsigned long channels);
+int 	Sensord_Snapshot(int fd, unsigned long channels, SensorSnapshot_t *snapshot);
+int 	Sensord_ReadSamples(int fd, Sample_t *samples, unsigned int count, int timeout_ms);
+int 	Sensord_TFTClear(int fd, uint16_t color);
+int 	Sensord_TFTText(int fd, uint8_t x, uint8_t y, uint16_t color, uint16_t background, const char *text, uint8_t size);
+int 	Sensord_TFTPixel(int fd, uint8_t x, uint8_t y, uint16_t color);
+int 	Sensord_TFTPrint(int fd, uint16_t color, uint16_t background, const char *text, uint8_t size);
+
+#endif
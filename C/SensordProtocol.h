@@ -0,0 +1,94 @@
+/**
+ * @file SensordProtocol.h
+ * @brief Messages exchanged between sensoriand and its clients over a SOCK_SEQPACKET Unix socket
+ *
+ * Every message is one packet made of a SensordHeader_t followed by length bytes of payload, so no
+ * framing is needed. Both ends run on the same host and share the struct layouts below.
+ */
+
+#ifndef __SENSORDPROTOCOL_H__
+#define __SENSORDPROTOCOL_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+
+#define SENSORD_SOCKET		"/var/run/sensoriand.sock"	/*!< Default socket path */
+#define SENSORD_VERSION		1							/*!< Bumped whenever a message layout changes */
+#define SENSORD_MAX_MSG		4096						/*!< Largest packet either side sends */
+#define SENSORD_TEXT_MAX	128							/*!< Longest TFT string including the terminator */
+
+/**
+ * @brief Message types. Requests go from client to daemon, the rest from daemon to client.
+ */
+typedef enum {SENSORD_MSG_HELLO = 1,		/**< SensordHello_t, sent by the daemon on accept */
+			  SENSORD_MSG_SUBSCRIBE,		/**< Request, SensordSubscribe_t */
+			  SENSORD_MSG_UNSUBSCRIBE,		/**< Request, SensordSubscribe_t, hz is ignored */
+			  SENSORD_MSG_SNAPSHOT_REQ,		/**< Request, SensordSubscribe_t, hz is ignored */
+			  SENSORD_MSG_SNAPSHOT,			/**< Reply, SensorSnapshot_t */
+			  SENSORD_MSG_SAMPLES,			/**< Sample_t array, one per subscribed sample */
+			  SENSORD_MSG_TFT,				/**< Request, SensordTFT_t with the text trimmed to its length */
+			  SENSORD_MSG_ERROR				/**< Reply, SensordError_t for a request that failed */
+} SensordMsgType_t;
+
+/**
+ * @brief TFT operations queued by SENSORD_MSG_TFT.
+ */
+typedef enum {SENSORD_TFT_CLEAR = 0,		/**< Fill the screen with color */
+			  SENSORD_TFT_TEXT,				/**< TFT_PrintString at x, y */
+			  SENSORD_TFT_PIXEL,			/**< TFT_SetPixel at x, y */
+			  SENSORD_TFT_PRINT				/**< TFT_Printer_PrintBoth, wrapped to the whole screen */
+} SensordTFTOp_t;
+
+/**
+ * @brief Starts every packet.
+ */
+typedef struct _SensordHeader
+{
+	uint16_t type;				/**< SensordMsgType_t */
+	uint16_t length;			/**< Payload bytes after the header */
+	uint32_t request_id;		/**< Chosen by the client, echoed in the reply */
+} SensordHeader_t;
+
+/**
+ * @brief Payload of SENSORD_MSG_HELLO.
+ */
+typedef struct _SensordHello
+{
+	uint32_t version;			/**< SENSORD_VERSION of the daemon */
+	uint32_t channel_count;		/**< SENSOR_CHANNEL_COUNT of the daemon */
+} SensordHello_t;
+
+/**
+ * @brief Payload of the subscription and snapshot requests.
+ */
+typedef struct _SensordSubscribe
+{
+	uint32_t channels;			/**< Channel mask, see SENSOR_CHANNEL_BIT */
+	float hz;					/**< Samples per second wanted for each channel */
+} SensordSubscribe_t;
+
+/**
+ * @brief Payload of SENSORD_MSG_TFT.
+ */
+typedef struct _SensordTFT
+{
+	uint8_t op;					/**< SensordTFTOp_t */
+	uint8_t x;					/**< Column in pixels */
+	uint8_t y;					/**< Row in pixels */
+	uint8_t size;				/**< Font size */
+	uint16_t color;				/**< RGB565 foreground */
+	uint16_t background;		/**< RGB565 background */
+	char text[SENSORD_TEXT_MAX];	/**< Zero terminated string for TEXT and PRINT */
+} SensordTFT_t;
+
+/**
+ * @brief Payload of SENSORD_MSG_ERROR.
+ */
+typedef struct _SensordError
+{
+	int32_t code;				/**< Negative errno value */
+} SensordError_t;
+
+#define SENSORD_MAX_SAMPLES	((SENSORD_MAX_MSG - sizeof(SensordHeader_t)) / sizeof(Sample_t))	/*!< Per packet */
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file Seqlock.h
+ * @brief Sequence lock for state written by one thread and read by many without blocking.
+ *
+ * The writer makes the sequence odd while it updates the data and even again
+ * when done. Readers copy the data and retry if the sequence was odd or
+ * changed meanwhile, so they never wait on a lock and never return a torn copy.
+ * Writers must be serialized by the caller.
+ */
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Sequence counter, even when the protected data is stable.
+ */
+typedef struct _Seqlock
+{
+	uint32_t sequence;
+} Seqlock_t;
+
+#define SEQLOCK_INIT	{0}
+
+/**
+ * @brief Tells the core that it is spinning on the sequence.
+ * @return none
+ */
+static inline void Seqlock_Pause(void)
+{
+#if defined(__arm__) || defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#elif defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#endif
+}
+
+/**
+ * @brief Marks the start of an update.
+ * @param lock Sequence lock
+ * @return none
+ */
+static inline void Seqlock_WriteBegin(Seqlock_t *lock)
+{
+	uint32_t seq = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&lock->sequence, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);		//Odd sequence is visible before any data store
+}
+
+/**
+ * @brief Marks the end of an update and publishes the data.
+ * @param lock Sequence lock
+ * @return none
+ */
+static inline void Seqlock_WriteEnd(Seqlock_t *lock)
+{
+	uint32_t seq = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&lock->sequence, seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Starts a read, waiting out an update that is in progress.
+ * @param lock Sequence lock
+ * @return seq Sequence to hand to Seqlock_ReadRetry
+ */
+static inline uint32_t Seqlock_ReadBegin(const Seqlock_t *lock)
+{
+	uint32_t seq;
+	while((seq = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE)) & 1)
+	{
+		Seqlock_Pause();
+	}
+	return seq;
+}
+
+/**
+ * @brief Starts a read like Seqlock_ReadBegin, but gives up on an update that takes longer than
+ *		  a number of spins, for a writer in another process that may die in the middle of it.
+ * @param lock Sequence lock
+ * @param spins Number of times to check the sequence at most
+ * @param seq Filled with the sequence to hand to Seqlock_ReadRetry
+ * @return status 0 on success, -1 if the update was still in progress.
+ */
+static inline int Seqlock_TryReadBegin(const Seqlock_t *lock, unsigned int spins, uint32_t *seq)
+{
+	while((*seq = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE)) & 1)
+	{
+		if(spins-- == 0)
+		{
+			return -1;
+		}
+		Seqlock_Pause();
+	}
+	return 0;
+}
+
+/**
+ * @brief Checks whether the data copied since Seqlock_ReadBegin may be torn.
+ * @param lock Sequence lock
+ * @param seq Value returned by Seqlock_ReadBegin
+ * @return retry Non-zero if the copy must be repeated.
+ */
+static inline int Seqlock_ReadRetry(const Seqlock_t *lock, uint32_t seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);		//Data loads complete before the sequence is checked
+	return __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED) != seq;
+}
+
+#endif
@@ -0,0 +1,766 @@
+/**
+ * @file SeriesLog.c
+ * @brief Compressed columnar sample log with a memory-mapped, chunk skipping reader.
+ *
+ * Every sample of a column is a timestamp followed by a value in one bit
+ * stream, most significant bit first:
+ *
+ * Timestamp, in units of the file's resolution. The first one is stored in
+ * 64 bits, the others as the change of the delta to the previous sample:
+ *   '0'                 delta of delta is 0
+ *   '10'   + 7 bits     -64 .. 63
+ *   '110'  + 12 bits    -2048 .. 2047
+ *   '1110' + 20 bits    -524288 .. 524287
+ *   '1111' + 64 bits    anything else
+ *
+ * Value, IEEE float bits XORed with the previous value. The first one is
+ * stored in 32 bits, the others as:
+ *   '0'                 same value
+ *   '10' + bits         XOR fits the previous leading/trailing zero window
+ *   '11' + 5 bits leading zeros + 5 bits length - 1 + length bits
+ *
+ * Regularly sampled, slowly changing channels cost a couple of bits per
+ * timestamp and a few bits per value.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "SeriesLog.h"
+
+#define MAX_SAMPLE_BITS		112			//4 + 64 timestamp bits and 2 + 10 + 32 value bits
+#define COLUMN_BUFFER		(8 + (SERIESLOG_COLUMN_SAMPLES * MAX_SAMPLE_BITS) / 8 + 8)
+#define NO_WINDOW			0xFF
+
+/**
+ * @brief Position in a column bit stream being decoded.
+ */
+typedef struct _BitReader
+{
+	const uint8_t *buffer;
+	uint32_t bit;
+	uint32_t limit;				/**< Bits in the stream */
+	int overrun;				/**< Set when a read went past limit */
+} BitReader_t;
+
+static void 	 putBits(SeriesLogEncoder_t *enc, uint64_t value, unsigned int n);
+static uint64_t  getBits(BitReader_t *reader, unsigned int n);
+static void 	 encodeSample(SeriesLogEncoder_t *enc, uint64_t t, float value);
+static int 		 decodeColumn(const SeriesLogReader_t *log, const uint8_t *chunk, uint32_t chunk_size,
+						  const SeriesLogColumn_t *col, Sample_t *samples);
+static off_t 	 validLength(int fd, off_t size);
+static uint32_t  floatBits(float value);
+static float 	 bitsFloat(uint32_t bits);
+
+/// \defgroup serieslog Series Log
+/// These functions store samples compactly on disk and query them by time.
+/// @{
+
+/**
+ * @brief Opens a log for appending, creating it if needed. A chunk cut short by a power loss is removed.
+ * @param log Writer to initialize
+ * @param path File name
+ * @param resolution_ns Timestamp resolution for a new file, 0 for SERIESLOG_RESOLUTION_NS.
+ *		  An existing file keeps its own.
+ * @return status 0 on success, -1 on error.
+ */
+int SeriesLogWriter_Open(SeriesLogWriter_t *log, const char *path, uint32_t resolution_ns)
+{
+	SeriesLogFile_t header;
+	struct stat st;
+
+	memset(log, 0, sizeof(*log));
+	log->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if(log->fd < 0 || fstat(log->fd, &st) < 0)
+	{
+		perror("SeriesLog open");
+		if(log->fd >= 0)
+		{
+			close(log->fd);
+		}
+		return -1;
+	}
+
+	if(st.st_size == 0)
+	{
+		memcpy(header.magic, SERIESLOG_MAGIC, sizeof(header.magic));
+		header.version = SERIESLOG_VERSION;
+		header.resolution_ns = resolution_ns ? resolution_ns : SERIESLOG_RESOLUTION_NS;
+		if(write(log->fd, &header, sizeof(header)) != sizeof(header))
+		{
+			close(log->fd);
+			return -1;
+		}
+		log->bytes = sizeof(header);
+	}
+	else
+	{
+		if(pread(log->fd, &header, sizeof(header), 0) != sizeof(header) ||
+		   memcmp(header.magic, SERIESLOG_MAGIC, sizeof(header.magic)) != 0 ||
+		   header.version != SERIESLOG_VERSION || header.resolution_ns == 0)
+		{
+			printf("SeriesLog: %s is not a version %d log.\n", path, SERIESLOG_VERSION);
+			close(log->fd);
+			return -1;
+		}
+		off_t valid = validLength(log->fd, st.st_size);
+		if(valid != st.st_size && ftruncate(log->fd, valid) < 0)
+		{
+			close(log->fd);
+			return -1;
+		}
+	}
+
+	log->resolution_ns = header.resolution_ns;
+	log->flush_ns = SERIESLOG_FLUSH_NS;
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		log->column[ch].buffer = calloc(1, COLUMN_BUFFER);
+		log->column[ch].leading = NO_WINDOW;
+		if(log->column[ch].buffer == NULL)
+		{
+			SeriesLogWriter_Close(log);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Appends samples. Samples without SAMPLE_VALID are skipped, the other flags are not stored.
+ *		  Complete chunks are written as they fill up.
+ * @param log Open writer
+ * @param samples Samples in time order per channel
+ * @param count Number of samples
+ * @return status 0 on success, -1 if a chunk could not be written.
+ */
+int SeriesLogWriter_Append(SeriesLogWriter_t *log, const Sample_t *samples, unsigned int count)
+{
+	for(unsigned int i = 0; i < count; i++)
+	{
+		const Sample_t *s = &samples[i];
+		if(s->channel >= SENSOR_CHANNEL_COUNT || (s->flags & SAMPLE_VALID) == 0)
+		{
+			continue;
+		}
+
+		if(log->chunk_samples == 0)
+		{
+			log->chunk_start = s->timestamp_ns;
+		}
+		else if(s->timestamp_ns > log->chunk_start + log->flush_ns)
+		{
+			if(SeriesLogWriter_Flush(log) < 0)
+			{
+				return -1;
+			}
+			log->chunk_start = s->timestamp_ns;
+		}
+
+		SeriesLogEncoder_t *enc = &log->column[s->channel];
+		encodeSample(enc, s->timestamp_ns / log->resolution_ns, s->value);
+		log->chunk_samples++;
+		log->samples++;
+		if(enc->count == SERIESLOG_COLUMN_SAMPLES && SeriesLogWriter_Flush(log) < 0)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Writes the open chunk with a single system call and starts a new one.
+ * @param log Open writer
+ * @return status 0 on success, -1 on error.
+ */
+int SeriesLogWriter_Flush(SeriesLogWriter_t *log)
+{
+	struct
+	{
+		SeriesLogChunk_t chunk;
+		SeriesLogColumn_t column[SENSOR_CHANNEL_COUNT];
+	} header;
+	struct iovec iov[SENSOR_CHANNEL_COUNT + 2];
+	static const uint8_t padding[8] = {0};
+	int n = 0;
+
+	if(log->chunk_samples == 0)
+	{
+		return 0;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.chunk.magic = SERIESLOG_CHUNK_MAGIC;
+	header.chunk.t_min = UINT64_MAX;
+	header.chunk.samples = log->chunk_samples;
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		if(log->column[ch].count)
+		{
+			header.chunk.columns++;
+		}
+	}
+
+	uint32_t offset = sizeof(SeriesLogChunk_t) + header.chunk.columns * sizeof(SeriesLogColumn_t);
+	iov[n].iov_base = &header;
+	iov[n++].iov_len = offset;
+	for(int ch = 0, c = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		SeriesLogEncoder_t *enc = &log->column[ch];
+		if(enc->count == 0)
+		{
+			continue;
+		}
+		SeriesLogColumn_t *col = &header.column[c++];
+		col->channel = ch;
+		col->count = enc->count;
+		col->t_first = enc->t_first * log->resolution_ns;
+		col->t_last = enc->t_last * log->resolution_ns;
+		col->min = enc->min;
+		col->max = enc->max;
+		col->offset = offset;
+		col->bytes = (enc->bits + 7) / 8;
+		offset += col->bytes;
+		header.chunk.t_min = (col->t_first < header.chunk.t_min) ? col->t_first : header.chunk.t_min;
+		header.chunk.t_max = (col->t_last > header.chunk.t_max) ? col->t_last : header.chunk.t_max;
+		iov[n].iov_base = enc->buffer;
+		iov[n++].iov_len = col->bytes;
+	}
+	header.chunk.size = (offset + 7) & ~7U;		//Keeps every chunk header 8 byte aligned in the mapping
+	iov[n].iov_base = (void *) padding;
+	iov[n++].iov_len = header.chunk.size - offset;
+
+	ssize_t written = writev(log->fd, iov, n);
+
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		SeriesLogEncoder_t *enc = &log->column[ch];
+		memset(enc->buffer, 0, (enc->bits + 7) / 8);
+		enc->bits = 0;
+		enc->count = 0;
+		enc->leading = NO_WINDOW;
+	}
+	log->chunk_samples = 0;
+
+	if(written != (ssize_t) header.chunk.size)
+	{
+		perror("SeriesLog write");
+		return -1;
+	}
+	log->bytes += written;
+	return 0;
+}
+
+/**
+ * @brief Writes the open chunk and closes the file.
+ * @param log Open writer
+ * @return status 0 on success, -1 if the last chunk could not be written.
+ */
+int SeriesLogWriter_Close(SeriesLogWriter_t *log)
+{
+	int status = 0;
+
+	if(log->fd >= 0)
+	{
+		status = SeriesLogWriter_Flush(log);
+		close(log->fd);
+		log->fd = -1;
+	}
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		free(log->column[ch].buffer);
+		log->column[ch].buffer = NULL;
+	}
+	return status;
+}
+
+/**
+ * @brief SampleCallback_t that appends every batch to a log: Scheduler_AddCallback(SeriesLogWriter_Callback, &log).
+ * @param samples Samples of one scheduler pass
+ * @param count Number of samples
+ * @param log SeriesLogWriter_t to append to
+ * @return none
+ */
+void SeriesLogWriter_Callback(const Sample_t *samples, unsigned int count, void *log)
+{
+	SeriesLogWriter_Append((SeriesLogWriter_t *) log, samples, count);
+}
+
+/**
+ * @brief Maps a log for reading.
+ * @param log Reader to initialize
+ * @param path File name
+ * @return status 0 on success, -1 on error.
+ */
+int SeriesLogReader_Open(SeriesLogReader_t *log, const char *path)
+{
+	SeriesLogFile_t header;
+	struct stat st;
+
+	memset(log, 0, sizeof(*log));
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0 || fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(header))
+	{
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+		return -1;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	memcpy(&header, map, sizeof(header));
+	if(memcmp(header.magic, SERIESLOG_MAGIC, sizeof(header.magic)) != 0 ||
+	   header.version != SERIESLOG_VERSION || header.resolution_ns == 0)
+	{
+		munmap(map, st.st_size);
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_RANDOM);		//Queries jump between chunks, read-ahead would fetch skipped ones
+	log->map = map;
+	log->size = st.st_size;
+	log->resolution_ns = header.resolution_ns;
+	return 0;
+}
+
+/**
+ * @brief Unmaps a log.
+ * @param log Open reader
+ * @return none
+ */
+void SeriesLogReader_Close(SeriesLogReader_t *log)
+{
+	if(log->map)
+	{
+		munmap((void *) log->map, log->size);
+		log->map = NULL;
+	}
+}
+
+/**
+ * @brief Decodes the samples of some channels within a time range. Chunks and columns outside the range
+ *		  are skipped from their headers, so their pages are never touched.
+ * @param log Open reader
+ * @param channels Channel mask, see SENSOR_CHANNEL_BIT
+ * @param t_from First timestamp wanted in ns
+ * @param t_to Last timestamp wanted in ns
+ * @param visitor Called with the matching samples of each column, chunk by chunk
+ * @param arg User pointer handed to the visitor
+ * @return count Number of samples visited, -1 if a chunk is corrupt.
+ */
+int64_t SeriesLogReader_Query(SeriesLogReader_t *log, unsigned long channels, uint64_t t_from, uint64_t t_to,
+							  SeriesLogVisitor_t visitor, void *arg)
+{
+	Sample_t samples[SERIESLOG_COLUMN_SAMPLES];
+	SeriesLogChunk_t chunk;
+	SeriesLogColumn_t col;
+	int64_t visited = 0;
+	size_t pos = sizeof(SeriesLogFile_t);
+
+	while(pos + sizeof(chunk) <= log->size)
+	{
+		const uint8_t *base = log->map + pos;
+		memcpy(&chunk, base, sizeof(chunk));
+		if(chunk.magic != SERIESLOG_CHUNK_MAGIC || chunk.size < sizeof(chunk) || chunk.size > log->size - pos)
+		{
+			break;								//End of the valid data
+		}
+		if(chunk.columns > (chunk.size - sizeof(chunk)) / sizeof(col))	//Column headers past the chunk
+		{
+			return -1;
+		}
+		pos += chunk.size;
+		if(chunk.t_max < t_from || chunk.t_min > t_to)
+		{
+			log->chunks_skipped++;
+			continue;
+		}
+
+		int decoded = 0;
+		for(uint32_t c = 0; c < chunk.columns; c++)
+		{
+			memcpy(&col, base + sizeof(chunk) + c * sizeof(col), sizeof(col));
+			if(col.channel >= SENSOR_CHANNEL_COUNT || (channels & SENSOR_CHANNEL_BIT(col.channel)) == 0 ||
+			   col.t_last < t_from || col.t_first > t_to)
+			{
+				continue;
+			}
+
+			int count = decodeColumn(log, base, chunk.size, &col, samples);
+			if(count < 0)
+			{
+				return -1;
+			}
+			decoded = 1;
+
+			int first = 0;
+			while(first < count && samples[first].timestamp_ns < t_from)
+			{
+				first++;
+			}
+			int last = count;
+			while(last > first && samples[last - 1].timestamp_ns > t_to)
+			{
+				last--;
+			}
+			if(last > first)
+			{
+				visited += last - first;
+				if(visitor && visitor(&samples[first], last - first, arg))
+				{
+					log->chunks_decoded++;
+					return visited;
+				}
+			}
+		}
+		if(decoded)
+		{
+			log->chunks_decoded++;
+		}
+		else
+		{
+			log->chunks_skipped++;
+		}
+	}
+	return visited;
+}
+
+/**
+ * @brief Computes count, min and max of a channel over a time range. Columns entirely inside the range
+ *		  are answered from their headers, only columns straddling the range ends are decoded.
+ * @param log Open reader
+ * @param channel Channel to summarize
+ * @param t_from First timestamp in ns
+ * @param t_to Last timestamp in ns
+ * @param summary Structure to fill
+ * @return status 0 if the range holds samples, -1 otherwise or if a chunk or column is corrupt.
+ */
+int SeriesLogReader_Summary(SeriesLogReader_t *log, SensorChannel_t channel, uint64_t t_from, uint64_t t_to,
+							SeriesLogSummary_t *summary)
+{
+	Sample_t samples[SERIESLOG_COLUMN_SAMPLES];
+	SeriesLogChunk_t chunk;
+	SeriesLogColumn_t col;
+	size_t pos = sizeof(SeriesLogFile_t);
+
+	memset(summary, 0, sizeof(*summary));
+	while(pos + sizeof(chunk) <= log->size)
+	{
+		const uint8_t *base = log->map + pos;
+		memcpy(&chunk, base, sizeof(chunk));
+		if(chunk.magic != SERIESLOG_CHUNK_MAGIC || chunk.size < sizeof(chunk) || chunk.size > log->size - pos)
+		{
+			break;
+		}
+		if(chunk.columns > (chunk.size - sizeof(chunk)) / sizeof(col))
+		{
+			return -1;
+		}
+		pos += chunk.size;
+		if(chunk.t_max < t_from || chunk.t_min > t_to)
+		{
+			log->chunks_skipped++;
+			continue;
+		}
+
+		for(uint32_t c = 0; c < chunk.columns; c++)
+		{
+			memcpy(&col, base + sizeof(chunk) + c * sizeof(col), sizeof(col));
+			if(col.channel != channel || col.t_last < t_from || col.t_first > t_to)
+			{
+				continue;
+			}
+
+			if(col.t_first >= t_from && col.t_last <= t_to)	//Whole column, the header is enough
+			{
+				if(summary->count == 0 || col.min < summary->min) summary->min = col.min;
+				if(summary->count == 0 || col.max > summary->max) summary->max = col.max;
+				if(summary->count == 0) summary->t_first = col.t_first;
+				summary->t_last = col.t_last;
+				summary->count += col.count;
+				continue;
+			}
+
+			int count = decodeColumn(log, base, chunk.size, &col, samples);
+			if(count < 0)
+			{
+				return -1;
+			}
+			log->chunks_decoded++;
+			for(int i = 0; i < count; i++)
+			{
+				if(samples[i].timestamp_ns < t_from || samples[i].timestamp_ns > t_to)
+				{
+					continue;
+				}
+				if(summary->count == 0 || samples[i].value < summary->min) summary->min = samples[i].value;
+				if(summary->count == 0 || samples[i].value > summary->max) summary->max = samples[i].value;
+				if(summary->count == 0) summary->t_first = samples[i].timestamp_ns;
+				summary->t_last = samples[i].timestamp_ns;
+				summary->count++;
+			}
+		}
+	}
+	return summary->count ? 0 : -1;
+}
+
+/// @}
+
+/**
+ * @brief Appends the n low bits of value to the stream, most significant first.
+ */
+static void putBits(SeriesLogEncoder_t *enc, uint64_t value, unsigned int n)
+{
+	while(n > 0)
+	{
+		unsigned int room = 8 - (enc->bits & 7);
+		unsigned int take = (n < room) ? n : room;
+		uint8_t part = (uint8_t)((value >> (n - take)) & ((1U << take) - 1));
+		enc->buffer[enc->bits >> 3] |= part << (room - take);
+		enc->bits += take;
+		n -= take;
+	}
+}
+
+/**
+ * @brief Reads n bits from the stream, most significant first.
+ */
+static uint64_t getBits(BitReader_t *reader, unsigned int n)
+{
+	uint64_t value = 0;
+
+	if(reader->bit + n > reader->limit)
+	{
+		reader->overrun = 1;
+		return 0;
+	}
+	while(n > 0)
+	{
+		unsigned int room = 8 - (reader->bit & 7);
+		unsigned int take = (n < room) ? n : room;
+		uint8_t part = (reader->buffer[reader->bit >> 3] >> (room - take)) & ((1U << take) - 1);
+		value = (value << take) | part;
+		reader->bit += take;
+		n -= take;
+	}
+	return value;
+}
+
+/**
+ * @brief Sign extends the n low bits of value.
+ */
+static int64_t signExtend(uint64_t value, unsigned int n)
+{
+	uint64_t sign = 1ULL << (n - 1);
+	return (int64_t)((value ^ sign) - sign);
+}
+
+/**
+ * @brief Appends one timestamp and value to a column.
+ */
+static void encodeSample(SeriesLogEncoder_t *enc, uint64_t t, float value)
+{
+	uint32_t bits = floatBits(value);
+
+	if(enc->count == 0)
+	{
+		putBits(enc, t, 64);
+		putBits(enc, bits, 32);
+		enc->t_first = t;
+		enc->delta = 0;
+		enc->min = value;
+		enc->max = value;
+	}
+	else
+	{
+		int64_t delta = (int64_t)(t - enc->t_last);
+		int64_t dod = delta - enc->delta;
+		enc->delta = delta;
+		if(dod == 0)
+		{
+			putBits(enc, 0x0, 1);
+		}
+		else if(dod >= -64 && dod <= 63)
+		{
+			putBits(enc, 0x2, 2);
+			putBits(enc, (uint64_t) dod, 7);
+		}
+		else if(dod >= -2048 && dod <= 2047)
+		{
+			putBits(enc, 0x6, 3);
+			putBits(enc, (uint64_t) dod, 12);
+		}
+		else if(dod >= -524288 && dod <= 524287)
+		{
+			putBits(enc, 0xE, 4);
+			putBits(enc, (uint64_t) dod, 20);
+		}
+		else
+		{
+			putBits(enc, 0xF, 4);
+			putBits(enc, (uint64_t) dod, 64);
+		}
+
+		uint32_t xor = bits ^ enc->value;
+		if(xor == 0)
+		{
+			putBits(enc, 0x0, 1);
+		}
+		else
+		{
+			unsigned int leading = __builtin_clz(xor);
+			unsigned int trailing = __builtin_ctz(xor);
+			if(leading > 31)
+			{
+				leading = 31;
+			}
+			if(enc->leading != NO_WINDOW && leading >= enc->leading && trailing >= enc->trailing)
+			{
+				putBits(enc, 0x2, 2);
+				putBits(enc, xor >> enc->trailing, 32 - enc->leading - enc->trailing);
+			}
+			else
+			{
+				unsigned int length = 32 - leading - trailing;
+				putBits(enc, 0x3, 2);
+				putBits(enc, leading, 5);
+				putBits(enc, length - 1, 5);
+				putBits(enc, xor >> trailing, length);
+				enc->leading = leading;
+				enc->trailing = trailing;
+			}
+		}
+		if(value < enc->min) enc->min = value;
+		if(value > enc->max) enc->max = value;
+	}
+	enc->t_last = t;
+	enc->value = bits;
+	enc->count++;
+}
+
+/**
+ * @brief Decodes one column of a mapped chunk.
+ * @return count Number of samples, -1 if the column is corrupt.
+ */
+static int decodeColumn(const SeriesLogReader_t *log, const uint8_t *chunk, uint32_t chunk_size,
+						const SeriesLogColumn_t *col, Sample_t *samples)
+{
+	if(col->count > SERIESLOG_COLUMN_SAMPLES || col->offset > chunk_size || col->bytes > chunk_size - col->offset)
+	{
+		return -1;
+	}
+
+	BitReader_t reader = {.buffer = chunk + col->offset, .bit = 0, .limit = col->bytes * 8, .overrun = 0};
+	uint64_t t = 0;
+	int64_t delta = 0;
+	uint32_t bits = 0;
+	unsigned int leading = 0, trailing = 0;
+
+	for(uint32_t i = 0; i < col->count; i++)
+	{
+		if(i == 0)
+		{
+			t = getBits(&reader, 64);
+			bits = (uint32_t) getBits(&reader, 32);
+		}
+		else
+		{
+			int64_t dod;
+			if(getBits(&reader, 1) == 0)
+			{
+				dod = 0;
+			}
+			else if(getBits(&reader, 1) == 0)
+			{
+				dod = signExtend(getBits(&reader, 7), 7);
+			}
+			else if(getBits(&reader, 1) == 0)
+			{
+				dod = signExtend(getBits(&reader, 12), 12);
+			}
+			else if(getBits(&reader, 1) == 0)
+			{
+				dod = signExtend(getBits(&reader, 20), 20);
+			}
+			else
+			{
+				dod = (int64_t) getBits(&reader, 64);
+			}
+			delta = (int64_t)((uint64_t) delta + (uint64_t) dod);	//Wraps instead of overflowing on a corrupt column
+			t += delta;
+
+			if(getBits(&reader, 1))
+			{
+				if(getBits(&reader, 1))
+				{
+					leading = (unsigned int) getBits(&reader, 5);
+					unsigned int length = (unsigned int) getBits(&reader, 5) + 1;
+					if(leading + length > 32)		//The writer never emits this, the column is corrupt
+					{
+						return -1;
+					}
+					trailing = 32 - leading - length;
+				}
+				bits ^= (uint32_t) getBits(&reader, 32 - leading - trailing) << trailing;
+			}
+		}
+		if(reader.overrun)
+		{
+			return -1;
+		}
+		samples[i].timestamp_ns = t * log->resolution_ns;
+		samples[i].value = bitsFloat(bits);
+		samples[i].channel = col->channel;
+		samples[i].flags = SAMPLE_VALID;
+	}
+	return col->count;
+}
+
+/**
+ * @brief Walks the chunk headers of a file to find where the valid data ends.
+ */
+static off_t validLength(int fd, off_t size)
+{
+	SeriesLogChunk_t chunk;
+	off_t pos = sizeof(SeriesLogFile_t);
+
+	while(pos + (off_t) sizeof(chunk) <= size &&
+		  pread(fd, &chunk, sizeof(chunk), pos) == sizeof(chunk) &&
+		  chunk.magic == SERIESLOG_CHUNK_MAGIC && chunk.size >= sizeof(chunk) && chunk.size <= size - pos)
+	{
+		pos += chunk.size;
+	}
+	return pos;
+}
+
+/**
+ * @brief Returns the bit pattern of a float.
+ */
+static uint32_t floatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/**
+ * @brief Returns the float with a bit pattern.
+ */
+static float bitsFloat(uint32_t bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
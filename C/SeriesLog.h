@@ -0,0 +1,139 @@
+/**
+ * @file SeriesLog.h
+ * @brief Header for the compressed columnar sample log and its memory-mapped reader
+ *
+ * A log file is a SeriesLogFile_t header followed by append-only chunks. A
+ * chunk holds one column per channel: Gorilla style delta-of-delta
+ * timestamps and XOR compressed float values, with count, time span and
+ * min/max in the column header so queries can skip whole chunks and columns.
+ */
+
+#ifndef __SERIESLOG_H__
+#define __SERIESLOG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SensorChannels.h"
+
+#define SERIESLOG_MAGIC			"SNSLOG01"			/*!< First 8 bytes of a log file */
+#define SERIESLOG_VERSION		1
+#define SERIESLOG_CHUNK_MAGIC	0x4B4E4843			/*!< "CHNK" */
+#define SERIESLOG_COLUMN_SAMPLES	1024			/*!< A chunk is closed when a column holds this many samples */
+#define SERIESLOG_FLUSH_NS		60000000000ULL		/*!< or when it spans this long, bounding the loss on power cuts */
+#define SERIESLOG_RESOLUTION_NS	1000				/*!< Default timestamp resolution, 1 us */
+
+/**
+ * @brief File header.
+ */
+typedef struct _SeriesLogFile
+{
+	char magic[8];					/**< SERIESLOG_MAGIC */
+	uint32_t version;				/**< SERIESLOG_VERSION */
+	uint32_t resolution_ns;			/**< Timestamps are stored in multiples of this */
+} SeriesLogFile_t;
+
+/**
+ * @brief Chunk header, followed by columns column headers and the column data. size is a multiple of 8.
+ */
+typedef struct _SeriesLogChunk
+{
+	uint32_t magic;					/**< SERIESLOG_CHUNK_MAGIC */
+	uint32_t size;					/**< Bytes from this header to the next chunk */
+	uint64_t t_min;					/**< Earliest timestamp in the chunk */
+	uint64_t t_max;					/**< Latest timestamp in the chunk */
+	uint32_t columns;				/**< Number of SeriesLogColumn_t that follow */
+	uint32_t samples;				/**< Samples in all columns */
+} SeriesLogChunk_t;
+
+/**
+ * @brief Column header, one channel of one chunk.
+ */
+typedef struct _SeriesLogColumn
+{
+	uint16_t channel;				/**< SensorChannel_t */
+	uint16_t reserved;
+	uint32_t count;					/**< Samples in the column */
+	uint64_t t_first;				/**< Timestamp of the first sample */
+	uint64_t t_last;				/**< Timestamp of the last sample */
+	float min;						/**< Smallest value */
+	float max;						/**< Largest value */
+	uint32_t offset;				/**< Start of the bit stream from the chunk header */
+	uint32_t bytes;					/**< Length of the bit stream */
+} SeriesLogColumn_t;
+
+/**
+ * @brief Compression state of one channel while its chunk is open.
+ */
+typedef struct _SeriesLogEncoder
+{
+	uint8_t *buffer;				/**< Bit stream */
+	uint32_t bits;					/**< Bits written */
+	uint32_t count;					/**< Samples written */
+	uint64_t t_first;				/**< First timestamp in resolution units */
+	uint64_t t_last;				/**< Previous timestamp in resolution units */
+	int64_t delta;					/**< Previous timestamp delta */
+	uint32_t value;					/**< Previous value bits */
+	uint8_t leading;				/**< Leading zeros of the current XOR window, 0xFF when unset */
+	uint8_t trailing;				/**< Trailing zeros of the current XOR window */
+	float min;
+	float max;
+} SeriesLogEncoder_t;
+
+/**
+ * @brief An open log being appended to.
+ */
+typedef struct _SeriesLogWriter
+{
+	int fd;
+	uint32_t resolution_ns;
+	uint64_t flush_ns;				/**< Longest span of an open chunk, SERIESLOG_FLUSH_NS by default */
+	uint64_t chunk_start;			/**< Earliest timestamp of the open chunk in ns */
+	uint32_t chunk_samples;			/**< Samples in the open chunk */
+	uint64_t samples;				/**< Samples appended since SeriesLogWriter_Open */
+	uint64_t bytes;					/**< Bytes written since SeriesLogWriter_Open */
+	SeriesLogEncoder_t column[SENSOR_CHANNEL_COUNT];
+} SeriesLogWriter_t;
+
+/**
+ * @brief A log mapped for reading.
+ */
+typedef struct _SeriesLogReader
+{
+	const uint8_t *map;
+	size_t size;
+	uint32_t resolution_ns;
+	uint64_t chunks_decoded;		/**< Chunks with at least one column decoded by queries */
+	uint64_t chunks_skipped;		/**< Chunks skipped from their header alone */
+} SeriesLogReader_t;
+
+/**
+ * @brief Aggregate of one channel over a time range.
+ */
+typedef struct _SeriesLogSummary
+{
+	uint64_t count;
+	float min;
+	float max;
+	uint64_t t_first;
+	uint64_t t_last;
+} SeriesLogSummary_t;
+
+/**
+ * @brief Receives decoded samples of one column in time order, returning non-zero stops the query.
+ */
+typedef int (*SeriesLogVisitor_t)(const Sample_t *samples, unsigned int count, void *arg);
+
+int 	SeriesLogWriter_Open(SeriesLogWriter_t *log, const char *path, uint32_t resolution_ns);
+int 	SeriesLogWriter_Append(SeriesLogWriter_t *log, const Sample_t *samples, unsigned int count);
+int 	SeriesLogWriter_Flush(SeriesLogWriter_t *log);
+int 	SeriesLogWriter_Close(SeriesLogWriter_t *log);
+void 	SeriesLogWriter_Callback(const Sample_t *samples, unsigned int count, void *log);
+
+int 	SeriesLogReader_Open(SeriesLogReader_t *log, const char *path);
+void 	SeriesLogReader_Close(SeriesLogReader_t *log);
+int64_t SeriesLogReader_Query(SeriesLogReader_t *log, unsigned long channels, uint64_t t_from, uint64_t t_to,
+							  SeriesLogVisitor_t visitor, void *arg);
+int 	SeriesLogReader_Summary(SeriesLogReader_t *log, SensorChannel_t channel, uint64_t t_from, uint64_t t_to,
+								SeriesLogSummary_t *summary);
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file SeriesLog2CSV.c
+ * @brief Converts a SeriesLog file, or a time range of it, to CSV on standard output
+ *
+ * Usage: ./SeriesLog2CSV log [from_ns [to_ns [channel ...]]]
+ * Channels are given by name, e.g. accel_x temperature. All channels are converted by default.
+ * Rows come chunk by chunk and channel by channel, each channel in time order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SeriesLog.h"
+
+/**
+ * @brief Prints one column of decoded samples.
+ */
+static int printSamples(const Sample_t *samples, unsigned int count, void *arg)
+{
+	for(unsigned int i = 0; i < count; i++)
+	{
+		printf("%llu,%s,%.9g,%s\n", (unsigned long long) samples[i].timestamp_ns,
+			   SensorChannel_Name(samples[i].channel), samples[i].value, SensorChannel_Unit(samples[i].channel));
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	SeriesLogReader_t log;
+	uint64_t from = 0, to = UINT64_MAX;
+	unsigned long channels = 0;
+
+	if(argc < 2)
+	{
+		printf("Usage: %s log [from_ns [to_ns [channel ...]]]\n", argv[0]);
+		return 1;
+	}
+	if(argc > 2) from = strtoull(argv[2], NULL, 0);
+	if(argc > 3) to = strtoull(argv[3], NULL, 0);
+	for(int a = 4; a < argc; a++)
+	{
+		int ch;
+		for(ch = 0; ch < SENSOR_CHANNEL_COUNT && strcmp(argv[a], SensorChannel_Name(ch)) != 0; ch++);
+		if(ch == SENSOR_CHANNEL_COUNT)
+		{
+			printf("Unknown channel %s\n", argv[a]);
+			return 1;
+		}
+		channels |= SENSOR_CHANNEL_BIT(ch);
+	}
+	if(channels == 0)
+	{
+		channels = SENSOR_ALL_CHANNELS;
+	}
+
+	if(SeriesLogReader_Open(&log, argv[1]) != 0)
+	{
+		printf("Could not read %s\n", argv[1]);
+		return 1;
+	}
+	printf("timestamp_ns,channel,value,unit\n");
+	int64_t count = SeriesLogReader_Query(&log, channels, from, to, printSamples, NULL);
+	SeriesLogReader_Close(&log);
+	if(count < 0)
+	{
+		fprintf(stderr, "%s is corrupt after the last sample printed.\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
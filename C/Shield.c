@@ -0,0 +1,218 @@
+/**
+ * @file Shield.c
+ * @brief Shield contexts and the thread binding the drivers use to find theirs.
+ *
+ * The drivers address their chips with the fixed addresses of the Sensorian
+ * shield. i2c.c sends every transfer on the transport of the shield bound to
+ * the calling thread, translated through Shield_Address, so the drivers
+ * themselves are shared by all the shields. A thread that never binds a shield
+ * uses the default one, which is how the flat API keeps working unchanged.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "MPL3115A2.h"
+#include "APDS9300.h"
+#include "CAP1203.h"
+#include "Shield.h"
+
+static const uint8_t default_address[SENSOR_DEVICE_COUNT] = {
+	[SENSOR_DEV_APDS9300] = APDS9300ADDR,
+	[SENSOR_DEV_MPL3115A2] = MPL3115A2_ADDRESS,
+	[SENSOR_DEV_FXOS8700CQ] = FXOS8700CQ_ADDRESS,
+	[SENSOR_DEV_CAP1203] = CAP1203ADDR,
+	[SENSOR_DEV_MCP79410] = MCP79410_ADDRESS,
+};
+
+static Shield_t default_shield = {
+	.bus = SHIELD_BUS_BCM2835,
+	.adapter = SHIELD_DEFAULT_ADAPTER,
+	.fd = -1,
+	.address = {
+		[SENSOR_DEV_APDS9300] = APDS9300ADDR,
+		[SENSOR_DEV_MPL3115A2] = MPL3115A2_ADDRESS,
+		[SENSOR_DEV_FXOS8700CQ] = FXOS8700CQ_ADDRESS,
+		[SENSOR_DEV_CAP1203] = CAP1203ADDR,
+		[SENSOR_DEV_MCP79410] = MCP79410_ADDRESS,
+	},
+	.bus_lock = PTHREAD_MUTEX_INITIALIZER,
+	.bus_once = PTHREAD_ONCE_INIT,
+	.state_lock = SEQLOCK_INIT,
+	.writer_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static __thread Shield_t *bound_shield = NULL;	/*!< Shield of the calling thread, NULL for the default one */
+
+/// \defgroup shield Shield contexts
+/// These functions create shields and choose the one the drivers act on.
+/// @{
+
+/**
+ * @brief Sets up a shield with the addresses of the Sensorian chips. Nothing is sent on the bus, every chip
+ *		  is brought up on first use like on the default shield.
+ * @param shield Shield to set up
+ * @param bus SHIELD_BUS_I2C_DEV for a kernel adapter, SHIELD_BUS_BCM2835 for the bcm2835 controller, which
+ *		  it then shares with the default shield
+ * @param adapter N of /dev/i2c-N, ignored for SHIELD_BUS_BCM2835
+ * @return status 0 on success, -1 if the adapter cannot be opened.
+ */
+int Shield_Open(Shield_t *shield, ShieldBus_t bus, int adapter)
+{
+	pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	memset(shield, 0, sizeof(*shield));
+	shield->bus = bus;
+	shield->adapter = adapter;
+	shield->fd = -1;
+	memcpy(shield->address, default_address, sizeof(shield->address));
+	pthread_mutex_init(&shield->bus_lock, NULL);
+	pthread_mutex_init(&shield->writer_lock, NULL);
+	shield->bus_once = once;
+	if(bus == SHIELD_BUS_I2C_DEV)
+	{
+		char path[32];
+		snprintf(path, sizeof(path), "/dev/i2c-%d", adapter);
+		shield->fd = open(path, O_RDWR | O_CLOEXEC);
+		if(shield->fd < 0)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Releases a shield opened with Shield_Open. No thread may use it any more.
+ * @param shield Shield to close
+ * @return none
+ */
+void Shield_Close(Shield_t *shield)
+{
+	if(shield == &default_shield)
+	{
+		return;
+	}
+	if(shield->fd >= 0)
+	{
+		close(shield->fd);
+		shield->fd = -1;
+	}
+	free(shield->power);					//calloc'ed by SensorPower.c
+	shield->power = NULL;
+	pthread_mutex_destroy(&shield->bus_lock);
+	pthread_mutex_destroy(&shield->writer_lock);
+}
+
+/**
+ * @brief Changes the I2C address of a chip, e.g. for a board with an address pin strapped differently.
+ * @param shield Shield to change
+ * @param device Chip to move
+ * @param address 7 bit I2C address
+ * @return none
+ */
+void Shield_SetAddress(Shield_t *shield, SensorDevice_t device, uint8_t address)
+{
+	if(device < SENSOR_DEVICE_COUNT)
+	{
+		shield->address[device] = address;
+	}
+}
+
+/**
+ * @brief Returns the shield used by threads that have not bound one, the shield on the bcm2835 bus.
+ * @return shield The default shield.
+ */
+Shield_t* Shield_Default(void)
+{
+	return &default_shield;
+}
+
+/**
+ * @brief Makes the drivers and the flat API act on a shield for the calling thread.
+ * @param shield Shield to use, NULL for the default one
+ * @return previous Shield bound before, NULL for the default one, to restore it with a second call.
+ */
+Shield_t* Shield_Bind(Shield_t *shield)
+{
+	Shield_t *previous = bound_shield;
+
+	bound_shield = (shield == &default_shield) ? NULL : shield;
+	return previous;
+}
+
+/**
+ * @brief Returns the shield the calling thread acts on.
+ * @return shield The bound shield, else the default one.
+ */
+Shield_t* Shield_Current(void)
+{
+	return bound_shield ? bound_shield : &default_shield;
+}
+
+/**
+ * @brief Translates the fixed address a driver uses into the address of that chip on a shield.
+ * @param shield Shield the transfer goes to
+ * @param address Address used by the driver
+ * @return address Address of the chip on the shield, the same address if it is not one of the sensor chips.
+ */
+uint8_t Shield_Address(const Shield_t *shield, uint8_t address)
+{
+	for(int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
+	{
+		if(default_address[dev] == address)
+		{
+			return shield->address[dev];
+		}
+	}
+	return address;
+}
+
+/**
+ * @brief Runs setupSensorianFast on a shield.
+ * @param shield Shield to set up
+ * @param flags SETUP_WAIT_DATA to also wait for the first conversion of every sensor
+ * @param report Receives the time each chip took to become ready, may be NULL
+ * @return status 0 if every chip became ready, -1 otherwise.
+ */
+int Shield_Setup(Shield_t *shield, unsigned int flags, SetupReport_t *report)
+{
+	Shield_t *previous = Shield_Bind(shield);
+	int status = setupSensorianFast(NULL, flags, report);
+	Shield_Bind(previous);
+	return status;
+}
+
+/**
+ * @brief Runs getSnapshotChannels on a shield.
+ * @param shield Shield to read
+ * @param snapshot Structure to fill
+ * @param channels Mask of channels to read, built with SENSOR_CHANNEL_BIT
+ * @return count Number of valid channels.
+ */
+int Shield_Snapshot(Shield_t *shield, SensorSnapshot_t *snapshot, unsigned long channels)
+{
+	Shield_t *previous = Shield_Bind(shield);
+	int count = getSnapshotChannels(snapshot, channels);
+	Shield_Bind(previous);
+	return count;
+}
+
+/**
+ * @brief Runs getLatestSnapshot on a shield, without touching its bus.
+ * @param shield Shield to read
+ * @param snapshot Structure to fill
+ * @return count Number of valid channels.
+ */
+int Shield_LatestSnapshot(Shield_t *shield, SensorSnapshot_t *snapshot)
+{
+	Shield_t *previous = Shield_Bind(shield);
+	int count = getLatestSnapshot(snapshot);
+	Shield_Bind(previous);
+	return count;
+}
+
+/// @}
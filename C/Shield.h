@@ -0,0 +1,86 @@
+/**
+ * @file Shield.h
+ * @brief Header for the shield contexts, which let one process drive several shields on several I2C buses
+ *
+ * A Shield_t owns the transport of its I2C traffic, either the bcm2835 I2C
+ * controller or a /dev/i2c-N adapter, the addresses of its chips, the power
+ * state of the chips and the latest readings. The drivers and the flat API of
+ * SensorsInterface.h act on the shield bound to the calling thread with
+ * Shield_Bind, or on the default shield, which is the bcm2835 bus, if none is
+ * bound. Shields on different buses are polled in parallel by giving each one
+ * its own thread:
+ *
+ *     Shield_Open(&second, SHIELD_BUS_I2C_DEV, 3);	//On a thread of its own
+ *     Shield_Bind(&second);
+ *     getSnapshot(&snapshot);
+ *
+ * or without binding, with Shield_Snapshot(&second, &snapshot, channels).
+ * The TFT, the LED and the scheduler stay on the default shield.
+ */
+
+#ifndef __SHIELD_H__
+#define __SHIELD_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "SensorChannels.h"
+#include "SensorsInterface.h"
+#include "FXOS8700CQ.h"
+#include "MCP79410.h"
+#include "Seqlock.h"
+
+#define SHIELD_DEFAULT_ADAPTER	1		/*!< /dev/i2c-1 is the header I2C bus of the Raspberry Pi */
+
+/**
+ * @brief Transport of the I2C traffic of a shield.
+ */
+typedef enum {SHIELD_BUS_BCM2835 = 0,	/**< The bcm2835 I2C controller through libbcm2835, one per process */
+			  SHIELD_BUS_I2C_DEV		/**< A /dev/i2c-N adapter of the kernel, e.g. a second bus or a USB bridge */
+} ShieldBus_t;
+
+/**
+ * @brief Readings shared between the thread that polls a shield and the threads calling the getters.
+ */
+typedef struct _ShieldState
+{
+	float mpl_temperature;							/**< Last temperature polled from the MPL3115A2 */
+	float mpl_altitude;								/**< Last altitude polled from the MPL3115A2 */
+	float mpl_pressure;								/**< Last barometric pressure polled from the MPL3115A2 */
+	rawdata_t magnetometer;							/**< Last polled magnetometer data */
+	rawdata_t accelerometer;						/**< Last polled accelerometer data */
+	RTCC_Struct current_time;						/**< Last polled date and time */
+	SensorReading_t latest[SENSOR_CHANNEL_COUNT];	/**< Latest reading of every channel published by the sampler */
+	uint32_t latest_valid;							/**< Mask of channels that have been published at least once */
+} ShieldState_t;
+
+/**
+ * @brief One shield and everything the library keeps about it.
+ */
+typedef struct _Shield
+{
+	ShieldBus_t bus;								/**< Transport of the I2C traffic */
+	int adapter;									/**< N of /dev/i2c-N with SHIELD_BUS_I2C_DEV */
+	int fd;											/**< Open /dev/i2c-N, -1 while closed */
+	uint8_t address[SENSOR_DEVICE_COUNT];			/**< I2C address of each chip */
+	pthread_mutex_t bus_lock;						/**< Serializes the transfers on an i2c-dev adapter */
+	pthread_once_t bus_once;						/**< Starts the bus for the first chip used */
+	ShieldState_t state;							/**< Only written between Seqlock_WriteBegin and Seqlock_WriteEnd */
+	Seqlock_t state_lock;							/**< Lets the getters read without blocking */
+	pthread_mutex_t writer_lock;					/**< Serializes the writers of the state only */
+	struct _PowerUnit *power;						/**< Power state of the chips, allocated by SensorPower.c */
+	uint64_t last_sweep_ns;							/**< Last idle check of the chips */
+} Shield_t;
+
+int 		Shield_Open(Shield_t *shield, ShieldBus_t bus, int adapter);
+void 		Shield_Close(Shield_t *shield);
+void 		Shield_SetAddress(Shield_t *shield, SensorDevice_t device, uint8_t address);
+Shield_t* 	Shield_Default(void);
+Shield_t* 	Shield_Bind(Shield_t *shield);
+Shield_t* 	Shield_Current(void);
+uint8_t 	Shield_Address(const Shield_t *shield, uint8_t address);
+
+int 		Shield_Setup(Shield_t *shield, unsigned int flags, SetupReport_t *report);
+int 		Shield_Snapshot(Shield_t *shield, SensorSnapshot_t *snapshot, unsigned long channels);
+int 		Shield_LatestSnapshot(Shield_t *shield, SensorSnapshot_t *snapshot);
+
+#endif
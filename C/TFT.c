@@ -10,6 +10,65 @@
 #include "TFT.h"
 #include "SPI.h"
 #include "Font.h"
+#include "Utilities.h"
+
+static unsigned char stream_buffer[TFT_STREAM_BUFFER];	/*!< Run of bytes waiting to be sent with one transfer */
+static unsigned int stream_length = 0;
+static int stream_depth = 0;		/*!< Nesting of TFT_StreamBegin, CS is held low while above 0 */
+static int stream_dc = -1;			/*!< DC level of the buffered run, -1 before the first byte of a stream */
+
+/**
+ * @brief One step of the initialization sequence, a command and its parameters.
+ */
+typedef struct _TFTInitStep
+{
+	unsigned char command;		/**< Command byte */
+	unsigned char count;		/**< Number of parameter bytes */
+	unsigned char args[16];		/**< Parameter bytes */
+} TFTInitStep_t;
+
+/**
+ * @brief ST7735S power, frame rate and gamma setup sent after a hardware reset. Only SLPOUT needs a wait,
+ *		  handled by TFT_WakeUp; the other registers take effect as soon as they are written.
+ */
+static const TFTInitStep_t init_steps[] = {
+	{SLEEP_OUT, 0, {0}},
+	{FRMCTR1, 3, {0x01, 0x2C, 0x2D}},							// Set ST7735S Frame Rate
+	{FRMCTR2, 3, {0x01, 0x2C, 0x2D}},
+	{FRMCTR3, 6, {0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D}},
+	{INVCTR,  1, {0x07}},										// Display Inversion Control
+	{PWCTR1,  3, {0xA2, 0x02, 0x84}},
+	{PWCTR2,  1, {0xC5}},
+	{PWCTR3,  2, {0x0A, 0x00}},									// Power Control 3 (in Normal mode/ Full colors)
+	{PWCTR4,  2, {0x8A, 0x2A}},									// Power Control 4 (in Idle mode/ 8-colors)
+	{PWCTR5,  2, {0x8A, 0xEE}},
+	{VMCTR1,  1, {0x0E}},										// ST7735S Power Sequence
+	{INVOFF,  0, {0}},
+	{MADCTL,  1, {0xC0}},										//MX, MY, RGB mode
+	{COLMOD,  1, {0x05}},										//65k mode
+	{GMCTRP1, 16, {0x02, 0x1c, 0x07, 0x12, 0x37, 0x32, 0x29, 0x2d,	// ST7735S Gamma Sequence
+				   0x29, 0x25, 0x2B, 0x39, 0x00, 0x01, 0x03, 0x10}},
+	{GMCTRN1, 16, {0x03, 0x1d, 0x07, 0x06, 0x2E, 0x2C, 0x29, 0x2D,
+				   0x2E, 0x2E, 0x37, 0x3F, 0x00, 0x00, 0x02, 0x10}},
+	{NORON,   0, {0}},											// Normal display on
+	{DISPON,  0, {0}}											// Display on
+};
+
+static int tft_configured = 0;		/*!< Set once init_steps were sent, the registers survive sleep */
+static int tft_sleeping = 1;		/*!< Set from reset or SLPIN until SLPOUT */
+static uint64_t tft_sleep_ns = 0;	/*!< Time of the last reset, SLPIN or SLPOUT */
+static uint64_t tft_ready_ns = 0;	/*!< Earliest time of the next command, 0 if it may be sent now */
+static unsigned char tft_madctl = 0xC0;	/*!< MADCTL last sent, init_steps sets MX and MY */
+static int tft_partial_first = -1;	/*!< First line of the partial area, -1 when the whole panel is scanned */
+static int tft_partial_last = -1;	/*!< Last line of the partial area */
+static int tft_idle = 0;			/*!< Set while in 8 colour idle mode */
+static int tft_full_color = 0;		/*!< Set once a color beyond the 8 of idle mode was drawn since the last TFT_Background */
+
+static void TFT_StreamPut(int dc, unsigned char byte);
+static void TFT_StreamFlush(void);
+static void TFT_SleepCommand(unsigned char command);
+static void TFT_PartialArea(void);
+static int TFT_IsEightColor(unsigned int color);
 
 /// \defgroup tft TFT Display 
 /// TFT driver for ST7735 controller 1.8 inch display.
@@ -19,121 +78,139 @@ extern const unsigned char FontASCII8X16[];
 
 /**
  *@brief This function intializes the display controller and prepares it for any subsequent operations.
+ *		 The controller keeps its registers while asleep, so once it has been set up a rerun only wakes
+ *		 it and turns the display on.
  *@return none
  */
 void TFT_Initialize(void)
 {
+    if (tft_configured)
+    {
+        TFT_WakeUp();
+        TFT_TurnOnDisplay();
+        return;
+    }
+
     CS_OUTPUT();
     DC_OUTPUT();
     RST_OUTPUT();
-    bcm2835_delay(100);
-    
-    CS_LOW();
-    bcm2835_delay(10);	
+    CS_HIGH();
+
     RST_LOW();
-    bcm2835_delay(100);
+    bcm2835_delayMicroseconds(TFT_RESET_US);		//A hardware reset makes SWRESET unnecessary
     RST_HIGH();
-    bcm2835_delay(100);	
-	
-	TFT_WriteCommand(SWRESET);
-	bcm2835_delay(150);	
-    TFT_WriteCommand(SLEEP_OUT);
-    bcm2835_delay(600);
-
-	TFT_WriteCommand(FRMCTR1);			// Set ST7735S Frame Rate
-	TFT_WriteData(0x01);
-	TFT_WriteData(0x2C);
-	TFT_WriteData(0x2D);
-	TFT_WriteCommand(FRMCTR2);
-	TFT_WriteData(0x01);
-	TFT_WriteData(0x2C);
-	TFT_WriteData(0x2D);
-	TFT_WriteCommand(FRMCTR3);
-	TFT_WriteData(0x01);
-	TFT_WriteData(0x2C);
-	TFT_WriteData(0x2D);
-	TFT_WriteData(0x01);
-	TFT_WriteData(0x2C);
-	TFT_WriteData(0x2D);
-	
-	TFT_WriteCommand(INVCTR); 		// Display Inversion Control
-	TFT_WriteData(0x07);
-	TFT_WriteCommand(PWCTR1);
-	TFT_WriteData(0xA2);
-	TFT_WriteData(0x02);
-	TFT_WriteData(0x84);
-	TFT_WriteCommand(PWCTR2);		
-	TFT_WriteData(0XC5);
-	TFT_WriteCommand(PWCTR3);		// Power Control 3 (in Normal mode/ Full colors)
-	TFT_WriteData(0x0A);
-	TFT_WriteData(0x00);
-	TFT_WriteCommand(PWCTR4);		// Power Control 4 (in Idle mode/ 8-colors)
-	TFT_WriteData(0x8A);
-	TFT_WriteData(0x2A);
-	TFT_WriteCommand(PWCTR5);
-	TFT_WriteData(0x8A);
-	TFT_WriteData(0xEE);
-	
-	TFT_WriteCommand(VMCTR1); // ST7735S Power Sequence
-	TFT_WriteData(0x0E);
-	TFT_WriteCommand(INVOFF);
-	TFT_WriteCommand(MADCTL); //MX, MY, RGB mode
-	TFT_WriteData(0xC0);
-	TFT_WriteCommand(COLMOD); //65k mode
-	TFT_WriteData(0x05);
-	
+    tft_sleep_ns = timestamp_ns();
+    tft_ready_ns = tft_sleep_ns + TFT_RESET_READY_MS * 1000000ULL;
+    tft_sleeping = 1;
+
+    TFT_StreamBegin();
+    for (unsigned int i = 0; i < sizeof(init_steps) / sizeof(init_steps[0]); i++)
+    {
+        const TFTInitStep_t *step = &init_steps[i];
+        if (step->command == SLEEP_OUT)
+        {
+            TFT_StreamFlush();
+            TFT_WakeUp();
+            continue;
+        }
+        TFT_WriteCommand(step->command);
+        TFT_StreamData(step->args, step->count);
+    }
+    TFT_StreamEnd();
+    tft_configured = 1;
+}
+
+/**
+ * @brief Starts a command stream. Until the matching TFT_StreamEnd, CS stays low, DC only changes between a
+ *		  command and its parameters, and each run of data bytes goes out with one SPI transfer. Streams nest,
+ *		  so every TFT_* call can be made inside an outer stream.
+ * @return none
+ */
+void TFT_StreamBegin(void)
+{
+	if (stream_depth++ == 0)
+	{
+		if (tft_ready_ns != 0)
+		{
+			wait_until_ns(tft_ready_ns);		//Only as long as the last SLPIN, SLPOUT or reset requires
+			tft_ready_ns = 0;
+		}
+		CS_LOW();
+		stream_dc = -1;
+	}
+}
+
+/**
+ * @brief Ends a command stream started with TFT_StreamBegin, sending what is buffered and releasing CS once
+ *		  the outermost stream ends.
+ * @return none
+ */
+void TFT_StreamEnd(void)
+{
+	if (--stream_depth == 0)
+	{
+		TFT_StreamFlush();
+		CS_HIGH();
+	}
+}
+
+/**
+ * @brief Sends parameter or pixel bytes as part of the current stream.
+ * @param data Bytes to send
+ * @param length Number of bytes
+ * @return none
+ */
+void TFT_StreamData(const unsigned char *data, unsigned int length)
+{
+	TFT_StreamBegin();
+	for (unsigned int i = 0; i < length; i++)
+	{
+		TFT_StreamPut(HIGH, data[i]);
+	}
+	TFT_StreamEnd();
+}
+
+/**
+ * @brief Sends the same 16 bit pixel many times, e.g. to fill a window set with TFT_SetWindow.
+ * @param color Pixel in RGB565
+ * @param count Number of pixels
+ * @return none
+ */
+void TFT_StreamFill(unsigned int color, unsigned long count)
+{
+	if (!TFT_IsEightColor(color))
+	{
+		tft_full_color = 1;
+	}
+	TFT_StreamBegin();
+	while (count-- > 0)
+	{
+		TFT_StreamPut(HIGH, color >> 8);
+		TFT_StreamPut(HIGH, color);
+	}
+	TFT_StreamEnd();
+}
+
+/**
+ * @brief Sets the window the following pixels are written to, in the current orientation, and starts RAMWR.
+ * @param x0 First column
+ * @param y0 First row
+ * @param x1 Last column
+ * @param y1 Last row
+ * @return none
+ */
+void TFT_SetWindow(unsigned char x0, unsigned char y0, unsigned char x1, unsigned char y1)
+{
+	const unsigned char columns[4] = {0x00, x0, 0x00, x1};
+	const unsigned char rows[4] = {0x00, y0, 0x00, y1};
+
+	TFT_StreamBegin();
 	TFT_WriteCommand(CASET);
-	TFT_WriteData(0x00);
-	TFT_WriteData(0x7F);
+	TFT_StreamData(columns, sizeof(columns));
 	TFT_WriteCommand(RASET);
-	TFT_WriteData(0x00);
-	TFT_WriteData(0x9F);
-	
-	TFT_WriteCommand(GMCTRP1);			// ST7735S Gamma Sequence
-	TFT_WriteData(0x02);
-	TFT_WriteData(0x1c);
-	TFT_WriteData(0x07);
-	TFT_WriteData(0x12);
-	
-	TFT_WriteData(0x37);
-	TFT_WriteData(0x32);
-	TFT_WriteData(0x29);
-	TFT_WriteData(0x2d);
-	
-	TFT_WriteData(0x29);
-	TFT_WriteData(0x25);
-	TFT_WriteData(0x2B);
-	TFT_WriteData(0x39);
-	
-	TFT_WriteData(0x00);
-	TFT_WriteData(0x01);
-	TFT_WriteData(0x03);
-	TFT_WriteData(0x10);
-	  
-	TFT_WriteCommand(GMCTRN1);
-	TFT_WriteData(0x03);
-	TFT_WriteData(0x1d);
-	TFT_WriteData(0x07);
-	TFT_WriteData(0x06);
-	
-	TFT_WriteData(0x2E);
-	TFT_WriteData(0x2C);
-	TFT_WriteData(0x29);
-	TFT_WriteData(0x2D);
-	
-	TFT_WriteData(0x2E);
-	TFT_WriteData(0x2E);
-	TFT_WriteData(0x37);
-	TFT_WriteData(0x3F);
-	
-	TFT_WriteData(0x00);
-	TFT_WriteData(0x00);
-	TFT_WriteData(0x02);
-	TFT_WriteData(0x10);
-
-	TFT_WriteCommand(NORON);        // Normal display on, no args, w/delay 10ms 0x13
-    bcm2835_delay(100);				// End ST7735S Gamma Sequence
-	TFT_WriteCommand(DISPON); 		// Display on
+	TFT_StreamData(rows, sizeof(rows));
+	TFT_WriteCommand(RAMWR);
+	TFT_StreamEnd();
 }
 
 /**
@@ -143,10 +220,9 @@ void TFT_Initialize(void)
  */
 void  TFT_WriteCommand(unsigned char command)
 {
-    CS_LOW();
-    DC_LOW();
-    SPI_Write(command);
-    CS_HIGH();
+    TFT_StreamBegin();
+    TFT_StreamPut(LOW, command);
+    TFT_StreamEnd();
 }
 
 /**
@@ -156,10 +232,7 @@ void  TFT_WriteCommand(unsigned char command)
  */
 void  TFT_WriteData(unsigned char datab)
 {
-    CS_LOW();
-    DC_HIGH();
-    SPI_Write(datab);
-    CS_HIGH();
+    TFT_StreamData(&datab, 1);
 }
 
 /**
@@ -169,11 +242,7 @@ void  TFT_WriteData(unsigned char datab)
  */
 void TFT_WriteDataWord(int wdata)
 {
-    CS_LOW();
-    DC_HIGH();
-    SPI_Write(wdata>>8);
-    SPI_Write(wdata);
-    CS_HIGH();
+    TFT_StreamFill(wdata, 1);
 }
 
 /**
@@ -182,18 +251,7 @@ void TFT_WriteDataWord(int wdata)
  */
 void  TFT_RamAdress(void)
 {
-   TFT_WriteCommand(CASET);
-   TFT_WriteData(0x00);
-   TFT_WriteData(0x00);
-   TFT_WriteData(0x00);
-   TFT_WriteData(WIDTH);
-  
-   TFT_WriteCommand(RASET);
-   TFT_WriteData(0x00);
-   TFT_WriteData(0x00);
-   TFT_WriteData(0x00);
-   TFT_WriteData(HEIGHT);
-   TFT_WriteCommand(RAMWR);
+   TFT_SetWindow(0, 0, WIDTH, HEIGHT);
 }
 
 /**
@@ -205,21 +263,10 @@ void  TFT_RamAdress(void)
  */
 void TFT_SetPixel(unsigned char x_start,unsigned char y_start,unsigned int color)
 {
-    TFT_WriteCommand(CASET);
-	TFT_WriteData(0x00);
-    TFT_WriteData(x_start);                        // XSTART
-    TFT_WriteData(0x00);
-    TFT_WriteData(x_start+1);                      // XEND
-
-    TFT_WriteCommand(RASET);              // Row addr set
-    TFT_WriteData(0x00);
-    TFT_WriteData(y_start);                        // YSTART
-    TFT_WriteData(0x00);
-    TFT_WriteData(y_start+1);                      // YEND
-
-    TFT_WriteCommand(RAMWR);
-    TFT_WriteData(color>>8);
-    TFT_WriteData(color);
+    TFT_StreamBegin();
+    TFT_SetWindow(x_start, y_start, x_start+1, y_start+1);
+    TFT_StreamFill(color, 1);
+    TFT_StreamEnd();
 }
 
 /**
@@ -228,8 +275,8 @@ void TFT_SetPixel(unsigned char x_start,unsigned char y_start,unsigned int color
  */
 void TFT_Sleep(void)
 {
-    TFT_WriteCommand(SLEEP_IN);
-    bcm2835_delay(5);
+    TFT_SleepCommand(SLEEP_IN);
+    tft_sleeping = 1;
 }
 
 /**
@@ -238,8 +285,8 @@ void TFT_Sleep(void)
  */
 void TFT_WakeUp(void)
 {
-    TFT_WriteCommand(SLEEP_OUT);
-    bcm2835_delay(120);
+    TFT_SleepCommand(SLEEP_OUT);
+    tft_sleeping = 0;
 }
 
 /**
@@ -268,34 +315,43 @@ void TFT_TurnOnDisplay(void)
  */
 void TFT_SetRotation(orientation_t mode)
 {
-  TFT_WriteCommand(MADCTL);
+  TFT_StreamBegin();
+  unsigned char madctl = tft_madctl;
   switch (mode)
   {
    case 0x00:
-     TFT_WriteData(MADCTL_MY | MADCTL_MX| MADCTL_BGR);
+     madctl = MADCTL_MY | MADCTL_MX| MADCTL_BGR;
      break;
    case 0x01:
-     TFT_WriteData(MADCTL_MV |MADCTL_ML| MADCTL_BGR);
+     madctl = MADCTL_MV |MADCTL_ML| MADCTL_BGR;
      break;
   case 0x02:
-     TFT_WriteData(MADCTL_MY | MADCTL_BGR);
+     madctl = MADCTL_MY | MADCTL_BGR;
     break;
    case 0x03:
-     TFT_WriteData(MADCTL_MX | MADCTL_BGR);
+     madctl = MADCTL_MX | MADCTL_BGR;
      break;
    case 0x04:
-     TFT_WriteData(MADCTL_MV | MADCTL_BGR | MADCTL_MX);
+     madctl = MADCTL_MV | MADCTL_BGR | MADCTL_MX;
      break;
    case 0x05:
-     TFT_WriteData(MADCTL_ML | MADCTL_BGR);
+     madctl = MADCTL_ML | MADCTL_BGR;
      break;
    case 0x06:
-     TFT_WriteData(MADCTL_MV|MADCTL_MY | MADCTL_BGR);
+     madctl = MADCTL_MV|MADCTL_MY | MADCTL_BGR;
      break;
    case 0x07:
-     TFT_WriteData(MADCTL_M8 | MADCTL_BGR);
+     madctl = MADCTL_M8 | MADCTL_BGR;
      break;
   }
+  TFT_WriteCommand(MADCTL);
+  TFT_WriteData(madctl);
+  tft_madctl = madctl;
+  if (tft_partial_first >= 0)
+  {
+    TFT_PartialArea();		//The lines of the partial area follow the orientation
+  }
+  TFT_StreamEnd();
 }
 
 /**
@@ -323,11 +379,11 @@ void TFT_InvertDisplayOff(void)
  */
 void  TFT_Background(int color)
 {
-    unsigned char i,j;
+    tft_full_color = 0;		//Everything drawn before is covered
+    TFT_StreamBegin();
     TFT_RamAdress();
-     for (i=0;i<160;i++)
-        for (j=0;j<128;j++)
-            TFT_WriteDataWord(color);
+    TFT_StreamFill(color, 160 * 128);
+    TFT_StreamEnd();
 }
 
 /**
@@ -343,14 +399,17 @@ void    TFT_ShowPic(unsigned int picture[],unsigned char width, unsigned char he
 {
     unsigned int i,j,k;
     k=0;
+    TFT_StreamBegin();
     for(i=0;i<width;i++)
     {
+        TFT_SetWindow(i+x, y, i+x, y+height-1);		//The picture is stored column by column
         for(j=0;j<height;j++)
         {
-            TFT_SetPixel(i+x,j+y,picture[k]);
+            TFT_StreamFill(picture[k], 1);
 			k++;
         }
     }
+    TFT_StreamEnd();
 }
 
 /**
@@ -364,14 +423,17 @@ void    TFT_DisplayImage(Image_t *image, unsigned char x, unsigned char y)
 {
     unsigned int i,j,k;
     k=0;
+    TFT_StreamBegin();
     for(i=0;i<image->width;i++)
     {
+        TFT_SetWindow(i+x, y, i+x, y+image->height-1);	//The picture is stored column by column
         for(j=0;j<image->height;j++)
         {
-            TFT_SetPixel(i+x,j+y,image->picture[k]);
+            TFT_StreamFill(image->picture[k], 1);
 			k++;
         }
     }
+    TFT_StreamEnd();
 }
 
 /**
@@ -398,33 +460,23 @@ unsigned int TFT_Color565(unsigned char r, unsigned char g, unsigned char b)
  */
 void TFT_ASCII(char x, char y, int color, int background, char letter, char size)
 {
-    unsigned char b,q,d,z;
+    unsigned char q,d,z;
     char data;
+    TFT_StreamBegin();
     for(q=0;q<5;q++)
     {
-        data = font[(unsigned char)letter][q];
-        for(z=0;z<8*size;z++)
+        for(d=0; d<size;d++)
         {
-            if((data&1)!=0){
-                for(d=0; d<size;d++)
-                {
-                    for(b=0; b<size;b++)
-                    {
-                        TFT_SetPixel(x+(q*size)+d,y+(z*size)+b,color);
-                    }
-                }
-            }else{
-                for(d=0; d<size;d++)
-                {
-                    for(b=0; b<size;b++)
-                    {
-                        TFT_SetPixel(x+(q*size)+d,y+(z*size)+b,background);
-                    }
-                }
+            TFT_SetWindow(x+(q*size)+d, y, x+(q*size)+d, y+(8*size*size)-1);	//One column of the glyph
+            data = font[(unsigned char)letter][q];
+            for(z=0;z<8*size;z++)
+            {
+                TFT_StreamFill(((data&1)!=0) ? color : background, size);
+                data>>=1;
             }
-            data>>=1;
         }
     }
+    TFT_StreamEnd();
 }
 
 /**
@@ -439,6 +491,7 @@ void TFT_ASCII(char x, char y, int color, int background, char letter, char size
  */
 void TFT_PrintString(char x, char y, int color, int background, char * message, char size)
 {
+    TFT_StreamBegin();
     while (*message)
     {
         TFT_ASCII(x,y,color,background,*message++, size);
@@ -449,6 +502,7 @@ void TFT_PrintString(char x, char y, int color, int background, char * message,
             y+=8*size;
         }
     }
+    TFT_StreamEnd();
 }
 
 /**
@@ -465,6 +519,7 @@ void TFT_PrintString(char x, char y, int color, int background, char * message,
 void TFT_PrintInteger(char x, char y, int color, int background,int integer, char size)
 {
     unsigned char tenthousands,thousands,hundreds,tens,ones;
+    TFT_StreamBegin();
     tenthousands = integer / 10000;
     TFT_ASCII(x,y,color,background,tenthousands+48, size);
     thousands = ((integer - tenthousands*10000)) / 1000;
@@ -479,6 +534,225 @@ void TFT_PrintInteger(char x, char y, int color, int background,int integer, cha
     ones=integer%10;
     x+=6;
     TFT_ASCII(x,y,color,background,ones+48, size);
+    TFT_StreamEnd();
+}
+
+/**
+ * @brief Prints a line of text as one band of rows across the display, the glyphs and the space around them
+ *		  sent with a single window, so the band fully replaces what was there. Text past the width is cut off.
+ * @param y First row of the band, which is 8 * size rows high
+ * @param width Columns of the band, starting at column 0
+ * @param color Color of text above background.
+ * @param background Color of text background.
+ * @param message Text to print
+ * @param size Size of font
+ * @return none
+ */
+void TFT_PrintLine(unsigned char y, unsigned char width, int color, int background, const char *message, char size)
+{
+    unsigned char row[2 * 256];
+    unsigned int length = strlen(message);
+    unsigned int r, x;
+
+    if (!TFT_IsEightColor(color) || !TFT_IsEightColor(background))
+    {
+        tft_full_color = 1;
+    }
+    TFT_StreamBegin();
+    TFT_SetWindow(0, y, width - 1, y + 8 * size - 1);
+    for (r = 0; r < 8 * size; r++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            unsigned int c = x / (6 * size);			//Character of this column
+            unsigned int q = (x % (6 * size)) / size;	//Column of its glyph, 5 is the gap
+            int pixel = background;
+            if (c < length && q < 5 && ((font[(unsigned char)message[c]][q] >> (r / size)) & 1))
+            {
+                pixel = color;
+            }
+            row[2 * x] = pixel >> 8;
+            row[2 * x + 1] = pixel;
+        }
+        TFT_StreamData(row, width * 2);
+    }
+    TFT_StreamEnd();
+}
+
+/**
+ * @brief Splits the rows into a fixed area at the top, a scrolling area and a fixed area at the bottom (SCRLAR).
+ *		  Rows are counted in display RAM, whose first row is the bottom of the screen in orientations with MY set.
+ * @param top Rows of the top fixed area
+ * @param height Rows of the scrolling area
+ * @param bottom Rows of the bottom fixed area, the three add up to HEIGHT + 1
+ * @return none
+ */
+void TFT_SetScrollArea(unsigned int top, unsigned int height, unsigned int bottom)
+{
+    const unsigned char args[6] = {top >> 8, top, height >> 8, height, bottom >> 8, bottom};
+
+    TFT_StreamBegin();
+    TFT_WriteCommand(SCRLAR);
+    TFT_StreamData(args, sizeof(args));
+    TFT_StreamEnd();
+}
+
+/**
+ * @brief Scrolls the area set with TFT_SetScrollArea so that it starts with a given RAM row (VSCSAD). Only
+ *		  two bytes are sent, the display RAM is not rewritten. NORON leaves the scrolling mode.
+ * @param row RAM row shown first in the scrolling area, from top to top + height - 1
+ * @return none
+ */
+void TFT_SetScrollStart(unsigned int row)
+{
+    const unsigned char args[2] = {row >> 8, row};
+
+    TFT_StreamBegin();
+    TFT_WriteCommand(VSCSAD);
+    TFT_StreamData(args, sizeof(args));
+    TFT_StreamEnd();
+}
+
+/**
+ * @brief Limits the scanning to a band of lines, the rest of the panel is left blank and not driven, or
+ *		  scans the whole panel again. The controller scans RAM rows, so the lines are rows of the screen in
+ *		  portrait orientations and columns in landscape ones. The band follows later changes of orientation.
+ * @param first First line of the band, -1 to scan the whole panel
+ * @param last Last line of the band, up to HEIGHT
+ * @return none
+ */
+void TFT_SetPartialLines(int first, int last)
+{
+    tft_partial_first = (first < 0 || last < first || last > HEIGHT) ? -1 : first;
+    tft_partial_last = last;
+    TFT_StreamBegin();
+    if (tft_partial_first < 0)
+    {
+        TFT_WriteCommand(NORON);		//Also leaves the scrolling mode
+    }
+    else
+    {
+        TFT_PartialArea();
+        TFT_WriteCommand(PTLON);
+    }
+    TFT_StreamEnd();
+}
+
+/**
+ * @brief Switches the 8 colour idle mode, which shows only the top bit of each color channel and lowers the
+ *		  power of the panel. Nothing is sent if the mode is already set.
+ * @param on Non zero for idle mode, 0 for full colors
+ * @return none
+ */
+void TFT_SetIdleMode(int on)
+{
+    if ((on != 0) == tft_idle)
+    {
+        return;
+    }
+    tft_idle = (on != 0);
+    TFT_WriteCommand(tft_idle ? IDLE_MODE_ON : IDLE_MODE_OFF);
+}
+
+/**
+ * @brief Tells whether everything drawn since the last TFT_Background looks the same in idle mode, every
+ *		  color having each channel fully on or off. Only the TFT_* drawing functions are tracked.
+ * @return eight 1 if idle mode would not change the screen, 0 otherwise.
+ */
+int TFT_EightColors(void)
+{
+    return !tft_full_color;
 }
 
 /// @}
+
+/**
+ * @brief Adds a byte to the stream, sending the buffered run first if DC must change or the buffer is full.
+ */
+static void TFT_StreamPut(int dc, unsigned char byte)
+{
+	if (dc != stream_dc)
+	{
+		TFT_StreamFlush();
+		if (dc == LOW)
+		{
+			DC_LOW();
+		}
+		else
+		{
+			DC_HIGH();
+		}
+		stream_dc = dc;
+	}
+	stream_buffer[stream_length++] = byte;
+	if (stream_length == TFT_STREAM_BUFFER)
+	{
+		TFT_StreamFlush();
+	}
+}
+
+/**
+ * @brief Sends the buffered run with one SPI transfer.
+ */
+static void TFT_StreamFlush(void)
+{
+	if (stream_length > 0)
+	{
+		SPI_Write_Array((char *) stream_buffer, stream_length);
+		stream_length = 0;
+	}
+}
+
+/**
+ * @brief Sends SLPIN or SLPOUT, first waiting out TFT_SLEEP_MS since the last reset, SLPIN or SLPOUT, and
+ *		  holds the next command back for TFT_SLEEP_READY_MS. Nothing is sent if the controller is already
+ *		  in that state.
+ */
+static void TFT_SleepCommand(unsigned char command)
+{
+	if (tft_sleeping == (command == SLEEP_IN))
+	{
+		return;
+	}
+	TFT_StreamFlush();
+	wait_until_ns(tft_sleep_ns + TFT_SLEEP_MS * 1000000ULL);
+	TFT_WriteCommand(command);
+	TFT_StreamFlush();
+	tft_sleep_ns = timestamp_ns();
+	if (stream_depth > 0)
+	{
+		wait_until_ns(tft_sleep_ns + TFT_SLEEP_READY_MS * 1000000ULL);	//Inside a stream the next byte follows at once
+	}
+	else
+	{
+		tft_ready_ns = tft_sleep_ns + TFT_SLEEP_READY_MS * 1000000ULL;
+	}
+}
+
+/**
+ * @brief Sends PTLAR for the partial lines, mapped to RAM rows through the MADCTL last sent.
+ */
+static void TFT_PartialArea(void)
+{
+	int first = tft_partial_first, last = tft_partial_last;
+	if (tft_madctl & MADCTL_MY)			//RAM row 0 is the last line
+	{
+		first = HEIGHT - tft_partial_last;
+		last = HEIGHT - tft_partial_first;
+	}
+	const unsigned char args[4] = {first >> 8, first, last >> 8, last};
+
+	TFT_StreamBegin();
+	TFT_WriteCommand(PTLAR);
+	TFT_StreamData(args, sizeof(args));
+	TFT_StreamEnd();
+}
+
+/**
+ * @brief Tells whether a color is one of the 8 idle mode shows unchanged.
+ */
+static int TFT_IsEightColor(unsigned int color)
+{
+	unsigned int r = (color >> 11) & 0x1F, g = (color >> 5) & 0x3F, b = color & 0x1F;
+	return (r == 0 || r == 0x1F) && (g == 0 || g == 0x3F) && (b == 0 || b == 0x1F);
+}
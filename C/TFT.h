@@ -104,6 +104,12 @@
 #define MADCTL_BGR 0x08
 
 /******************************************************************************/
+#define TFT_STREAM_BUFFER	4096	/** Bytes of one command stream run sent with a single SPI transfer. */
+#define TFT_RESET_US		10		/** Shortest low pulse on RST that resets the controller. */
+#define TFT_RESET_READY_MS	120		/** Wait after a reset before the first command, when it was awake before. */
+#define TFT_SLEEP_MS		120		/** Least time between a reset, SLPIN or SLPOUT and the next SLPIN or SLPOUT. */
+#define TFT_SLEEP_READY_MS	5		/** Wait after SLPIN or SLPOUT before the next command. */
+
 #define WIDTH   0x7F        /** Display width 127 pixel. */
 #define HEIGHT  0x9F        /** Display height 159 pixel. */
 
@@ -161,6 +167,11 @@ typedef struct _Image
 }Image_t;
 
 void    		TFT_Initialize(void);
+void 			TFT_StreamBegin(void);
+void 			TFT_StreamEnd(void);
+void 			TFT_StreamData(const unsigned char *data, unsigned int length);
+void 			TFT_StreamFill(unsigned int color, unsigned long count);
+void 			TFT_SetWindow(unsigned char x0, unsigned char y0, unsigned char x1, unsigned char y1);
 void  			TFT_WriteCommand(unsigned char command);
 void  			TFT_WriteData(unsigned char datab);
 void    		TFT_WriteDataWord(int wdata);
@@ -184,4 +195,10 @@ unsigned int 	TFT_Color565(unsigned char r, unsigned char g, unsigned char b);
 void 			TFT_ASCII(char x, char y, int color, int background, char letter, char size);
 void 			TFT_PrintString(char x, char y, int color, int background, char * message, char size);
 void 			TFT_PrintInteger(char x, char y, int color, int background,int integer, char size);
+void 			TFT_PrintLine(unsigned char y, unsigned char width, int color, int background, const char *message, char size);
+void 			TFT_SetScrollArea(unsigned int top, unsigned int height, unsigned int bottom);
+void 			TFT_SetScrollStart(unsigned int row);
+void 			TFT_SetPartialLines(int first, int last);
+void 			TFT_SetIdleMode(int on);
+int 			TFT_EightColors(void);
 #endif
@@ -8,8 +8,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
 #include "SPI.h"
 #include "TFT.h"
+#include "SensorPower.h"
 #include "TFT_Printer.h"
 
 orientation_t lastMode = LANDSCAPE_INV; /*!< The last orientation given, defaults to Landscape Inverted */
@@ -17,15 +19,154 @@ int lastColor = WHITE; /*!< The last text color given, defaults to White */
 int lastBackground = BLACK; /*!< The last background color given, defaults to Black */
 int lastSize = 1; /*!< The last font size given, defaults to 1 */
 
+static int logActive = 0; /*!< Set between TFT_Printer_LogStart and TFT_Printer_LogStop */
+static orientation_t logMode; /*!< Orientation of the log, a portrait type */
+static int logColor, logBackground, logSize; /*!< Colors and font size of the log lines */
+static int logLines; /*!< How many lines fit in the scrolling area */
+static int logSlot; /*!< Line of the scrolling area the next line is printed on */
+static int logFixed; /*!< Rows left below the last line, kept fixed and blank */
+static int logMirrored; /*!< Set if the orientation mirrors rows, so RAM row 0 is the bottom of the screen */
+
+static int tftUnit = -1; /*!< Power unit of the TFT, see SensorPower.h */
+static pthread_once_t tftOnce = PTHREAD_ONCE_INIT;
+static TFTPowerPolicy_t tftPolicy = {-1, -1, 0, 0, NULL}; /*!< Set with TFT_SetPowerPolicy */
+static int tftStale = 0; /*!< Set when the screen must be redrawn on the next wake */
+
 /**
- * @brief Prepares the TFT LCD and its SPI bus for use, clearing the screen to black as well
+ * @brief Prepares the SPI bus and the TFT LCD, clearing the screen to black as well
  * @return none
  */
-void TFT_Setup()
+static void TFT_Bringup(void)
 {
     SPI_Initialize(); //Prepare the SPI bus for use by the LCD
     TFT_Initialize(); //Prepare the TFT LCD for use
     TFT_Background(BLACK); //Clear the screen to Black
+    __atomic_store_n(&tftStale, 1, __ATOMIC_RELAXED); //Whatever the redraw callback shows is gone
+}
+
+/**
+ * @brief Takes the TFT LCD out of sleep mode, the screen keeps its contents
+ * @return 0
+ */
+static int TFT_Resume(void)
+{
+    TFT_WakeUp();
+    return 0;
+}
+
+static const SensorPowerOps_t tftOps = {TFT_Bringup, NULL, TFT_Sleep, TFT_Resume};
+
+/**
+ * @brief Registers the TFT LCD as a power unit that never sleeps until TFT_SetIdleTimeout is called
+ * @return none
+ */
+static void TFT_Register(void)
+{
+    tftUnit = SensorPower_Register("ST7735", &tftOps, 0);
+}
+
+/**
+ * @brief Prepares the TFT LCD and its SPI bus for use, clearing the screen to black as well. Only the first
+ * call initializes the display.
+ * @return none
+ */
+void TFT_Setup()
+{
+    if (TFT_Acquire() == 0)
+    {
+        TFT_Release();
+    }
+}
+
+/**
+ * @brief Marks the TFT LCD in use, setting it up on first use or waking it from sleep. Drawing with TFT.c
+ * directly between TFT_Acquire and TFT_Release keeps the display from being put to sleep meanwhile. The
+ * redraw callback of the power policy runs first if the screen went stale, see TFT_Invalidate.
+ * @return 0 if the display may be drawn on, -1 if no power unit was left for it
+ */
+int TFT_Acquire(void)
+{
+    pthread_once(&tftOnce, TFT_Register);
+    if (SensorPower_Acquire(tftUnit) != 0)
+    {
+        return -1;
+    }
+    if (tftPolicy.redraw != NULL && __atomic_exchange_n(&tftStale, 0, __ATOMIC_RELAXED))
+    {
+        tftPolicy.redraw(); //Its own TFT_Acquire finds the display awake and the flag cleared
+    }
+    return 0;
+}
+
+/**
+ * @brief Ends a use of the TFT LCD started with TFT_Acquire, dropping to 8 colour idle mode if the power
+ * policy allows it and everything drawn fits those colours
+ * @return none
+ */
+void TFT_Release(void)
+{
+    if (tftPolicy.idle_colors)
+    {
+        TFT_SetIdleMode(TFT_EightColors());
+    }
+    SensorPower_Release(tftUnit);
+}
+
+/**
+ * @brief Sets how the TFT LCD saves power while it shows a status screen. Scanning only the status strip
+ * and dropping to 8 colours both lower the panel's current while it stays on; after sleep_ms without
+ * drawing it goes to sleep. The ST7735 keeps its RAM while asleep, so waking does not redraw unless
+ * TFT_Invalidate was called meanwhile or the display was set up again.
+ * @param policy The policy, copied
+ * @return none
+ */
+void TFT_SetPowerPolicy(const TFTPowerPolicy_t *policy)
+{
+    tftPolicy = *policy;
+    TFT_SetIdleTimeout(policy->sleep_ms);
+    if (TFT_Acquire() != 0)
+    {
+        return;
+    }
+    TFT_SetPartialLines(policy->strip_first, policy->strip_last);
+    if (!policy->idle_colors)
+    {
+        TFT_SetIdleMode(0);
+    }
+    TFT_Release();
+}
+
+/**
+ * @brief Tells the TFT LCD that the state shown on it changed. Redraws it at once with the redraw callback
+ * of the power policy while the display is awake; while it sleeps, only marks it stale so it is not woken,
+ * and the redraw happens on the next TFT_Acquire.
+ * @return none
+ */
+void TFT_Invalidate(void)
+{
+    pthread_once(&tftOnce, TFT_Register);
+    if (SensorPower_State(tftUnit) != SENSOR_POWER_ACTIVE)
+    {
+        __atomic_store_n(&tftStale, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (tftPolicy.redraw != NULL && TFT_Acquire() == 0)
+    {
+        tftPolicy.redraw();
+        TFT_Release();
+    }
+}
+
+/**
+ * @brief Puts the TFT LCD to sleep once it has not been drawn on for a while. The screen goes dark and
+ * comes back with its contents on the next TFT_Acquire.
+ * @param ms Idle time before sleeping, 0 to keep the display on
+ * @return none
+ */
+void TFT_SetIdleTimeout(unsigned int ms)
+{
+    pthread_once(&tftOnce, TFT_Register);
+    SensorPower_SetIdleTimeout(tftUnit, ms);
 }
 
 /**
@@ -129,6 +270,11 @@ void TFT_Printer_PrintAll(orientation_t mode, int color, int background, char *
 {
 	int maxChars; //Integer to store how many characters to fit in a line on the display
 	int maxLines; //Integer to store how many lines to fit on the display
+	if (TFT_Acquire() != 0) //Sets the display up on first use or wakes it
+	{
+		return;
+	}
+	TFT_Printer_LogStop(); //A full screen message ends a scrolling log
 	lastMode = mode; //Set the last value of orientation mode to the new value
 	lastColor = color; //Set the last value of color to the new value
 	lastBackground = background; //Set the last value of background to the new value
@@ -149,6 +295,7 @@ void TFT_Printer_PrintAll(orientation_t mode, int color, int background, char *
 		TFT_SetRotation(mode); //Set back to the given landscape-type orientation
 	}
 	TFT_Printer_PrintWrap(maxChars, maxLines, color, background, message, size); //Wrap message on LCD
+	TFT_Release();
 }
 
 /**
@@ -201,4 +348,100 @@ void TFT_Printer_PrintBoth(int color, int background, char * message, int size)
 	lastColor = color; //Set the last value of color to the new value
 	lastBackground = background; //Set the last value of background to the new value
 	lastSize = size; //Set the last value of size to the new value
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Clears the screen and starts a scrolling log, newest line at the bottom. Only portrait orientations
+ * scroll along the text lines, the controller scrolls RAM rows.
+ * @param mode The orientation of the log, a portrait type
+ * @param color Color of text above background.
+ * @param background Color of text background.
+ * @param size Size of font
+ * @return 0 on success, -1 for a landscape orientation or if the display is not available
+ */
+int TFT_Printer_LogStart(orientation_t mode, int color, int background, int size)
+{
+	int height = FONT_HEIGHT * size; //Rows of one line
+	if (mode == 1 || mode == 4 || mode == 6 || mode == 7 || size < 1 || height > LCD_LENGTH)
+	{
+		return -1;
+	}
+	if (TFT_Acquire() != 0)
+	{
+		return -1;
+	}
+	logMode = mode;
+	logColor = color;
+	logBackground = background;
+	logSize = size;
+	logLines = LCD_LENGTH / height;
+	logFixed = LCD_LENGTH - logLines * height;
+	logMirrored = (mode == PORTRAIT || mode == PORTRAIT_REF); //The orientations with MADCTL_MY
+	logSlot = 0;
+	logActive = 1;
+	TFT_SetRotation(mode);
+	TFT_Background(background);
+	if (logMirrored) //The blank rows stay at the bottom of the screen, the top of the RAM
+	{
+		TFT_SetScrollArea(logFixed, logLines * height, 0);
+		TFT_SetScrollStart(logFixed);
+	}
+	else
+	{
+		TFT_SetScrollArea(0, logLines * height, logFixed);
+		TFT_SetScrollStart(0);
+	}
+	TFT_Release();
+	return 0;
+}
+
+/**
+ * @brief Appends a line to the log started with TFT_Printer_LogStart. The line replaces the oldest one in the
+ * display RAM, one band of rows, and the scrolling area then moves to show it at the bottom. Text past the
+ * width of the screen is cut off.
+ * @param message Line to print
+ * @return none
+ */
+void TFT_Printer_LogLine(const char * message)
+{
+	if (!logActive || TFT_Acquire() != 0)
+	{
+		return;
+	}
+	int height = FONT_HEIGHT * logSize; //Rows of one line
+	int scrolling = logLines * height; //Rows of the scrolling area
+	TFT_StreamBegin();
+	TFT_SetRotation(logMode); //In case something else was drawn meanwhile
+	TFT_PrintLine(logSlot * height, LCD_HEIGHT, logColor, logBackground, message, logSize);
+	logSlot = (logSlot + 1) % logLines; //The oldest line, now shown at the top
+	if (logMirrored) //RAM rows run up the screen, so the start moves the other way
+	{
+		TFT_SetScrollStart(logFixed + (scrolling - logSlot * height) % scrolling);
+	}
+	else
+	{
+		TFT_SetScrollStart(logSlot * height);
+	}
+	TFT_StreamEnd();
+	TFT_Release();
+}
+
+/**
+ * @brief Ends the scrolling log, the screen shows the display RAM unscrolled again, its lines out of order
+ * until it is redrawn.
+ * @return none
+ */
+void TFT_Printer_LogStop(void)
+{
+	if (!logActive || TFT_Acquire() != 0) //Wakes the display, and keeps the sweep from putting it to sleep meanwhile
+	{
+		return;
+	}
+	logActive = 0;
+	TFT_StreamBegin();
+	TFT_SetScrollArea(0, LCD_LENGTH, 0);
+	TFT_SetScrollStart(0);
+	TFT_SetPartialLines(tftPolicy.strip_first, tftPolicy.strip_last); //Leaves the scrolling mode
+	TFT_StreamEnd();
+	TFT_Release();
+}
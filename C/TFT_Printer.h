@@ -15,11 +15,31 @@
 #define FONT_LENGTH 6
 #define FONT_HEIGHT 8
 
+/**
+ * @brief How the TFT LCD saves power while showing a status screen, see TFT_SetPowerPolicy
+ */
+typedef struct _TFTPowerPolicy
+{
+    int strip_first; /**< First line of the status strip kept scanned, -1 to scan the whole panel */
+    int strip_last; /**< Last line of the status strip, rows in portrait and columns in landscape */
+    int idle_colors; /**< Non zero to use 8 colour idle mode while everything drawn fits it */
+    unsigned int sleep_ms; /**< Time without drawing before the display sleeps, 0 to keep it on */
+    void (*redraw)(void); /**< Draws the screen from the application's state, NULL if it never needs to */
+} TFTPowerPolicy_t;
+
 void    TFT_Setup();
+int     TFT_Acquire(void);
+void    TFT_Release(void);
+void    TFT_SetIdleTimeout(unsigned int ms);
+void    TFT_SetPowerPolicy(const TFTPowerPolicy_t *policy);
+void    TFT_Invalidate(void);
 void    TFT_Printer_Print(char * message);
 void    TFT_Printer_PrintColor(int color, int background, char * message);
 void    TFT_Printer_PrintSize(char * message, int size);
 void    TFT_Printer_PrintBoth(int color, int background, char * message, int size);
 void    TFT_Printer_PrintAll(orientation_t mode, int color, int background, char * message, int size);
+int     TFT_Printer_LogStart(orientation_t mode, int color, int background, int size);
+void    TFT_Printer_LogLine(const char * message);
+void    TFT_Printer_LogStop(void);
 
 #endif
\ No newline at end of file
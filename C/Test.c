@@ -32,6 +32,16 @@ int main(void)
     printf("Date (DD/MM/YY): %d, %d, %d\n", get_rtcc_date(), get_rtcc_month(), get_rtcc_year()); //Print the date
     printf("Time: %d:%d:%d\n", get_rtcc_hour(), get_rtcc_minute(), get_rtcc_second()); //Print the last polled time
 
+    SensorSnapshot_t snapshot; //Create a struct in which to store every channel at full precision
+    getSnapshot(&snapshot); //Read all the sensors at once, each channel gets its own timestamp
+    for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+    {
+        if (snapshot.reading[ch].valid) //Only print channels that were read successfully
+        {
+            printf("%s: %f %s\n", SensorChannel_Name(ch), snapshot.reading[ch].value, SensorChannel_Unit(ch));
+        }
+    }
+
 	//Create a sample string/char array to print to the screen
 	char s[] = "This is a long string that will wrap with the display to fit if possible.";
 	
@@ -0,0 +1,268 @@
+/**
+ * @file Timebase.c
+ * @brief Uses the MCP79410 multi-function pin as a crystal locked sampling clock.
+ *
+ * The RTCC is switched to square wave output and the edges on MFP_PIN are
+ * received through the GPIO character device, which timestamps them in the
+ * kernel interrupt handler. Sampling paced this way follows the 32.768 kHz
+ * crystal instead of accumulating the drift and wake-up jitter of sleep().
+ * Kernels before 5.7 stamp the edges with CLOCK_REALTIME, later ones with
+ * CLOCK_MONOTONIC; every timestamp is moved onto the clock of timestamp_ns so
+ * it can be compared with the schedule and the samples.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#undef CTRL									//sys/ttydefaults.h macro, clashes with the RTCC register name
+#include "MCP79410.h"
+#include "Utilities.h"
+#include "Timebase.h"
+
+static int timebase_fd = -1;			/*!< Line event fd, -1 when closed */
+static unsigned int timebase_hz = 0;	/*!< Nominal square wave frequency */
+static TimebaseStats_t timebase_stats;	/*!< Edge statistics since open */
+
+static uint64_t Timebase_Monotonic(uint64_t kernel_ns);
+
+/// \defgroup timebase RTCC Timebase
+/// These functions pace sampling from the RTCC square wave output.
+/// @{
+
+/**
+ * @brief Starts the RTCC square wave and requests rising edge events for the MFP line.
+ *		  The I2C bus must already be initialized.
+ * @param rate TIMEBASE_1HZ or TIMEBASE_64HZ
+ * @return fd File descriptor that becomes readable on each edge, -1 on error.
+ */
+int Timebase_Open(TimebaseRate_t rate)
+{
+	struct gpioevent_request req;
+
+	if(timebase_fd >= 0)
+	{
+		Timebase_Close();
+	}
+
+	if(!MCP79410_IsRunning())					//The square wave is derived from the oscillator
+	{
+		MCP79410_EnableOscillator();
+	}
+	MCP79410_SetSquareWaveRate(rate);
+	MCP79410_SetMFP_Functionality(SQUARE_WAVE);
+
+	int chip = open(TIMEBASE_GPIOCHIP, O_RDONLY | O_CLOEXEC);
+	if(chip < 0)
+	{
+		printf("Timebase: cannot open %s: %s\n", TIMEBASE_GPIOCHIP, strerror(errno));
+		MCP79410_SetMFP_Functionality(GPO);			//As Timebase_Close leaves it
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.lineoffset = TIMEBASE_MFP_LINE;
+	req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+	req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+	strncpy(req.consumer_label, "sensorian-timebase", sizeof(req.consumer_label) - 1);
+
+	int ret = ioctl(chip, GPIO_GET_LINEEVENT_IOCTL, &req);
+	close(chip);								//The event fd stays valid on its own
+	if(ret < 0)
+	{
+		printf("Timebase: cannot request MFP line events: %s\n", strerror(errno));
+		MCP79410_SetMFP_Functionality(GPO);
+		return -1;
+	}
+
+	timebase_fd = req.fd;
+	timebase_hz = (rate == TIMEBASE_64HZ) ? 64 : 1;
+	memset(&timebase_stats, 0, sizeof(timebase_stats));
+	return timebase_fd;
+}
+
+/**
+ * @brief Releases the MFP line and returns the pin to general purpose output.
+ * @return none
+ */
+void Timebase_Close(void)
+{
+	if(timebase_fd < 0)
+	{
+		return;
+	}
+	close(timebase_fd);
+	timebase_fd = -1;
+	timebase_hz = 0;
+	MCP79410_SetMFP_Functionality(GPO);
+}
+
+/**
+ * @brief Returns the edge event file descriptor so it can be added to poll/epoll sets.
+ * @return fd Event file descriptor, -1 when the timebase is closed.
+ */
+int Timebase_Fd(void)
+{
+	return timebase_fd;
+}
+
+/**
+ * @brief Returns the nominal tick frequency.
+ * @return hz 1 or 64, 0 when the timebase is closed.
+ */
+unsigned int Timebase_Hz(void)
+{
+	return timebase_hz;
+}
+
+/**
+ * @brief Returns the nominal tick period.
+ * @return period Period in nanoseconds, 0 when the timebase is closed.
+ */
+uint64_t Timebase_PeriodNs(void)
+{
+	return timebase_hz ? 1000000000ULL / timebase_hz : 0;
+}
+
+/**
+ * @brief Consumes one pending edge event and updates the statistics.
+ *		  Blocks if no event is pending, call after poll() reports the fd readable to avoid that.
+ * @param timestamp Receives the kernel timestamp of the edge on the clock of timestamp_ns, may be NULL.
+ * @return ticks Number of nominal periods since the previous edge (more than 1 if edges were lost), -1 on error.
+ */
+int Timebase_HandleEvent(uint64_t *timestamp)
+{
+	struct gpioevent_data event;
+	ssize_t n;
+
+	do
+	{
+		n = read(timebase_fd, &event, sizeof(event));
+	} while(n < 0 && errno == EINTR);
+
+	if(n != sizeof(event))
+	{
+		return -1;
+	}
+
+	uint64_t edge_ns = Timebase_Monotonic(event.timestamp);
+	int ticks = 1;
+	uint64_t period = Timebase_PeriodNs();
+	if(timebase_stats.ticks > 0)
+	{
+		uint64_t delta = edge_ns - timebase_stats.last_ns;
+		uint64_t periods = (delta + period / 2) / period;	//Round to the nearest whole period
+		if(periods == 0)
+		{
+			periods = 1;
+		}
+		int64_t jitter = (int64_t)(delta - periods * period);
+		if(jitter < 0)
+		{
+			jitter = -jitter;
+		}
+		if(jitter > timebase_stats.max_jitter_ns)
+		{
+			timebase_stats.max_jitter_ns = jitter;
+		}
+		timebase_stats.missed += periods - 1;
+		ticks = (int) periods;
+	}
+	timebase_stats.ticks++;
+	timebase_stats.last_ns = edge_ns;
+
+	if(timestamp)
+	{
+		*timestamp = edge_ns;
+	}
+	return ticks;
+}
+
+/**
+ * @brief Blocks until the next square wave edge.
+ * @param timestamp Receives the kernel timestamp of the edge on the clock of timestamp_ns, may be NULL.
+ * @return ticks Number of nominal periods elapsed, -1 on error.
+ */
+int Timebase_WaitTick(uint64_t *timestamp)
+{
+	if(timebase_fd < 0)
+	{
+		return -1;
+	}
+	return Timebase_HandleEvent(timestamp);
+}
+
+/**
+ * @brief Runs a sampling loop locked to the square wave.
+ *		  The callback is called on every divider-th edge with that edge's timestamp,
+ *		  e.g. divider 16 on TIMEBASE_64HZ samples at 4 Hz. Lost edges still count towards the divider.
+ * @param divider Number of edges per callback, 0 is treated as 1.
+ * @param callback Sampling function, the loop ends when it returns non-zero.
+ * @param arg User pointer handed to the callback.
+ * @return status 0 when stopped by the callback, -1 on error.
+ */
+int Timebase_Loop(unsigned int divider, TimebaseCallback_t callback, void *arg)
+{
+	unsigned int count = 0;
+	uint64_t ts;
+
+	if(divider == 0)
+	{
+		divider = 1;
+	}
+
+	for(;;)
+	{
+		int ticks = Timebase_WaitTick(&ts);
+		if(ticks < 0)
+		{
+			return -1;
+		}
+		count += ticks;
+		if(count >= divider)
+		{
+			count %= divider;
+			if(callback(ts, arg))
+			{
+				return 0;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Copies the edge statistics.
+ * @param stats Structure to fill.
+ * @return none
+ */
+void Timebase_GetStats(TimebaseStats_t *stats)
+{
+	*stats = timebase_stats;
+}
+
+/// @}
+
+/**
+ * @brief Moves an edge timestamp onto the clock of timestamp_ns. The event was just read, so a CLOCK_REALTIME
+ *		  stamp is much closer to the realtime clock than to the monotonic one, whatever the kernel version.
+ */
+static uint64_t Timebase_Monotonic(uint64_t kernel_ns)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t real = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	uint64_t now = timestamp_ns();
+	uint64_t to_real = (real > kernel_ns) ? real - kernel_ns : kernel_ns - real;
+	uint64_t to_now = (now > kernel_ns) ? now - kernel_ns : kernel_ns - now;
+
+	if(to_real >= to_now)
+	{
+		return kernel_ns;
+	}
+	return (real > kernel_ns) ? now - to_real : now + to_real;		//Same age on the monotonic clock
+}
@@ -0,0 +1,48 @@
+/**
+ * @file Timebase.h
+ * @brief Header for the RTCC square wave timebase, which paces sampling from the MCP79410 crystal
+ */
+
+#ifndef __TIMEBASE_H__
+#define __TIMEBASE_H__
+
+#include <stdint.h>
+#include "MCP79410.h"
+
+#define TIMEBASE_GPIOCHIP	"/dev/gpiochip0"	/*!< GPIO character device the MFP line belongs to */
+#define TIMEBASE_MFP_LINE	24					/*!< BCM line number of MFP_PIN (P1-18) */
+
+/**
+ * @brief Square wave rates usable as a sampling timebase.
+ */
+typedef enum {TIMEBASE_1HZ = MFP_01H,		/**< 1 Hz square wave */
+			  TIMEBASE_64HZ = MFP_64H		/**< 64 Hz square wave */
+} TimebaseRate_t;
+
+/**
+ * @brief Running statistics of the received edges.
+ */
+typedef struct _TimebaseStats
+{
+	uint64_t ticks;				/**< Edges received since Timebase_Open */
+	uint64_t missed;			/**< Edges inferred lost from gaps in the edge timestamps */
+	uint64_t last_ns;			/**< Timestamp of the most recent edge, on the clock of timestamp_ns */
+	int64_t  max_jitter_ns;		/**< Largest deviation of an edge interval from the nominal period */
+} TimebaseStats_t;
+
+/**
+ * @brief Called on every n-th edge, returning non-zero stops Timebase_Loop.
+ */
+typedef int (*TimebaseCallback_t)(uint64_t timestamp_ns, void *arg);
+
+int 			Timebase_Open(TimebaseRate_t rate);
+void 			Timebase_Close(void);
+int 			Timebase_Fd(void);
+unsigned int 	Timebase_Hz(void);
+uint64_t 		Timebase_PeriodNs(void);
+int 			Timebase_WaitTick(uint64_t *timestamp);
+int 			Timebase_HandleEvent(uint64_t *timestamp);
+int 			Timebase_Loop(unsigned int divider, TimebaseCallback_t callback, void *arg);
+void 			Timebase_GetStats(TimebaseStats_t *stats);
+
+#endif
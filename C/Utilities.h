@@ -31,7 +31,16 @@ typedef enum PinLev {LOWLEVEL = 0, HIGHLEVEL} PinLevel_t;
 
 #endif
 
+#define POLL_READY_US	100		//Pause between two polls of poll_ready
+
 void delay_ms(unsigned int ms);
+uint64_t timestamp_ns(void);
+void wait_until_ns(uint64_t ns);
+void timestamp_set_clock(uint64_t (*now)(void), void (*wait_until)(uint64_t ns));
+int timestamp_is_virtual(void);
+int hardware_acquire(void);
+void hardware_release(void);
+int poll_ready(unsigned char (*ready)(void), unsigned int timeout_ms);
 
 PinLevel_t 	ReadPinStatus(PIN_t pin);
 void 		pinModeOutput(PIN_t pin);
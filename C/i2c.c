@@ -1,5 +1,23 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#undef CTRL			//sys/ttydefaults.h's CTRL() would clash with the MCP79410 register name
 #include "i2c.h"
+#include "Utilities.h"
+#include "BusStats.h"
+#include "BusTrace.h"
+#include "Shield.h"
+
+static int i2c_mapped = 0; /*!< 1 while I2C holds a hardware_acquire reference */
+static pthread_mutex_t bcm2835_lock = PTHREAD_MUTEX_INITIALIZER; /*!< Keeps the slave address with its transfer when several threads share the controller */
+
+static uint8_t I2C_Transfer(unsigned char address, BusOp_t op, const char *write, uint32_t write_length,
+							char *read, uint32_t read_length);
 
 /**
  *@brief Initializes the I2C peripheral
@@ -24,9 +42,18 @@ void I2C_Initialize(unsigned char address)
 */
 void I2C_Initialize(void)
 {    					
-	if (!bcm2835_init())						//Configure I2C pins
+	if (Shield_Current()->bus == SHIELD_BUS_I2C_DEV)	//Opened by Shield_Open, nothing to configure
 	{
-		printf("BCM libray error.\n");
+		return;
+	}
+	if (!i2c_mapped)
+	{
+		if (hardware_acquire() != 0)			//Shares the mapping with SPI and GPIO
+		{
+			printf("BCM libray error.\n");
+			return;
+		}
+		i2c_mapped = 1;
 	}
 	bcm2835_i2c_end();		//Close I2C peripheral to reconfigure it
 	
@@ -43,9 +70,8 @@ void I2C_Initialize(void)
  */
 void I2C_WriteByte(unsigned char address,char bdata)
 {
-	bcm2835_i2c_setSlaveAddress(address);
 	char data = bdata;
-	bcm2835_i2c_write(&data, 1);
+	I2C_Transfer(address, BUS_OP_WRITE, &data, 1, NULL, 0);
 }
 
 /**
@@ -56,15 +82,11 @@ void I2C_WriteByte(unsigned char address,char bdata)
  */
 void I2C_WriteByteRegister(unsigned char address,unsigned char reg,unsigned char data)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
-	unsigned char wr_buf[2];
+	char wr_buf[2];
 
 	wr_buf[0] = reg;
 	wr_buf[1] = data;
-
-	bcm2835_i2c_write((const char *)wr_buf, 2);
+	I2C_Transfer(address, BUS_OP_WRITE, wr_buf, 2, NULL, 0);
 }
 
 /**
@@ -75,16 +97,12 @@ void I2C_WriteByteRegister(unsigned char address,unsigned char reg,unsigned char
  */
 void I2C_WriteWordRegister(unsigned char address,unsigned char reg, unsigned char* data)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
-	unsigned char wr_buf[3];
+	char wr_buf[3];
 	
 	wr_buf[0] = reg;
 	wr_buf[1] = data[0];
 	wr_buf[2] = data[1];
-
-	bcm2835_i2c_write((const char *)wr_buf, 3);
+	I2C_Transfer(address, BUS_OP_WRITE, wr_buf, 3, NULL, 0);
 }
 
 /**
@@ -96,9 +114,6 @@ void I2C_WriteWordRegister(unsigned char address,unsigned char reg, unsigned cha
  */
 void I2C_WriteByteArray(unsigned char address, char reg, char* data, unsigned int length)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
 	char* wr_buf = (char*) malloc(sizeof(char) * length);
 	if (wr_buf==NULL) 
 	{
@@ -110,8 +125,7 @@ void I2C_WriteByteArray(unsigned char address, char reg, char* data, unsigned in
 	{
 		wr_buf[i] = data[i];
 	}
-
-	bcm2835_i2c_write((const char *)wr_buf, length);
+	I2C_Transfer(address, BUS_OP_WRITE, wr_buf, length, NULL, 0);
 }
 
 /**
@@ -121,13 +135,9 @@ void I2C_WriteByteArray(unsigned char address, char reg, char* data, unsigned in
  */
 unsigned char I2C_ReadByteRegister(unsigned char address, char reg)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
 	char val = 0;
  
-	bcm2835_i2c_read_register_rs(&reg,&val,1);
-	
+	I2C_Transfer(address, BUS_OP_WRITE_READ, &reg, 1, &val, 1);
 	return val;
 }
  
@@ -140,10 +150,7 @@ unsigned char I2C_ReadByteRegister(unsigned char address, char reg)
  */
 void I2C_ReadByteArray(unsigned char address,char reg,char *buffer,unsigned int  length)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
-	bcm2835_i2c_read_register_rs(&reg,buffer,length);
+	I2C_Transfer(address, BUS_OP_WRITE_READ, &reg, 1, buffer, length);
 }
 
  /**
@@ -153,14 +160,11 @@ void I2C_ReadByteArray(unsigned char address,char reg,char *buffer,unsigned int
  */
 unsigned int I2C_ReadWordRegisterRS(unsigned char address,char reg)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
 	char cmd[1] = {reg}; 
 	char receive[2] = {0};
-	bcm2835_i2c_write_read_rs(cmd,1,receive,2);
-	
-	return (receive[0]<<8)|receive[1];
+
+	I2C_Transfer(address, BUS_OP_WRITE_READ, cmd, 1, receive, 2);
+	return ((unsigned char) receive[0]<<8)|(unsigned char) receive[1];	//char may be signed
 }
 
 /**
@@ -169,12 +173,10 @@ unsigned int I2C_ReadWordRegisterRS(unsigned char address,char reg)
  */
 unsigned int I2C_ReadWordPresetPointer(unsigned char address)
 {
-	
-	bcm2835_i2c_setSlaveAddress(address);
-	
 	char val[2] = {0}; 
-	bcm2835_i2c_read(val,2);
-	unsigned int data = (val[0] << 8)|val[1];
+
+	I2C_Transfer(address, BUS_OP_READ, NULL, 0, val, 2);
+	unsigned int data = ((unsigned char) val[0] << 8)|(unsigned char) val[1];	//char may be signed
 	
 	return data;
 }
@@ -185,6 +187,66 @@ unsigned int I2C_ReadWordPresetPointer(unsigned char address)
  */
 void I2C_Close(void)
 {
+	if (Shield_Current()->bus == SHIELD_BUS_I2C_DEV)	//Closed by Shield_Close
+	{
+		return;
+	}
 	bcm2835_i2c_end();
+	if (i2c_mapped)
+	{
+		i2c_mapped = 0;
+		hardware_release();
+	}
 }
 
+/**
+ * @brief Sends one transfer to a chip of the shield bound to the calling thread, on that shield's
+ *		  transport and at that shield's address for the chip, and records it in the bus statistics and trace.
+ * @return reason BCM2835_I2C_REASON_OK, or the bcm2835 reason code of the failure.
+ */
+static uint8_t I2C_Transfer(unsigned char address, BusOp_t op, const char *write, uint32_t write_length,
+							char *read, uint32_t read_length)
+{
+	Shield_t *shield = Shield_Current();
+	uint8_t reason;
+
+	address = Shield_Address(shield, address);
+	BUS_STATS_START(t);
+	if (shield->bus == SHIELD_BUS_I2C_DEV)
+	{
+		struct i2c_msg msgs[2];
+		struct i2c_rdwr_ioctl_data transfer = {msgs, 0};
+		if (write_length)
+		{
+			msgs[transfer.nmsgs++] = (struct i2c_msg) {address, 0, (uint16_t) write_length, (uint8_t *) write};
+		}
+		if (read_length)
+		{
+			msgs[transfer.nmsgs++] = (struct i2c_msg) {address, I2C_M_RD, (uint16_t) read_length, (uint8_t *) read};
+		}
+		pthread_mutex_lock(&shield->bus_lock);
+		reason = (ioctl(shield->fd, I2C_RDWR, &transfer) < 0) ? BCM2835_I2C_REASON_ERROR_NACK : BCM2835_I2C_REASON_OK;
+		pthread_mutex_unlock(&shield->bus_lock);
+	}
+	else
+	{
+		pthread_mutex_lock(&bcm2835_lock);
+		bcm2835_i2c_setSlaveAddress(address);
+		if (op == BUS_OP_WRITE)
+		{
+			reason = bcm2835_i2c_write(write, write_length);
+		}
+		else if (op == BUS_OP_READ)
+		{
+			reason = bcm2835_i2c_read(read, read_length);
+		}
+		else
+		{
+			reason = bcm2835_i2c_write_read_rs((char *) write, write_length, read, read_length);
+		}
+		pthread_mutex_unlock(&bcm2835_lock);
+	}
+	BUS_STATS_RECORD(BUS_I2C, address, op, write_length + read_length, reason, t);
+	BUS_TRACE_RECORD(BUS_I2C, address, op, write, write_length, read, read_length, reason);
+	return reason;
+}
@@ -0,0 +1,632 @@
+/**
+ * @file sensoriand.c
+ * @brief Sensor daemon, the only process that touches the I2C, SPI and GPIO hardware
+ *
+ * The daemon runs setupSensorianFast once and keeps the scheduler
+ * sampling. Clients connect over the Unix socket in SensordProtocol.h with
+ * SensordClient.c. Each channel is sampled at the highest rate any client
+ * subscribed to (at least SENSORD_IDLE_HZ, so snapshots are never stale) and
+ * every client receives its own decimated stream, one packet per client per
+ * scheduler pass. TFT draws are queued and drawn by a separate thread so a
+ * slow screen update never delays the samples.
+ *
+ * Usage: sudo ./sensoriand [socket path [trace file]]
+ * kill -USR1 prints the bus statistics, which are printed on exit too. With a
+ * trace file the I2C transactions are recorded from the start and the trace is
+ * saved to it on USR1 and on exit, for replay with BUS_REPLAY, see FakeShield.c.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "TFT_Printer.h"
+#include "SensorsInterface.h"
+#include "BusStats.h"
+#include "BusTrace.h"
+#include "Scheduler.h"
+#include "SampleRing.h"
+#include "SensorShm.h"
+#include "SensordProtocol.h"
+
+#define SENSORD_MAX_CLIENTS		16			/*!< Connections served at once */
+#define SENSORD_IDLE_HZ			1.0f		/*!< Rate of channels nobody subscribed to */
+#define SENSORD_RING_SIZE		4096		/*!< Samples buffered between the scheduler and the main loop */
+#define SENSORD_TFT_QUEUE		32			/*!< Draws buffered for the TFT thread */
+#define SENSORD_TFT_IDLE_MS		60000		/*!< The TFT sleeps when nothing was drawn for this long */
+#define SENSORD_DISPATCH_BATCH	256			/*!< Samples taken from the ring at a time */
+
+/**
+ * @brief One packet of samples being filled for a client.
+ */
+typedef struct _SamplesPacket
+{
+	SensordHeader_t header;
+	Sample_t samples[SENSORD_MAX_SAMPLES];
+} SamplesPacket_t;
+
+/**
+ * @brief A connected client and its subscriptions.
+ */
+typedef struct _Client
+{
+	int fd;										/**< Non-blocking socket, -1 for a free slot */
+	uint32_t channels;							/**< Subscribed channel mask */
+	uint64_t period_ns[SENSOR_CHANNEL_COUNT];	/**< Requested sample spacing per channel */
+	uint64_t next_due[SENSOR_CHANNEL_COUNT];	/**< Earliest timestamp of the next sample to forward */
+	uint64_t dropped;							/**< Samples lost because the client did not read */
+	SamplesPacket_t packet;						/**< Samples of the current pass */
+} Client_t;
+
+static Client_t clients[SENSORD_MAX_CLIENTS];
+static float channel_hz[SENSOR_CHANNEL_COUNT];	/*!< Rate the scheduler currently runs each channel at */
+static SampleRing_t sample_ring;				/*!< Scheduler thread to main loop */
+static int sample_fd = -1;						/*!< eventfd signalled when the ring has new samples */
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t dump_stats = 0;
+
+static SensordTFT_t tft_queue[SENSORD_TFT_QUEUE];
+static unsigned int tft_head = 0, tft_tail = 0;
+static int tft_running = 1;
+static pthread_mutex_t tft_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tft_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Stops the main loop on SIGINT or SIGTERM.
+ */
+static void stop(int sig)
+{
+	running = 0;
+}
+
+/**
+ * @brief Asks the main loop to print the bus statistics on SIGUSR1.
+ */
+static void requestStats(int sig)
+{
+	dump_stats = 1;
+}
+
+/**
+ * @brief Scheduler callback, hands the samples to the main loop. Runs on the scheduler thread.
+ */
+static void onSamples(const Sample_t *samples, unsigned int count, void *arg)
+{
+	uint64_t one = 1;
+
+	SampleRing_Push(&sample_ring, samples, count);
+	if(write(sample_fd, &one, sizeof(one)) < 0)
+	{
+		perror("sensoriand wake");
+	}
+}
+
+/**
+ * @brief Runs every channel at the highest rate subscribed by any client.
+ */
+static void updateRates(void)
+{
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		float hz = SENSORD_IDLE_HZ;
+		for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+		{
+			if(clients[i].fd >= 0 && (clients[i].channels & SENSOR_CHANNEL_BIT(ch)))
+			{
+				float wanted = (float)(1e9 / clients[i].period_ns[ch]);
+				hz = (wanted > hz) ? wanted : hz;
+			}
+		}
+		if(hz != channel_hz[ch])
+		{
+			Scheduler_SetRate(ch, hz, 0);
+			channel_hz[ch] = hz;
+		}
+	}
+}
+
+/**
+ * @brief Sends one reply packet, dropping it if the client's socket is full.
+ */
+static void reply(Client_t *client, SensordMsgType_t type, uint32_t request_id, const void *payload, uint16_t length)
+{
+	char packet[SENSORD_MAX_MSG];
+	SensordHeader_t header = {.type = type, .length = length, .request_id = request_id};
+
+	memcpy(packet, &header, sizeof(header));
+	memcpy(packet + sizeof(header), payload, length);
+	send(client->fd, packet, sizeof(header) + length, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Replies with a negative errno value.
+ */
+static void replyError(Client_t *client, uint32_t request_id, int code)
+{
+	SensordError_t error = {.code = -code};
+	reply(client, SENSORD_MSG_ERROR, request_id, &error, sizeof(error));
+}
+
+/**
+ * @brief Closes a client and drops its subscriptions.
+ */
+static void dropClient(Client_t *client)
+{
+	close(client->fd);
+	client->fd = -1;
+	if(client->channels)
+	{
+		client->channels = 0;
+		updateRates();
+	}
+}
+
+/**
+ * @brief Sends the samples collected for a client in one packet.
+ */
+static void flushClient(Client_t *client)
+{
+	SamplesPacket_t *packet = &client->packet;
+	unsigned int count = packet->header.length / sizeof(Sample_t);
+
+	if(count == 0)
+	{
+		return;
+	}
+	packet->header.type = SENSORD_MSG_SAMPLES;
+	packet->header.request_id = 0;
+	if(send(client->fd, packet, sizeof(packet->header) + packet->header.length, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+	{
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			client->dropped += count;		//A stalled client must not hold up the others
+		}
+		else
+		{
+			dropClient(client);
+		}
+	}
+	packet->header.length = 0;
+}
+
+/**
+ * @brief Adds a sample to a client's packet if the client subscribed to it and is due for one.
+ */
+static void forwardSample(Client_t *client, const Sample_t *sample)
+{
+	unsigned int ch = sample->channel;
+	uint64_t period = client->period_ns[ch];
+	uint64_t ts = sample->timestamp_ns;
+
+	if((client->channels & SENSOR_CHANNEL_BIT(ch)) == 0 || ts + period / 2 < client->next_due[ch])
+	{
+		return;								//Decimated, another client asked for a higher rate
+	}
+	if(client->next_due[ch] + period + period / 2 <= ts)
+	{
+		client->next_due[ch] = ts + period;	//First sample or the stream had a gap, restart the grid
+	}
+	else
+	{
+		client->next_due[ch] += period;
+	}
+
+	SamplesPacket_t *packet = &client->packet;
+	packet->samples[packet->header.length / sizeof(Sample_t)] = *sample;
+	packet->header.length += sizeof(Sample_t);
+	if(packet->header.length / sizeof(Sample_t) == SENSORD_MAX_SAMPLES)
+	{
+		flushClient(client);
+	}
+}
+
+/**
+ * @brief Fans the samples of the ring out to the clients, one packet per client.
+ */
+static void dispatchSamples(void)
+{
+	uint64_t events;
+	const Sample_t *slots;
+	unsigned int count;
+
+	if(read(sample_fd, &events, sizeof(events)) < 0)
+	{
+		return;
+	}
+	while((count = SampleRing_Peek(&sample_ring, &slots, SENSORD_DISPATCH_BATCH)) > 0)
+	{
+		for(unsigned int s = 0; s < count; s++)
+		{
+			for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+			{
+				if(clients[i].fd >= 0 && slots[s].channel < SENSOR_CHANNEL_COUNT)
+				{
+					forwardSample(&clients[i], &slots[s]);
+				}
+			}
+		}
+		SampleRing_Release(&sample_ring, count);
+	}
+	for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+	{
+		if(clients[i].fd >= 0)
+		{
+			flushClient(&clients[i]);
+		}
+	}
+}
+
+/**
+ * @brief Queues a draw for the TFT thread.
+ * @return status 0 on success, -1 if the queue is full.
+ */
+static int queueDraw(const SensordTFT_t *draw)
+{
+	int status = -1;
+
+	pthread_mutex_lock(&tft_lock);
+	if(tft_head - tft_tail < SENSORD_TFT_QUEUE)
+	{
+		tft_queue[tft_head % SENSORD_TFT_QUEUE] = *draw;
+		tft_head++;
+		status = 0;
+		pthread_cond_signal(&tft_cond);
+	}
+	pthread_mutex_unlock(&tft_lock);
+	return status;
+}
+
+/**
+ * @brief Sets up the TFT, then draws the queued TFT requests in order. The TFT sleeps between draws
+ *		  more than SENSORD_TFT_IDLE_MS apart.
+ */
+static void* tftThread(void *arg)
+{
+	SensordTFT_t draw;
+
+	TFT_SetIdleTimeout(SENSORD_TFT_IDLE_MS);
+	TFT_Setup();							//Draws queue up meanwhile, sampling does not wait for the TFT
+	pthread_mutex_lock(&tft_lock);
+	for(;;)
+	{
+		while(tft_head == tft_tail && tft_running)
+		{
+			pthread_cond_wait(&tft_cond, &tft_lock);
+		}
+		if(tft_head == tft_tail)
+		{
+			break;
+		}
+		draw = tft_queue[tft_tail % SENSORD_TFT_QUEUE];
+		tft_tail++;
+		pthread_mutex_unlock(&tft_lock);
+
+		if(TFT_Acquire() != 0)				//Wakes the display if it went to sleep
+		{
+			pthread_mutex_lock(&tft_lock);
+			continue;
+		}
+		switch(draw.op)
+		{
+			case SENSORD_TFT_CLEAR:
+				TFT_Background(draw.color);
+				break;
+			case SENSORD_TFT_TEXT:
+				TFT_PrintString(draw.x, draw.y, draw.color, draw.background, draw.text, draw.size);
+				break;
+			case SENSORD_TFT_PIXEL:
+				TFT_SetPixel(draw.x, draw.y, draw.color);
+				break;
+			case SENSORD_TFT_PRINT:
+				TFT_Printer_PrintBoth(draw.color, draw.background, draw.text, draw.size);
+				break;
+		}
+		TFT_Release();
+		pthread_mutex_lock(&tft_lock);
+	}
+	pthread_mutex_unlock(&tft_lock);
+	return NULL;
+}
+
+/**
+ * @brief Handles one request packet of a client.
+ */
+static void handleRequest(Client_t *client)
+{
+	char packet[SENSORD_MAX_MSG];
+	SensordHeader_t header;
+	SensordSubscribe_t sub;
+	SensordTFT_t draw;
+	SensorSnapshot_t snapshot;
+
+	ssize_t n = recv(client->fd, packet, sizeof(packet), MSG_DONTWAIT);
+	if(n <= 0)
+	{
+		if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			dropClient(client);
+		}
+		return;
+	}
+	if(n < (ssize_t) sizeof(header))
+	{
+		return;
+	}
+	memcpy(&header, packet, sizeof(header));
+	if(header.length != n - sizeof(header))
+	{
+		replyError(client, header.request_id, EPROTO);
+		return;
+	}
+	const char *payload = packet + sizeof(header);
+
+	switch(header.type)
+	{
+		case SENSORD_MSG_SUBSCRIBE:
+		case SENSORD_MSG_UNSUBSCRIBE:
+		case SENSORD_MSG_SNAPSHOT_REQ:
+			if(header.length != sizeof(sub))
+			{
+				replyError(client, header.request_id, EPROTO);
+				return;
+			}
+			memcpy(&sub, payload, sizeof(sub));
+			sub.channels &= SENSOR_ALL_CHANNELS;
+			break;
+		case SENSORD_MSG_TFT:
+			if(header.length < offsetof(SensordTFT_t, text) || header.length > sizeof(draw))
+			{
+				replyError(client, header.request_id, EPROTO);
+				return;
+			}
+			memset(&draw, 0, sizeof(draw));
+			memcpy(&draw, payload, header.length);
+			draw.text[SENSORD_TEXT_MAX - 1] = '\0';
+			break;
+		default:
+			replyError(client, header.request_id, EINVAL);
+			return;
+	}
+
+	switch(header.type)
+	{
+		case SENSORD_MSG_SUBSCRIBE:
+			if(!(sub.hz > 0.0f) || sub.hz > 1000.0f)
+			{
+				replyError(client, header.request_id, EINVAL);
+				return;
+			}
+			for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+			{
+				if(sub.channels & SENSOR_CHANNEL_BIT(ch))
+				{
+					client->period_ns[ch] = (uint64_t)(1e9 / sub.hz);
+					client->next_due[ch] = 0;
+				}
+			}
+			client->channels |= sub.channels;
+			updateRates();
+			break;
+		case SENSORD_MSG_UNSUBSCRIBE:
+			client->channels &= ~sub.channels;
+			updateRates();
+			break;
+		case SENSORD_MSG_SNAPSHOT_REQ:
+			getLatestSnapshot(&snapshot);		//Published by the scheduler, never waits for the bus
+			snapshot.valid &= sub.channels;
+			for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+			{
+				snapshot.reading[ch].valid = (snapshot.valid >> ch) & 1;
+			}
+			reply(client, SENSORD_MSG_SNAPSHOT, header.request_id, &snapshot, sizeof(snapshot));
+			break;
+		case SENSORD_MSG_TFT:
+			if(draw.op > SENSORD_TFT_PRINT || queueDraw(&draw) != 0)
+			{
+				replyError(client, header.request_id, (draw.op > SENSORD_TFT_PRINT) ? EINVAL : EBUSY);
+			}
+			break;
+	}
+}
+
+/**
+ * @brief Accepts a connection and greets it with the protocol version.
+ */
+static void acceptClient(int listen_fd)
+{
+	SensordHello_t hello = {.version = SENSORD_VERSION, .channel_count = SENSOR_CHANNEL_COUNT};
+
+	int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if(fd < 0)
+	{
+		return;
+	}
+	for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+	{
+		if(clients[i].fd < 0)
+		{
+			memset(&clients[i], 0, sizeof(clients[i]));
+			clients[i].fd = fd;
+			reply(&clients[i], SENSORD_MSG_HELLO, 0, &hello, sizeof(hello));
+			return;
+		}
+	}
+	printf("sensoriand: too many clients.\n");
+	close(fd);
+}
+
+/**
+ * @brief Creates the listening socket, readable and writable by every user.
+ */
+static int listenSocket(const char *path)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+	{
+		perror("sensoriand socket");
+		return -1;
+	}
+	unlink(path);							//Left behind by a previous run
+	if(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, SENSORD_MAX_CLIENTS) < 0)
+	{
+		perror("sensoriand bind");
+		close(fd);
+		return -1;
+	}
+	chmod(path, 0666);
+	return fd;
+}
+
+/**
+ * @brief Saves the bus trace, if one is being recorded.
+ */
+static void saveTrace(const char *trace_path)
+{
+	if(trace_path != NULL && BusTrace_Save(trace_path) < 0)
+	{
+		printf("sensoriand: could not save the bus trace to %s.\n", trace_path);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = (argc > 1) ? argv[1] : SENSORD_SOCKET;
+	const char *trace_path = (argc > 2) ? argv[2] : NULL;
+	struct pollfd fds[2 + SENSORD_MAX_CLIENTS];
+	Client_t *polled[SENSORD_MAX_CLIENTS];
+	pthread_t tft_thread;
+
+	for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+	{
+		clients[i].fd = -1;
+	}
+	if(SampleRing_Init(&sample_ring, SENSORD_RING_SIZE) != 0 ||
+	   (sample_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+	{
+		return 1;
+	}
+	int listen_fd = listenSocket(path);
+	if(listen_fd < 0)
+	{
+		return 1;
+	}
+
+	//Only I2C is traced, the TFT reads nothing worth replaying and would crowd the sensors out of the ring
+	if(trace_path != NULL && BusTrace_Start(BUS_TRACE_DEFAULT_SIZE, BUS_TRACE_BUS_BIT(BUS_I2C)) != 0)
+	{
+		printf("sensoriand: bus tracing is not available, build with -DBUS_TRACE.\n");
+		trace_path = NULL;
+	}
+
+	SetupReport_t report;					//The only time the bring-up runs, clients skip it
+	if(setupSensorianFast(NULL, 0, &report) != 0)
+	{
+		for(int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
+		{
+			if((report.ready & (1UL << dev)) == 0)
+			{
+				printf("sensoriand: %s is not responding.\n", SensorDevice_Name(dev));
+			}
+		}
+	}
+
+	SensorShm_Create();						//Shared memory readers are served too
+	Scheduler_AddCallback(onSamples, NULL);
+	Scheduler_AddCallback(publishSamples, NULL);
+	Scheduler_AddCallback(SensorShm_Publish, NULL);
+	updateRates();
+	if(Scheduler_Start(SCHEDULER_TIMERFD) != 0)
+	{
+		return 1;
+	}
+	pthread_create(&tft_thread, NULL, tftThread, NULL);
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGUSR1, requestStats);
+	printf("sensoriand listening on %s, sensors ready in %.1f ms\n", path, report.total_us / 1000.0);
+
+	while(running)
+	{
+		int count = 0;
+		if(dump_stats)
+		{
+			dump_stats = 0;
+			BusStats_Dump(stdout);
+			saveTrace(trace_path);
+			fflush(stdout);
+		}
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = sample_fd;
+		fds[1].events = POLLIN;
+		for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+		{
+			if(clients[i].fd >= 0)
+			{
+				fds[2 + count].fd = clients[i].fd;
+				fds[2 + count].events = POLLIN;
+				polled[count++] = &clients[i];
+			}
+		}
+
+		if(poll(fds, 2 + count, -1) < 0)
+		{
+			continue;						//EINTR from the stop signal
+		}
+		if(fds[1].revents & POLLIN)
+		{
+			dispatchSamples();
+		}
+		for(int i = 0; i < count; i++)
+		{
+			if(fds[2 + i].revents && polled[i]->fd == fds[2 + i].fd)
+			{
+				handleRequest(polled[i]);
+			}
+		}
+		if(fds[0].revents & POLLIN)
+		{
+			acceptClient(listen_fd);
+		}
+	}
+
+	Scheduler_Stop();
+	pthread_mutex_lock(&tft_lock);
+	tft_running = 0;
+	pthread_cond_signal(&tft_cond);
+	pthread_mutex_unlock(&tft_lock);
+	pthread_join(tft_thread, NULL);
+	BusStats_Dump(stdout);
+	saveTrace(trace_path);
+
+	for(int i = 0; i < SENSORD_MAX_CLIENTS; i++)
+	{
+		if(clients[i].fd >= 0)
+		{
+			close(clients[i].fd);
+		}
+	}
+	close(listen_fd);
+	unlink(path);
+	SensorShm_Destroy();
+	SampleRing_Free(&sample_ring);
+	close(sample_fd);
+	return 0;
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env python
+
+"""Bench_Interface.py: Compares the latency of a read through ctypes and through the _sensorian extension module
+
+Run from the directory holding libsensorianplus.so and _sensorian.so. Built with make sim in i2c-devices-interface
+the library answers from the fake shield, and FAKESHIELD_VIRTUAL_TIME=1 keeps the bus time out of the numbers,
+which then show only the cost of crossing from Python into C and back.
+"""
+
+import sys
+import timeit
+from ctypes import *
+
+lib_sensorian = CDLL("./libsensorianplus.so")
+lib_sensorian.getAmbientLight.restype = c_float
+
+try:
+    import _sensorian
+except ImportError:
+    print("_sensorian.so is not built, run make in i2c-devices-interface")
+    sys.exit(1)
+
+
+def ctypesLight():
+    """Ambient light the way SensorsInterface.py read it before, through str() and float()"""
+    return float(str(lib_sensorian.getAmbientLight()))
+
+
+def ctypesAccelerometer():
+    """One ctypes call per axis"""
+    return lib_sensorian.getAccelX(), lib_sensorian.getAccelY(), lib_sensorian.getAccelZ()
+
+
+def ctypesRTCC():
+    """One ctypes call to poll and one per field"""
+    lib_sensorian.poll_rtcc()
+    return (lib_sensorian.get_rtcc_year(), lib_sensorian.get_rtcc_month(), lib_sensorian.get_rtcc_date(),
+            lib_sensorian.get_rtcc_hour(), lib_sensorian.get_rtcc_minute(), lib_sensorian.get_rtcc_second())
+
+
+## @var CASES
+# Name of the read, its ctypes version and its extension version
+CASES = [("getAmbientLight", ctypesLight, _sensorian.getAmbientLight),
+         ("getTemperature", lib_sensorian.getTemperature, _sensorian.getTemperature),
+         ("getAccelerometer", ctypesAccelerometer, _sensorian.getAccelerometer),
+         ("getRTCCtime", ctypesRTCC, _sensorian.getRTCCtime),
+         ("getLatestSnapshot", None, _sensorian.getLatestSnapshot)]
+
+
+def perCall(function, number):
+    """Best of five runs of number calls, in ns per call"""
+    return min(timeit.repeat(function, number=number, repeat=5)) / number * 1e9
+
+
+def main():
+    number = int(sys.argv[1]) if len(sys.argv) > 1 else 2000
+    _sensorian.setupSensorian()
+    _sensorian.pollMPL()
+    _sensorian.pollFXOS()
+    print("%-20s %12s %12s %8s" % ("read", "ctypes ns", "module ns", "speedup"))
+    for name, slow, fast in CASES:
+        fast_ns = perCall(fast, number)
+        if slow is None:
+            print("%-20s %12s %12.0f %8s" % (name, "-", fast_ns, "-"))
+            continue
+        slow_ns = perCall(slow, number)
+        print("%-20s %12.0f %12.0f %7.1fx" % (name, slow_ns, fast_ns, slow_ns / fast_ns))
+
+
+if __name__ == "__main__":
+    main()
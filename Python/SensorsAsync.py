@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+
+"""SensorsAsync.py: Reads the Sensorian sensors from asyncio without blocking the event loop
+
+The C library runs each read on a worker thread and makes an eventfd readable when it is done (SensorAsync.h).
+SensorsAsync registers that fd with the event loop, so any number of coroutines can wait on readings from one
+thread while the bus transfers, such as a 512 ms MPL3115A2 conversion, run without the GIL. Needs Python 3.
+
+    sensors = SensorsAsync()
+    light, temperature = await asyncio.gather(sensors.read(["light"]), sensors.read(["temperature"]))
+"""
+
+import asyncio
+import collections
+from ctypes import *
+
+## @var lib_sensorian
+# Points to the C Shared Object DLL which is used to call the Sensorian C functions
+lib_sensorian = CDLL("./libsensorianplus.so")
+lib_sensorian.SensorAsync_Submit.argtypes = [c_ulong, c_uint64]
+
+## @var CHANNELS
+# Channel names in the order of SensorChannel_t in SensorChannels.h
+CHANNELS = ["light", "temperature", "pressure", "altitude", "accel_x", "accel_y", "accel_z",
+            "mag_x", "mag_y", "mag_z", "touch", "rtcc"]
+
+## @var SAMPLE_VALID
+# Flag of a Sample holding a fresh reading, see SensorChannels.h
+SAMPLE_VALID = 0x0001
+
+## @var ASYNC_SAMPLES
+# Tag of the completions carrying samples published by a scheduler, SENSOR_ASYNC_SAMPLES in SensorAsync.h
+ASYNC_SAMPLES = 0
+
+
+class Sample(Structure):
+    """Mirrors Sample_t in SensorChannels.h"""
+    _fields_ = [("timestamp_ns", c_uint64), ("value", c_float), ("channel", c_uint16), ("flags", c_uint16)]
+
+
+class Completion(Structure):
+    """Mirrors SensorCompletion_t in SensorAsync.h"""
+    _fields_ = [("tag", c_uint64), ("count", c_int32), ("valid", c_uint32), ("samples", Sample * len(CHANNELS))]
+
+
+class SensorsAsync(object):
+    """Submits reads to the C library and resolves a future for each one when its eventfd reports it done."""
+
+    def __init__(self, loop=None, on_samples=None):
+        """Opens the request queue and registers its fd with the loop.
+
+        on_samples, if given, is called with a list of (channel name, value, timestamp_ns) for every batch a C
+        scheduler publishes through SensorAsync_Publish.
+        """
+        self.loop = loop if loop is not None else asyncio.get_event_loop()
+        self.on_samples = on_samples
+        self.fd = lib_sensorian.SensorAsync_Open()
+        if self.fd < 0:
+            raise OSError("SensorAsync_Open failed")
+        self.futures = {}  # Futures of the submitted reads by tag
+        self.backlog = collections.deque()  # Reads waiting for room in the C queue
+        self.next_tag = ASYNC_SAMPLES + 1
+        self.buffer = (Completion * 16)()  # Completions taken out per call
+        self.loop.add_reader(self.fd, self._ready)
+
+    def close(self):
+        """Stops watching the fd and the worker thread, and cancels the reads still waiting."""
+        self.loop.remove_reader(self.fd)
+        lib_sensorian.SensorAsync_Close()
+        for future in self.futures.values():
+            future.cancel()
+        self.futures.clear()
+        self.backlog.clear()
+
+    def read(self, channels=None):
+        """Returns a future of a dict from channel name to (value, timestamp_ns) for the channels read.
+
+        channels is a list of names from CHANNELS, None for all of them. Each chip is read with one burst.
+        """
+        mask = (1 << len(CHANNELS)) - 1 if channels is None else sum(1 << CHANNELS.index(c) for c in channels)
+        tag = self.next_tag
+        self.next_tag += 1
+        future = self.loop.create_future()
+        self.futures[tag] = future
+        if self.backlog or lib_sensorian.SensorAsync_Submit(mask, tag) != 0:
+            self.backlog.append((mask, tag))  # The queue is full, submitted once completions are collected
+        return future
+
+    def _ready(self):
+        """Called by the loop when the fd is readable, resolves the futures of the completed reads."""
+        while True:
+            n = lib_sensorian.SensorAsync_Complete(self.buffer, len(self.buffer))
+            for i in range(n):
+                self._complete(self.buffer[i])
+            if n < len(self.buffer):
+                break
+        while self.backlog and lib_sensorian.SensorAsync_Submit(*self.backlog[0]) == 0:
+            self.backlog.popleft()
+
+    def _complete(self, completion):
+        """Hands one completion to its future, or to on_samples for a published batch."""
+        if completion.tag == ASYNC_SAMPLES:
+            if self.on_samples is not None:
+                self.on_samples([(CHANNELS[s.channel], s.value, s.timestamp_ns)
+                                 for s in completion.samples[:completion.count] if s.flags & SAMPLE_VALID])
+            return
+        future = self.futures.pop(completion.tag, None)
+        if future is None or future.done():
+            return
+        future.set_result(dict((CHANNELS[s.channel], (s.value, s.timestamp_ns))
+                               for s in completion.samples if s.flags & SAMPLE_VALID))
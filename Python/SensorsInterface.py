@@ -6,9 +6,24 @@ from ctypes import *
 import time
 import calendar
 
+try:
+    import numpy
+except ImportError:  # The bulk calls then return ctypes arrays instead of numpy views
+    numpy = None
+
 ## @var lib_sensorian
 # Points to the C Shared Object DLL which is used to call the Sensorian C functions
 lib_sensorian = CDLL("./libsensorianplus.so")
+lib_sensorian.getAmbientLight.restype = c_float  # Tells Python to expect a float rather than the default of int
+
+try:
+    import _sensorian  # Compiled extension over the same library, see i2c-devices-interface/sensorianmodule.c
+except ImportError:
+    _sensorian = None
+
+## @var lib_fast
+# The extension module when it is built, else the ctypes handle. Both have the functions the getters below call.
+lib_fast = _sensorian if _sensorian is not None else lib_sensorian
 
 
 def setupSensorian():
@@ -16,7 +31,7 @@ def setupSensorian():
 
     Call the C version of the function using the DLL to set up all the Sensorian sensors and LCD.
     """
-    lib_sensorian.setupSensorian()
+    lib_fast.setupSensorian()
 
 
 def ledOn():
@@ -24,7 +39,7 @@ def ledOn():
 
     Call the C version of the function using the DLL to turn on the Sensorian's orange LED.
     """
-    lib_sensorian.LED_on()
+    lib_fast.LED_on()
 
 
 def ledOff():
@@ -32,7 +47,7 @@ def ledOff():
 
     Call the C version of the function using the DLL to turn off the Sensorian's orange LED.
     """
-    lib_sensorian.LED_off()
+    lib_fast.LED_off()
 
 
 def getAmbientLight():
@@ -40,10 +55,7 @@ def getAmbientLight():
 
     Call the C version of the function using the DLL to get the ambient light level.
     """
-    lightCall = lib_sensorian.getAmbientLight  # Creates a C function to be called later
-    lightCall.restype = c_float  # Tells Python to expect a return type of float rather than the default of int
-    lightString = str(lightCall())  # Calls the C function and stores the result in a string
-    return float(lightString)  # Returns a float when called
+    return lib_fast.getAmbientLight()  # Returns a float when called
 
 ## @var mpl_last_polled
 # Used to ensure the temperature/altitude/pressure sensor is not polled too often
@@ -58,15 +70,15 @@ def getTemperature():
     global mpl_last_polled  # Declares mpl_last_polled to be global since all three sensors share the timer
     if mpl_last_polled == -1:  # If this is the first time the sensor is polled, it is okay to poll it
         print "Polling MPL3115A2"
-        lib_sensorian.pollMPL()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollMPL()  # Polls the sensor since it is confirmed okay to do so
         mpl_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
     elif time.time() - mpl_last_polled > 30:  # If it has been at least 30 seconds since the last poll, it is safe
         print "Polling MPL3115A2"
-        lib_sensorian.pollMPL()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollMPL()  # Polls the sensor since it is confirmed okay to do so
         mpl_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
-    return lib_sensorian.getTemperature()  # Calls the C function to get the current temperature and return an int
+    return lib_fast.getTemperature()  # Calls the C function to get the current temperature and return an int
 
 
 def getAltitude():
@@ -77,15 +89,15 @@ def getAltitude():
     global mpl_last_polled  # Declares mpl_last_polled to be global since all three sensors share the timer
     if mpl_last_polled == -1:  # If this is the first time the sensor is polled, it is okay to poll it
         print "Polling MPL3115A2"
-        lib_sensorian.pollMPL()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollMPL()  # Polls the sensor since it is confirmed okay to do so
         mpl_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
     elif time.time() - mpl_last_polled > 30:  # If it has been at least 30 seconds since the last poll, it is safe
         print "Polling MPL3115A2"
-        lib_sensorian.pollMPL()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollMPL()  # Polls the sensor since it is confirmed okay to do so
         mpl_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
-    return lib_sensorian.getAltitude()  # Calls the C function to get the current altitude and return an int
+    return lib_fast.getAltitude()  # Calls the C function to get the current altitude and return an int
 
 
 def getBarometricPressure():
@@ -96,23 +108,26 @@ def getBarometricPressure():
     global mpl_last_polled  # Declares mpl_last_polled to be global since all three sensors share the timer
     if mpl_last_polled == -1:  # If this is the first time the sensor is polled, it is okay to poll it
         print "Polling MPL3115A2"
-        lib_sensorian.pollMPL()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollMPL()  # Polls the sensor since it is confirmed okay to do so
         mpl_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
     elif time.time() - mpl_last_polled > 30:  # If it has been at least 30 seconds since the last poll, it is safe
         print "Polling MPL3115A2"
-        lib_sensorian.pollMPL()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollMPL()  # Polls the sensor since it is confirmed okay to do so
         mpl_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
-    return lib_sensorian.getBarometricPressure()  # Calls the C function to get the current pressure and return an int
+    return lib_fast.getBarometricPressure()  # Calls the C function to get the current pressure and return an int
 
 
 def getTouchpad():
     """Gets an int of the capacitive button state.
 
-    Call the C version of the function using the DLL to get the capacitive button state.
+    Call the C version of the function using the DLL to get the capacitive button state, waking the sensor if
+    it was put to sleep while idle.
     """
-    return lib_sensorian.CAP1203_ReadPressedButton()
+    if _sensorian is not None:
+        return _sensorian.getTouchpad()
+    return lib_sensorian.getTouchpad()
 
 ## @var fxos_last_polled
 # Used to ensure the Accelerometer/Magnetometer sensor is not polled too often
@@ -126,12 +141,14 @@ def getAccelerometer():
     """
     global fxos_last_polled  # Declares fxos_last_polled to be global since the two sensors share the timer
     if fxos_last_polled == -1:  # If this is the first time the sensor is polled, it is okay to poll it
-        lib_sensorian.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
         fxos_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
     elif time.time() - fxos_last_polled > 1:  # If it has been at least 1 second since the last poll, it is safe
-        lib_sensorian.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
         fxos_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
+    if _sensorian is not None:
+        return _sensorian.getAccelerometer()  # All three forces in one call
     ac_x = lib_sensorian.getAccelX()  # Calls the C function to get the current x forces which returns an int
     ac_y = lib_sensorian.getAccelY()  # Calls the C function to get the current y forces which returns an int
     ac_z = lib_sensorian.getAccelZ()  # Calls the C function to get the current z forces which returns an int
@@ -145,12 +162,14 @@ def getMagnetometer():
     """
     global fxos_last_polled  # Declares fxos_last_polled to be global since the two sensors share the timer
     if fxos_last_polled == -1:  # If this is the first time the sensor is polled, it is okay to poll it
-        lib_sensorian.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
         fxos_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
     elif time.time() - fxos_last_polled > 1:  # If it has been at least 1 second since the last poll, it is safe
-        lib_sensorian.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
+        lib_fast.pollFXOS()  # Polls the sensor since it is confirmed okay to do so
         fxos_last_polled = time.time()  # Sets the last time the sensor was polled to the current time
 
+    if _sensorian is not None:
+        return _sensorian.getMagnetometer()  # All three magnetic forces in one call
     mag_x = lib_sensorian.getMagX()  # Calls the C function to get the current x magnetic forces which returns an int
     mag_y = lib_sensorian.getMagY()  # Calls the C function to get the current y magnetic forces which returns an int
     mag_z = lib_sensorian.getMagZ()  # Calls the C function to get the current z magnetic forces which returns an int
@@ -162,6 +181,8 @@ def getRTCCtime():
 
     Call the C version of the function using the DLL to get the date and time.
     """
+    if _sensorian is not None:
+        return _sensorian.getRTCCtime()  # Polls the clock and returns all six values in one call
     lib_sensorian.poll_rtcc()  # Call the C function to poll the real time clock, which has no limit on frequency
     # Call the respective C functions to get the year,month,date,hour,minute,second as integers
     year = lib_sensorian.get_rtcc_year()
@@ -258,6 +279,128 @@ def resetRTCCalarm():
     """
     lib_sensorian.reset_alarm()
 
+## @var CHANNELS
+# Channel names in the order of SensorChannel_t in SensorChannels.h
+CHANNELS = ["light", "temperature", "pressure", "altitude", "accel_x", "accel_y", "accel_z",
+            "mag_x", "mag_y", "mag_z", "touch", "rtcc"]
+
+
+class SensorReading(Structure):
+    """Mirrors SensorReading_t in SensorsInterface.h"""
+    _fields_ = [("timestamp_ns", c_uint64), ("value", c_float), ("valid", c_uint32)]
+
+
+def attachShared():
+    """Attaches to the readings published by a sampler process such as Example_Publisher.
+
+    Call the C version of the function using the DLL to map the shared segment. setupSensorian is not needed
+    and the bus is never touched, so any number of processes can read while one process owns the sensors.
+    Returns True if a publisher is running.
+    """
+    return lib_sensorian.SensorShm_Attach() == 0
+
+
+def getSharedReading(channel):
+    """Gets the latest published value of a channel as a float and its timestamp in nanoseconds.
+
+    Call the C version of the function using the DLL to copy the reading from shared memory, without system calls.
+    The channel is a name from CHANNELS. Returns None if the channel has not been published yet, or if the
+    publisher has stopped or restarted, in which case attachShared must be called again.
+    """
+    reading = SensorReading()  # Creates a C struct for the function to fill
+    if lib_sensorian.SensorShm_ReadChannel(CHANNELS.index(channel), byref(reading)) != 0:
+        return None
+    return reading.value, reading.timestamp_ns  # Returns the full precision value and when it was sampled
+
+
+class Sample(Structure):
+    """Mirrors Sample_t in SensorChannels.h, 16 bytes with no padding"""
+    _fields_ = [("timestamp_ns", c_uint64), ("value", c_float), ("channel", c_uint16), ("flags", c_uint16)]
+
+## @var SAMPLE_VALID
+# Flag of a Sample holding a fresh reading, see SensorChannels.h
+SAMPLE_VALID = 0x0001
+
+## @var SAMPLE_DTYPE
+# numpy record type with the layout of Sample, for views over the buffers filled by the C library
+SAMPLE_DTYPE = None
+if numpy is not None:
+    SAMPLE_DTYPE = numpy.dtype([("timestamp_ns", "<u8"), ("value", "<f4"), ("channel", "<u2"), ("flags", "<u2")])
+
+
+def _sampleView(buf, count):
+    """Returns the first count samples of a ctypes Sample array as a numpy record array sharing its memory."""
+    if numpy is None:
+        return buf[:count]
+    return numpy.frombuffer(buf, dtype=SAMPLE_DTYPE, count=count)
+
+
+def _channelMask(channels):
+    """Turns a list of names from CHANNELS into the channel mask the C functions take, None for all of them."""
+    if channels is None:
+        return (1 << len(CHANNELS)) - 1
+    mask = 0
+    for channel in channels:
+        mask |= 1 << CHANNELS.index(channel)
+    return mask
+
+
+def getSnapshotArray(channels=None):
+    """Reads every channel, or the names given in channels, with a single call into the C library.
+
+    Call the C version of the function using the DLL to fill one Sample per channel, indexed like CHANNELS.
+    Each chip is read with one burst, so this costs far less than calling the single value getters in turn.
+    Returns a numpy record array with the fields timestamp_ns, value, channel and flags, or a list of Sample
+    if numpy is not installed. Channels not read have no SAMPLE_VALID flag.
+    """
+    buf = (Sample * len(CHANNELS))()  # Creates a C array for the function to fill
+    lib_sensorian.getSnapshotSamples(buf, c_ulong(_channelMask(channels)))
+    return _sampleView(buf, len(CHANNELS))
+
+
+def getLatestArray():
+    """Gets the latest readings of every channel without touching the bus, in the same form as getSnapshotArray.
+
+    Call the C version of the function using the DLL to copy the readings last published in this process.
+    """
+    buf = (Sample * len(CHANNELS))()  # Creates a C array for the function to fill
+    lib_sensorian.getLatestSamples(buf)
+    return _sampleView(buf, len(CHANNELS))
+
+
+def getSnapshot(channels=None):
+    """Reads every channel, or the names given in channels, and returns a tuple indexed like CHANNELS.
+
+    Each entry is a (value, timestamp_ns) tuple, or None for a channel that was not read. Uses the extension
+    module when it is built, which converts the readings without going through ctypes, else getSnapshotSamples.
+    """
+    if _sensorian is not None:
+        return _sensorian.getSnapshot(_channelMask(channels))
+    buf = (Sample * len(CHANNELS))()  # Creates a C array for the function to fill
+    lib_sensorian.getSnapshotSamples(buf, c_ulong(_channelMask(channels)))
+    return tuple((s.value, s.timestamp_ns) if s.flags & SAMPLE_VALID else None for s in buf)
+
+
+## @var SHARED_HISTORY
+# Samples kept by a sampler process in the shared segment, SENSOR_SHM_HISTORY in SensorShm.h
+SHARED_HISTORY = 1024
+
+
+def getSharedHistory(cursor=0, count=SHARED_HISTORY):
+    """Gets up to count samples buffered by a sampler process since cursor, oldest first, with a single call.
+
+    Call the C version of the function using the DLL to copy the samples out of shared memory after attachShared.
+    Start with a cursor of 0 for the whole history and pass the returned cursor back to get only newer samples.
+    Returns the samples in the same form as getSnapshotArray and the new cursor, or None and the cursor if the
+    publisher has stopped or restarted, in which case attachShared must be called again.
+    """
+    buf = (Sample * count)()  # Creates a C array for the function to fill
+    position = c_uint64(cursor)
+    read_count = lib_sensorian.SensorShm_ReadHistory(byref(position), buf, c_uint(count))
+    if read_count < 0:
+        return None, position.value
+    return _sampleView(buf, read_count), position.value
+
 
 __author__ = "Michael Lescisin"
 __maintainer__ = "Dylan Kauling"
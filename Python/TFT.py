@@ -9,6 +9,7 @@ __version__ = "1.0"
 
 import numbers
 import time
+from ctypes import *
 from PIL import Image
 from PIL import ImageDraw
 import RPi.GPIO as GPIO
@@ -16,6 +17,16 @@ import spidev as spi
 
 spi = spi.SpiDev()
 
+# Frame conversion and diff in C, see RGB565.h. Without the library display converts and sends whole frames in Python.
+try:
+	lib_sensorian = CDLL("./libsensorianplus.so")
+	lib_sensorian.RGB565_Convert
+except (OSError, AttributeError):
+	lib_sensorian = None
+
+RGB565_DITHER = 0x01	# Ordered dither instead of truncating the colours
+MAX_RECTS = 8			# Changed areas flushed separately per frame, further changes merge into the last one
+
 #Loosely based on some snippets from Adafruit display driver.
 
 # Constants for interacting with display registers.
@@ -142,6 +153,10 @@ def color565(r, g, b):
 	"""
 	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
 
+class RGB565Rect(Structure):
+	"""Mirrors RGB565Rect_t in RGB565.h, inclusive bounds"""
+	_fields_ = [("x0", c_uint16), ("y0", c_uint16), ("x1", c_uint16), ("y1", c_uint16)]
+
 def image_to_data(image):
 	"""Generator function to convert a PIL image to 16-bit 565 RGB bytes.
 	
@@ -187,6 +202,10 @@ class TFT(object):
 		GPIO.setup(self.rst, GPIO.OUT)	
 		self.CE_DESELECT()
 		self.buffer = Image.new('RGB', (self.width, self.height))	# Create an image buffer.
+		self.frame = create_string_buffer(self.width * self.height * 2)		# Converted frame
+		self.cropped = create_string_buffer(self.width * self.height * 2)	# One changed area, contiguous
+		self.rects = (RGB565Rect * MAX_RECTS)()
+		self.previous = None		# Frame last sent, None when the display RAM is not known
 	
 	def CE_OUTPUT(self):
 		"""
@@ -235,6 +254,11 @@ class TFT(object):
 		# Convert scalar argument to list so either can be passed as parameter.
 		if isinstance(data, numbers.Number):
 			data = [data & 0xFF]
+		if hasattr(spi, "writebytes2"):		# spidev 3.4 and later take any buffer and split it themselves
+			spi.writebytes2(data)
+			return
+		if not isinstance(data, list):
+			data = list(bytearray(data))
 		# Write data a chunk at a time.
 		for start in range(0, len(data), length):
 			end = min(start+length, len(data))
@@ -295,6 +319,7 @@ class TFT(object):
 		
 		GPIO.output(self.dc, 0)
 		GPIO.output(self.rst, 1)
+		self.previous = None		# The reset leaves the display RAM undefined
 		
 		self.command(SWRESET) 
 		time.sleep(0.015)
@@ -413,29 +438,28 @@ class TFT(object):
 		if y1 is None:
 			y1 = self.height-1
 		self.command(CASET)		# Column addr set
-		self.data(x0 >> 8)
-		self.data(x0)					# XSTART 
-		self.data(x1 >> 8)
-		self.data(x1)					# XEND
+		self.data([x0 >> 8, x0 & 0xFF, x1 >> 8, x1 & 0xFF])		# XSTART, XEND
 		self.command(RASET)		# Row addr set
-		self.data(y0 >> 8)
-		self.data(y0)					# YSTART
-		self.data(y1 >> 8)
-		self.data(y1)					# YEND
+		self.data([y0 >> 8, y0 & 0xFF, y1 >> 8, y1 & 0xFF])		# YSTART, YEND
 		self.command(RAMWR)		# write to RAM
 
-	def display(self, image=None):
+	def display(self, image=None, dither=False):
 		"""
 		Write the provided image to the hardware. If no image parameter is provided the display buffer will be written to the hardware.  
 		If an image is provided, it should be RGB format and the same dimensions as the display hardware.
+		With the C library only the areas that changed since the last frame are sent.
 		
 		
 		:param image: picture image
+		:param dither: Dither the colours down to 16 bits instead of truncating them
 		:returns none :
 		"""
 		# By default write the internal buffer to the display.
 		if image is None:
 			image = self.buffer
+		if lib_sensorian is not None and image.size == (self.width, self.height):
+			self.displayChanged(image, dither)
+			return
 		# Set address bounds to entire display.
 		self.setAddrWindow()
 		# Convert image to array of 16bit 565 RGB data bytes.
@@ -445,6 +469,34 @@ class TFT(object):
 		pixelbytes = list(image_to_data(image))
 		# Write data to hardware.
 		self.data(pixelbytes)
+		self.previous = None
+
+	def displayChanged(self, image, dither=False):
+		"""
+		Converts the image in C and writes only the areas that differ from the frame last sent.
+		The first frame, and the first after initialize or setRotation, is written whole.
+		
+		
+		:param image: picture image of the display's size, RGB or RGBA
+		:param dither: Dither the colours down to 16 bits instead of truncating them
+		:returns none :
+		"""
+		if image.mode not in ('RGB', 'RGBA'):
+			image = image.convert('RGB')
+		channels = len(image.mode)
+		lib_sensorian.RGB565_Convert(image.tobytes(), self.width, self.height, self.width * channels, channels,
+									 RGB565_DITHER if dither else 0, self.frame)
+		if self.previous is None:
+			self.previous = create_string_buffer(self.frame.raw, len(self.frame))
+			self.setAddrWindow()
+			self.data(self.frame.raw)
+			return
+		count = lib_sensorian.RGB565_Diff(self.frame, self.previous, self.width, self.height, self.rects, MAX_RECTS)
+		for i in range(count):
+			rect = self.rects[i]
+			self.setAddrWindow(rect.x0, rect.y0, rect.x1, rect.y1)
+			length = lib_sensorian.RGB565_Crop(self.frame, self.width, byref(rect), self.cropped)
+			self.data(string_at(self.cropped, length))
 
 	def clear(self, color=(0,0,0)):
 		"""
@@ -487,6 +539,7 @@ class TFT(object):
 		:param mode: orientation data   
 		:returns none :
 		"""
+		self.previous = None		# The display RAM is addressed differently from now on
 		self.command(MADCTL)
 		if (mode == 0x00):
 			 self.data(MADCTL_MY | MADCTL_MX| MADCTL_BGR)	#portrait
@@ -28,6 +28,8 @@
 
 /***********************COMMAND REG*****************************/
 #define COMMAND             0x80
+#define APDS9300_PARTNO     0x50        //Upper nibble of the ID register
+#define APDS9300_S3_MS      402         //Integration time of S3, the first reading is valid after it
 #define CMD_CLEAR_INT       0x40
 #define CMD_WORD            0x20
 
@@ -0,0 +1,339 @@
+/**
+ * @file BusStats.c
+ * @brief Counts the transactions and bytes of every device on the I2C and SPI buses and keeps a
+ *		  histogram of their latencies.
+ *
+ * i2c.c and SPI.c wrap every transfer in BUS_STATS_START and BUS_STATS_RECORD.
+ * A record costs a counter read, a table lookup and a few additions. The
+ * counters are plain, not atomic, since each bus already expects one
+ * transaction at a time. Two threads using the same bus at once may lose a
+ * count, never corrupt the bus.
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "BusStats.h"
+
+#define BUS_NO_SLOT		0xFF		//bus_slot entry of a device not seen yet
+
+#ifdef BUS_STATS
+
+static BusOpStats_t bus_stats[BUS_COUNT][BUS_STATS_MAX_DEVICES][BUS_OP_COUNT];
+static uint8_t bus_slot[BUS_COUNT][256];					/*!< Slot of each device address */
+static uint16_t bus_device[BUS_COUNT][BUS_STATS_MAX_DEVICES];	/*!< Address of each slot */
+static unsigned int bus_devices[BUS_COUNT];					/*!< Slots in use */
+static uint64_t bus_tick_scale = 0;						/*!< ns per tick in 16.16 fixed point, 0 until known */
+static pthread_mutex_t bus_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t bus_once = PTHREAD_ONCE_INIT;
+
+static void BusStats_Init(void);
+static unsigned int BusStats_Slot(Bus_t bus, unsigned int device);
+
+#endif
+
+/// \defgroup busstats Bus statistics
+/// These functions report the transaction counts and latencies of the I2C and SPI buses.
+/// @{
+
+#ifdef BUS_STATS
+
+/**
+ * @brief Reads the monotonic clock in ns, used by BusStats_Ticks where no cycle counter can be read.
+ * @return ns Monotonic time.
+ */
+uint64_t BusStats_Clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Records one transaction. Called through BUS_STATS_RECORD.
+ * @param bus Bus used
+ * @param device I2C address, 0 for the SPI display
+ * @param op Kind of transaction
+ * @param bytes Bytes written and read
+ * @param error Non zero if the controller reported a failure
+ * @param start BusStats_Ticks before the transaction
+ * @return none
+ */
+void BusStats_Record(Bus_t bus, unsigned int device, BusOp_t op, uint32_t bytes, int error, uint64_t start)
+{
+	uint64_t ticks = BusStats_Ticks() - start;
+
+	if(bus_tick_scale == 0)
+	{
+		pthread_once(&bus_once, BusStats_Init);
+	}
+	unsigned int slot = bus_slot[bus][device & 0xFF];
+	if(slot == BUS_NO_SLOT)
+	{
+		slot = BusStats_Slot(bus, device);
+		if(slot == BUS_NO_SLOT)
+		{
+			return;
+		}
+	}
+
+	uint64_t ns = (ticks * bus_tick_scale) >> 16;
+	unsigned int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+	BusOpStats_t *s = &bus_stats[bus][slot][op];
+
+	s->count++;
+	s->bytes += bytes;
+	s->errors += (error != 0);
+	s->total_ns += ns;
+	if(ns > s->max_ns)
+	{
+		s->max_ns = ns;
+	}
+	s->histogram[(bucket < BUS_STATS_BUCKETS) ? bucket : BUS_STATS_BUCKETS - 1]++;
+}
+
+#endif
+
+/**
+ * @brief Tells whether the library was built with the bus statistics.
+ * @return enabled 1 if built with -DBUS_STATS, 0 otherwise.
+ */
+int BusStats_Enabled(void)
+{
+#ifdef BUS_STATS
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief Copies the counters of one operation on one device.
+ * @param bus Bus of the device
+ * @param device I2C address, 0 for the SPI display
+ * @param op Kind of transaction
+ * @param stats Receives the counters, zeroed if the device was never used
+ * @return status 0 on success, -1 for invalid arguments or when the statistics are compiled out.
+ */
+int BusStats_Get(Bus_t bus, unsigned int device, BusOp_t op, BusOpStats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+#ifdef BUS_STATS
+	if((unsigned) bus >= BUS_COUNT || (unsigned) op >= BUS_OP_COUNT || device > 0xFF)
+	{
+		return -1;
+	}
+	unsigned int slot = bus_slot[bus][device];
+	if(slot != BUS_NO_SLOT && slot < bus_devices[bus] && bus_device[bus][slot] == device)
+	{
+		*stats = bus_stats[bus][slot][op];
+	}
+	return 0;
+#else
+	(void) bus;
+	(void) device;
+	(void) op;
+	return -1;
+#endif
+}
+
+/**
+ * @brief Lists the devices that have been used on a bus, in order of first use.
+ * @param bus Bus to list
+ * @param devices Array receiving the I2C addresses, or 0 for the SPI display
+ * @param count Size of the array
+ * @return count Number of devices written.
+ */
+unsigned int BusStats_Devices(Bus_t bus, unsigned int *devices, unsigned int count)
+{
+	unsigned int n = 0;
+#ifdef BUS_STATS
+	if((unsigned) bus < BUS_COUNT)
+	{
+		pthread_mutex_lock(&bus_slot_lock);
+		for(; n < bus_devices[bus] && n < count; n++)
+		{
+			devices[n] = bus_device[bus][n];
+		}
+		pthread_mutex_unlock(&bus_slot_lock);
+	}
+#else
+	(void) bus;
+	(void) devices;
+	(void) count;
+#endif
+	return n;
+}
+
+/**
+ * @brief Estimates a latency percentile from the histogram, as the upper end of the bucket it falls in.
+ * @param stats Counters from BusStats_Get
+ * @param percent Percentile, 0 to 100
+ * @return ns Latency at or below which that share of the transactions completed, 0 without transactions.
+ */
+uint64_t BusStats_Percentile(const BusOpStats_t *stats, unsigned int percent)
+{
+	uint64_t rank = (stats->count * (percent > 100 ? 100 : percent) + 99) / 100;
+	uint64_t seen = 0;
+
+	if(stats->count == 0)
+	{
+		return 0;
+	}
+	for(unsigned int k = 0; k < BUS_STATS_BUCKETS; k++)
+	{
+		seen += stats->histogram[k];
+		if(seen >= rank && seen > 0)
+		{
+			uint64_t upper = (2ULL << k) - 1;
+			return (upper < stats->max_ns) ? upper : stats->max_ns;
+		}
+	}
+	return stats->max_ns;
+}
+
+/**
+ * @brief Names the chip at a bus address.
+ * @param bus Bus of the device
+ * @param device I2C address, 0 for the SPI display
+ * @return name Chip name, "?" for an unknown address.
+ */
+const char* BusStats_DeviceName(Bus_t bus, unsigned int device)
+{
+	if(bus == BUS_SPI)
+	{
+		return "ST7735";
+	}
+	switch(device)		//The addresses of the driver headers, which cannot all be included together
+	{
+		case 0x1E:
+			return "FXOS8700CQ";
+		case 0x28:
+			return "CAP1203";
+		case 0x29:
+			return "APDS9300";
+		case 0x57:
+			return "MCP79410 EEPROM";
+		case 0x60:
+			return "MPL3115A2";
+		case 0x6F:
+			return "MCP79410";
+		default:
+			return "?";
+	}
+}
+
+/**
+ * @brief Clears every counter. Devices keep their slots.
+ * @return none
+ */
+void BusStats_Reset(void)
+{
+#ifdef BUS_STATS
+	pthread_mutex_lock(&bus_slot_lock);
+	memset(bus_stats, 0, sizeof(bus_stats));
+	pthread_mutex_unlock(&bus_slot_lock);
+#endif
+}
+
+/**
+ * @brief Prints a table of every device and operation used, with latency percentiles and the
+ *		  non empty histogram buckets.
+ * @param out Stream to print to, e.g. stdout
+ * @return none
+ */
+void BusStats_Dump(FILE *out)
+{
+#ifdef BUS_STATS
+	static const char *bus_names[BUS_COUNT] = {"I2C", "SPI"};
+	static const char *op_names[BUS_OP_COUNT] = {"read", "write", "write-read"};
+	unsigned int devices[BUS_STATS_MAX_DEVICES];
+	BusOpStats_t s;
+
+	fprintf(out, "%-4s %-20s %-10s %10s %12s %7s %10s %10s %10s %10s\n", "bus", "device", "op", "count", "bytes",
+			"errors", "mean_us", "p50_us", "p99_us", "max_us");
+	for(int bus = 0; bus < BUS_COUNT; bus++)
+	{
+		unsigned int n = BusStats_Devices(bus, devices, BUS_STATS_MAX_DEVICES);
+		for(unsigned int d = 0; d < n; d++)
+		{
+			for(int op = 0; op < BUS_OP_COUNT; op++)
+			{
+				BusStats_Get(bus, devices[d], op, &s);
+				if(s.count == 0)
+				{
+					continue;
+				}
+				char name[32];
+				snprintf(name, sizeof(name), "0x%02X %s", devices[d], BusStats_DeviceName(bus, devices[d]));
+				fprintf(out, "%-4s %-20s %-10s %10llu %12llu %7llu %10.1f %10.1f %10.1f %10.1f\n", bus_names[bus],
+						name, op_names[op], (unsigned long long) s.count, (unsigned long long) s.bytes,
+						(unsigned long long) s.errors, s.total_ns / 1000.0 / s.count,
+						BusStats_Percentile(&s, 50) / 1000.0, BusStats_Percentile(&s, 99) / 1000.0, s.max_ns / 1000.0);
+				fprintf(out, "     histogram");
+				for(int k = 0; k < BUS_STATS_BUCKETS; k++)
+				{
+					if(s.histogram[k])
+					{
+						unsigned long long upper = 2ULL << k;
+						if(upper < 10000)
+						{
+							fprintf(out, " <%lluns:%u", upper, s.histogram[k]);
+						}
+						else
+						{
+							fprintf(out, " <%lluus:%u", (upper + 999) / 1000, s.histogram[k]);
+						}
+					}
+				}
+				fprintf(out, "\n");
+			}
+		}
+	}
+#else
+	fprintf(out, "Bus statistics are compiled out, build with -DBUS_STATS to enable them.\n");
+#endif
+}
+
+/// @}
+
+#ifdef BUS_STATS
+
+/**
+ * @brief Empties the slot table and measures the tick rate of BusStats_Ticks.
+ */
+static void BusStats_Init(void)
+{
+	uint64_t hz = 1000000000ULL;
+
+	memset(bus_slot, BUS_NO_SLOT, sizeof(bus_slot));
+#if defined(__aarch64__)
+	__asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (hz));
+#elif defined(__arm__) && __ARM_ARCH >= 7
+	uint32_t frq;
+	__asm__ __volatile__("mrc p15, 0, %0, c14, c0, 0" : "=r" (frq));
+	hz = frq;
+#endif
+	__atomic_store_n(&bus_tick_scale, (1000000000ULL << 16) / hz, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Gives a device its slot on first use.
+ */
+static unsigned int BusStats_Slot(Bus_t bus, unsigned int device)
+{
+	pthread_mutex_lock(&bus_slot_lock);
+	unsigned int slot = bus_slot[bus][device & 0xFF];
+	if(slot == BUS_NO_SLOT && bus_devices[bus] < BUS_STATS_MAX_DEVICES)
+	{
+		slot = bus_devices[bus];
+		bus_device[bus][slot] = device & 0xFF;
+		__atomic_store_n(&bus_slot[bus][device & 0xFF], slot, __ATOMIC_RELEASE);
+		bus_devices[bus]++;
+	}
+	pthread_mutex_unlock(&bus_slot_lock);
+	return slot;
+}
+
+#endif
@@ -0,0 +1,414 @@
+/**
+ * @file BusTrace.c
+ * @brief Records the I2C and SPI transactions into a binary trace ring, saves it and reads it back.
+ *
+ * i2c.c and SPI.c pass every transfer to BUS_TRACE_RECORD. A record is two
+ * bytes for the bus, operation, result and address, three varints for the
+ * time since the previous record in us and the write and read lengths, then
+ * the bytes written and read. An I2C register read takes about 8 bytes. When
+ * the ring is full the oldest records are overwritten, so a unit can record
+ * for as long as it runs and the trace holds what happened last.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "BusTrace.h"
+
+#define BUS_TRACE_HEAD_MAX		32		//Encoded size of the fixed fields and three varints, at most
+
+#ifdef BUS_TRACE
+
+static uint8_t *trace_ring = NULL;
+static size_t trace_size = 0;
+static size_t trace_head = 0;			/*!< Where the next record goes */
+static size_t trace_tail = 0;			/*!< Oldest record */
+static size_t trace_used = 0;			/*!< Bytes between tail and head */
+static uint64_t trace_records = 0;		/*!< Records in the ring */
+static uint64_t trace_dropped = 0;		/*!< Records overwritten, or too large for the ring */
+static uint64_t trace_first_us = 0;		/*!< Monotonic time of the oldest record */
+static uint64_t trace_last_us = 0;		/*!< Monotonic time of the newest record */
+static unsigned int trace_buses = 0;	/*!< Buses being recorded, 0 when stopped */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t BusTrace_Clock(clockid_t clock);
+static void BusTrace_Put(const uint8_t *bytes, size_t length);
+static uint64_t BusTrace_Varint(size_t *pos);
+static void BusTrace_Evict(void);
+static size_t BusTrace_PutVarint(uint8_t *out, uint64_t value);
+
+#endif
+
+static int BusTrace_GetVarint(const uint8_t *data, size_t size, size_t *pos, uint64_t *value);
+
+/// \defgroup bustrace Bus trace
+/// These functions record the bus transactions and read saved traces.
+/// @{
+
+#ifdef BUS_TRACE
+
+/**
+ * @brief Records one transaction. Called through BUS_TRACE_RECORD, returns at once while stopped.
+ * @param bus Bus used
+ * @param address I2C address, 0 for the SPI display
+ * @param op Kind of transaction
+ * @param write Bytes written
+ * @param write_length Number of bytes written
+ * @param read Bytes received, as the driver saw them
+ * @param read_length Number of bytes read
+ * @param result bcm2835 I2C reason code, 0 for SPI
+ * @return none
+ */
+void BusTrace_Record(Bus_t bus, unsigned int address, BusOp_t op, const void *write, uint32_t write_length,
+					 const void *read, uint32_t read_length, int result)
+{
+	uint8_t head[BUS_TRACE_HEAD_MAX];
+
+	if((__atomic_load_n(&trace_buses, __ATOMIC_RELAXED) & BUS_TRACE_BUS_BIT(bus)) == 0)
+	{
+		return;
+	}
+	uint64_t now = BusTrace_Clock(CLOCK_MONOTONIC) / 1000;
+
+	pthread_mutex_lock(&trace_lock);
+	if((trace_buses & BUS_TRACE_BUS_BIT(bus)) == 0)
+	{
+		pthread_mutex_unlock(&trace_lock);			//Stopped meanwhile
+		return;
+	}
+	head[0] = (uint8_t)((bus << 7) | (op << 5) | (result & 0x1F));
+	head[1] = (uint8_t) address;
+	size_t n = 2;
+	n += BusTrace_PutVarint(head + n, (trace_records && now > trace_last_us) ? now - trace_last_us : 0);
+	n += BusTrace_PutVarint(head + n, write_length);
+	n += BusTrace_PutVarint(head + n, read_length);
+
+	size_t length = n + write_length + read_length;
+	if(length > trace_size)
+	{
+		trace_dropped++;
+		pthread_mutex_unlock(&trace_lock);
+		return;
+	}
+	while(trace_size - trace_used < length)
+	{
+		BusTrace_Evict();
+	}
+	if(trace_records == 0)
+	{
+		trace_first_us = now;
+	}
+	BusTrace_Put(head, n);
+	BusTrace_Put(write, write_length);
+	BusTrace_Put(read, read_length);
+	trace_records++;
+	trace_last_us = now;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+#endif
+
+/**
+ * @brief Starts recording into an empty ring, replacing any earlier recording.
+ * @param size Ring size in bytes, e.g. BUS_TRACE_DEFAULT_SIZE
+ * @param buses Buses to record, e.g. BUS_TRACE_BUS_BIT(BUS_I2C) | BUS_TRACE_BUS_BIT(BUS_SPI)
+ * @return status 0 on success, -1 without memory or when the recorder is compiled out.
+ */
+int BusTrace_Start(size_t size, unsigned int buses)
+{
+#ifdef BUS_TRACE
+	uint8_t *ring = (uint8_t*) malloc(size);
+	if(ring == NULL || size < BUS_TRACE_HEAD_MAX)
+	{
+		free(ring);
+		return -1;
+	}
+	pthread_mutex_lock(&trace_lock);
+	free(trace_ring);
+	trace_ring = ring;
+	trace_size = size;
+	trace_head = trace_tail = trace_used = 0;
+	trace_records = trace_dropped = 0;
+	__atomic_store_n(&trace_buses, buses, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&trace_lock);
+	return 0;
+#else
+	(void) size;
+	(void) buses;
+	return -1;
+#endif
+}
+
+/**
+ * @brief Stops recording. The ring is kept until the next BusTrace_Start and can still be saved.
+ * @return none
+ */
+void BusTrace_Stop(void)
+{
+#ifdef BUS_TRACE
+	pthread_mutex_lock(&trace_lock);
+	__atomic_store_n(&trace_buses, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&trace_lock);
+#endif
+}
+
+/**
+ * @brief Writes the records in the ring to a file, oldest first. Recording goes on meanwhile.
+ * @param path File to create or replace
+ * @return records Number of records saved, -1 if nothing was recorded or the file could not be written.
+ */
+int BusTrace_Save(const char *path)
+{
+#ifdef BUS_TRACE
+	BusTraceHeader_t header = {.magic = BUS_TRACE_MAGIC, .version = BUS_TRACE_VERSION};
+
+	pthread_mutex_lock(&trace_lock);
+	uint8_t *data = (trace_ring != NULL) ? (uint8_t*) malloc(trace_used + 1) : NULL;
+	if(data == NULL)
+	{
+		pthread_mutex_unlock(&trace_lock);
+		return -1;
+	}
+	size_t size = trace_used;
+	size_t first = trace_size - trace_tail;			//Bytes up to the end of the ring
+	if(first > size)
+	{
+		first = size;
+	}
+	memcpy(data, trace_ring + trace_tail, first);
+	memcpy(data + first, trace_ring, size - first);
+	header.buses = (uint16_t) trace_buses;
+	header.records = trace_records;
+	header.dropped = trace_dropped;
+	header.start_ns = trace_first_us * 1000 + BusTrace_Clock(CLOCK_REALTIME) - BusTrace_Clock(CLOCK_MONOTONIC);
+	pthread_mutex_unlock(&trace_lock);
+
+	FILE *f = fopen(path, "wb");
+	int ok = (f != NULL && fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(data, 1, size, f) == size);
+	if(f != NULL && fclose(f) != 0)
+	{
+		ok = 0;
+	}
+	free(data);
+	return ok ? (int) header.records : -1;
+#else
+	(void) path;
+	return -1;
+#endif
+}
+
+/**
+ * @brief Loads a saved trace for reading.
+ * @param reader Reader to fill, positioned at the first record
+ * @param path Trace file
+ * @return status 0 on success, -1 if the file cannot be read or is not a trace.
+ */
+int BusTraceReader_Open(BusTraceReader_t *reader, const char *path)
+{
+	memset(reader, 0, sizeof(*reader));
+	FILE *f = fopen(path, "rb");
+	if(f == NULL)
+	{
+		return -1;
+	}
+	long end = -1;
+	if(fread(&reader->header, sizeof(reader->header), 1, f) == 1 && reader->header.magic == BUS_TRACE_MAGIC &&
+	   reader->header.version == BUS_TRACE_VERSION && fseek(f, 0, SEEK_END) == 0)
+	{
+		end = ftell(f);
+	}
+	if(end < (long) sizeof(reader->header))
+	{
+		fclose(f);
+		return -1;
+	}
+	reader->size = end - sizeof(reader->header);
+	reader->data = (uint8_t*) malloc(reader->size + 1);
+	if(reader->data == NULL || fseek(f, sizeof(reader->header), SEEK_SET) != 0 ||
+	   fread(reader->data, 1, reader->size, f) != reader->size)
+	{
+		fclose(f);
+		BusTraceReader_Close(reader);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
+/**
+ * @brief Decodes the next record.
+ * @param reader Reader from BusTraceReader_Open
+ * @param record Receives the record, its payload points into the reader
+ * @return status 1 for a record, 0 at the end of the trace, -1 if the rest of the trace is corrupt.
+ */
+int BusTraceReader_Next(BusTraceReader_t *reader, BusTraceRecord_t *record)
+{
+	uint64_t dt, write_length, read_length;
+	size_t pos = reader->offset;
+
+	if(pos >= reader->size)
+	{
+		return 0;
+	}
+	if(pos + 2 > reader->size)
+	{
+		return -1;
+	}
+	uint8_t kind = reader->data[pos];
+	record->bus = (Bus_t)(kind >> 7);
+	record->op = (BusOp_t)((kind >> 5) & 0x03);
+	record->result = kind & 0x1F;
+	record->address = reader->data[pos + 1];
+	pos += 2;
+	if(record->op >= BUS_OP_COUNT ||
+	   BusTrace_GetVarint(reader->data, reader->size, &pos, &dt) != 0 ||
+	   BusTrace_GetVarint(reader->data, reader->size, &pos, &write_length) != 0 ||
+	   BusTrace_GetVarint(reader->data, reader->size, &pos, &read_length) != 0 ||
+	   write_length + read_length > reader->size - pos)
+	{
+		return -1;
+	}
+	record->write_length = (uint32_t) write_length;
+	record->read_length = (uint32_t) read_length;
+	record->write = reader->data + pos;
+	record->read = reader->data + pos + write_length;
+	reader->time_us = (reader->offset == 0) ? 0 : reader->time_us + dt;	//The first delta refers to a dropped record
+	record->time_us = reader->time_us;
+	reader->offset = pos + write_length + read_length;
+	return 1;
+}
+
+/**
+ * @brief Goes back to the first record.
+ * @param reader Reader from BusTraceReader_Open
+ * @return none
+ */
+void BusTraceReader_Rewind(BusTraceReader_t *reader)
+{
+	reader->offset = 0;
+	reader->time_us = 0;
+}
+
+/**
+ * @brief Frees a loaded trace.
+ * @param reader Reader from BusTraceReader_Open
+ * @return none
+ */
+void BusTraceReader_Close(BusTraceReader_t *reader)
+{
+	free(reader->data);
+	reader->data = NULL;
+	reader->size = reader->offset = 0;
+}
+
+/// @}
+
+#ifdef BUS_TRACE
+
+/**
+ * @brief Reads a clock in ns.
+ */
+static uint64_t BusTrace_Clock(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Copies bytes to the head of the ring, wrapping at its end. Called with trace_lock held.
+ */
+static void BusTrace_Put(const uint8_t *bytes, size_t length)
+{
+	if(length == 0)
+	{
+		return;
+	}
+	size_t first = trace_size - trace_head;
+	if(first > length)
+	{
+		first = length;
+	}
+	memcpy(trace_ring + trace_head, bytes, first);
+	memcpy(trace_ring, bytes + first, length - first);
+	trace_head = (trace_head + length) % trace_size;
+	trace_used += length;
+}
+
+/**
+ * @brief Decodes a varint in the ring and moves past it. Called with trace_lock held.
+ */
+static uint64_t BusTrace_Varint(size_t *pos)
+{
+	uint64_t value = 0;
+	for(unsigned int shift = 0; shift < 64; shift += 7)
+	{
+		uint8_t byte = trace_ring[*pos];
+		*pos = (*pos + 1) % trace_size;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if((byte & 0x80) == 0)
+		{
+			break;
+		}
+	}
+	return value;
+}
+
+/**
+ * @brief Overwrites the oldest record, and moves the start time to the one after it. Called with trace_lock held.
+ */
+static void BusTrace_Evict(void)
+{
+	size_t pos = (trace_tail + 2) % trace_size;
+	BusTrace_Varint(&pos);
+	uint64_t write_length = BusTrace_Varint(&pos);
+	uint64_t read_length = BusTrace_Varint(&pos);
+	size_t length = (pos + trace_size - trace_tail) % trace_size + write_length + read_length;
+
+	trace_tail = (trace_tail + length) % trace_size;
+	trace_used -= length;
+	trace_records--;
+	trace_dropped++;
+	if(trace_records)
+	{
+		pos = (trace_tail + 2) % trace_size;
+		trace_first_us += BusTrace_Varint(&pos);
+	}
+}
+
+/**
+ * @brief Encodes a value as a little endian base 128 varint.
+ */
+static size_t BusTrace_PutVarint(uint8_t *out, uint64_t value)
+{
+	size_t n = 0;
+	while(value >= 0x80)
+	{
+		out[n++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = (uint8_t) value;
+	return n;
+}
+
+#endif
+
+/**
+ * @brief Decodes a varint from a buffer, checking its end.
+ */
+static int BusTrace_GetVarint(const uint8_t *data, size_t size, size_t *pos, uint64_t *value)
+{
+	*value = 0;
+	for(unsigned int shift = 0; shift < 64 && *pos < size; shift += 7)
+	{
+		uint8_t byte = data[(*pos)++];
+		*value |= (uint64_t)(byte & 0x7F) << shift;
+		if((byte & 0x80) == 0)
+		{
+			return 0;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file BusTrace.h
+ * @brief Header for the recorder that keeps every I2C and SPI transaction in a binary trace ring, and the
+ *		  reader that walks a saved trace
+ *
+ * The recorder is only compiled in with -DBUS_TRACE and records nothing until
+ * BusTrace_Start. A saved trace replays through FakeShield.o, see
+ * FakeShield_Replay.
+ */
+
+#ifndef __BUSTRACE_H__
+#define __BUSTRACE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "BusStats.h"
+
+#define BUS_TRACE_MAGIC			0x52544253	/*!< "SBTR" at the start of a saved trace */
+#define BUS_TRACE_VERSION		1
+#define BUS_TRACE_DEFAULT_SIZE	(1 << 20)	/*!< Ring size in bytes, about 80000 sensor transactions */
+#define BUS_TRACE_BUS_BIT(bus)	(1U << (bus))	/*!< Selects a bus in BusTrace_Start */
+
+/**
+ * @brief Header of a saved trace. The records follow, oldest first.
+ */
+typedef struct _BusTraceHeader
+{
+	uint32_t magic;							/**< BUS_TRACE_MAGIC */
+	uint16_t version;						/**< BUS_TRACE_VERSION */
+	uint16_t buses;							/**< Buses that were recorded, BUS_TRACE_BUS_BIT */
+	uint64_t start_ns;						/**< Wall clock time of the first record, ns since the epoch */
+	uint64_t records;						/**< Records in the file */
+	uint64_t dropped;						/**< Older records overwritten in the ring before the save */
+} BusTraceHeader_t;
+
+/**
+ * @brief One decoded transaction.
+ */
+typedef struct _BusTraceRecord
+{
+	uint64_t time_us;						/**< Time of the transaction since the first record */
+	Bus_t bus;
+	BusOp_t op;
+	uint8_t address;						/**< I2C address, 0 for the SPI display */
+	uint8_t result;							/**< bcm2835 I2C reason code, 0 for SPI */
+	uint32_t write_length;
+	uint32_t read_length;
+	const uint8_t *write;					/**< Bytes written, the register address first on I2C */
+	const uint8_t *read;					/**< Bytes the driver received */
+} BusTraceRecord_t;
+
+/**
+ * @brief A saved trace loaded for reading.
+ */
+typedef struct _BusTraceReader
+{
+	BusTraceHeader_t header;
+	uint8_t *data;							/**< The records */
+	size_t size;
+	size_t offset;							/**< Next record */
+	uint64_t time_us;						/**< Time of the last record read */
+} BusTraceReader_t;
+
+#ifdef BUS_TRACE
+
+void 			BusTrace_Record(Bus_t bus, unsigned int address, BusOp_t op, const void *write, uint32_t write_length,
+								const void *read, uint32_t read_length, int result);
+
+#define BUS_TRACE_RECORD(bus, address, op, write, write_length, read, read_length, result)	\
+	BusTrace_Record(bus, address, op, write, write_length, read, read_length, result)
+
+#else
+
+#define BUS_TRACE_RECORD(bus, address, op, write, write_length, read, read_length, result)
+
+#endif
+
+int 			BusTrace_Start(size_t size, unsigned int buses);
+void 			BusTrace_Stop(void);
+int 			BusTrace_Save(const char *path);
+
+int 			BusTraceReader_Open(BusTraceReader_t *reader, const char *path);
+int 			BusTraceReader_Next(BusTraceReader_t *reader, BusTraceRecord_t *record);
+void 			BusTraceReader_Rewind(BusTraceReader_t *reader);
+void 			BusTraceReader_Close(BusTraceReader_t *reader);
+
+#endif
@@ -54,6 +54,9 @@
 #define MAN_ID					0xFE
 #define REV						0xFF	
 
+#define CAP1203_PRODUCT_ID		0x6D		//Value of PRODUCT_ID
+#define CAP1203_MAN_ID			0x5D		//Value of MAN_ID, Microchip
+
 /************************MAIN CTRL REG********************************/
 #define STBY					0x20
 #define SLEEP					0x08
@@ -477,6 +477,7 @@
 #define A_FFMT_THS_Z_LSB_MASK       0xFC
 
 #define FXOS8700CQ_WHOAMI_VAL 	0xC7		// FXOS8700CQ WHOAMI production register value
+#define FXOS_RESET_TIMEOUT_MS 	10			// Longest wait for the reboot after a software reset
 #define FXOS8700CQ_READ_LEN 	12			// 6 channels of two bytes = 12 bytes 
 #define UINT14_MAX 				16383		// For processing the accelerometer data to right-justified 2's complement
 
@@ -522,6 +523,9 @@ typedef struct rawdata {
 } rawdata_t;
 
 void            FXOS8700CQ_Initialize(void);
+void            FXOS8700CQ_Reset(void);
+unsigned char   FXOS8700CQ_IsReady(void);
+void            FXOS8700CQ_Configure(void);
 char 			FXOS8700CQ_ReadStatusReg(void);
 void            FXOS8700CQ_ActiveMode(void);
 char   			FXOS8700CQ_StandbyMode(void);
@@ -0,0 +1,70 @@
+/**
+ * @file FakeShield.h
+ * @brief Header for the in-process stand-in of the Sensorian shield, linked in place of libbcm2835
+ *
+ * FakeShield.c implements the bcm2835 calls the drivers use. The five I2C chips
+ * answer from register maps that behave like the real parts, including their
+ * FIFOs and interrupt outputs on the GPIO pins, the ST7735 on SPI draws into its
+ * display RAM, and every transfer and delay advances a virtual clock by the time
+ * it would take on the bus instead of sleeping. A trace saved by BusTrace_Save
+ * can stand in for the chips instead.
+ *
+ * Programs relinked against FakeShield.o read these environment variables:
+ * BUS_REPLAY, a trace to replay; FAKESHIELD_VIRTUAL_TIME=1, which puts
+ * timestamp_ns and the scheduler on the virtual clock; FAKESHIELD_IMAGE, a
+ * PPM file the display is saved to on exit.
+ */
+
+#ifndef __FAKESHIELD_H__
+#define __FAKESHIELD_H__
+
+#include <stdint.h>
+
+#define FAKE_TFT_WIDTH		128		/*!< Columns of the 1.8 inch panel, as mapped into the ST7735 display RAM */
+#define FAKE_TFT_HEIGHT		160		/*!< Rows of the panel */
+
+/**
+ * @brief What the simulated sensors measure. The chips latch these values at each conversion.
+ */
+typedef struct _FakeShieldEnvironment
+{
+	float pressure_pa;				/**< MPL3115A2 in barometer mode */
+	float altitude_m;				/**< MPL3115A2 in altimeter mode */
+	float temperature_c;			/**< MPL3115A2 */
+	uint16_t light_ch0;				/**< APDS9300 visible and infrared counts at gain 1 and 402 ms */
+	uint16_t light_ch1;				/**< APDS9300 infrared counts */
+	int16_t accel_mg[3];			/**< FXOS8700CQ X, Y and Z */
+	int16_t mag[3];					/**< FXOS8700CQ X, Y and Z in 0.1 uT */
+	int8_t fxos_temperature_c;
+	uint8_t touched;				/**< CAP1203 inputs being touched, bit 0 for CS1 */
+} FakeShieldEnvironment_t;
+
+/**
+ * @brief Traffic seen by the fake chips since FakeShield_Reset, and how the virtual time was spent.
+ */
+typedef struct _FakeShieldStats
+{
+	uint64_t i2c_transfers;		/**< I2C transfers, acknowledged or not */
+	uint64_t i2c_bytes;			/**< Bytes written and read, excluding the address bytes */
+	uint64_t spi_transfers;		/**< Calls to the SPI transfer functions */
+	uint64_t spi_bytes;
+	uint64_t i2c_ns;			/**< Clocking bits on the I2C bus */
+	uint64_t spi_ns;			/**< Clocking bits on the SPI bus */
+	uint64_t delay_ns;			/**< Waiting in bcm2835_delay and bcm2835_delayMicroseconds */
+	uint64_t replayed;			/**< Transfers answered from the replayed trace */
+	uint64_t diverged;			/**< Replayed transfers that differ from the trace, or came after its end */
+} FakeShieldStats_t;
+
+void 		FakeShield_Reset(void);
+int 		FakeShield_Replay(const char *path);
+void 		FakeShield_VirtualTime(int enable);
+void 		FakeShield_GetEnvironment(FakeShieldEnvironment_t *environment);
+void 		FakeShield_SetEnvironment(const FakeShieldEnvironment_t *environment);
+uint64_t 	FakeShield_Now(void);
+void 		FakeShield_Stats(FakeShieldStats_t *stats);
+void 		FakeShield_Advance(uint64_t ns);
+uint8_t 	FakeShield_Register(uint8_t address, uint8_t reg);
+uint16_t 	FakeShield_Pixel(unsigned int x, unsigned int y);
+int 		FakeShield_SaveImage(const char *path);
+
+#endif
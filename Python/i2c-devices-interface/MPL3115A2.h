@@ -67,6 +67,10 @@
 #define TDR             0x02       //Temperature new Data Available.
 
 
+/**********************SYSMOD**************************************/
+#define SYSMOD_ACTIVE   0x01      //Set while the sensor is in active mode
+#define MPL_ACTIVE_TIMEOUT_MS   10    //Longest wait for active mode after setting SBYB
+
 /**********************Control Register 1****************************/
 #define ALT     0x80
 #define RAW     0x40
@@ -175,6 +179,7 @@ unsigned char   MPL3115A2_ID(void);
 unsigned char   MPL3115A2_GetMode(void);
 void            MPL3115A2_StandbyMode(void);                        // Puts the sensor into Standby mode. Required when changing CTRL1 register.
 void            MPL3115A2_ActiveMode(void);                         // Start taking measurements!
+unsigned char   MPL3115A2_IsActive(void);                           // SYSMOD reports active mode
 
 void            MPL3115A2_AltimeterMode(void);                      // Puts the sensor into altimetery mode.
 float           MPL3115A2_ReadAltitude(void);                       // Returns float with meters above sealevel. Ex: 1638.94
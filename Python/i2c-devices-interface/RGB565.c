@@ -0,0 +1,223 @@
+/**
+ * @file RGB565.c
+ * @brief Converts RGB888 and RGBA frames into the big endian RGB565 bytes the TFT takes, and finds what changed.
+ *
+ * Rows are converted 16 pixels at a time. Built with NEON (-mfpu=neon on a
+ * Pi 2 or later, always on 64 bit ARM) each block is one vld3 or vld4, three
+ * saturating adds for the dither and one interleaved vst2; elsewhere a plain
+ * loop does the same.
+ *
+ * RGB565_Diff compares a converted frame with a copy of the last one sent
+ * and returns the bands of rows that changed, each cut down to the columns
+ * that changed, so only those need to be written to the display RAM.
+ */
+
+#include <string.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#include "RGB565.h"
+
+#define BLOCK	16		/*!< Pixels per NEON vector, a multiple of the 4 columns of the dither matrix */
+
+/**
+ * @brief 4x4 Bayer thresholds, 0 to 15, each row repeated over BLOCK columns so a block loads them at once.
+ */
+#define BAYER_ROW(a, b, c, d)	{a, b, c, d, a, b, c, d, a, b, c, d, a, b, c, d}
+static const uint8_t bayer[4][BLOCK] = {
+	BAYER_ROW( 0,  8,  2, 10),
+	BAYER_ROW(12,  4, 14,  6),
+	BAYER_ROW( 3, 11,  1,  9),
+	BAYER_ROW(15,  7, 13,  5)
+};
+
+static inline void convertRow(const uint8_t *restrict src, unsigned int width, unsigned int channels,
+							  const uint8_t *restrict threshold, uint8_t *restrict dst);
+static inline void convertBlock(const uint8_t *restrict src, unsigned int channels,
+								const uint8_t *restrict threshold, uint8_t *restrict dst);
+static inline void convertPixels(const uint8_t *restrict src, unsigned int count, unsigned int channels,
+								 const uint8_t *restrict threshold, uint8_t *restrict dst);
+
+/// \defgroup rgb565 RGB565 frames
+/// These functions prepare frames for the TFT and limit the transfers to the area that changed.
+/// @{
+
+/**
+ * @brief Converts a frame to RGB565, two bytes per pixel with the high byte first as RAMWR expects.
+ * @param src First pixel, R, G and B bytes followed by an alpha byte that is ignored if channels is 4
+ * @param width Pixels per row
+ * @param height Rows
+ * @param stride Bytes from one row of src to the next
+ * @param channels 3 for RGB888, 4 for RGBA
+ * @param flags RGB565_DITHER to dither the colours, 0 to truncate them
+ * @param dst Receives width * height * 2 bytes
+ * @return none
+ */
+void RGB565_Convert(const uint8_t *src, unsigned int width, unsigned int height, unsigned int stride,
+					unsigned int channels, unsigned int flags, uint8_t *dst)
+{
+	static const uint8_t no_dither[BLOCK] = {0};
+
+	for(unsigned int y = 0; y < height; y++)
+	{
+		const uint8_t *threshold = (flags & RGB565_DITHER) ? bayer[y & 3] : no_dither;
+		if(channels == 4)
+		{
+			convertRow(src, width, 4, threshold, dst);		//Constant pixel sizes once inlined
+		}
+		else
+		{
+			convertRow(src, width, 3, threshold, dst);
+		}
+		src += stride;
+		dst += width * 2;
+	}
+}
+
+/**
+ * @brief Finds the areas of a frame that differ from the previous one and updates the previous one.
+ *		  Changed rows closer than RGB565_MERGE_ROWS rows make one area, and the last area grows to
+ *		  cover the rest once max_rects areas are used.
+ * @param frame Converted frame, width * height * 2 bytes
+ * @param previous Frame last sent, overwritten with the rows of frame that changed
+ * @param width Pixels per row
+ * @param height Rows
+ * @param rects Receives the changed areas, top to bottom
+ * @param max_rects Size of rects, at least 1
+ * @return count Number of areas, 0 if nothing changed.
+ */
+unsigned int RGB565_Diff(const uint8_t *frame, uint8_t *previous, unsigned int width, unsigned int height,
+						 RGB565Rect_t *rects, unsigned int max_rects)
+{
+	const size_t row_bytes = width * 2;
+	unsigned int count = 0;
+
+	for(unsigned int y = 0; y < height; y++)
+	{
+		const uint8_t *row = frame + y * row_bytes;
+		uint8_t *old = previous + y * row_bytes;
+		unsigned int x0 = 0, x1 = width - 1;
+
+		if(memcmp(row, old, row_bytes) == 0)
+		{
+			continue;
+		}
+		while(row[x0 * 2] == old[x0 * 2] && row[x0 * 2 + 1] == old[x0 * 2 + 1])
+		{
+			x0++;
+		}
+		while(row[x1 * 2] == old[x1 * 2] && row[x1 * 2 + 1] == old[x1 * 2 + 1])
+		{
+			x1--;
+		}
+		memcpy(old, row, row_bytes);
+
+		if(count > 0 && (y - rects[count - 1].y1 <= RGB565_MERGE_ROWS || count == max_rects))
+		{
+			RGB565Rect_t *last = &rects[count - 1];	//Close to the last area, or out of areas
+			last->y1 = y;
+			if(x0 < last->x0) last->x0 = x0;
+			if(x1 > last->x1) last->x1 = x1;
+			continue;
+		}
+		RGB565Rect_t *r = &rects[count++];
+		r->x0 = x0;
+		r->x1 = x1;
+		r->y0 = r->y1 = y;
+	}
+	return count;
+}
+
+/**
+ * @brief Copies one area of a converted frame into a contiguous buffer, to send it with one transfer.
+ * @param frame Converted frame
+ * @param width Pixels per row of the frame
+ * @param rect Area to copy
+ * @param out Receives the pixels of the area row by row
+ * @return bytes Number of bytes copied.
+ */
+unsigned int RGB565_Crop(const uint8_t *frame, unsigned int width, const RGB565Rect_t *rect, uint8_t *out)
+{
+	const size_t bytes = (rect->x1 - rect->x0 + 1) * 2;
+
+	for(unsigned int y = rect->y0; y <= rect->y1; y++)
+	{
+		memcpy(out, frame + (y * width + rect->x0) * 2, bytes);
+		out += bytes;
+	}
+	return bytes * (rect->y1 - rect->y0 + 1);
+}
+
+/// @}
+
+/**
+ * @brief Converts one row, BLOCK pixels at a time so every block starts on the first dither column.
+ */
+static inline void convertRow(const uint8_t *restrict src, unsigned int width, unsigned int channels,
+							  const uint8_t *restrict threshold, uint8_t *restrict dst)
+{
+	unsigned int x = 0;
+
+	for(; x + BLOCK <= width; x += BLOCK)
+	{
+		convertBlock(src + x * channels, channels, threshold, dst + x * 2);
+	}
+	convertPixels(src + x * channels, width - x, channels, threshold, dst + x * 2);
+}
+
+/**
+ * @brief Converts BLOCK pixels.
+ */
+static inline void convertBlock(const uint8_t *restrict src, unsigned int channels,
+								const uint8_t *restrict threshold, uint8_t *restrict dst)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint8x16_t t = vld1q_u8(threshold);
+	uint8x16_t r, g, b;
+	uint8x16x2_t out;
+
+	if(channels == 4)
+	{
+		uint8x16x4_t p = vld4q_u8(src);
+		r = p.val[0];
+		g = p.val[1];
+		b = p.val[2];
+	}
+	else
+	{
+		uint8x16x3_t p = vld3q_u8(src);
+		r = p.val[0];
+		g = p.val[1];
+		b = p.val[2];
+	}
+	r = vqaddq_u8(r, vshrq_n_u8(t, 1));
+	g = vqaddq_u8(g, vshrq_n_u8(t, 2));
+	b = vqaddq_u8(b, vshrq_n_u8(t, 1));
+	out.val[0] = vorrq_u8(vandq_u8(r, vdupq_n_u8(0xF8)), vshrq_n_u8(g, 5));
+	out.val[1] = vorrq_u8(vandq_u8(vshlq_n_u8(g, 3), vdupq_n_u8(0xE0)), vshrq_n_u8(b, 3));
+	vst2q_u8(dst, out);
+#else
+	convertPixels(src, BLOCK, channels, threshold, dst);
+#endif
+}
+
+/**
+ * @brief Converts up to BLOCK pixels one at a time. The thresholds are scaled to the step of each channel
+ *		  and added with saturation.
+ */
+static inline void convertPixels(const uint8_t *restrict src, unsigned int count, unsigned int channels,
+								 const uint8_t *restrict threshold, uint8_t *restrict dst)
+{
+	for(unsigned int i = 0; i < count; i++)
+	{
+		unsigned int t = threshold[i];
+		unsigned int r = src[i * channels] + (t >> 1);		//Red and blue lose 3 bits, green 2
+		unsigned int g = src[i * channels + 1] + (t >> 2);
+		unsigned int b = src[i * channels + 2] + (t >> 1);
+		r = (r > 255) ? 255 : r;
+		g = (g > 255) ? 255 : g;
+		b = (b > 255) ? 255 : b;
+		dst[i * 2] = (r & 0xF8) | (g >> 5);
+		dst[i * 2 + 1] = ((g << 3) & 0xE0) | (b >> 3);
+	}
+}
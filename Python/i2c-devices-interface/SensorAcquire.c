@@ -0,0 +1,190 @@
+/**
+ * @file SensorAcquire.c
+ * @brief Reads every channel of a device with as few I2C transactions as the chip allows.
+ *
+ * The FXOS8700CQ status, accelerometer and magnetometer registers come out
+ * of one 13 byte burst thanks to hybrid auto-increment, the MPL3115A2
+ * pressure and temperature out of one 6 byte burst in barometer mode (the
+ * altitude is computed from the pressure instead of switching modes), and the
+ * MCP79410 time and date out of one 7 byte burst.
+ */
+
+#include <math.h>
+#include "MPL3115A2.h"
+#include "APDS9300.h"
+#include "CAP1203.h"
+#include "FXOS8700CQ.h"
+#include "MCP79410.h"
+#include "i2c.h"
+#include "Utilities.h"
+#include "SensorPower.h"
+#include "SensorAcquire.h"
+
+#define FXOS_BURST_LEN		13				//Status, accelerometer XYZ and magnetometer XYZ
+#define FXOS_ACCEL_SCALE	(0.000244f * 9.80665f)	//m/s^2 per LSB at +/-2g, 14 bit left justified
+#define FXOS_MAG_SCALE		0.1f			//uT per LSB
+#define FXOS_DATA_READY		(ZYXDR_MASK | 0x80)	//ZYXDR or ZYXOW
+
+#define MPL_BURST_LEN		6				//Status, pressure MSB..LSB, temperature MSB..LSB
+
+static void Acquire_APDS9300(Acquisition_t *acq);
+static void Acquire_MPL3115A2(Acquisition_t *acq);
+static void Acquire_FXOS8700CQ(Acquisition_t *acq);
+static void Acquire_CAP1203(Acquisition_t *acq);
+static void Acquire_MCP79410(Acquisition_t *acq);
+
+/**
+ * @brief Reads all channels of one device, bringing it up first if it is not yet initialized or asleep.
+ * @param device Device to read
+ * @param acq Receives the readings, the valid mask is replaced.
+ * @return status 0 if at least one channel is valid, -1 otherwise.
+ */
+int Acquire_Device(SensorDevice_t device, Acquisition_t *acq)
+{
+	acq->valid = 0;
+	if((unsigned) device >= SENSOR_DEVICE_COUNT || SensorPower_Acquire(device) != 0)	//Brings the chip up or wakes it
+	{
+		acq->timestamp_ns = timestamp_ns();
+		return -1;
+	}
+	uint64_t start = timestamp_ns();
+
+	switch(device)
+	{
+		case SENSOR_DEV_APDS9300:
+			Acquire_APDS9300(acq);
+			break;
+		case SENSOR_DEV_MPL3115A2:
+			Acquire_MPL3115A2(acq);
+			break;
+		case SENSOR_DEV_FXOS8700CQ:
+			Acquire_FXOS8700CQ(acq);
+			break;
+		case SENSOR_DEV_CAP1203:
+			Acquire_CAP1203(acq);
+			break;
+		case SENSOR_DEV_MCP79410:
+			Acquire_MCP79410(acq);
+			break;
+		default:
+			break;
+	}
+	SensorPower_Release(device);
+
+	acq->timestamp_ns = start + (timestamp_ns() - start) / 2;
+	return acq->valid ? 0 : -1;
+}
+
+/**
+ * @brief Converts a pressure to altitude with the barometric formula from the MPL3115A2 datasheet.
+ * @param pascal Pressure in Pa
+ * @return altitude Metres above SEA_LEVEL_PRESSURE
+ */
+float Acquire_PressureToAltitude(float pascal)
+{
+	return 44330.77f * (1.0f - powf(pascal / SEA_LEVEL_PRESSURE, 0.1902632f));
+}
+
+/**
+ * @brief Reads both photodiode channels with repeated start word reads and computes lux.
+ */
+static void Acquire_APDS9300(Acquisition_t *acq)
+{
+	char raw[2] = {0};
+
+	I2C_ReadByteArray(APDS9300ADDR, COMMAND|CMD_CLEAR_INT|CMD_WORD|DATA0LOW, raw, 2);
+	unsigned int ch0 = ((unsigned char) raw[1] << 8) | (unsigned char) raw[0];
+	I2C_ReadByteArray(APDS9300ADDR, COMMAND|CMD_CLEAR_INT|CMD_WORD|DATA1LOW, raw, 2);
+	unsigned int ch1 = ((unsigned char) raw[1] << 8) | (unsigned char) raw[0];
+
+	acq->value[SENSOR_LIGHT] = (ch0 == 0) ? 0.0f : AL_Lux(ch0, ch1);	//AL_Lux divides by ch0
+	acq->valid |= SENSOR_CHANNEL_BIT(SENSOR_LIGHT);
+}
+
+/**
+ * @brief Reads pressure and temperature in one burst. The sensor must be in barometer mode. The channels stay
+ *		  invalid unless a conversion completed since the last read, which cleared PTDR.
+ */
+static void Acquire_MPL3115A2(Acquisition_t *acq)
+{
+	unsigned char raw[MPL_BURST_LEN] = {0};
+
+	I2C_ReadByteArray(MPL3115A2_ADDRESS, STATUS, (char *) raw, MPL_BURST_LEN);
+
+	if((raw[0] & PTDR) == 0)					//The outputs still hold the previous conversion
+	{
+		return;
+	}
+
+	uint32_t p = ((uint32_t) raw[1] << 16) | ((uint32_t) raw[2] << 8) | raw[3];
+
+	float pressure = (p >> 4) / 4.0f;			//Q18.2 Pa, left justified in 24 bits
+	float temperature = (int8_t) raw[4] + (raw[5] >> 4) / 16.0f;	//Q8.4 degrees C
+
+	acq->value[SENSOR_PRESSURE] = pressure;
+	acq->value[SENSOR_TEMPERATURE] = temperature;
+	acq->value[SENSOR_ALTITUDE] = Acquire_PressureToAltitude(pressure);
+	acq->valid |= SENSOR_CHANNEL_BIT(SENSOR_PRESSURE) | SENSOR_CHANNEL_BIT(SENSOR_TEMPERATURE) |
+				  SENSOR_CHANNEL_BIT(SENSOR_ALTITUDE);
+}
+
+/**
+ * @brief Reads status, accelerometer and magnetometer in one hybrid mode burst.
+ */
+static void Acquire_FXOS8700CQ(Acquisition_t *acq)
+{
+	unsigned char raw[FXOS_BURST_LEN] = {0};
+
+	I2C_ReadByteArray(FXOS8700CQ_ADDRESS, STATUS, (char *) raw, FXOS_BURST_LEN);
+
+	if((raw[0] & FXOS_DATA_READY) == 0)
+	{
+		return;
+	}
+
+	for(int axis = 0; axis < 3; axis++)
+	{
+		int16_t accel = (int16_t)((raw[1 + 2*axis] << 8) | raw[2 + 2*axis]) >> 2;
+		int16_t mag = (int16_t)((raw[7 + 2*axis] << 8) | raw[8 + 2*axis]);
+		acq->value[SENSOR_ACCEL_X + axis] = accel * FXOS_ACCEL_SCALE;
+		acq->value[SENSOR_MAG_X + axis] = mag * FXOS_MAG_SCALE;
+	}
+	acq->valid |= SensorDevice_Channels(SENSOR_DEV_FXOS8700CQ);
+}
+
+/**
+ * @brief Reads the pressed button.
+ */
+static void Acquire_CAP1203(Acquisition_t *acq)
+{
+	acq->value[SENSOR_TOUCH] = CAP1203_ReadPressedButton();
+	acq->valid |= SENSOR_CHANNEL_BIT(SENSOR_TOUCH);
+}
+
+/**
+ * @brief Reads the time and date registers in one burst.
+ */
+static void Acquire_MCP79410(Acquisition_t *acq)
+{
+	unsigned char raw[7] = {0};
+
+	I2C_ReadByteArray(MCP79410_ADDRESS, SEC, (char *) raw, 7);
+
+	unsigned char hour = raw[HOUR];
+	hour = ((hour & HOUR_12) == HOUR_12) ? (hour & 0x1F) : (hour & 0x3F);
+
+	acq->time.sec = MCP79410_bcd2dec(raw[SEC] & ~START_32KHZ);
+	acq->time.min = MCP79410_bcd2dec(raw[MIN]);
+	acq->time.hour = MCP79410_bcd2dec(hour);
+	acq->time.weekday = MCP79410_bcd2dec(raw[DAY] & ~(OSCRUN|PWRFAIL|VBATEN));
+	acq->time.date = MCP79410_bcd2dec(raw[DATE]);
+	acq->time.month = MCP79410_bcd2dec(raw[MNTH] & ~LPYR);
+	acq->time.year = MCP79410_bcd2dec(raw[YEAR]);
+
+	if((raw[DAY] & OSCRUN) == 0)				//Registers are not counting
+	{
+		return;
+	}
+	acq->value[SENSOR_RTCC] = acq->time.hour * 3600.0f + acq->time.min * 60.0f + acq->time.sec;
+	acq->valid |= SENSOR_CHANNEL_BIT(SENSOR_RTCC);
+}
@@ -0,0 +1,300 @@
+/**
+ * @file SensorAsync.c
+ * @brief Runs submitted reads on a worker thread and signals their completion on an eventfd.
+ *
+ * Requests and completions sit in two fixed rings guarded by one mutex. A
+ * request is only accepted while its completion is sure to fit, so the worker
+ * never waits on the reader; published samples are dropped instead when the
+ * completion ring is full. The eventfd counts completions posted since it was
+ * last read. SensorAsync_Complete reads it before taking completions out, and
+ * writes it again if some are left, so a reader that sleeps until the fd is
+ * readable never misses one. Each request runs on the shield that was bound to
+ * the submitting thread.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "SensorsInterface.h"
+#include "Shield.h"
+#include "SensorAsync.h"
+
+#define QUEUE_MASK	(SENSOR_ASYNC_QUEUE - 1)
+
+/**
+ * @brief A submitted read waiting for the worker.
+ */
+typedef struct _SensorRequest
+{
+	unsigned long channels;		/**< Mask of channels to read */
+	uint64_t tag;				/**< Returned in the completion */
+	Shield_t *shield;			/**< Shield of the submitting thread */
+} SensorRequest_t;
+
+static SensorRequest_t request_ring[SENSOR_ASYNC_QUEUE];
+static SensorCompletion_t completion_ring[SENSOR_ASYNC_QUEUE];
+static unsigned int request_head = 0, request_tail = 0;			/*!< Free running, tail - head requests queued */
+static unsigned int completion_head = 0, completion_tail = 0;	/*!< Free running, tail - head completions waiting */
+static unsigned int pending = 0;								/*!< Requests accepted and not completed yet */
+static uint64_t dropped = 0;									/*!< Published batches lost to a full ring */
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t async_thread;
+static volatile int async_running = 0;
+static int async_fd = -1;
+
+static void SensorAsync_Signal(void);
+static int SensorAsync_Full(void);
+static void* SensorAsync_Thread(void *arg);
+
+/// \defgroup sensorasync Asynchronous requests
+/// These functions queue reads without blocking and report them through a file descriptor.
+/// @{
+
+/**
+ * @brief Starts the worker thread and creates the eventfd. Opening again returns the same fd.
+ * @return fd Readable while completions are waiting, -1 on failure.
+ */
+int SensorAsync_Open(void)
+{
+	pthread_mutex_lock(&async_lock);
+	if(async_running)
+	{
+		pthread_mutex_unlock(&async_lock);
+		return async_fd;
+	}
+	async_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(async_fd < 0)
+	{
+		pthread_mutex_unlock(&async_lock);
+		return -1;
+	}
+	request_head = request_tail = 0;
+	completion_head = completion_tail = 0;
+	pending = 0;
+	async_running = 1;
+	if(pthread_create(&async_thread, NULL, SensorAsync_Thread, NULL) != 0)
+	{
+		async_running = 0;
+		close(async_fd);
+		async_fd = -1;
+	}
+	pthread_mutex_unlock(&async_lock);
+	return async_fd;
+}
+
+/**
+ * @brief Stops the worker once its current request is done and closes the eventfd. Requests still queued
+ *		  and completions not collected are discarded.
+ * @return none
+ */
+void SensorAsync_Close(void)
+{
+	pthread_mutex_lock(&async_lock);
+	if(!async_running)
+	{
+		pthread_mutex_unlock(&async_lock);
+		return;
+	}
+	async_running = 0;
+	pthread_cond_signal(&async_cond);
+	pthread_mutex_unlock(&async_lock);
+	pthread_join(async_thread, NULL);
+
+	pthread_mutex_lock(&async_lock);		//Publishers may still be signalling
+	close(async_fd);
+	async_fd = -1;
+	pthread_mutex_unlock(&async_lock);
+}
+
+/**
+ * @brief Queues a read of some channels and returns without touching the bus.
+ * @param channels Mask of channels to read, built with SENSOR_CHANNEL_BIT
+ * @param tag Any value but SENSOR_ASYNC_SAMPLES, returned in the completion
+ * @return status 0 if queued, -1 if not open or SENSOR_ASYNC_QUEUE requests and completions are outstanding.
+ */
+int SensorAsync_Submit(unsigned long channels, uint64_t tag)
+{
+	int status = -1;
+
+	pthread_mutex_lock(&async_lock);
+	if(async_running && !SensorAsync_Full())
+	{
+		SensorRequest_t *r = &request_ring[request_tail++ & QUEUE_MASK];
+		r->channels = channels;
+		r->tag = tag;
+		r->shield = Shield_Current();
+		pending++;
+		pthread_cond_signal(&async_cond);
+		status = 0;
+	}
+	pthread_mutex_unlock(&async_lock);
+	return status;
+}
+
+/**
+ * @brief Takes the waiting completions out, oldest first. Never blocks. Call it when the fd is readable.
+ * @param completions Buffer to fill
+ * @param count Size of the buffer in completions
+ * @return copied Number of completions copied.
+ */
+unsigned int SensorAsync_Complete(SensorCompletion_t *completions, unsigned int count)
+{
+	uint64_t value;
+	unsigned int n = 0;
+	int left;
+
+	pthread_mutex_lock(&async_lock);
+	if(async_fd < 0)
+	{
+		pthread_mutex_unlock(&async_lock);
+		return 0;
+	}
+	if(read(async_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)	//EAGAIN when nothing was posted since
+	{
+		perror("SensorAsync complete");
+	}
+	while(n < count && completion_head != completion_tail)
+	{
+		completions[n++] = completion_ring[completion_head++ & QUEUE_MASK];
+	}
+	left = (completion_head != completion_tail);
+	pthread_mutex_unlock(&async_lock);
+	if(left)
+	{
+		SensorAsync_Signal();				//Keep the fd readable for the rest
+	}
+	return n;
+}
+
+/**
+ * @brief Returns the number of published batches dropped because completions were not collected in time.
+ * @return dropped Batches dropped since the library was loaded.
+ */
+uint64_t SensorAsync_Dropped(void)
+{
+	pthread_mutex_lock(&async_lock);
+	uint64_t n = dropped;
+	pthread_mutex_unlock(&async_lock);
+	return n;
+}
+
+/**
+ * @brief Posts a batch of samples as completions tagged SENSOR_ASYNC_SAMPLES, SENSOR_CHANNEL_COUNT samples
+ *		  per completion. Has the SampleCallback_t signature, register it with
+ *		  Scheduler_AddCallback(SensorAsync_Publish, NULL).
+ * @param samples Samples taken in one pass
+ * @param count Number of samples
+ * @param arg Unused
+ */
+void SensorAsync_Publish(const Sample_t *samples, unsigned int count, void *arg)
+{
+	int posted = 0;
+
+	pthread_mutex_lock(&async_lock);
+	while(async_running && count > 0)
+	{
+		unsigned int n = (count < SENSOR_CHANNEL_COUNT) ? count : SENSOR_CHANNEL_COUNT;
+		if(SensorAsync_Full())
+		{
+			dropped++;
+			break;
+		}
+		SensorCompletion_t *c = &completion_ring[completion_tail++ & QUEUE_MASK];
+		c->tag = SENSOR_ASYNC_SAMPLES;
+		c->count = n;
+		c->valid = 0;
+		for(unsigned int i = 0; i < n; i++)
+		{
+			c->samples[i] = samples[i];
+			if((samples[i].flags & SAMPLE_VALID) && samples[i].channel < SENSOR_CHANNEL_COUNT)
+			{
+				c->valid |= SENSOR_CHANNEL_BIT(samples[i].channel);
+			}
+		}
+		memset(&c->samples[n], 0, (SENSOR_CHANNEL_COUNT - n) * sizeof(Sample_t));
+		samples += n;
+		count -= n;
+		posted = 1;
+	}
+	pthread_mutex_unlock(&async_lock);
+	if(posted)
+	{
+		SensorAsync_Signal();
+	}
+}
+
+/// @}
+
+/**
+ * @brief Makes the eventfd readable. Takes async_lock, so SensorAsync_Close cannot close the fd meanwhile.
+ */
+static void SensorAsync_Signal(void)
+{
+	pthread_mutex_lock(&async_lock);
+	if(async_fd >= 0)
+	{
+		uint64_t one = 1;
+		if(write(async_fd, &one, sizeof(one)) < 0)
+		{
+			perror("SensorAsync signal");
+		}
+	}
+	pthread_mutex_unlock(&async_lock);
+}
+
+/**
+ * @brief Tells whether another request or batch could overflow the completion ring. Called with the lock held.
+ */
+static int SensorAsync_Full(void)
+{
+	return pending + (completion_tail - completion_head) >= SENSOR_ASYNC_QUEUE;
+}
+
+/**
+ * @brief Worker thread, runs the requests in order and posts their completions.
+ */
+static void* SensorAsync_Thread(void *arg)
+{
+	Sample_t samples[SENSOR_CHANNEL_COUNT];
+
+	pthread_mutex_lock(&async_lock);
+	while(async_running)
+	{
+		if(request_head == request_tail)
+		{
+			pthread_cond_wait(&async_cond, &async_lock);
+			continue;
+		}
+		SensorRequest_t r = request_ring[request_head++ & QUEUE_MASK];
+		pthread_mutex_unlock(&async_lock);
+
+		Shield_t *previous = Shield_Bind(r.shield);
+		int count = getSnapshotSamples(samples, r.channels);	//Outside the lock, the bus is slow
+		Shield_Bind(previous);
+
+		pthread_mutex_lock(&async_lock);
+		SensorCompletion_t *c = &completion_ring[completion_tail++ & QUEUE_MASK];
+		c->tag = r.tag;
+		c->count = count;
+		c->valid = 0;
+		for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+		{
+			if(samples[ch].flags & SAMPLE_VALID)
+			{
+				c->valid |= SENSOR_CHANNEL_BIT(ch);
+			}
+		}
+		memcpy(c->samples, samples, sizeof(samples));
+		pending--;
+		pthread_mutex_unlock(&async_lock);
+		SensorAsync_Signal();
+		pthread_mutex_lock(&async_lock);
+	}
+	pthread_mutex_unlock(&async_lock);
+	return NULL;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file SensorPower.h
+ * @brief Header for the on-demand bring-up and idle power-down of the shield's chips
+ */
+
+#ifndef __SENSORPOWER_H__
+#define __SENSORPOWER_H__
+
+#include <stdint.h>
+#include "SensorChannels.h"
+
+#define SENSOR_POWER_MAX_UNITS		(SENSOR_DEVICE_COUNT + 4)	/*!< The sensor chips plus units added with SensorPower_Register */
+#define SENSOR_IDLE_TIMEOUT_MS		10000		/*!< Default time a sensor stays awake after its last use */
+#define SENSOR_POWER_SWEEP_MS		100			/*!< Shortest interval between two idle checks made by SensorPower_Release */
+#define SENSOR_POWER_RETRY_MS		1000		/*!< Time before a chip that did not come up is tried again */
+
+/**
+ * @brief Power state of a unit.
+ */
+typedef enum {SENSOR_POWER_OFF = 0,			/**< Never initialized */
+			  SENSOR_POWER_STARTING,		/**< Initialization started, waiting for the chip to be ready */
+			  SENSOR_POWER_ACTIVE,			/**< Initialized and awake */
+			  SENSOR_POWER_STANDBY,			/**< Initialized, put to sleep after being idle */
+			  SENSOR_POWER_FAILED			/**< Did not become ready, retried after SENSOR_POWER_RETRY_MS */
+} SensorPowerState_t;
+
+/**
+ * @brief How to bring up, wake and put a unit to sleep. Unused steps are NULL.
+ */
+typedef struct _SensorPowerOps
+{
+	void (*begin)(void);		/**< Starts the initialization, returns without waiting for the chip */
+	int (*finish)(void);		/**< Waits until the chip is ready and completes the setup, 0 on success */
+	void (*sleep)(void);		/**< Puts the unit in its lowest power state, NULL if it must stay awake */
+	int (*wake)(void);			/**< Brings the unit back from sleep, 0 on success */
+} SensorPowerOps_t;
+
+int 				SensorPower_Register(const char *name, const SensorPowerOps_t *ops, unsigned int idle_ms);
+int 				SensorPower_Begin(int unit);
+int 				SensorPower_Finish(int unit);
+int 				SensorPower_Acquire(int unit);
+void 				SensorPower_Release(int unit);
+void 				SensorPower_KeepAwake(int unit, int keep);
+void 				SensorPower_SetIdleTimeout(int unit, unsigned int idle_ms);
+unsigned int 		SensorPower_Idle(uint64_t now);
+SensorPowerState_t 	SensorPower_State(int unit);
+const char* 		SensorPower_Name(int unit);
+
+#endif
@@ -0,0 +1,379 @@
+/**
+ * @file SensorShm.c
+ * @brief Publishes the latest readings and a short history to other processes through POSIX shared memory.
+ *
+ * One sampling process owns the bus and calls SensorShm_Create and then
+ * SensorShm_Publish for every batch of samples, typically by registering it
+ * with Scheduler_AddCallback. Any number of other processes call
+ * SensorShm_Attach once and then read with plain loads from the read-only
+ * mapping: no bus access, no locks and no system calls per read. Readers
+ * retry under the seqlock if the publisher was writing meanwhile. A read
+ * returns -1 and detaches once the publisher has removed or restarted the
+ * segment, or died in the middle of an update, so the reader can attach again.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "SensorShm.h"
+
+#define HISTORY_MASK	(SENSOR_SHM_HISTORY - 1)
+#define WRITER_SPINS	100000			//Spins on an update in progress before checking that the publisher lives
+
+static SensorShm_t *shm_writer = NULL;			/*!< Read-write mapping of the publishing process */
+static const SensorShm_t *shm_reader = NULL;	/*!< Read-only mapping of a reading process */
+static uint32_t shm_reader_pid = 0;				/*!< Publisher the reading process attached to */
+static pthread_mutex_t shm_writer_lock = PTHREAD_MUTEX_INITIALIZER;	/*!< Serializes publishing threads */
+
+static void SensorShm_StoreReading(const Sample_t *sample);
+static int SensorShm_ReadBegin(uint32_t *seq);
+
+/// \defgroup sensorshm Shared Memory Publication
+/// These functions share the sensor readings between processes without touching the bus more than once.
+/// @{
+
+/**
+ * @brief Creates or takes over the shared segment as its only publisher.
+ * @return status 0 on success, -1 on error.
+ */
+int SensorShm_Create(void)
+{
+	if(shm_writer)
+	{
+		return 0;
+	}
+
+	int fd = shm_open(SENSOR_SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if(fd < 0)
+	{
+		perror("SensorShm create");
+		return -1;
+	}
+	if(ftruncate(fd, sizeof(SensorShm_t)) < 0)
+	{
+		perror("SensorShm resize");
+		close(fd);
+		return -1;
+	}
+	void *map = mmap(NULL, sizeof(SensorShm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		perror("SensorShm map");
+		return -1;
+	}
+	shm_writer = map;
+
+	//A restarted publisher keeps the sequence so readers of the old contents retry instead of tearing.
+	//An odd sequence means the last publisher died during an update, which is simply taken over.
+	if((__atomic_load_n(&shm_writer->lock.sequence, __ATOMIC_RELAXED) & 1) == 0)
+	{
+		Seqlock_WriteBegin(&shm_writer->lock);
+	}
+	shm_writer->version = SENSOR_SHM_VERSION;
+	shm_writer->size = sizeof(SensorShm_t);
+	shm_writer->writer_pid = (uint32_t) getpid();
+	shm_writer->history_len = SENSOR_SHM_HISTORY;
+	shm_writer->publish_count = 0;
+	shm_writer->history_head = 0;
+	memset(&shm_writer->latest, 0, sizeof(shm_writer->latest));
+	memset(shm_writer->history, 0, sizeof(shm_writer->history));
+	Seqlock_WriteEnd(&shm_writer->lock);
+	__atomic_store_n(&shm_writer->magic, SENSOR_SHM_MAGIC, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * @brief Unmaps and removes the shared segment. The next read of every attached reader fails and detaches.
+ * @return none
+ */
+void SensorShm_Destroy(void)
+{
+	if(shm_writer == NULL)
+	{
+		return;
+	}
+	__atomic_store_n(&shm_writer->magic, 0, __ATOMIC_RELEASE);
+	munmap(shm_writer, sizeof(SensorShm_t));
+	shm_writer = NULL;
+	shm_unlink(SENSOR_SHM_NAME);
+}
+
+/**
+ * @brief Publishes a batch of samples as the latest readings and appends them to the history.
+ *		  Has the SampleCallback_t signature: Scheduler_AddCallback(SensorShm_Publish, NULL).
+ * @param samples Samples of one scheduler pass
+ * @param count Number of samples
+ * @param arg Unused
+ * @return none
+ */
+void SensorShm_Publish(const Sample_t *samples, unsigned int count, void *arg)
+{
+	(void) arg;
+	if(shm_writer == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&shm_writer_lock);
+	Seqlock_WriteBegin(&shm_writer->lock);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		SensorShm_StoreReading(&samples[i]);
+		shm_writer->history[shm_writer->history_head & HISTORY_MASK] = samples[i];
+		shm_writer->history_head++;
+	}
+	shm_writer->publish_count++;
+	Seqlock_WriteEnd(&shm_writer->lock);
+	pthread_mutex_unlock(&shm_writer_lock);
+}
+
+/**
+ * @brief Publishes the valid channels of a snapshot, e.g. one taken with getSnapshot.
+ *		  Snapshots update the latest readings only, they are not added to the history.
+ * @param snapshot Snapshot to publish
+ * @return none
+ */
+void SensorShm_PublishSnapshot(const SensorSnapshot_t *snapshot)
+{
+	if(shm_writer == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&shm_writer_lock);
+	Seqlock_WriteBegin(&shm_writer->lock);
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		if(snapshot->valid & SENSOR_CHANNEL_BIT(ch))
+		{
+			shm_writer->latest.reading[ch] = snapshot->reading[ch];
+		}
+	}
+	shm_writer->latest.valid |= snapshot->valid;
+	if(snapshot->valid & SENSOR_CHANNEL_BIT(SENSOR_RTCC))
+	{
+		shm_writer->latest.time = snapshot->time;
+	}
+	shm_writer->publish_count++;
+	Seqlock_WriteEnd(&shm_writer->lock);
+	pthread_mutex_unlock(&shm_writer_lock);
+}
+
+/**
+ * @brief Maps the shared segment read-only. Does not touch the bus, setupSensorian is not needed.
+ * @return status 0 on success, -1 if no publisher has created the segment or its layout differs.
+ */
+int SensorShm_Attach(void)
+{
+	struct stat st;
+
+	if(shm_reader)
+	{
+		return 0;
+	}
+
+	int fd = shm_open(SENSOR_SHM_NAME, O_RDONLY, 0);
+	if(fd < 0)
+	{
+		return -1;
+	}
+	if(fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(SensorShm_t))
+	{
+		close(fd);
+		return -1;
+	}
+	void *map = mmap(NULL, sizeof(SensorShm_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	const SensorShm_t *shm = map;
+	if(__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != SENSOR_SHM_MAGIC ||
+	   shm->version != SENSOR_SHM_VERSION || shm->size != sizeof(SensorShm_t))
+	{
+		printf("SensorShm: segment is not initialized or has another layout.\n");
+		munmap(map, sizeof(SensorShm_t));
+		return -1;
+	}
+	shm_reader = shm;
+	shm_reader_pid = __atomic_load_n(&shm->writer_pid, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+/**
+ * @brief Unmaps the shared segment.
+ * @return none
+ */
+void SensorShm_Detach(void)
+{
+	if(shm_reader)
+	{
+		munmap((void *) shm_reader, sizeof(SensorShm_t));
+		shm_reader = NULL;
+	}
+}
+
+/**
+ * @brief Returns the publish counter, which changes whenever new readings are available.
+ * @return count Number of publishes, 0 when not attached.
+ */
+uint64_t SensorShm_PublishCount(void)
+{
+	if(shm_reader == NULL)
+	{
+		return 0;
+	}
+	return __atomic_load_n(&shm_reader->publish_count, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Copies the latest reading of every channel.
+ * @param snapshot Structure to fill
+ * @return count Number of valid channels, -1 when not attached or the publisher is gone.
+ */
+int SensorShm_ReadSnapshot(SensorSnapshot_t *snapshot)
+{
+	uint32_t seq;
+	int count = 0;
+
+	if(shm_reader == NULL)
+	{
+		return -1;
+	}
+	do
+	{
+		if(SensorShm_ReadBegin(&seq) != 0)
+		{
+			return -1;
+		}
+		memcpy(snapshot, &shm_reader->latest, sizeof(*snapshot));
+	} while(Seqlock_ReadRetry(&shm_reader->lock, seq));
+
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		count += (snapshot->valid >> ch) & 1;
+	}
+	return count;
+}
+
+/**
+ * @brief Copies the latest reading of one channel.
+ * @param channel Channel to read
+ * @param reading Structure to fill
+ * @return status 0 if the channel has been published, -1 otherwise or when the publisher is gone.
+ */
+int SensorShm_ReadChannel(SensorChannel_t channel, SensorReading_t *reading)
+{
+	uint32_t seq;
+
+	if(shm_reader == NULL || (unsigned) channel >= SENSOR_CHANNEL_COUNT)
+	{
+		return -1;
+	}
+	do
+	{
+		if(SensorShm_ReadBegin(&seq) != 0)
+		{
+			return -1;
+		}
+		memcpy(reading, &shm_reader->latest.reading[channel], sizeof(*reading));
+	} while(Seqlock_ReadRetry(&shm_reader->lock, seq));
+	return reading->valid ? 0 : -1;
+}
+
+/**
+ * @brief Copies the samples published since the cursor, oldest first. Start with a cursor of 0 to get
+ *		  the whole history. If the reader fell more than SENSOR_SHM_HISTORY samples behind, the cursor
+ *		  jumps to the oldest sample still kept.
+ * @param cursor Position of the next sample wanted, advanced past the samples copied
+ * @param samples Buffer to fill
+ * @param count Size of the buffer in samples
+ * @return copied Number of samples copied, -1 when not attached or the publisher is gone.
+ */
+int SensorShm_ReadHistory(uint64_t *cursor, Sample_t *samples, unsigned int count)
+{
+	uint32_t seq;
+	uint64_t start;
+	unsigned int n;
+
+	if(shm_reader == NULL)
+	{
+		return -1;
+	}
+	do
+	{
+		if(SensorShm_ReadBegin(&seq) != 0)
+		{
+			return -1;
+		}
+		uint64_t head = shm_reader->history_head;
+		uint64_t oldest = (head > SENSOR_SHM_HISTORY) ? head - SENSOR_SHM_HISTORY : 0;
+
+		start = *cursor;
+		if(start < oldest || start > head)		//Fell behind, or the publisher restarted
+		{
+			start = oldest;
+		}
+		n = (head - start < count) ? (unsigned int)(head - start) : count;
+		for(unsigned int i = 0; i < n; i++)
+		{
+			samples[i] = shm_reader->history[(start + i) & HISTORY_MASK];
+		}
+	} while(Seqlock_ReadRetry(&shm_reader->lock, seq));
+
+	*cursor = start + n;
+	return (int) n;
+}
+
+/// @}
+
+/**
+ * @brief Stores one sample as the latest reading of its channel. Called inside the write section.
+ */
+static void SensorShm_StoreReading(const Sample_t *sample)
+{
+	if(sample->channel >= SENSOR_CHANNEL_COUNT || (sample->flags & SAMPLE_VALID) == 0)
+	{
+		return;
+	}
+	SensorReading_t *reading = &shm_writer->latest.reading[sample->channel];
+	reading->timestamp_ns = sample->timestamp_ns;
+	reading->value = sample->value;
+	reading->valid = 1;
+	shm_writer->latest.valid |= SENSOR_CHANNEL_BIT(sample->channel);
+}
+
+/**
+ * @brief Starts a read of the reader mapping. Detaches if the segment was removed, a new publisher took it
+ *		  over, or the publisher died in the middle of an update. Only the last case costs a system call.
+ * @param seq Filled with the sequence to hand to Seqlock_ReadRetry
+ * @return status 0 on success, -1 after detaching.
+ */
+static int SensorShm_ReadBegin(uint32_t *seq)
+{
+	while(Seqlock_TryReadBegin(&shm_reader->lock, WRITER_SPINS, seq) != 0)
+	{
+		if(kill((pid_t) shm_reader_pid, 0) < 0 && errno == ESRCH)
+		{
+			SensorShm_Detach();
+			return -1;
+		}
+	}
+	if(__atomic_load_n(&shm_reader->magic, __ATOMIC_ACQUIRE) != SENSOR_SHM_MAGIC ||
+	   __atomic_load_n(&shm_reader->writer_pid, __ATOMIC_ACQUIRE) != shm_reader_pid)
+	{
+		SensorShm_Detach();
+		return -1;
+	}
+	return 0;
+}
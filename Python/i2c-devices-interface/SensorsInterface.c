@@ -8,7 +8,10 @@
 
 #include <bcm2835.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "MPL3115A2.h"
 #include "APDS9300.h"
 #include "CAP1203.h"
@@ -17,62 +20,225 @@
 #include "led.h"
 #include "i2c.h"
 #include "Utilities.h"
+#include "SensorAcquire.h"
+#include "SensorPower.h"
+#include "Seqlock.h"
 #include "SensorsInterface.h"
+#include "Shield.h"
 
-RTCC_Struct *current_time; /*!< Stores last polled date and time */
+static pthread_once_t led_once = PTHREAD_ONCE_INIT; /*!< Sets the LED pin up on first use */
 
+/**
+ * @brief Starts an update of the shared state of a shield
+ */
+static void stateWriteBegin(Shield_t *shield)
+{
+	pthread_mutex_lock(&shield->writer_lock);
+	Seqlock_WriteBegin(&shield->state_lock);
+}
+
+/**
+ * @brief Publishes an update of the shared state of a shield
+ */
+static void stateWriteEnd(Shield_t *shield)
+{
+	Seqlock_WriteEnd(&shield->state_lock);
+	pthread_mutex_unlock(&shield->writer_lock);
+}
+
+/**
+ * @brief Reads a float from the shared state without blocking
+ * @param shield Shield the field belongs to
+ * @param field Pointer to the field inside the state of the shield
+ * @return float of a consistent value of the field
+ */
+static float readStateFloat(Shield_t *shield, const float *field)
+{
+	uint32_t seq;
+	float value;
+	do
+	{
+		seq = Seqlock_ReadBegin(&shield->state_lock);
+		value = *(const volatile float *) field;
+	} while (Seqlock_ReadRetry(&shield->state_lock, seq));
+	return value;
+}
+
+/**
+ * @brief Copies a part of the shared state without blocking
+ * @param shield Shield the field belongs to
+ * @param field Pointer to the field inside the state of the shield
+ * @param out Buffer to copy into
+ * @param size Size of the field
+ */
+static void readState(Shield_t *shield, const void *field, void *out, size_t size)
+{
+	uint32_t seq;
+	do
+	{
+		seq = Seqlock_ReadBegin(&shield->state_lock);
+		memcpy(out, field, size);
+	} while (Seqlock_ReadRetry(&shield->state_lock, seq));
+}
+
+
+/**
+ * @brief Maps the peripherals and makes the LED pin an output
+ */
+static void ledSetup(void)
+{
+	if(hardware_acquire() == 0) //Held until exit like the I2C and SPI mappings
+	{
+		LED_init();
+	}
+}
+
+/**
+ * @brief Work run on a second thread during setupSensorianFast
+ */
+typedef struct _SetupTask
+{
+	void (*run)(void); /*!< Function to run */
+	uint32_t elapsed_us; /*!< Time it took */
+} SetupTask_t;
+
+/**
+ * @brief Runs a SetupTask_t and times it
+ */
+static void* runSetupTask(void *arg)
+{
+	SetupTask_t *task = (SetupTask_t *) arg;
+	uint64_t start = timestamp_ns();
+	task->run();
+	task->elapsed_us = (uint32_t)((timestamp_ns() - start) / 1000);
+	return NULL;
+}
+
+/**
+ * @brief First data condition of the FXOS8700CQ: a complete X, Y, Z sample
+ */
+static unsigned char motionData(void)
+{
+	return (FXOS8700CQ_ReadStatusReg() & ZYXDR_MASK) != 0;
+}
+
+/**
+ * @brief First data condition of the MPL3115A2: a pressure or temperature conversion
+ */
+static unsigned char pressureData(void)
+{
+	return (MPL3115A2_ReadByte(STATUS) & PTDR) != 0;
+}
+
+/**
+ * @brief Records in a report how long a device took to become ready
+ */
+static void setupMark(SetupReport_t *report, SensorDevice_t device, int status, uint64_t start, uint16_t id)
+{
+	report->ready_us[device] = (uint32_t)((timestamp_ns() - start) / 1000);
+	report->chip_id[device] = id;
+	if(status == 0)
+	{
+		report->ready |= 1UL << device;
+	}
+}
 
 /**
  * @brief Sets up all the Sensorian sensors, buttons, clock and LED for use by the program
- * @return 0 upon successful setup
+ * @return 0 upon successful setup, -1 if a chip did not become ready
  */
 int setupSensorian(void)
 {
-	printf("Initializing sensors.\r\n");
-	I2C_Initialize(); //Initialize I2C BCM library
-	
-	MPL3115A2_Initialize();		//Initialize Temp/Baro/Alti sensor
-	MPL3115A2_ActiveMode();		//Configure the sensor for active mode
-	
-	AL_Initialize(); //Setup Ambient Light sensor
-	
-	CAP1203_Initialize(); //Setup Capacitive Touch sensor
-	
-	FXOS8700CQ_Initialize(); //Setup Accelerometer/Magnetometer sensor
-	
-	unsigned char id  = MPL3115A2_ID();	//Verify chip id for MPL3115A2
-	printf("MPL3115A2 Chip ID: 0x%02X . \r\n", id);
-	id = AL_ChipID(); //Verify chip id for APDS9300
-	printf("APDS9300 Chip ID: 0x%02X . \r\n", id);
-	id = CAP1203_ReadID(); //Verify chip id for CAP1203
-	printf("CAP1203 Chip ID: 0x%04X. \r\n",id);
-	id = FXOS8700CQ_ID(); //Verify chip id for FXOS8700CQ
-	printf("FXOS8700CQ Chip ID: 0x%02X. \r\n",id);
-	
-	//Setup APDS9300 - Ambient Light Sensor
-	AL_SetGain(GAIN_16);
-	AL_SetSamplingTime(S3);
-	AL_Clear_Interrupt();
-	
-	//Setup FXOS8700CQ - Magnetometer/Accelerometer
-	FXOS8700CQ_StandbyMode();
-	FXOS8700CQ_WriteByte(SYSMOD,0x01);		//Set to wake up 
-	FXOS8700CQ_ActiveMode();
-	
-	//Set LED pin as output
-	LED_init();
-	
-	//Setup RTCC
-	if(MCP79410_IsRunning())	//If clock is already running stop it 
+	SetupReport_t report;
+	int status = setupSensorianFast(NULL, SETUP_WAIT_DATA, &report); //The getters read the sensors right away
+
+	for(int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
 	{
-		MCP79410_DisableOscillator();
+		printf("%-10s ID 0x%04X %s after %.1f ms\n", SensorDevice_Name(dev), report.chip_id[dev],
+			   (report.ready & (1UL << dev)) ? "ready" : "NOT READY", report.ready_us[dev] / 1000.0);
 	}
-	MCP79410_Initialize();	//Initialize RTCC with system time and date
-	current_time = (RTCC_Struct *) malloc(sizeof(RTCC_Struct));
+	printf("Sensors initialized in %.1f ms, first readings after %.1f ms.\n", report.total_us / 1000.0,
+		   report.data_us / 1000.0);
+	return status;
+}
+
+/**
+ * @brief Sets up the sensors, clock and LED without fixed sleeps, waiting for each chip's own ready
+ *		  condition. The FXOS8700CQ reboots while the other chips are configured and the MPL3115A2 is
+ *		  started first so its first conversion overlaps the rest. Prints nothing. Calling it is optional,
+ *		  every getter brings its chip up on first use, see SensorPower.h. Chips already up are left as they are.
+ * @param alongside Function run on a second thread meanwhile, e.g. TFT_Setup, or NULL. It may use SPI
+ *		  and GPIO but not I2C.
+ * @param flags SETUP_WAIT_DATA to also wait for the first conversion of every sensor. The sampler does
+ *		  not need it, it marks channels without a conversion as not valid.
+ * @param report Receives the time each chip took to become ready, may be NULL
+ * @return 0 if every chip became ready, -1 otherwise
+ */
+int setupSensorianFast(void (*alongside)(void), unsigned int flags, SetupReport_t *report)
+{
+	SetupReport_t local;
+	SetupTask_t task = {alongside, 0};
+	pthread_t thread;
+	int threaded = 0;
+	uint64_t start = timestamp_ns();
 
-	sleep(2); // Wait 2 seconds or some sensors won't be ready
-	printf("Sensors initialized.\n");
-	return 0;
+	if(report == NULL)
+	{
+		report = &local;
+	}
+	memset(report, 0, sizeof(*report));
+
+	I2C_Initialize(); //Maps the peripherals once, SPI shares the mapping
+	pthread_once(&led_once, ledSetup); //Pin functions are read-modify-write, so they are set before the second thread starts
+	if(alongside)
+	{
+		threaded = (pthread_create(&thread, NULL, runSetupTask, &task) == 0);
+	}
+
+	SensorPower_Begin(SENSOR_DEV_FXOS8700CQ); //Reboots while the other chips are set up
+
+	SensorPower_Begin(SENSOR_DEV_MPL3115A2); //Active with OS_128, the first conversion takes 512 ms
+	setupMark(report, SENSOR_DEV_MPL3115A2, SensorPower_Finish(SENSOR_DEV_MPL3115A2), start, MPL3115A2_ID());
+
+	SensorPower_Begin(SENSOR_DEV_APDS9300);
+	uint64_t light_on = timestamp_ns();
+	setupMark(report, SENSOR_DEV_APDS9300, SensorPower_Finish(SENSOR_DEV_APDS9300), start, AL_ChipID());
+
+	SensorPower_Begin(SENSOR_DEV_CAP1203);
+	setupMark(report, SENSOR_DEV_CAP1203, SensorPower_Finish(SENSOR_DEV_CAP1203), start, CAP1203_ReadID());
+
+	SensorPower_Begin(SENSOR_DEV_MCP79410); //Sets the system time and starts the oscillator, checked last
+
+	setupMark(report, SENSOR_DEV_FXOS8700CQ, SensorPower_Finish(SENSOR_DEV_FXOS8700CQ), start,
+			  (unsigned char) FXOS8700CQ_ID());
+
+	setupMark(report, SENSOR_DEV_MCP79410, SensorPower_Finish(SENSOR_DEV_MCP79410), start, 0);
+
+	int data = 0;
+	if(flags & SETUP_WAIT_DATA)
+	{
+		data = poll_ready(motionData, SETUP_DATA_TIMEOUT_MS);
+		data |= poll_ready(pressureData, SETUP_DATA_TIMEOUT_MS);
+		uint64_t light_due = light_on + APDS9300_S3_MS * 1000000ULL; //The APDS9300 has no data ready flag
+		uint64_t now = timestamp_ns();
+		if(now < light_due)
+		{
+			delay_ms((unsigned int)((light_due - now) / 1000000) + 1);
+		}
+		report->data_us = (uint32_t)((timestamp_ns() - start) / 1000);
+	}
+
+	if(threaded)
+	{
+		pthread_join(thread, NULL);
+	}
+	else if(alongside)
+	{
+		runSetupTask(&task);
+	}
+	report->alongside_us = task.elapsed_us;
+	report->total_us = (uint32_t)((timestamp_ns() - start) / 1000);
+	return (report->ready == (1UL << SENSOR_DEVICE_COUNT) - 1 && data == 0) ? 0 : -1;
 }
 
 /**
@@ -81,28 +247,59 @@ int setupSensorian(void)
  */
 float getAmbientLight(void)
 {
+	if(SensorPower_Acquire(SENSOR_DEV_APDS9300) != 0)  //Powers the sensor up on first use
+	{
+		return 0.0f;
+	}
 	unsigned int channel1 = AL_ReadChannel(CH0);  //Get a light reading from the first channel
 	unsigned int channel2 = AL_ReadChannel(CH1);  //Get a light reading from the second channel
+	SensorPower_Release(SENSOR_DEV_APDS9300);
+	if(channel1 == 0)  //The first integration after power up has not finished, AL_Lux divides by it
+	{
+		return 0.0f;
+	}
 	return AL_Lux(channel1,channel2);  //Return a c_float of the calculated lux level
 }
 
-float mpl_temperature = 0.0; /*!< Stores last Temperature polled from MPL3115A2 */
-float mpl_altitude = 0.0; /*!< Stores last Altitude polled from MPL3115A2 */
-float mpl_pressure = 0.0; /*!< Stores last Barometric Pressure polled from MPL3115A2 */
-
+/**
+ * @brief Reads which capacitive button is pressed, keeping the CAP1203 awake while it is polled
+ * @return int of the pressed button, 1 to 3, 0 for none
+ */
+int getTouchpad(void)
+{
+	if(SensorPower_Acquire(SENSOR_DEV_CAP1203) != 0)  //Wakes the sensor up if the idle sweep put it to sleep
+	{
+		return 0;
+	}
+	int button = CAP1203_ReadPressedButton();
+	SensorPower_Release(SENSOR_DEV_CAP1203);
+	return button;
+}
 
 /**
- * @brief Polls the sensor for temperature, altitude and pressure sequentially and stores their values in their global buffers
+ * @brief Polls the sensor for temperature, altitude and pressure sequentially and publishes them to the shared state
  */
 void pollMPL(void)
 {
-	mpl_temperature = MPL3115A2_ReadTemperature();
+	if(SensorPower_Acquire(SENSOR_DEV_MPL3115A2) != 0)  //Keeps the last values if the sensor does not answer
+	{
+		return;
+	}
+	float temperature = MPL3115A2_ReadTemperature();
 	MPL3115A2_StandbyMode();
 	MPL3115A2_AltimeterMode();
-	mpl_altitude = MPL3115A2_ReadAltitude();
+	float altitude = MPL3115A2_ReadAltitude();
 	MPL3115A2_StandbyMode();
 	MPL3115A2_BarometerMode();
-	mpl_pressure = MPL3115A2_ReadBarometricPressure();
+	float pressure = MPL3115A2_ReadBarometricPressure();
+	SensorPower_Release(SENSOR_DEV_MPL3115A2);
+
+	Shield_t *shield = Shield_Current();
+	stateWriteBegin(shield);
+	shield->state.mpl_temperature = temperature;
+	shield->state.mpl_altitude = altitude;
+	shield->state.mpl_pressure = pressure;
+	stateWriteEnd(shield);
 }
 
 /**
@@ -111,7 +308,8 @@ void pollMPL(void)
  */
 int getTemperature(void)
 {
-	return (int) mpl_temperature;
+	Shield_t *shield = Shield_Current();
+	return (int) readStateFloat(shield, &shield->state.mpl_temperature);
 }
 
 /**
@@ -120,7 +318,8 @@ int getTemperature(void)
  */
 int getAltitude(void)
 {
-	return (int) mpl_altitude;
+	Shield_t *shield = Shield_Current();
+	return (int) readStateFloat(shield, &shield->state.mpl_altitude);
 }
 
 /**
@@ -129,31 +328,47 @@ int getAltitude(void)
  */
 int getBarometricPressure(void)
 {
-	return (int) mpl_pressure;
+	Shield_t *shield = Shield_Current();
+	return (int) readStateFloat(shield, &shield->state.mpl_pressure);
 }
 
 
-rawdata_t magnetometerBuffer = {.x = 0, .y = 0, .z = 0}; /*!< Stores last polled Magnetometer data */
-rawdata_t accelerometerBuffer = {.x = 0, .y = 0, .z = 0}; /*!< Stores last polled Accelerometer data */
-
 /**
- * @brief Polls the accelerometer and magnetometer simultaneously and stores their values in the global buffer
+ * @brief Polls the accelerometer and magnetometer simultaneously and publishes their values to the shared state
  */
 void pollFXOS(void)
 {
-	if(FXOS8700CQ_ReadStatusReg() & 0x80)
+	rawdata_t magnetometer = {.x = 0, .y = 0, .z = 0};
+	rawdata_t accelerometer = {.x = 0, .y = 0, .z = 0};
+
+	if(SensorPower_Acquire(SENSOR_DEV_FXOS8700CQ) != 0)
 	{
-		FXOS8700CQ_GetData(&accelerometerBuffer,&magnetometerBuffer);
+		return;
 	}
-	else
-	{
-		magnetometerBuffer.x = 0;
-		magnetometerBuffer.y = 0;
-		magnetometerBuffer.z = 0;
-		accelerometerBuffer.x = 0;
-		accelerometerBuffer.y = 0;
-		accelerometerBuffer.z = 0;
+	if(FXOS8700CQ_ReadStatusReg() & 0x80)
+	{
+		FXOS8700CQ_GetData(&accelerometer,&magnetometer);
 	}
+	SensorPower_Release(SENSOR_DEV_FXOS8700CQ);
+
+	Shield_t *shield = Shield_Current();
+	stateWriteBegin(shield);
+	shield->state.magnetometer = magnetometer;
+	shield->state.accelerometer = accelerometer;
+	stateWriteEnd(shield);
+}
+
+/**
+ * @brief Reads one of the triple axis buffers from the shared state of the current shield
+ * @param magnetometer 1 for the magnetometer, 0 for the accelerometer
+ * @return rawdata_t copy of all three axes from the same poll
+ */
+static rawdata_t readStateAxes(int magnetometer)
+{
+	Shield_t *shield = Shield_Current();
+	rawdata_t axes;
+	readState(shield, magnetometer ? &shield->state.magnetometer : &shield->state.accelerometer, &axes, sizeof(axes));
+	return axes;
 }
 
 /**
@@ -162,7 +377,7 @@ void pollFXOS(void)
  */
 int getMagX(void)
 {
-	return (int) magnetometerBuffer.x;
+	return (int) readStateAxes(1).x;
 }
 
 /**
@@ -171,7 +386,7 @@ int getMagX(void)
  */
 int getMagY(void)
 {
-	return (int) magnetometerBuffer.y;
+	return (int) readStateAxes(1).y;
 }
 
 /**
@@ -180,7 +395,7 @@ int getMagY(void)
  */
 int getMagZ(void)
 {
-	return (int) magnetometerBuffer.z;
+	return (int) readStateAxes(1).z;
 }
 
 /**
@@ -189,7 +404,7 @@ int getMagZ(void)
  */
 int getAccelX(void)
 {
-	return (int) accelerometerBuffer.x;
+	return (int) readStateAxes(0).x;
 }
 
 /**
@@ -198,7 +413,7 @@ int getAccelX(void)
  */
 int getAccelY(void)
 {
-	return (int) accelerometerBuffer.y;
+	return (int) readStateAxes(0).y;
 }
 
 /**
@@ -207,7 +422,7 @@ int getAccelY(void)
  */
 int getAccelZ(void)
 {
-	return (int) accelerometerBuffer.z;
+	return (int) readStateAxes(0).z;
 }
 
 /**
@@ -215,7 +430,30 @@ int getAccelZ(void)
  */
 void poll_rtcc(void)
 {
-	current_time = MCP79410_GetTime();
+	if(SensorPower_Acquire(SENSOR_DEV_MCP79410) != 0)
+	{
+		return;
+	}
+	RTCC_Struct *time = MCP79410_GetTime();
+	SensorPower_Release(SENSOR_DEV_MCP79410);
+
+	Shield_t *shield = Shield_Current();
+	stateWriteBegin(shield);
+	shield->state.current_time = *time;
+	stateWriteEnd(shield);
+	free(time);
+}
+
+/**
+ * @brief Reads the last polled date and time from the shared state
+ * @return RTCC_Struct copy of all the fields from the same poll
+ */
+static RTCC_Struct readStateTime(void)
+{
+	Shield_t *shield = Shield_Current();
+	RTCC_Struct time;
+	readState(shield, &shield->state.current_time, &time, sizeof(time));
+	return time;
 }
 
 /**
@@ -224,7 +462,7 @@ void poll_rtcc(void)
  */
 int get_rtcc_year(void)
 {
-	return (int) current_time->year;
+	return (int) readStateTime().year;
 }
 
 /**
@@ -233,7 +471,7 @@ int get_rtcc_year(void)
  */
 int get_rtcc_month(void)
 {
-	return (int) current_time->month;
+	return (int) readStateTime().month;
 }
 
 /**
@@ -242,7 +480,7 @@ int get_rtcc_month(void)
  */
 int get_rtcc_date(void)
 {
-	return (int) current_time->date;
+	return (int) readStateTime().date;
 }
 
 /**
@@ -251,7 +489,7 @@ int get_rtcc_date(void)
  */
 int get_rtcc_hour(void)
 {
-	return (int) current_time->hour;
+	return (int) readStateTime().hour;
 }
 
 /**
@@ -260,7 +498,7 @@ int get_rtcc_hour(void)
  */
 int get_rtcc_minute(void)
 {
-	return (int) current_time->min;
+	return (int) readStateTime().min;
 }
 
 /**
@@ -269,7 +507,7 @@ int get_rtcc_minute(void)
  */
 int get_rtcc_second(void)
 {
-	return (int) current_time->sec;
+	return (int) readStateTime().sec;
 }
 
 /**
@@ -286,6 +524,10 @@ void set_rtcc_datetime(int year, int month, int date, int w_day, int hour, int m
 	input_time.min = (unsigned char) minute;
 	input_time.sec = (unsigned char) second;
 	
+	if (SensorPower_Acquire(SENSOR_DEV_MCP79410) != 0)
+	{
+		return;
+	}
 	//If the clock is already running temporarily stop it
 	if (MCP79410_IsRunning())
 	{
@@ -296,6 +538,7 @@ void set_rtcc_datetime(int year, int month, int date, int w_day, int hour, int m
 	
 	//Restart the clock
 	MCP79410_EnableOscillator();
+	SensorPower_Release(SENSOR_DEV_MCP79410);
 }
 
 /**
@@ -312,6 +555,10 @@ void set_rtcc_alarm(int year, int month, int date, int w_day, int hour, int minu
 	input_time.min = (unsigned char) minute;
 	input_time.sec = (unsigned char) second;
 	
+	if (SensorPower_Acquire(SENSOR_DEV_MCP79410) != 0)
+	{
+		return;
+	}
 	MCP79410_ClearInterruptFlag(RTCC_ZERO);
 	MCP79410_SetAlarmTime(&input_time,RTCC_ZERO);
 	//Allow different match modes
@@ -341,6 +588,7 @@ void set_rtcc_alarm(int year, int month, int date, int w_day, int hour, int minu
 	}
 	MCP79410_SetAlarmMFPPolarity(LOWPOL,RTCC_ZERO);
 	MCP79410_SetMFP_Functionality(ALARM_INTERRUPT);	 //Set alarm interrupt
+	SensorPower_Release(SENSOR_DEV_MCP79410);
 }
 
 /**
@@ -349,7 +597,12 @@ void set_rtcc_alarm(int year, int month, int date, int w_day, int hour, int minu
  */
 int poll_rtcc_alarm(void)
 {
+	if (SensorPower_Acquire(SENSOR_DEV_MCP79410) != 0)
+	{
+		return 0;
+	}
 	AlarmStatus_t s = MCP79410_GetAlarmStatus(RTCC_ZERO); //Check alarm status
+	SensorPower_Release(SENSOR_DEV_MCP79410);
 	return (int) s;  //Returns 0 if not triggered
 }
 
@@ -358,6 +611,10 @@ int poll_rtcc_alarm(void)
  */
 void reset_alarm(void)
 {
+	if (SensorPower_Acquire(SENSOR_DEV_MCP79410) != 0)
+	{
+		return;
+	}
 	AlarmStatus_t s = MCP79410_GetAlarmStatus(RTCC_ZERO); //Check alarm status
 	
 	if ((int) s != 0)  //If the alarm is triggered
@@ -365,6 +622,7 @@ void reset_alarm(void)
 		MCP79410_ClearInterruptFlag(RTCC_ZERO);  //Alarms trigger an interrupt so clear that
 		MCP79410_DisableAlarm(RTCC_ZERO);  //Turn off the alarm since it is confirmed to have triggered
 	}
+	SensorPower_Release(SENSOR_DEV_MCP79410);
 }
 
 /**
@@ -372,6 +630,7 @@ void reset_alarm(void)
  */
 void orange_led_on(void)
 {
+	pthread_once(&led_once, ledSetup); //The pin is only made an output when the LED is first used
 	LED_on();  //Call the function to do so from TFT.c so it isn't called implicitly from the program
 }
 
@@ -380,5 +639,178 @@ void orange_led_on(void)
  */
 void orange_led_off(void)
 {
+	pthread_once(&led_once, ledSetup);
 	LED_off();  //Call the function to do so from TFT.c so it isn't called implicitly from the program
 }
+
+/**
+ * @brief Reads every channel of the shield into a caller provided snapshot
+ * @param snapshot Structure to fill
+ * @return int of the number of valid channels
+ */
+int getSnapshot(SensorSnapshot_t *snapshot)
+{
+	return getSnapshotChannels(snapshot, SENSOR_ALL_CHANNELS);
+}
+
+/**
+ * @brief Reads the requested channels into a caller provided snapshot. Each device is read with one burst
+ * where the chip allows it, so asking for several channels of the same device costs no extra bus traffic.
+ * Channels that were not requested are marked invalid.
+ * @param snapshot Structure to fill
+ * @param channels Mask of channels to read, built with SENSOR_CHANNEL_BIT
+ * @return int of the number of valid channels
+ */
+int getSnapshotChannels(SensorSnapshot_t *snapshot, unsigned long channels)
+{
+	Acquisition_t acq;
+	int count = 0;
+
+	snapshot->valid = 0;
+	for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		snapshot->reading[ch].valid = 0;
+	}
+
+	for (int dev = 0; dev < SENSOR_DEVICE_COUNT; dev++)
+	{
+		unsigned long wanted = SensorDevice_Channels(dev) & channels;
+		if (wanted == 0)  //Skip devices with no requested channel
+		{
+			continue;
+		}
+		Acquire_Device(dev, &acq);
+		for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+		{
+			if (wanted & acq.valid & SENSOR_CHANNEL_BIT(ch))
+			{
+				snapshot->reading[ch].timestamp_ns = acq.timestamp_ns;
+				snapshot->reading[ch].value = acq.value[ch];
+				snapshot->reading[ch].valid = 1;
+				snapshot->valid |= SENSOR_CHANNEL_BIT(ch);
+				count++;
+			}
+		}
+		if (dev == SENSOR_DEV_MCP79410)
+		{
+			snapshot->time = acq.time;
+		}
+	}
+
+	Shield_t *shield = Shield_Current();
+	stateWriteBegin(shield);
+	for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		if (snapshot->valid & SENSOR_CHANNEL_BIT(ch))
+		{
+			shield->state.latest[ch] = snapshot->reading[ch];
+		}
+	}
+	shield->state.latest_valid |= snapshot->valid;
+	if (snapshot->valid & SENSOR_CHANNEL_BIT(SENSOR_RTCC))
+	{
+		shield->state.current_time = snapshot->time;
+	}
+	stateWriteEnd(shield);
+	return count;
+}
+
+/**
+ * @brief Publishes a batch of samples as the latest readings. Has the SampleCallback_t signature so the
+ * sampler can be registered with Scheduler_AddCallback(publishSamples, NULL).
+ * @param samples Samples taken in one pass
+ * @param count Number of samples
+ * @param arg Shield to publish to, NULL for the shield of the calling thread
+ */
+void publishSamples(const Sample_t *samples, unsigned int count, void *arg)
+{
+	Shield_t *shield = arg ? (Shield_t *) arg : Shield_Current();
+
+	stateWriteBegin(shield);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (samples[i].channel >= SENSOR_CHANNEL_COUNT || !(samples[i].flags & SAMPLE_VALID))
+		{
+			continue;
+		}
+		SensorReading_t *reading = &shield->state.latest[samples[i].channel];
+		reading->timestamp_ns = samples[i].timestamp_ns;
+		reading->value = samples[i].value;
+		reading->valid = 1;
+		shield->state.latest_valid |= SENSOR_CHANNEL_BIT(samples[i].channel);
+	}
+	stateWriteEnd(shield);
+}
+
+/**
+ * @brief Copies the latest published readings without touching the bus. Never blocks, and every channel
+ * in the copy comes from the same published state even while the sampler is writing.
+ * @param snapshot Structure to fill, channels never published are marked invalid
+ * @return int of the number of valid channels
+ */
+int getLatestSnapshot(SensorSnapshot_t *snapshot)
+{
+	Shield_t *shield = Shield_Current();
+	uint32_t seq;
+	int count = 0;
+
+	do
+	{
+		seq = Seqlock_ReadBegin(&shield->state_lock);
+		memcpy(snapshot->reading, shield->state.latest, sizeof(snapshot->reading));
+		memcpy(&snapshot->time, &shield->state.current_time, sizeof(snapshot->time));
+		snapshot->valid = *(const volatile uint32_t *) &shield->state.latest_valid;
+	} while (Seqlock_ReadRetry(&shield->state_lock, seq));
+
+	for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		count += (snapshot->valid >> ch) & 1;
+	}
+	return count;
+}
+
+/**
+ * @brief Copies a snapshot into one Sample_t per channel, indexed by SensorChannel_t.
+ */
+static void snapshotSamples(const SensorSnapshot_t *snapshot, Sample_t *samples)
+{
+	for (int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		samples[ch].timestamp_ns = snapshot->reading[ch].timestamp_ns;
+		samples[ch].value = snapshot->reading[ch].value;
+		samples[ch].channel = ch;
+		samples[ch].flags = (snapshot->valid & SENSOR_CHANNEL_BIT(ch)) ? SAMPLE_VALID : 0;
+	}
+}
+
+/**
+ * @brief Reads the requested channels into a caller provided array of SENSOR_CHANNEL_COUNT samples, so a
+ * binding gets a whole snapshot in one call. Sample_t is packed in 16 bytes with no padding, a layout a
+ * ctypes or numpy record can mirror directly, unlike SensorSnapshot_t.
+ * @param samples Array of SENSOR_CHANNEL_COUNT samples to fill, indexed by SensorChannel_t
+ * @param channels Mask of channels to read, built with SENSOR_CHANNEL_BIT
+ * @return int of the number of valid channels, the others have no SAMPLE_VALID flag
+ */
+int getSnapshotSamples(Sample_t *samples, unsigned long channels)
+{
+	SensorSnapshot_t snapshot;
+	int count = getSnapshotChannels(&snapshot, channels);
+
+	snapshotSamples(&snapshot, samples);
+	return count;
+}
+
+/**
+ * @brief Copies the latest published readings into a caller provided array of SENSOR_CHANNEL_COUNT samples
+ * without touching the bus, like getLatestSnapshot.
+ * @param samples Array of SENSOR_CHANNEL_COUNT samples to fill, indexed by SensorChannel_t
+ * @return int of the number of valid channels
+ */
+int getLatestSamples(Sample_t *samples)
+{
+	SensorSnapshot_t snapshot;
+	int count = getLatestSnapshot(&snapshot);
+
+	snapshotSamples(&snapshot, samples);
+	return count;
+}
@@ -8,8 +8,50 @@
 #ifndef C_SENSORSINTERFACE_H
 #define C_SENSORSINTERFACE_H
 
+#include <stdint.h>
+#include "SensorChannels.h"
+#include "MCP79410.h"
+
+/**
+ * @brief One channel of a snapshot.
+ */
+typedef struct _SensorReading
+{
+	uint64_t timestamp_ns; /*!< Acquisition time on the monotonic clock */
+	float value; /*!< Reading in the channel's SI unit, see SensorChannels.h */
+	uint32_t valid; /*!< 1 if the value was freshly read for this snapshot */
+} SensorReading_t;
+
+/**
+ * @brief Every channel of the shield, filled by getSnapshot.
+ */
+typedef struct _SensorSnapshot
+{
+	SensorReading_t reading[SENSOR_CHANNEL_COUNT]; /*!< Indexed by SensorChannel_t */
+	uint32_t valid; /*!< Mask of valid channels, see SENSOR_CHANNEL_BIT */
+	RTCC_Struct time; /*!< Full RTCC date and time, valid with SENSOR_RTCC */
+} SensorSnapshot_t;
+
+#define SETUP_WAIT_DATA 0x01 /*!< setupSensorianFast returns once every sensor has a first reading */
+#define SETUP_DATA_TIMEOUT_MS 1100 /*!< Longest wait for a first reading, the MPL3115A2 takes 512 ms at OS_128 */
+
+/**
+ * @brief Startup timing filled by setupSensorianFast.
+ */
+typedef struct _SetupReport
+{
+	uint32_t ready_us[SENSOR_DEVICE_COUNT]; /*!< Time from the start of setup until each chip was ready */
+	uint16_t chip_id[SENSOR_DEVICE_COUNT]; /*!< ID read from each chip, 0 for the MCP79410 which has none */
+	uint32_t ready; /*!< Mask of the chips that became ready, bit n for SensorDevice_t n */
+	uint32_t data_us; /*!< Time until every sensor had a first reading, with SETUP_WAIT_DATA */
+	uint32_t alongside_us; /*!< Time the function run alongside took, 0 if there was none */
+	uint32_t total_us; /*!< Time until setupSensorianFast returned */
+} SetupReport_t;
+
 int setupSensorian(void);
+int setupSensorianFast(void (*alongside)(void), unsigned int flags, SetupReport_t *report);
 float getAmbientLight(void);
+int getTouchpad(void);
 void pollMPL(void);
 int getTemperature(void);
 int getAltitude(void);
@@ -34,5 +76,11 @@ int poll_rtcc_alarm(void);
 void reset_alarm(void);
 void orange_led_on(void);
 void orange_led_off(void);
+int getSnapshot(SensorSnapshot_t *snapshot);
+int getSnapshotChannels(SensorSnapshot_t *snapshot, unsigned long channels);
+void publishSamples(const Sample_t *samples, unsigned int count, void *arg);
+int getLatestSnapshot(SensorSnapshot_t *snapshot);
+int getSnapshotSamples(Sample_t *samples, unsigned long channels);
+int getLatestSamples(Sample_t *samples);
 
 #endif //C_SENSORSINTERFACE_H
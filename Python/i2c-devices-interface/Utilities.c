@@ -1,5 +1,14 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
 #include "Utilities.h"
 
+static unsigned int hardware_users = 0; /*!< Drivers holding the bcm2835 mapping of /dev/mem */
+static pthread_mutex_t hardware_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t (*clock_now)(void) = NULL;			/*!< Replaces CLOCK_MONOTONIC, e.g. with a simulated clock */
+static void (*clock_wait_until)(uint64_t ns) = NULL;	/*!< Waits for a time of that clock */
+
 /// \defgroup utilities Utilities
 /// These are common helper functions that are used to read and write GPIO pins and for timing delays.
 /// @{
@@ -14,6 +23,119 @@ void delay_ms(unsigned int ms)
 	bcm2835_delay(ms);
 }
 
+/**
+ * @brief Monotonic timestamp used for sample times and schedules.
+ * @return now Nanoseconds on CLOCK_MONOTONIC.
+ */
+uint64_t timestamp_ns(void)
+{
+	if(clock_now)
+	{
+		return clock_now();
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Sleeps until timestamp_ns reaches a time.
+ * @param ns Time to wait for, in the time base of timestamp_ns
+ * @return none
+ */
+void wait_until_ns(uint64_t ns)
+{
+	if(clock_wait_until)
+	{
+		clock_wait_until(ns);
+		return;
+	}
+	struct timespec ts = {.tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL};
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/**
+ * @brief Replaces the clock behind timestamp_ns and wait_until_ns, e.g. with the virtual clock of the
+ *		  simulated shield, on which waiting means moving the clock forward.
+ * @param now Returns the time in ns, NULL to go back to CLOCK_MONOTONIC
+ * @param wait_until Returns once the clock has reached the given time
+ * @return none
+ */
+void timestamp_set_clock(uint64_t (*now)(void), void (*wait_until)(uint64_t ns))
+{
+	clock_wait_until = now ? wait_until : NULL;
+	clock_now = now;
+}
+
+/**
+ * @brief Tells whether timestamp_ns runs on a clock set with timestamp_set_clock.
+ * @return virtual 1 for a replaced clock, 0 for CLOCK_MONOTONIC.
+ */
+int timestamp_is_virtual(void)
+{
+	return clock_now != NULL;
+}
+
+/**
+ * @brief Maps the peripherals with bcm2835_init for the first user, so the I2C, SPI and GPIO drivers
+ *		  share one mapping of /dev/mem. Safe to call from several threads.
+ * @return status 0 on success, -1 if the mapping failed, which usually means the program was not run as root.
+ */
+int hardware_acquire(void)
+{
+	int status = 0;
+
+	pthread_mutex_lock(&hardware_lock);
+	if(hardware_users == 0 && !bcm2835_init())
+	{
+		status = -1;
+	}
+	else
+	{
+		hardware_users++;
+	}
+	pthread_mutex_unlock(&hardware_lock);
+	return status;
+}
+
+/**
+ * @brief Releases a mapping taken with hardware_acquire and unmaps the peripherals after the last user.
+ * @return none
+ */
+void hardware_release(void)
+{
+	pthread_mutex_lock(&hardware_lock);
+	if(hardware_users > 0 && --hardware_users == 0)
+	{
+		bcm2835_close();
+	}
+	pthread_mutex_unlock(&hardware_lock);
+}
+
+/**
+ * @brief Polls a chip until it reports that it is ready, instead of sleeping for its worst case.
+ * @param ready Returns non-zero once the chip is ready
+ * @param timeout_ms Longest time to wait
+ * @return status 0 once ready, -1 on timeout.
+ */
+int poll_ready(unsigned char (*ready)(void), unsigned int timeout_ms)
+{
+	uint64_t deadline = timestamp_ns() + timeout_ms * 1000000ULL;
+
+	for(;;)
+	{
+		if(ready())
+		{
+			return 0;
+		}
+		if(timestamp_ns() >= deadline)
+		{
+			return -1;
+		}
+		bcm2835_delayMicroseconds(POLL_READY_US);
+	}
+}
+
 /**
  * @brief Configures the given pin as output.
  * @param pin PIN_t type 
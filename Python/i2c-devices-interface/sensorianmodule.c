@@ -0,0 +1,295 @@
+/**
+ * @file sensorianmodule.c
+ * @brief _sensorian, a CPython extension module over libsensorianplus.so
+ *
+ * SensorsInterface.py uses these functions in place of its ctypes calls when
+ * the module is built. Each call converts its result straight into Python
+ * objects, returning one tuple where the ctypes path makes a call per value,
+ * and releases the GIL while the library talks to the bus so other Python
+ * threads keep running. getSnapshot takes its optional argument through the
+ * METH_FASTCALL calling convention on Python 3.7 and later, so no argument
+ * tuple is built. The module links against libsensorianplus.so rather than
+ * its objects, so it shares the sensors' state with the ctypes handle.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdint.h>
+#include "SensorsInterface.h"
+#include "led.h"
+
+#if PY_VERSION_HEX >= 0x03070000
+#define FASTCALL_FLAGS		METH_FASTCALL
+#define FASTCALL_PARAMS		PyObject *self, PyObject *const *args, Py_ssize_t nargs
+#define FASTCALL_UNPACK
+#else
+#define FASTCALL_FLAGS		METH_VARARGS
+#define FASTCALL_PARAMS		PyObject *self, PyObject *argtuple
+#define FASTCALL_UNPACK		Py_ssize_t nargs = PyTuple_GET_SIZE(argtuple); \
+							PyObject **args = &PyTuple_GET_ITEM(argtuple, 0);
+#endif
+
+#if PY_MAJOR_VERSION < 3
+#define PyLong_FromLong		PyInt_FromLong
+#endif
+
+static PyObject* snapshotTuple(const SensorSnapshot_t *snapshot);
+
+/// \defgroup sensorianmodule Python extension
+/// These functions are the methods of the _sensorian module. They take the names of the C functions they wrap.
+/// @{
+
+/**
+ * @brief Sets up every sensor, like setupSensorian.
+ * @return int 0 on success.
+ */
+static PyObject* py_setupSensorian(PyObject *self, PyObject *unused)
+{
+	int status;
+
+	Py_BEGIN_ALLOW_THREADS
+	status = setupSensorian();
+	Py_END_ALLOW_THREADS
+	return PyLong_FromLong(status);
+}
+
+/**
+ * @brief Turns the orange LED on.
+ */
+static PyObject* py_LED_on(PyObject *self, PyObject *unused)
+{
+	LED_on();
+	Py_RETURN_NONE;
+}
+
+/**
+ * @brief Turns the orange LED off.
+ */
+static PyObject* py_LED_off(PyObject *self, PyObject *unused)
+{
+	LED_off();
+	Py_RETURN_NONE;
+}
+
+/**
+ * @brief Reads the ambient light level.
+ * @return float in lux.
+ */
+static PyObject* py_getAmbientLight(PyObject *self, PyObject *unused)
+{
+	float lux;
+
+	Py_BEGIN_ALLOW_THREADS
+	lux = getAmbientLight();
+	Py_END_ALLOW_THREADS
+	return PyFloat_FromDouble(lux);
+}
+
+/**
+ * @brief Polls the MPL3115A2 for temperature, altitude and pressure.
+ */
+static PyObject* py_pollMPL(PyObject *self, PyObject *unused)
+{
+	Py_BEGIN_ALLOW_THREADS
+	pollMPL();
+	Py_END_ALLOW_THREADS
+	Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns the temperature of the last pollMPL.
+ * @return int in degrees Celsius.
+ */
+static PyObject* py_getTemperature(PyObject *self, PyObject *unused)
+{
+	return PyLong_FromLong(getTemperature());
+}
+
+/**
+ * @brief Returns the altitude of the last pollMPL.
+ * @return int in m.
+ */
+static PyObject* py_getAltitude(PyObject *self, PyObject *unused)
+{
+	return PyLong_FromLong(getAltitude());
+}
+
+/**
+ * @brief Returns the barometric pressure of the last pollMPL.
+ * @return int in Pa.
+ */
+static PyObject* py_getBarometricPressure(PyObject *self, PyObject *unused)
+{
+	return PyLong_FromLong(getBarometricPressure());
+}
+
+/**
+ * @brief Polls the FXOS8700CQ for acceleration and magnetic field.
+ */
+static PyObject* py_pollFXOS(PyObject *self, PyObject *unused)
+{
+	Py_BEGIN_ALLOW_THREADS
+	pollFXOS();
+	Py_END_ALLOW_THREADS
+	Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns the acceleration of the last pollFXOS.
+ * @return tuple of the raw x, y and z ints.
+ */
+static PyObject* py_getAccelerometer(PyObject *self, PyObject *unused)
+{
+	return Py_BuildValue("(iii)", getAccelX(), getAccelY(), getAccelZ());
+}
+
+/**
+ * @brief Returns the magnetic field of the last pollFXOS.
+ * @return tuple of the raw x, y and z ints.
+ */
+static PyObject* py_getMagnetometer(PyObject *self, PyObject *unused)
+{
+	return Py_BuildValue("(iii)", getMagX(), getMagY(), getMagZ());
+}
+
+/**
+ * @brief Reads which capacitive button is pressed.
+ * @return int 1 to 3, 0 for none.
+ */
+static PyObject* py_getTouchpad(PyObject *self, PyObject *unused)
+{
+	int button;
+
+	Py_BEGIN_ALLOW_THREADS
+	button = getTouchpad();
+	Py_END_ALLOW_THREADS
+	return PyLong_FromLong(button);
+}
+
+/**
+ * @brief Polls the real time clock and returns its date and time.
+ * @return tuple of year, month, date, hour, minute and second.
+ */
+static PyObject* py_getRTCCtime(PyObject *self, PyObject *unused)
+{
+	Py_BEGIN_ALLOW_THREADS
+	poll_rtcc();
+	Py_END_ALLOW_THREADS
+	return Py_BuildValue("(iiiiii)", get_rtcc_year(), get_rtcc_month(), get_rtcc_date(),
+						 get_rtcc_hour(), get_rtcc_minute(), get_rtcc_second());
+}
+
+/**
+ * @brief Reads every channel, or the channels of a mask, with one burst per chip like getSnapshotChannels.
+ * @param args Optional int mask of channels, bit n for channel n of SensorChannel_t
+ * @return tuple with one entry per channel, a (value, timestamp_ns) tuple or None if the channel was not read.
+ */
+static PyObject* py_getSnapshot(FASTCALL_PARAMS)
+{
+	FASTCALL_UNPACK
+	SensorSnapshot_t snapshot;
+	unsigned long channels = SENSOR_ALL_CHANNELS;
+
+	if(nargs > 1)
+	{
+		PyErr_SetString(PyExc_TypeError, "getSnapshot takes at most one argument");
+		return NULL;
+	}
+	if(nargs == 1)
+	{
+		channels = PyLong_AsUnsignedLongMask(args[0]);
+		if(PyErr_Occurred())
+		{
+			return NULL;
+		}
+	}
+	Py_BEGIN_ALLOW_THREADS
+	getSnapshotChannels(&snapshot, channels);
+	Py_END_ALLOW_THREADS
+	return snapshotTuple(&snapshot);
+}
+
+/**
+ * @brief Copies the latest published readings without touching the bus, like getLatestSnapshot.
+ * @return tuple in the form of getSnapshot.
+ */
+static PyObject* py_getLatestSnapshot(PyObject *self, PyObject *unused)
+{
+	SensorSnapshot_t snapshot;
+
+	getLatestSnapshot(&snapshot);
+	return snapshotTuple(&snapshot);
+}
+
+/// @}
+
+/**
+ * @brief Builds the tuple returned by getSnapshot, None for the channels not valid.
+ */
+static PyObject* snapshotTuple(const SensorSnapshot_t *snapshot)
+{
+	PyObject *tuple = PyTuple_New(SENSOR_CHANNEL_COUNT);
+
+	if(tuple == NULL)
+	{
+		return NULL;
+	}
+	for(int ch = 0; ch < SENSOR_CHANNEL_COUNT; ch++)
+	{
+		PyObject *item;
+
+		if(snapshot->valid & SENSOR_CHANNEL_BIT(ch))
+		{
+			item = Py_BuildValue("(dK)", (double) snapshot->reading[ch].value,
+								 (unsigned long long) snapshot->reading[ch].timestamp_ns);
+			if(item == NULL)
+			{
+				Py_DECREF(tuple);
+				return NULL;
+			}
+		}
+		else
+		{
+			Py_INCREF(Py_None);
+			item = Py_None;
+		}
+		PyTuple_SET_ITEM(tuple, ch, item);
+	}
+	return tuple;
+}
+
+static PyMethodDef sensorian_methods[] = {
+	{"setupSensorian", py_setupSensorian, METH_NOARGS, "Sets up every sensor on the shield."},
+	{"LED_on", py_LED_on, METH_NOARGS, "Turns the orange LED on."},
+	{"LED_off", py_LED_off, METH_NOARGS, "Turns the orange LED off."},
+	{"getAmbientLight", py_getAmbientLight, METH_NOARGS, "Reads the ambient light level in lux."},
+	{"pollMPL", py_pollMPL, METH_NOARGS, "Polls the MPL3115A2 for temperature, altitude and pressure."},
+	{"getTemperature", py_getTemperature, METH_NOARGS, "Temperature of the last pollMPL."},
+	{"getAltitude", py_getAltitude, METH_NOARGS, "Altitude of the last pollMPL."},
+	{"getBarometricPressure", py_getBarometricPressure, METH_NOARGS, "Pressure of the last pollMPL."},
+	{"pollFXOS", py_pollFXOS, METH_NOARGS, "Polls the FXOS8700CQ for acceleration and magnetic field."},
+	{"getAccelerometer", py_getAccelerometer, METH_NOARGS, "(x, y, z) acceleration of the last pollFXOS."},
+	{"getMagnetometer", py_getMagnetometer, METH_NOARGS, "(x, y, z) magnetic field of the last pollFXOS."},
+	{"getTouchpad", py_getTouchpad, METH_NOARGS, "Pressed capacitive button 1-3, 0 for none."},
+	{"getRTCCtime", py_getRTCCtime, METH_NOARGS, "(year, month, date, hour, minute, second) of the RTCC."},
+	{"getSnapshot", (PyCFunction)(void (*)(void)) py_getSnapshot, FASTCALL_FLAGS,
+	 "getSnapshot([channels]): (value, timestamp_ns) or None for every channel, read in one burst per chip."},
+	{"getLatestSnapshot", py_getLatestSnapshot, METH_NOARGS, "The latest published readings, in the form of getSnapshot."},
+	{NULL, NULL, 0, NULL}
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef sensorian_module = {
+	PyModuleDef_HEAD_INIT, "_sensorian", "Sensorian shield, without ctypes.", -1, sensorian_methods
+};
+
+PyMODINIT_FUNC PyInit__sensorian(void)
+{
+	return PyModule_Create(&sensorian_module);
+}
+#else
+PyMODINIT_FUNC init_sensorian(void)
+{
+	Py_InitModule3("_sensorian", sensorian_methods, "Sensorian shield, without ctypes.");
+}
+#endif
@@ -71,6 +71,8 @@ cp -p PythonSharedObjectSrc/CAP1203/libCAP.so ./libCAP.so
 
 cp -p i2c-devices-interface/libsensorianplus.so ./libsensorianplus.so
 
+cp -p i2c-devices-interface/_sensorian.so ./_sensorian.so
+
 #Enable SPI and I2C interfaces
 sudo sed -i 's/#dtparam=i2c_arm=on/dtparam=i2c_arm=on/g' /boot/config.txt
 sudo sed -i 's/#dtparam=spi=on/dtparam=spi=on/g' /boot/config.txt